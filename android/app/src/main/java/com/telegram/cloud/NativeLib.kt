@@ -27,10 +27,18 @@ object NativeLib {
     external fun nativeOpenDatabase(path: String, passphrase: String?): Boolean
     external fun nativeCloseDatabase(): Boolean
     external fun nativeExportBackup(path: String): Boolean
+    // Solo las filas del catálogo cambiadas desde el último backup; el primero es completo
+    external fun nativeCreateIncrementalBackup(path: String, password: String?): Boolean
     external fun nativeImportBackup(path: String): Boolean
     external fun nativeImportEncryptedBackup(path: String, password: String): Boolean
     external fun nativeStartDownload(url: String, destPath: String): Int
     external fun nativeStopDownload(downloadId: Int): Boolean
     external fun nativeGetDownloadStatus(downloadId: Int): String
     external fun nativeStartUpload(filePath: String, target: String): Int
+    // sortBy: "name" | "size" | "date"; cursor = nextCursor de la página anterior (null = primera)
+    external fun nativeListFiles(sortBy: String, ascending: Boolean, limit: Int, cursor: String?): String
+    external fun nativeSearchFiles(query: String, limit: Int, cursor: String?): String
+    external fun nativeGetCatalogStats(): String
+    // Tiempos de apertura de la base (JSON); firstQueryMillis = 0 hasta la primera lectura
+    external fun nativeGetDatabaseStartupTiming(): String
 }
@@ -7,10 +7,12 @@ import com.telegram.cloud.data.local.CloudFileEntity
 import com.telegram.cloud.data.remote.ChunkedDownloadManager
 import org.json.JSONArray
 import org.json.JSONObject
+import java.io.ByteArrayInputStream
 import java.io.File
 import java.io.FileInputStream
 import java.io.FileOutputStream
 import java.security.SecureRandom
+import java.util.zip.InflaterInputStream
 import javax.crypto.Cipher
 import javax.crypto.SecretKeyFactory
 import javax.crypto.spec.IvParameterSpec
@@ -19,7 +21,7 @@ import javax.crypto.spec.SecretKeySpec
 
 /**
  * Manages encrypted .link files compatible with desktop application
- * Format: salt(16) + iv(16) + encrypted_json
+ * Format: salt(16) + iv(16) + encrypted payload (JSON v1, or binary v2 from desktop)
  * Encryption: AES-256-CBC with PBKDF2-HMAC-SHA256 key derivation (10000 iterations)
  * 
  * Compatible with:
@@ -35,6 +37,9 @@ class ShareLinkManager {
         private const val SALT_LENGTH = 16
         private const val IV_LENGTH = 16
         private const val VERSION = "1.0"
+        // Binary v2 links from desktop (LinkWriter)
+        private val LINK_V2_MAGIC = byteArrayOf('T'.code.toByte(), 'C'.code.toByte(), 'L'.code.toByte(), 0x02)
+        private const val LINK_FLAG_DEFLATE = 0x01
     }
     
     // Data class for parsed share link
@@ -141,10 +146,7 @@ class ShareLinkManager {
             Log.i(TAG, "Reading .link file: ${linkFile.absolutePath}")
             
             val encryptedData = linkFile.readBytes()
-            val jsonData = decryptData(encryptedData, password)
-            
-            Log.d(TAG, "Decrypted JSON: $jsonData")
-            parseJsonData(jsonData)
+            parseLinkData(decryptData(encryptedData, password))
         } catch (e: Exception) {
             Log.e(TAG, "Failed to read link file", e)
             null
@@ -165,8 +167,7 @@ class ShareLinkManager {
             val encryptedData = context.contentResolver.openInputStream(uri)?.use { it.readBytes() }
                 ?: throw Exception("Cannot open URI")
             
-            val jsonData = decryptData(encryptedData, password)
-            parseJsonData(jsonData)
+            parseLinkData(decryptData(encryptedData, password))
         } catch (e: Exception) {
             Log.e(TAG, "Failed to read link file from URI", e)
             null
@@ -289,7 +290,139 @@ class ShareLinkManager {
         }
     }
     
-    // ==================== JSON Parsing (compatible with desktop) ====================
+    // ==================== Parsing (compatible with desktop) ====================
+    
+    private fun parseLinkData(data: ByteArray): ShareLinkData {
+        return if (data.size >= LINK_V2_MAGIC.size + 1 &&
+            data.copyOfRange(0, LINK_V2_MAGIC.size).contentEquals(LINK_V2_MAGIC)) {
+            parseBinaryData(data)
+        } else {
+            parseJsonData(String(data, Charsets.UTF_8))
+        }
+    }
+    
+    /**
+     * Binary v2 format written by desktop's LinkWriter (telegram-cloud-cpp/src/linkformat.cpp):
+     * "TCL" 0x02 | flags (bit 0 = zlib body) | type | (1 file-record)* 0
+     * Integers are LEB128 varints, bot tokens are interned in order of appearance
+     */
+    private fun parseBinaryData(data: ByteArray): ShareLinkData {
+        val flags = data[LINK_V2_MAGIC.size].toInt() and 0xff
+        require(flags and LINK_FLAG_DEFLATE.inv() == 0) { "Unsupported link flags: $flags" }
+        
+        val headerSize = LINK_V2_MAGIC.size + 1
+        val body = if (flags and LINK_FLAG_DEFLATE != 0) {
+            InflaterInputStream(ByteArrayInputStream(data, headerSize, data.size - headerSize)).use { it.readBytes() }
+        } else {
+            data.copyOfRange(headerSize, data.size)
+        }
+        val reader = BinaryLinkReader(body)
+        
+        val type = if (reader.varint() == 0L) "single" else "batch"
+        val tokens = mutableListOf<String>()
+        val files = mutableListOf<SharedFileInfo>()
+        
+        while (reader.varint() != 0L) {
+            val fileId = reader.string()
+            val fileName = reader.string()
+            val fileSize = reader.varint()
+            val mimeType = reader.string()
+            val category = reader.string()
+            val uploadDate = reader.string()
+            val telegramFileId = reader.string()
+            val uploaderBotToken = reader.token(tokens)
+            val isEncrypted = reader.byte() != 0
+            val chunkCount = reader.varint()
+            
+            var chunks: List<SharedChunkInfo>? = null
+            if (chunkCount > 0) {
+                val totalChunks = reader.varint().toInt()
+                var previousNumber = -1L
+                var previousSize = 0L
+                chunks = (0 until chunkCount).map {
+                    val number = previousNumber + 1 + reader.signedVarint()
+                    val size = previousSize + reader.signedVarint()
+                    previousNumber = number
+                    previousSize = size
+                    SharedChunkInfo(
+                        chunkNumber = number.toInt(),
+                        totalChunks = totalChunks,
+                        chunkSize = size,
+                        chunkHash = reader.hash(),
+                        telegramFileId = reader.string(),
+                        uploaderBotToken = reader.token(tokens)
+                    )
+                }
+            }
+            
+            files.add(
+                SharedFileInfo(
+                    fileId = fileId,
+                    fileName = fileName,
+                    fileSize = fileSize,
+                    mimeType = mimeType,
+                    category = category,
+                    uploadDate = uploadDate,
+                    telegramFileId = telegramFileId,
+                    uploaderBotToken = uploaderBotToken,
+                    isEncrypted = isEncrypted,
+                    chunks = chunks
+                )
+            )
+        }
+        
+        return ShareLinkData("2", type, files)
+    }
+    
+    private class BinaryLinkReader(private val data: ByteArray) {
+        private var pos = 0
+        
+        fun byte(): Int {
+            if (pos >= data.size) throw IllegalArgumentException("Truncated link data")
+            return data[pos++].toInt() and 0xff
+        }
+        
+        fun varint(): Long {
+            var value = 0L
+            var shift = 0
+            while (shift < 64) {
+                val b = byte()
+                value = value or ((b and 0x7f).toLong() shl shift)
+                if (b and 0x80 == 0) return value
+                shift += 7
+            }
+            throw IllegalArgumentException("Invalid varint in link data")
+        }
+        
+        fun signedVarint(): Long {
+            val raw = varint()
+            return (raw ushr 1) xor -(raw and 1)
+        }
+        
+        fun bytes(length: Int): ByteArray {
+            if (length < 0 || length > data.size - pos) throw IllegalArgumentException("Truncated link data")
+            return data.copyOfRange(pos, pos + length).also { pos += length }
+        }
+        
+        fun string(): String = String(bytes(varint().toInt()), Charsets.UTF_8)
+        
+        fun hash(): String = when (byte()) {
+            0 -> ""
+            1 -> bytes(32).joinToString("") { "%02x".format(it.toInt() and 0xff) }
+            2 -> string()
+            else -> throw IllegalArgumentException("Invalid chunk hash in link data")
+        }
+        
+        fun token(tokens: MutableList<String>): String {
+            val index = varint()
+            require(index <= tokens.size) { "Invalid token index in link data" }
+            if (index == tokens.size.toLong()) {
+                tokens.add(string())
+            }
+            return tokens[index.toInt()]
+        }
+    }
+    
     
     private fun parseJsonData(jsonString: String): ShareLinkData {
         val json = JSONObject(jsonString)
@@ -369,7 +502,7 @@ class ShareLinkManager {
      * Decrypt data using AES-256-CBC with PBKDF2-HMAC-SHA256
      * Compatible with desktop's UniversalLinkDownloader::decryptData
      */
-    private fun decryptData(data: ByteArray, password: String): String {
+    private fun decryptData(data: ByteArray, password: String): ByteArray {
         if (data.size < SALT_LENGTH + IV_LENGTH) {
             throw IllegalArgumentException("Invalid link file format (file too short)")
         }
@@ -388,8 +521,7 @@ class ShareLinkManager {
         cipher.init(Cipher.DECRYPT_MODE, key, IvParameterSpec(iv))
         
         return try {
-            val decrypted = cipher.doFinal(encrypted)
-            String(decrypted, Charsets.UTF_8)
+            cipher.doFinal(encrypted)
         } catch (e: Exception) {
             throw IllegalArgumentException("Wrong password or corrupted link file", e)
         }
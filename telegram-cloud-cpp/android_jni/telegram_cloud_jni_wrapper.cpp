@@ -17,6 +17,7 @@
 #include "config.h"
 #include "backupmanager.h"
 #include "envmanager.h"
+#include "linkformat.h"
 #include "logger.h"
 #include <nlohmann/json.hpp>
 
@@ -200,6 +201,8 @@ Java_com_telegram_cloud_NativeLib_nativeOpenDatabase(JNIEnv* env, jclass /*clazz
     if (!g_database) {
         g_database = std::make_unique<Database>();
     }
+    // La caché de chunks se ubica junto a la base de datos abierta
+    Config::instance().setDatabasePath(path);
     bool ok = g_database->initialize(path);
     if (!pass.empty()) {
         g_database->setEncryptionKey(pass);
@@ -232,6 +235,19 @@ Java_com_telegram_cloud_NativeLib_nativeExportBackup(JNIEnv* env, jclass /*clazz
     return JNI_TRUE;
 }
 
+// Backup incremental de la cadena actual (completo si aún no hay ninguno)
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_telegram_cloud_NativeLib_nativeCreateIncrementalBackup(JNIEnv* env, jclass /*clazz*/, jstring jPath, jstring jPassword) {
+    std::string path = jstringToStd(env, jPath);
+    std::string password = jstringToStd(env, jPassword);
+    JNILOG_INFO("nativeCreateIncrementalBackup path=%s", path.c_str());
+    if (!g_database) {
+        JNILOG_ERROR("nativeCreateIncrementalBackup: database not open");
+        return JNI_FALSE;
+    }
+    return BackupManager::createIncrementalBackup(path, password, *g_database) ? JNI_TRUE : JNI_FALSE;
+}
+
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_telegram_cloud_NativeLib_nativeImportBackup(JNIEnv* env, jclass /*clazz*/, jstring jPath) {
     std::string archivePath = jstringToStd(env, jPath);
@@ -653,3 +669,92 @@ Java_com_telegram_cloud_NativeLib_nativeGetDownloadStatus(JNIEnv* env, jclass /*
     const char* stub = "{\"status\":\"unknown\",\"progress\":0}";
     return env->NewStringUTF(stub);
 }
+
+// Fila del catálogo para el dashboard (sin el token del bot)
+static nlohmann::json fileInfoToJson(const FileInfo& file) {
+    return {
+        {"fileId", file.fileId},
+        {"fileName", file.fileName},
+        {"fileSize", file.fileSize},
+        {"mimeType", file.mimeType},
+        {"category", file.category},
+        {"uploadDate", file.uploadDate},
+        {"messageId", file.messageId},
+        {"telegramFileId", file.telegramFileId},
+        {"isEncrypted", file.isEncrypted}
+    };
+}
+
+static std::string filePageToJson(nlohmann::json files, const std::string& nextCursor) {
+    nlohmann::json page = {{"files", std::move(files)}, {"nextCursor", nextCursor}};
+    // Nombres con UTF-8 inválido no deben abortar el listado
+    return page.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_telegram_cloud_NativeLib_nativeListFiles(JNIEnv* env, jclass /*clazz*/, jstring jSortBy,
+                                                  jboolean ascending, jint limit, jstring jCursor) {
+    if (!g_database) {
+        return env->NewStringUTF("{\"error\":\"database not open\"}");
+    }
+    
+    std::string sortBy = jstringToStd(env, jSortBy);
+    FileListOptions options;
+    options.sortBy = sortBy == "name" ? FileSortOrder::Name
+                   : sortBy == "size" ? FileSortOrder::Size
+                   : FileSortOrder::Date;
+    options.ascending = ascending == JNI_TRUE;
+    // Siempre paginado: el dashboard pide la siguiente página con nextCursor
+    options.limit = limit > 0 ? std::min<jint>(limit, 1000) : 200;
+    options.cursor = jstringToStd(env, jCursor);
+    
+    nlohmann::json files = nlohmann::json::array();
+    std::string nextCursor;
+    bool ok = g_database->listFiles(options, [&files](const FileInfo& file) {
+        files.push_back(fileInfoToJson(file));
+        return true;
+    }, nextCursor);
+    if (!ok) {
+        return env->NewStringUTF("{\"error\":\"invalid cursor or query failed\"}");
+    }
+    
+    return env->NewStringUTF(filePageToJson(std::move(files), nextCursor).c_str());
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_telegram_cloud_NativeLib_nativeSearchFiles(JNIEnv* env, jclass /*clazz*/, jstring jQuery,
+                                                    jint limit, jstring jCursor) {
+    if (!g_database) {
+        return env->NewStringUTF("{\"error\":\"database not open\"}");
+    }
+    
+    FileSearchPage result = g_database->search(jstringToStd(env, jQuery),
+                                               limit > 0 ? std::min<jint>(limit, 1000) : 50,
+                                               jstringToStd(env, jCursor));
+    if (!result.ok) {
+        return env->NewStringUTF("{\"error\":\"invalid cursor or query failed\"}");
+    }
+    
+    nlohmann::json files = nlohmann::json::array();
+    for (const FileInfo& file : result.files) {
+        files.push_back(fileInfoToJson(file));
+    }
+    return env->NewStringUTF(filePageToJson(std::move(files), result.nextCursor).c_str());
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_telegram_cloud_NativeLib_nativeGetCatalogStats(JNIEnv* env, jclass /*clazz*/) {
+    if (!g_database) {
+        return env->NewStringUTF("{\"error\":\"database not open\"}");
+    }
+    // Lectura de contadores ya agregados: apto para sondeo periódico del dashboard
+    return env->NewStringUTF(g_database->getCatalogStats().toJson().c_str());
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_telegram_cloud_NativeLib_nativeGetDatabaseStartupTiming(JNIEnv* env, jclass /*clazz*/) {
+    if (!g_database) {
+        return env->NewStringUTF("{\"error\":\"database not open\"}");
+    }
+    return env->NewStringUTF(g_database->startupTiming().toJson().c_str());
+}
@@ -0,0 +1,125 @@
+#ifndef BACKUPARCHIVE_H
+#define BACKUPARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+namespace TelegramCloud {
+
+/**
+ * @brief Transformación incremental de bloques (cifrado, compresión...)
+ *
+ * Misma forma que CipherStream: update() añade la salida a out y finish()
+ * vacía lo que quede pendiente.
+ */
+class BlockTransform {
+public:
+    virtual ~BlockTransform() = default;
+    virtual bool update(const char* data, size_t length, std::string& out) = 0;
+    virtual bool finish(std::string& out) = 0;
+};
+
+/**
+ * @brief Escritor ZIP nativo en streaming (sustituye a Compress-Archive)
+ *
+ * Cada entrada pasa por tres etapas solapadas: un hilo lee bloques del
+ * origen, el hilo llamador aplica la transformación opcional y deflate, y un
+ * tercer hilo escribe en disco. Entre etapas hay colas acotadas, así que la
+ * memoria es constante sea cual sea el tamaño del origen.
+ *
+ * Los tamaños y el CRC se parchean en la cabecera local al cerrar la entrada
+ * (sin data descriptors), de modo que java.util.zip.ZipInputStream puede leer
+ * también las entradas STORED. Las entradas grandes usan extensiones ZIP64.
+ */
+class ZipArchiveWriter {
+public:
+    enum class Method : uint16_t { Stored = 0, Deflate = 8 };
+
+    ZipArchiveWriter();
+    ~ZipArchiveWriter();
+
+    ZipArchiveWriter(const ZipArchiveWriter&) = delete;
+    ZipArchiveWriter& operator=(const ZipArchiveWriter&) = delete;
+
+    bool open(const std::string& path);
+
+    /**
+     * @brief Añadir una entrada leyendo el origen en streaming
+     * @param transform Transformación aplicada antes de comprimir (puede ser nulo)
+     * @param sizeHint Tamaño aproximado del origen, para reservar cabeceras ZIP64
+     */
+    bool addEntry(const std::string& name, std::istream& source, Method method,
+                  BlockTransform* transform = nullptr, uint64_t sizeHint = 0);
+
+    bool addEntry(const std::string& name, const std::string& data, Method method);
+
+    /**
+     * @brief Escribir el directorio central y cerrar el archivo
+     */
+    bool close();
+
+private:
+    struct CentralEntry {
+        std::string name;
+        uint16_t method = 0;
+        uint32_t crc = 0;
+        uint64_t compressedSize = 0;
+        uint64_t uncompressedSize = 0;
+        uint64_t localHeaderOffset = 0;
+        bool zip64 = false;
+    };
+
+    bool writeLocalHeader(CentralEntry& entry);
+    bool patchLocalHeader(const CentralEntry& entry);
+    bool writeCentralDirectory();
+
+    std::ofstream m_out;
+    std::vector<CentralEntry> m_entries;
+    uint16_t m_dosTime;
+    uint16_t m_dosDate;
+    bool m_failed;
+};
+
+/**
+ * @brief Lector ZIP nativo (ZIP64, STORED y DEFLATE) que extrae en streaming
+ *
+ * Lee el directorio central, por lo que acepta tanto los archivos propios
+ * como los creados por Compress-Archive en versiones anteriores.
+ */
+class ZipArchiveReader {
+public:
+    struct Entry {
+        std::string name;
+        uint16_t method = 0;
+        uint32_t crc = 0;
+        uint64_t compressedSize = 0;
+        uint64_t uncompressedSize = 0;
+        uint64_t localHeaderOffset = 0;
+    };
+
+    using Sink = std::function<bool(const char* data, size_t length)>;
+
+    bool open(const std::string& path);
+    const std::vector<Entry>& entries() const { return m_entries; }
+    const Entry* find(const std::string& name) const;
+
+    /**
+     * @brief Extraer una entrada bloque a bloque, verificando el CRC
+     */
+    bool extract(const Entry& entry, const Sink& sink);
+    bool extractToString(const Entry& entry, std::string& out, size_t maxBytes = 1024 * 1024);
+
+private:
+    bool readCentralDirectory(uint64_t fileSize);
+
+    std::ifstream m_in;
+    std::vector<Entry> m_entries;
+};
+
+} // namespace TelegramCloud
+
+#endif // BACKUPARCHIVE_H
@@ -1,26 +1,36 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace TelegramCloud {
 
+class Database;
+
 class BackupManager {
 public:
-    // Crea un .zip con .env y la base de datos usando PowerShell (sin dependencias externas)
+    // Crea un .zip con .env y la base de datos en streaming (escritor ZIP nativo, memoria constante).
     // Si password no está vacío, se guardan .env y DB en versión cifrada (.enc) y se incluye manifest JSON.
-    static bool createZipBackup(const std::string& archivePath, const std::string& password = "");
+    // Si se pasa database, la DB se copia con la API de backup online sin necesidad de cerrarla.
+    static bool createZipBackup(const std::string& archivePath, const std::string& password = "",
+                                Database* database = nullptr);
+
+    // Backup incremental: solo .env y las filas modificadas desde el último backup de la cadena
+    // (delta SQLCipher exportado del diario de cambios). Sin backup previo crea uno completo.
+    static bool createIncrementalBackup(const std::string& archivePath, const std::string& password,
+                                        Database& database);
 
     // Extrae un .zip en el directorio de trabajo (sobrescribe archivos). Si el backup es cifrado,
-    // se requiere password para descifrar los .enc extraídos.
+    // se requiere password y se descifra al vuelo; devuelve false si la contraseña no es válida.
     static bool restoreZipBackup(const std::string& archivePath, const std::string& password = "");
 
+    // Restaura un backup completo seguido de sus incrementales, en orden. Los deltas quedan
+    // junto a la DB y se reaplican al abrirla (Database::replayPendingChanges).
+    static bool restoreBackupChain(const std::vector<std::string>& archivePaths, const std::string& password = "");
+
     // Encrypt/decrypt individual files (public for Android JNI usage)
     static bool encryptFile(const std::string& in, const std::string& out, const std::string& password);
     static bool decryptFile(const std::string& in, const std::string& out, const std::string& password);
-
-private:
-    static std::string quote(const std::string& s);
-    static std::string randomBytes(size_t n);
 };
 
 } // namespace TelegramCloud
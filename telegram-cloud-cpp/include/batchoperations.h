@@ -10,6 +10,8 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <functional>
+#include <atomic>
 
 namespace TelegramCloud {
 
@@ -57,17 +59,28 @@ public:
     std::string generateGlobalShareData(const std::vector<BatchFileInfo>& files);
     
 private:
+    // Estado de un archivo dentro de una descarga por lote concurrente
+    struct BatchDownloadJob {
+        BatchFileInfo info;
+        std::vector<ChunkInfo> chunks;
+        std::string telegramFileId;
+        std::string botToken;
+        std::string fullPath;
+        std::string password;
+        std::string tempDir;
+        std::atomic<int> remaining{0};
+        std::atomic<bool> failed{false};
+    };
+    
     Database* m_database;
     TelegramHandler* m_telegramHandler;
     
     // Funciones auxiliares
     bool deleteSingleFile(const std::string& fileId, const std::string& fileName);
-    bool downloadSingleFile(const BatchFileInfo& fileInfo, const std::string& destinationDir, const std::string& decryptionPassword = "");
-    bool downloadChunkedFile(const BatchFileInfo& fileInfo, const std::vector<ChunkInfo>& chunks, const std::string& fullPath, const std::string& decryptionPassword);
-    bool downloadDirectFile(const BatchFileInfo& fileInfo, const std::string& fullPath, const std::string& decryptionPassword);
+    bool downloadBatchChunk(const ChunkInfo& chunk, const std::string& tempDir);
+    bool assembleChunkedFile(const std::vector<ChunkInfo>& chunks, const std::string& tempDir, const std::string& fullPath, const std::string& decryptionPassword);
+    bool downloadDirectFile(const std::string& telegramFileId, const std::string& botToken, const std::string& fullPath, const std::string& decryptionPassword);
     bool decryptFile(const std::string& inputPath, const std::string& outputPath, const std::string& password);
-    std::string aesDecrypt(const std::string& ciphertext, const std::string& password);
-    std::string deriveKey(const std::string& password, const std::string& salt);
     std::string encryptShareData(const std::string& data, const std::string& password);
 };
 
@@ -0,0 +1,93 @@
+#ifndef CHUNKBITMAP_H
+#define CHUNKBITMAP_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <chrono>
+#include <functional>
+
+namespace TelegramCloud {
+
+/**
+ * @brief Mapa de bits compacto de chunks (un bit por chunk)
+ *
+ * Se usa para persistir qué rangos de una transferencia ya fueron
+ * verificados sin escribir una fila por chunk. Se serializa comprimido
+ * (runs en varint) porque el progreso suele ser un prefijo contiguo.
+ */
+class ChunkBitmap {
+public:
+    ChunkBitmap() : m_size(0) {}
+    explicit ChunkBitmap(int64_t size) { resize(size); }
+
+    void resize(int64_t size);
+    int64_t size() const { return m_size; }
+
+    void set(int64_t index);
+    void reset(int64_t index);
+    bool test(int64_t index) const;
+
+    int64_t count() const;
+    bool all() const { return m_size > 0 && count() == m_size; }
+    void clear();
+
+    // Serialización a blob binario (para columnas BLOB de SQLite)
+    std::string serialize() const;
+
+    /**
+     * @brief Reconstruir desde serialize()
+     * @param expectedSize Número de chunks de la transferencia; si el blob declara
+     *        otro tamaño (o está corrupto) se devuelve un mapa vacío. Con -1 solo
+     *        se acota a MAX_SIZE
+     */
+    static ChunkBitmap deserialize(const std::string& blob, int64_t expectedSize = -1);
+
+    // Tope de chunks aceptado sin tamaño esperado (8MB de palabras)
+    static constexpr int64_t MAX_SIZE = int64_t(1) << 26;
+
+private:
+    std::vector<uint64_t> m_words;
+    int64_t m_size;
+};
+
+/**
+ * @brief Estado de reanudación de una transferencia en memoria
+ *
+ * Marca chunks completados en un ChunkBitmap y lo vuelca a la BD solo cada
+ * FLUSH_EVERY_CHUNKS chunks o FLUSH_INTERVAL, y al pausar/terminar con flush().
+ */
+class TransferCheckpoint {
+public:
+    using FlushFunction = std::function<void(const std::string& bitmapBlob, int64_t completedChunks)>;
+
+    void reset(const ChunkBitmap& bitmap, FlushFunction flushFunction);
+
+    /**
+     * @brief Marcar chunk completado; vuelca si toca
+     * @return Número de chunks completados
+     */
+    int64_t markCompleted(int64_t index);
+
+    bool isCompleted(int64_t index) const;
+    int64_t completedCount() const;
+
+    void flush();
+
+    static constexpr int FLUSH_EVERY_CHUNKS = 32;
+    static constexpr std::chrono::seconds FLUSH_INTERVAL{2};
+
+private:
+    ChunkBitmap m_bitmap;
+    FlushFunction m_flushFunction;
+    int m_pendingChanges = 0;
+    std::chrono::steady_clock::time_point m_lastFlush;
+
+    mutable std::mutex m_mutex;
+    std::mutex m_flushMutex;
+};
+
+} // namespace TelegramCloud
+
+#endif // CHUNKBITMAP_H
@@ -0,0 +1,117 @@
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include <string>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace TelegramCloud {
+
+/**
+ * @brief Caché persistente en disco de chunks descargados
+ *
+ * Los chunks se direccionan por contenido: la clave es el telegram file_id
+ * (o el hash del chunk) y el objeto se guarda como SHA-256(clave) dentro del
+ * directorio de caché. Todas las rutas de descarga comparten esta instancia.
+ *
+ * - Presupuesto de bytes configurable con expulsión LRU.
+ * - Admisión en el segundo acceso: la primera vez que se ofrece un chunk solo
+ *   se recuerda su nombre; se guarda si vuelve a descargarse. Así una única
+ *   descarga grande no vacía la caché de chunks que sí se reutilizan.
+ * - store() enlaza (hard link) el chunk descargado en vez de copiarlo; solo
+ *   copia si el sistema de archivos no admite enlaces.
+ * - Escritura atómica (archivo .part + rename): un crash nunca deja objetos
+ *   a medias visibles. El índice solo guarda el orden LRU y se reconstruye
+ *   a partir del directorio si falta o está corrupto.
+ * - Lectores concurrentes bajo shared_mutex; solo inserción/expulsión
+ *   toman el lock exclusivo.
+ */
+class ChunkCache {
+public:
+    static ChunkCache& instance();
+
+    /**
+     * @brief Inicializar la caché (idempotente)
+     * @param cacheDir Directorio de la caché
+     * @param maxBytes Presupuesto máximo en bytes
+     *
+     * Si falla, la inicialización perezosa queda desactivada y la caché no
+     * se usa hasta una nueva llamada explícita que tenga éxito.
+     */
+    bool initialize(const std::string& cacheDir, int64_t maxBytes);
+
+    /**
+     * @brief Copiar un chunk cacheado a destPath
+     * @return true si el chunk estaba en caché y se copió
+     */
+    bool fetch(const std::string& key, const std::string& destPath);
+
+    /**
+     * @brief Ofrecer a la caché el chunk descargado en srcPath
+     * @return true si el chunk quedó en caché (no en su primer acceso)
+     */
+    bool store(const std::string& key, const std::string& srcPath);
+
+    bool contains(const std::string& key);
+    bool isDisabled() const { return m_disabled.load(); }
+    void remove(const std::string& key);
+    void clear();
+
+    void setMaxBytes(int64_t maxBytes);
+    int64_t maxBytes() const { return m_maxBytes.load(); }
+    int64_t totalBytes() const { return m_totalBytes.load(); }
+
+    /**
+     * @brief Persistir el orden LRU en disco
+     */
+    void flushIndex();
+
+private:
+    ChunkCache();
+    ~ChunkCache();
+    ChunkCache(const ChunkCache&) = delete;
+    ChunkCache& operator=(const ChunkCache&) = delete;
+
+    struct Entry {
+        int64_t size = 0;
+        std::atomic<uint64_t> lastAccess{0};
+    };
+
+    bool ensureInitialized();
+    void loadIndex();
+    void evictLocked(int64_t incomingBytes);
+    std::string objectName(const std::string& key) const;
+    std::string objectPath(const std::string& name) const;
+    bool shouldAdmit(const std::string& name);
+
+    std::string m_cacheDir;
+    std::atomic<int64_t> m_maxBytes;
+    std::atomic<int64_t> m_totalBytes;
+    std::atomic<uint64_t> m_accessClock;
+    std::atomic<int> m_opsSinceFlush;
+    bool m_initialized;
+    std::atomic<bool> m_disabled;
+
+    std::unordered_map<std::string, Entry> m_entries;
+    mutable std::shared_mutex m_mutex;
+
+    // fetch() y store() pueden volcar el índice a la vez: comparten el .tmp
+    std::mutex m_flushMutex;
+
+    // Chunks vistos una vez y aún no admitidos (FIFO acotada)
+    std::unordered_map<std::string, uint64_t> m_seenOnce;
+    std::deque<std::pair<uint64_t, std::string>> m_seenOrder;
+    uint64_t m_seenSequence;
+    std::mutex m_seenMutex;
+
+    static constexpr int FLUSH_EVERY_OPS = 64;
+    static constexpr size_t SEEN_ONCE_CAPACITY = 8192;
+};
+
+} // namespace TelegramCloud
+
+#endif // CHUNKCACHE_H
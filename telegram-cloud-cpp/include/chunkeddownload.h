@@ -9,11 +9,12 @@
 #include <set>
 #include <map>
 #include "database.h"
+#include "chunkbitmap.h"
+#include "telegramnotifier.h"
 
 namespace TelegramCloud {
 
 class TelegramHandler;
-class TelegramNotifier;
 
 /**
  * @brief Gestor de descarga de archivos chunked con persistencia
@@ -61,6 +62,7 @@ private:
     // Validación y reanudación
     bool validateExistingChunks(const std::string& tempDir, std::set<int64_t>& validChunks);
     bool loadDownloadState(const std::string& downloadId);
+    void resetCheckpoint(const ChunkBitmap& bitmap);
     
     // Estado compartido entre instancias para control de pause/cancel
     static std::map<std::string, std::atomic<bool>> s_pausedDownloads;
@@ -70,6 +72,7 @@ private:
     Database* m_database;
     TelegramHandler* m_telegramHandler;
     TelegramNotifier* m_notifier;
+    OperationHandle m_notifierHandle;
     
     // Download state
     std::string m_downloadId;
@@ -85,6 +88,7 @@ private:
     int64_t m_totalChunks;
     std::atomic<int64_t> m_completedChunks;
     std::vector<ChunkInfo> m_chunks;
+    TransferCheckpoint m_checkpoint;
     
     // Sincronización
     std::mutex m_stateMutex;
@@ -10,11 +10,12 @@
 #include <set>
 #include <map>
 #include "database.h"
+#include "chunkbitmap.h"
+#include "telegramnotifier.h"
 
 namespace TelegramCloud {
 
 class TelegramHandler;
-class TelegramNotifier;
 
 /**
  * @brief Gestor de subida de archivos con chunking paralelo
@@ -65,6 +66,7 @@ private:
     // Validación y reanudación
     bool validateExistingChunks(const std::string& filePath, std::set<int64_t>& validChunks);
     bool loadUploadState(const std::string& uploadId);
+    void resetCheckpoint(const ChunkBitmap& bitmap);
     
     // Estado compartido entre instancias para control de pause/cancel
     static std::map<std::string, std::atomic<bool>> s_pausedUploads;
@@ -74,6 +76,7 @@ private:
     Database* m_database;
     TelegramHandler* m_telegramHandler;
     TelegramNotifier* m_notifier;
+    OperationHandle m_notifierHandle;
     
     // Upload state
     std::string m_uploadId;
@@ -90,6 +93,8 @@ private:
     int64_t m_totalChunks;
     std::atomic<int64_t> m_completedChunks;
     int64_t m_currentChunkIndex;
+    TransferCheckpoint m_checkpoint;
+    bool m_metadataCommitted;   // false si se perdió un lote con chunks de esta pasada
     
     // Sincronización
     std::mutex m_stateMutex;
@@ -0,0 +1,45 @@
+#ifndef CHUNKINTEGRITY_H
+#define CHUNKINTEGRITY_H
+
+#include <string>
+#include <cstdint>
+#include "database.h"
+
+namespace TelegramCloud {
+
+class TelegramHandler;
+
+/**
+ * @brief Verificación de integridad de chunks durante la descarga
+ *
+ * El SHA-256 se calcula mientras los bytes se escriben a disco, por lo que
+ * la verificación no requiere una segunda lectura. Un chunk corrupto o
+ * truncado se reintenta de forma aislada en lugar de fallar el archivo.
+ */
+class ChunkIntegrity {
+public:
+    /**
+     * @brief SHA-256 en hexadecimal de un archivo (vacío si no se puede abrir)
+     */
+    static std::string fileSha256Hex(const std::string& path);
+
+    /**
+     * @brief Comparar el hash almacenado con el calculado
+     *
+     * Hash vacío: no hay referencia, se acepta. Formato heredado
+     * "chunk_hash_<bytes>": solo se puede validar el tamaño.
+     */
+    static bool matches(const std::string& expectedHash, const std::string& actualHex, int64_t actualSize);
+
+    /**
+     * @brief Obtener un chunk verificado (caché local o red), reintentando solo este chunk
+     * @param botToken Token a usar (vacío = token principal)
+     */
+    static bool fetchVerifiedChunk(TelegramHandler* handler, const ChunkInfo& chunk,
+                                   const std::string& chunkPath, const std::string& botToken,
+                                   int maxAttempts = 3);
+};
+
+} // namespace TelegramCloud
+
+#endif // CHUNKINTEGRITY_H
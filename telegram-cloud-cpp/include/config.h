@@ -6,6 +6,7 @@
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
 
 namespace TelegramCloud {
 
@@ -29,10 +30,18 @@ public:
     int chunkThreshold() const { return m_chunkThreshold; }
     int maxRetries() const { return m_maxRetries; }
     int apiPort() const { return m_apiPort; }
+    int downloadMaxInFlight() const { return m_downloadMaxInFlight; }
+    int downloadPerTokenLimit() const { return m_downloadPerTokenLimit; }
     std::string apiHost() const { return m_apiHost; }
     
     // Database Configuration
     std::string databasePath() const { return m_databasePath; }
+    void setDatabasePath(const std::string& path) { m_databasePath = path; }
+    
+    // Chunk Cache Configuration
+    // CHUNK_CACHE_PATH o, si no se configuró, "chunk_cache" junto a la base de datos
+    std::string chunkCachePath() const;
+    int64_t chunkCacheMaxBytes() const { return m_chunkCacheMaxBytes; }
     
     // Logging Configuration
     std::string logLevel() const { return m_logLevel; }
@@ -51,6 +60,9 @@ public:
     static constexpr int DEFAULT_CHUNK_THRESHOLD = 4 * 1024 * 1024;
     static constexpr int DEFAULT_MAX_RETRIES = 3;
     static constexpr int DEFAULT_API_PORT = 5000;
+    static constexpr int DEFAULT_DOWNLOAD_MAX_IN_FLIGHT = 8;
+    static constexpr int DEFAULT_DOWNLOAD_PER_TOKEN_LIMIT = 5;
+    static constexpr int64_t DEFAULT_CHUNK_CACHE_MAX_BYTES = 512LL * 1024 * 1024; // 512MB
     
 private:
     Config();
@@ -78,11 +90,17 @@ private:
     int m_chunkThreshold;
     int m_maxRetries;
     int m_apiPort;
+    int m_downloadMaxInFlight;
+    int m_downloadPerTokenLimit;
     std::string m_apiHost;
     
     // Database
     std::string m_databasePath;
     
+    // Chunk Cache
+    std::string m_chunkCachePath;
+    int64_t m_chunkCacheMaxBytes;
+    
     // Logging
     std::string m_logLevel;
     std::string m_logPath;
@@ -0,0 +1,272 @@
+#ifndef CRYPTOENGINE_H
+#define CRYPTOENGINE_H
+
+#include <string>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+namespace TelegramCloud {
+
+/**
+ * @brief Contexto AES-256-CBC reutilizable
+ *
+ * Envuelve un EVP_CIPHER_CTX que se reinicializa con cada clave/IV en lugar
+ * de crearse y destruirse por operación. Procesa los datos por bloques, de
+ * modo que el consumo de memoria no depende del tamaño del archivo.
+ */
+class CipherStream {
+public:
+    enum class Mode { Encrypt, Decrypt };
+
+    CipherStream();
+    ~CipherStream();
+
+    CipherStream(const CipherStream&) = delete;
+    CipherStream& operator=(const CipherStream&) = delete;
+
+    /**
+     * @brief Preparar el contexto para una nueva operación
+     * @param key Clave de 32 bytes
+     * @param iv IV de 16 bytes
+     */
+    bool init(Mode mode, const std::string& key, const std::string& iv);
+
+    /**
+     * @brief Procesar un bloque de datos, añadiendo la salida a out
+     */
+    bool update(const void* data, size_t length, std::string& out);
+
+    /**
+     * @brief Terminar la operación (padding PKCS#7), añadiendo la salida a out
+     * @return false si el padding no es válido (contraseña incorrecta o datos corruptos)
+     */
+    bool finish(std::string& out);
+
+private:
+    EVP_CIPHER_CTX* m_ctx;
+    bool m_ready;
+};
+
+/**
+ * @brief Aceleración por hardware disponible para AES
+ */
+struct CryptoHardwareInfo {
+    bool aesni = false;        // x86/x64 AES-NI
+    bool armCrypto = false;    // ARMv8 Crypto Extensions
+    std::string describe() const;
+};
+
+/**
+ * @brief SHA-256 incremental para datos que llegan por partes
+ *
+ * Para descargas y archivos que se hashean mientras se escriben o leen,
+ * sin tenerlos enteros en memoria.
+ */
+class Sha256Stream {
+public:
+    Sha256Stream();
+    ~Sha256Stream();
+
+    Sha256Stream(const Sha256Stream&) = delete;
+    Sha256Stream& operator=(const Sha256Stream&) = delete;
+
+    void update(const void* data, size_t length);
+
+    /**
+     * @brief Digest binario de 32 bytes (vacío si OpenSSL falla)
+     */
+    std::string finish();
+
+private:
+    EVP_MD_CTX* m_ctx;
+    bool m_ok;
+};
+
+/**
+ * @brief Sobrescribe un secreto con OPENSSL_cleanse al salir de ámbito
+ */
+class SecretWipe {
+public:
+    explicit SecretWipe(std::string& secret) : m_secret(secret) {}
+    ~SecretWipe();
+
+    SecretWipe(const SecretWipe&) = delete;
+    SecretWipe& operator=(const SecretWipe&) = delete;
+
+private:
+    std::string& m_secret;
+};
+
+/**
+ * @brief Caché de claves derivadas por PBKDF2 durante la sesión
+ *
+ * Descifrar muchos archivos o enlaces con la misma contraseña y salt no
+ * vuelve a ejecutar PBKDF2. La entrada se indexa por
+ * (huella de la contraseña, salt, iteraciones): la huella es un HMAC con un
+ * secreto aleatorio del proceso, así que la contraseña nunca se guarda en
+ * claro. Las claves se borran con OPENSSL_cleanse al expulsarlas, al caducar
+ * o en clear(); las copias devueltas las borra el llamador (SecretWipe).
+ *
+ * Solo el descifrado pasa por la caché: cada archivo o enlace cifrado lleva
+ * un salt aleatorio propio, así que dos artefactos con la misma contraseña
+ * no comparten clave ni se delatan entre sí. Lo que se reaprovecha es la
+ * clave de un mismo salt: reanudar una descarga, volver a abrir un enlace o
+ * descifrar varias veces el mismo archivo cuesta un solo PBKDF2.
+ */
+class DerivedKeyCache {
+public:
+    static DerivedKeyCache& instance();
+
+    /**
+     * @brief Clave PBKDF2-HMAC-SHA256 de 32 bytes, desde caché si existe
+     */
+    std::string pbkdf2(const std::string& password, const std::string& salt, int iterations);
+
+    /**
+     * @brief Borrar (y sobrescribir) todas las claves, p. ej. al cerrar sesión
+     */
+    void clear();
+
+    void setCapacity(size_t capacity);
+    size_t size() const;
+    uint64_t hits() const { return m_hits.load(); }
+    uint64_t misses() const { return m_misses.load(); }
+
+private:
+    DerivedKeyCache();
+    ~DerivedKeyCache();
+    DerivedKeyCache(const DerivedKeyCache&) = delete;
+    DerivedKeyCache& operator=(const DerivedKeyCache&) = delete;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string key;
+        Clock::time_point lastUse;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    std::string cacheKey(const std::string& password, const std::string& salt, int iterations) const;
+    void evictLocked(std::unordered_map<std::string, Entry>::iterator it);
+    void expireLocked(Clock::time_point now);
+
+    std::string m_sessionSecret;
+    size_t m_capacity;
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::list<std::string> m_lru;   // más reciente al frente
+    mutable std::mutex m_mutex;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+    static constexpr std::chrono::minutes IDLE_TIMEOUT{15};
+};
+
+/**
+ * @brief Primitivas criptográficas comunes a toda la aplicación
+ *
+ * Reúne AES-256-CBC, PBKDF2-SHA256 y SHA-256, que antes estaban copiados en
+ * cada módulo. Los formatos en disco no cambian: los enlaces y archivos
+ * compartidos siguen siendo salt(16) | iv(16) | ciphertext con la clave
+ * derivada por PBKDF2; cada llamador conserva su propia cabecera y método de
+ * derivación y solo delega el cifrado.
+ *
+ * Las funciones sobre buffers lanzan std::runtime_error; las de streams y
+ * archivos devuelven false y registran el error.
+ */
+class CryptoEngine {
+public:
+    static constexpr size_t KEY_SIZE = 32;
+    static constexpr size_t IV_SIZE = 16;
+    static constexpr size_t SALT_SIZE = 16;
+    static constexpr size_t STREAM_BUFFER_SIZE = 64 * 1024;
+    static constexpr int LINK_PBKDF2_ITERATIONS = 10000;
+
+    static std::string randomBytes(size_t length);
+
+    /**
+     * @brief SHA-256 binario (32 bytes) de la concatenación a || b
+     */
+    static std::string sha256(const std::string& a, const std::string& b = std::string());
+
+    /**
+     * @brief SHA-256 en hexadecimal en minúsculas, el formato de chunk_hash
+     */
+    static std::string sha256Hex(const void* data, size_t length);
+
+    /**
+     * @brief Hexadecimal en minúsculas, dos caracteres por byte
+     */
+    static std::string toHex(const std::string& bytes);
+    static std::string toHex(const void* data, size_t length);
+
+    /**
+     * @brief Derivar una clave de 32 bytes con PBKDF2-HMAC-SHA256
+     */
+    static std::string deriveKeyPbkdf2(const std::string& password, const std::string& salt,
+                                       int iterations = LINK_PBKDF2_ITERATIONS);
+
+    /**
+     * @brief PBKDF2-HMAC-SHA1 de 32 bytes: la derivación que hace SQLCipher con
+     * cipher_kdf_algorithm = PBKDF2_HMAC_SHA1 (para abrir con clave en bruto)
+     */
+    static std::string deriveKeyPbkdf2Sha1(const std::string& password, const std::string& salt, int iterations);
+
+    /**
+     * @brief Igual que deriveKeyPbkdf2 pero a través de DerivedKeyCache
+     */
+    static std::string deriveKeyPbkdf2Cached(const std::string& password, const std::string& salt,
+                                             int iterations = LINK_PBKDF2_ITERATIONS);
+
+    /**
+     * @brief Cifrar/descifrar un buffer completo con una clave ya derivada
+     */
+    static std::string encrypt(const std::string& plaintext, const std::string& key, const std::string& iv);
+    static std::string decrypt(const std::string& ciphertext, const std::string& key, const std::string& iv);
+
+    /**
+     * @brief Formato salt | iv | ciphertext con clave PBKDF2 de la contraseña
+     *
+     * Cada cifrado usa un salt y un IV nuevos; solo el descifrado usa DerivedKeyCache.
+     */
+    static std::string encryptWithPassword(const std::string& plaintext, const std::string& password,
+                                           int iterations = LINK_PBKDF2_ITERATIONS);
+    static std::string decryptWithPassword(const std::string& blob, const std::string& password,
+                                           int iterations = LINK_PBKDF2_ITERATIONS);
+
+    /**
+     * @brief Cifrar/descifrar en streaming con buffers de tamaño fijo
+     */
+    static bool encryptStream(std::istream& in, std::ostream& out, const std::string& key, const std::string& iv);
+    static bool decryptStream(std::istream& in, std::ostream& out, const std::string& key, const std::string& iv);
+
+    /**
+     * @brief Archivos en formato salt | iv | ciphertext (PBKDF2), en streaming
+     *
+     * Si el descifrado falla se elimina la salida parcial.
+     */
+    static bool encryptFileWithPassword(const std::string& inputPath, const std::string& outputPath,
+                                        const std::string& password,
+                                        int iterations = LINK_PBKDF2_ITERATIONS);
+    static bool decryptFileWithPassword(const std::string& inputPath, const std::string& outputPath,
+                                        const std::string& password,
+                                        int iterations = LINK_PBKDF2_ITERATIONS);
+
+    static const CryptoHardwareInfo& hardwareInfo();
+};
+
+} // namespace TelegramCloud
+
+#endif // CRYPTOENGINE_H
@@ -4,7 +4,14 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
 #include <sqlite3.h>
+#include "metadatawriter.h"
+#include "readconnectionpool.h"
 #include <random>
 #include <sstream>
 #include <iomanip>
@@ -65,8 +72,85 @@ struct DownloadInfo {
     std::string tempDir;
 };
 
+enum class FileSortOrder {
+    Name,
+    Size,
+    Date
+};
+
+/**
+ * @brief Página del catálogo con paginación por clave (sort key, id)
+ *
+ * cursor es opaco: vacío para la primera página, o el nextCursor devuelto
+ * por la anterior. limit <= 0 recorre hasta el final.
+ */
+struct FileListOptions {
+    FileSortOrder sortBy = FileSortOrder::Date;
+    bool ascending = false;
+    int limit = 200;
+    std::string cursor;
+};
+
+/**
+ * @brief Resultados de Database::search (bm25, o recientes primero si hay muchos)
+ */
+struct FileSearchPage {
+    bool ok = false;
+    std::vector<FileInfo> files;
+    std::string nextCursor;   // vacío = no hay más resultados
+};
+
+// Devuelve false para detener el recorrido
+using FileVisitor = std::function<bool(const FileInfo&)>;
+
+// Chunks de un archivo, ordenados por chunk_number; false detiene el recorrido
+using FileChunksVisitor = std::function<bool(const std::string& fileId, std::vector<ChunkInfo>& chunks)>;
+
+struct StatsCounter {
+    std::string key;
+    int64_t items = 0;
+    int64_t bytes = 0;
+};
+
+/**
+ * @brief Estadísticas del catálogo mantenidas por triggers (tabla catalog_stats)
+ *
+ * bots agrupa archivos y chunks por el bot que los subió; key es el id del
+ * bot, no el token.
+ */
+struct CatalogStats {
+    int64_t totalFiles = 0;
+    int64_t totalBytes = 0;
+    int64_t totalChunks = 0;
+    int64_t chunkBytes = 0;
+    std::vector<StatsCounter> categories;
+    std::vector<StatsCounter> mimeTypes;
+    std::vector<StatsCounter> bots;
+    std::string toJson() const;
+};
+
+/**
+ * @brief Tiempos de Database::initialize hasta la primera consulta del catálogo (ms)
+ */
+struct DatabaseStartupTiming {
+    double openMillis = 0.0;        // sqlite3_open_v2
+    double keyMillis = 0.0;         // PRAGMA key + verificación (incluye el KDF sin clave en bruto)
+    double schemaMillis = 0.0;      // journal + comprobación de versión / migraciones
+    double readyMillis = 0.0;       // initialize() completo
+    double firstQueryMillis = 0.0;  // desde initialize() hasta la primera lectura terminada (0 = aún no)
+    bool rawKey = false;            // abierta con la clave derivada en caché
+    std::string toJson() const;
+};
+
 /**
  * @brief Manejo de base de datos SQLite
+ *
+ * Las consultas de texto fijo reutilizan su sqlite3_stmt (caché indexada por
+ * el SQL, con reset + clear_bindings al liberar). La conexión usa WAL.
+ *
+ * m_db es la única conexión de escritura (serializada por m_writeMutex); el
+ * listado, la búsqueda y las estadísticas leen en paralelo desde un pool de
+ * conexiones de solo lectura con la misma clave.
  */
 class Database {
 public:
@@ -82,10 +166,23 @@ public:
     bool setEncryptionKey(const std::string& key);
     bool isDatabaseEncrypted();
     
+    DatabaseStartupTiming startupTiming() const;
+    
+    // Copia consistente de la base abierta (API de backup online de SQLite)
+    bool backupTo(const std::string& destPath, int pagesPerStep = 256);
+    
     // File operations
     bool saveFileInfo(const FileInfo& fileInfo);
     std::vector<FileInfo> getFiles();
+    // Recorre una página sin materializarla; nextCursor vacío = no hay más filas
+    bool listFiles(const FileListOptions& options, const FileVisitor& visitor, std::string& nextCursor);
+    // Búsqueda por subcadena en nombre, tipo MIME y categoría (FTS5 trigram).
+    // Ordena por relevancia salvo consultas con muchas coincidencias (recientes primero)
+    FileSearchPage search(const std::string& query, int limit = 50, const std::string& cursor = "");
     FileInfo getFileInfo(const std::string& fileId);
+    // Varios archivos en una sola consulta, en el orden de fileIds; los que no existen se
+    // omiten y un id repetido aparece en cada posición
+    std::vector<FileInfo> getFilesInfo(const std::vector<std::string>& fileIds);
     bool deleteFile(const std::string& fileId);
     std::vector<std::pair<int64_t, std::string>> getMessagesToDelete(const std::string& fileId);
     
@@ -93,6 +190,13 @@ public:
     bool registerChunkedFile(const ChunkedFileInfo& fileInfo);
     bool saveChunkInfo(const ChunkInfo& chunkInfo);
     std::vector<ChunkInfo> getFileChunks(const std::string& fileId);
+    // Chunks de varios archivos en una sola consulta, agrupados por archivo en el
+    // orden de fileIds; los archivos sin chunks no llegan al visitor y un id repetido
+    // se visita en cada posición (cada archivo se consulta una sola vez)
+    bool getChunksForFiles(const std::vector<std::string>& fileIds, const FileChunksVisitor& visitor);
+    // Mismo contrato con una consulta por archivo: lo que usa getChunksForFiles
+    // cuando SQLite no tiene JSON1 (público para poder probarlo)
+    bool getChunksPerFile(const std::vector<std::string>& fileIds, const FileChunksVisitor& visitor);
     
     // Upload progress persistence
     bool updateUploadState(const std::string& fileId, const std::string& state);
@@ -116,19 +220,121 @@ public:
     bool updateDownloadProgress(const std::string& downloadId, int64_t completedChunks);
     bool markAllActiveDownloadsAsPaused();
     
-    // Statistics
+    // Mapas de bits por transferencia (blob compacto, un bit por chunk)
+    bool saveTransferBitmap(const std::string& transferId, const std::string& kind, const std::string& bitmap);
+    std::string loadTransferBitmap(const std::string& transferId, const std::string& kind);
+    bool deleteTransferBitmaps(const std::string& transferId);
+    
+    // Statistics (contadores de catalog_stats, sin recorrer files)
     int64_t getTotalStorageUsed();
     int getTotalFilesCount();
+    CatalogStats getCatalogStats();
+    
+    // Escrituras diferidas: se confirman por lotes en el hilo de MetadataWriter.
+    // Los checkpoints se coalescen por transferencia (solo el último estado).
+    void queueChunkInfo(const ChunkInfo& chunkInfo);
+    void queueUploadCheckpoint(const std::string& fileId, const std::string& bitmap, int64_t completedChunks);
+    void queueDownloadCheckpoint(const std::string& downloadId, const std::string& bitmap, int64_t completedChunks);
+    // flushQueuedWrites(mark) devuelve false si se perdió algún lote con
+    // escrituras encoladas después de mark (tomada con queuedWriteSequence())
+    uint64_t queuedWriteSequence();
+    bool flushQueuedWrites(uint64_t since = 0);
+    
+    // EXPLAIN QUERY PLAN de las consultas calientes: false si alguna recorre
+    // la tabla completa u ordena en memoria (detalle en problems). Lo comprueba
+    // database_test tras cada migración; no se ejecuta al arrancar
+    bool verifyQueryPlans(std::vector<std::string>* problems = nullptr);
+    
+    // Diario de cambios para backups incrementales: los triggers anotan cada
+    // fila modificada del catálogo con una secuencia monótona y los deltas se
+    // exportan a una base SQLCipher pequeña (misma clave) que se reaplica sobre
+    // la base. Solo registra desde enableChangeJournal() (primer backup completo)
+    bool enableChangeJournal();
+    int64_t getChangeSeq();
+    bool exportChangesSince(int64_t sinceSeq, const std::string& deltaPath, int64_t& toSeq);
+    bool applyChanges(const std::string& deltaPath);
+    bool replayPendingChanges();
+    std::string pendingChangesDir() const;
+    static std::string pendingChangesDir(const std::string& dbPath);
+    
+    // Último backup de la cadena incremental (chain_id vacío = sin cadena)
+    bool getBackupCheckpoint(std::string& chainId, int64_t& seq);
+    bool setBackupCheckpoint(const std::string& chainId, int64_t seq);
+    bool clearBackupCheckpoint();
+    
+    // Versión de esquema en PRAGMA user_version; cada migración la incrementa en uno
+    static constexpr int SCHEMA_VERSION = 7;
     
 private:
     sqlite3* m_db;
     std::string m_dbPath;
     std::string m_encryptionKey;
+    // Clave derivada para PRAGMA key ("x'<clave><salt>'"); vacía = usar la frase
+    std::string m_rawKey;
     bool m_isEncrypted;
+    bool m_searchIndexAvailable;
+    
+    // Más coincidencias que esto se devuelven por recencia en lugar de por bm25
+    static constexpr int RANKED_SEARCH_LIMIT = 1000;
     
     bool executeQuery(const std::string& query);
     std::string getLastError() const;
+    bool openConnection();
     bool configureEncryption();
+    void cacheRawKey();
+    int schemaVersion();
+    bool migrateSchema(int fromVersion);
+    bool createBaseTables();
+    bool createHotQueryIndexes();
+    bool createListingIndexes();
+    bool createSearchIndex();
+    bool ensureSearchIndex();
+    bool migrateSearchIndex();
+    bool createStatsTable();
+    bool readStatsCounter(const char* dimension, const char* key, int64_t& items, int64_t& bytes);
+    bool tableExists(const char* table);
+    bool columnExists(const char* table, const char* column);
+    bool setupChangeJournal();
+    bool narrowChangeJournal();
+    bool configureJournal();
+    std::string pragmaValue(const char* pragma);
+    
+    // Caché de sentencias: prepareCached/releaseStatement sustituyen a
+    // sqlite3_prepare_v2/sqlite3_finalize. Si la sentencia ya está en uso
+    // por otro hilo se prepara una temporal.
+    struct CachedStatement {
+        sqlite3_stmt* stmt;
+        bool inUse;
+    };
+    int prepareCached(const char* sql, sqlite3_stmt** stmt);
+    void releaseStatement(sqlite3_stmt* stmt);
+    void clearStatementCache();
+    
+    bool runBatch(const std::vector<MetadataWriter::Operation>& operations);
+    void queueWrite(const std::string& coalesceKey, MetadataWriter::Operation operation);
+    
+    // Lecturas de catálogo (listado, búsqueda, estadísticas) en el pool de
+    // solo lectura; sin pool (p. ej. no se pudo abrir) usan m_db
+    sqlite3* openReadConnection();
+    int prepareRead(ReadConnectionPool::Lease& reader, const char* sql, sqlite3_stmt** stmt);
+    void releaseRead(ReadConnectionPool::Lease& reader, sqlite3_stmt* stmt);
+    std::string readError(const ReadConnectionPool::Lease& reader) const;
+    
+    // Único escritor: toda escritura sobre m_db (directa o por lotes de
+    // MetadataWriter) la toma. No llamar a flushQueuedWrites() con él tomado.
+    std::recursive_mutex m_writeMutex;
+    std::unique_ptr<MetadataWriter> m_metadataWriter;
+    std::unique_ptr<ReadConnectionPool> m_readers;
+    
+    DatabaseStartupTiming m_startupTiming;
+    std::chrono::steady_clock::time_point m_initStart;
+    std::atomic<bool> m_firstQueryDone;
+    std::atomic<double> m_firstQueryMillis;
+    
+    std::unordered_map<std::string, CachedStatement> m_statements;
+    std::mutex m_statementMutex;
+    bool attachDelta(const std::string& deltaPath);
+    void detachDelta();
 };
 
 } // namespace TelegramCloud
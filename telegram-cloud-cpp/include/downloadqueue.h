@@ -0,0 +1,113 @@
+#ifndef DOWNLOADQUEUE_H
+#define DOWNLOADQUEUE_H
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace TelegramCloud {
+
+/**
+ * @brief Cola de trabajo con ventana de descargas en vuelo acotada
+ *
+ * Sustituye a los lotes fijos de futures: en cuanto un slot queda libre se
+ * arranca la siguiente tarea pendiente, de modo que el enlace se mantiene
+ * ocupado sin esperar al chunk más lento de cada lote. Cada tarea se asocia
+ * a un bot token y nunca hay más de perTokenLimit tareas en vuelo por token.
+ *
+ * Cada token tiene su propia cola; solo los tokens con tareas pendientes y
+ * slot libre están en la lista de listos, así que elegir la siguiente tarea
+ * es O(1) y los tokens saturados nunca se recorren. Se sirven por turnos.
+ */
+class DownloadQueue {
+public:
+    using Task = std::function<bool()>;
+    using StopPredicate = std::function<bool()>;
+
+    /**
+     * @param maxInFlight Máximo de tareas simultáneas
+     * @param perTokenLimit Máximo de tareas simultáneas por token (0 = sin límite)
+     * @param stopOnFailure Descartar las tareas pendientes tras el primer fallo
+     */
+    DownloadQueue(int maxInFlight, int perTokenLimit = 0, bool stopOnFailure = false);
+    ~DownloadQueue();
+
+    DownloadQueue(const DownloadQueue&) = delete;
+    DownloadQueue& operator=(const DownloadQueue&) = delete;
+
+    /**
+     * @brief Encolar una tarea; arranca en cuanto haya slot para su token
+     */
+    void submit(const std::string& token, Task task);
+
+    /**
+     * @brief Predicado consultado antes de arrancar cada tarea (pausa/cancelación)
+     */
+    void setStopPredicate(StopPredicate predicate) { m_stopPredicate = predicate; }
+
+    /**
+     * @brief Descartar las tareas pendientes (las que están en vuelo terminan)
+     */
+    void cancelPending();
+
+    /**
+     * @brief Bloquear hasta que queden menos de maxPending tareas sin arrancar
+     *
+     * Contrapresión para productores en streaming: quien encola no se
+     * adelanta indefinidamente a las descargas.
+     * @return false si un fallo ya detuvo la cola (stopOnFailure)
+     */
+    bool waitForRoom(size_t maxPending);
+
+    /**
+     * @brief Esperar a que terminen todas las tareas
+     * @return true si todas las tareas ejecutadas tuvieron éxito y no se descartó ninguna
+     */
+    bool waitAll();
+
+    int inFlight() const { return m_inFlight.load(); }
+
+private:
+    struct TokenQueue {
+        std::string token;
+        std::deque<Task> pending;
+        int active = 0;
+        bool ready = false;     // está en m_ready
+    };
+
+    void workerLoop();
+    bool hasRoomLocked(const TokenQueue& queue) const;
+    void markReadyLocked(TokenQueue& queue);
+    TokenQueue* takeNextLocked(Task& out);
+    void dropPendingLocked();
+
+    int m_maxInFlight;
+    int m_perTokenLimit;
+    bool m_stopOnFailure;
+
+    std::unordered_map<std::string, TokenQueue> m_tokens;
+    std::deque<TokenQueue*> m_ready;
+    size_t m_pendingCount;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_idle;
+
+    std::atomic<int> m_inFlight;
+    bool m_shutdown;
+    bool m_failed;
+    bool m_dropped;
+
+    StopPredicate m_stopPredicate;
+};
+
+} // namespace TelegramCloud
+
+#endif // DOWNLOADQUEUE_H
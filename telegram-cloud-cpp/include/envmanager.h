@@ -103,6 +103,13 @@ private:
      */
     std::vector<unsigned char> deriveMasterKey() const;
     
+    /**
+     * @brief Deriva una clave AES con PBKDF2-SHA256 (salt fijo de la aplicación)
+     * @param seed Semilla (hash del contenido o valores críticos)
+     * @return Clave derivada (32 bytes)
+     */
+    std::vector<unsigned char> deriveKeyFromSeed(const std::string& seed) const;
+    
     /**
      * @brief Encripta datos usando AES-256-CBC
      * @param plaintext Datos en texto plano
@@ -148,13 +155,6 @@ private:
      */
     std::string sha256(const std::string& data) const;
     
-    /**
-     * @brief Convierte bytes a hexadecimal
-     * @param data Bytes a convertir
-     * @return String hexadecimal
-     */
-    std::string toHex(const std::vector<unsigned char>& data) const;
-    
     /**
      * @brief Convierte hexadecimal a bytes
      * @param hex String hexadecimal
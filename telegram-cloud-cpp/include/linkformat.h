@@ -0,0 +1,180 @@
+#ifndef LINKFORMAT_H
+#define LINKFORMAT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <functional>
+#include "database.h"
+#include "cryptoengine.h"
+
+namespace TelegramCloud {
+
+enum class LinkType : uint8_t {
+    Single = 0,
+    Batch = 1
+};
+
+/**
+ * @brief Recibe cada archivo del enlace según se decodifica; false detiene la lectura
+ */
+using LinkFileVisitor = std::function<bool(FileInfo fileInfo, std::vector<ChunkInfo> chunks)>;
+
+/**
+ * @brief Formato binario v2 del contenido de un .link (antes del cifrado)
+ *
+ * "TCL" 0x02 | flags | cuerpo. Con LINK_FLAG_DEFLATE el cuerpo va comprimido
+ * con zlib. Cuerpo: tipo, y por archivo un marcador 1 seguido del registro;
+ * un 0 cierra la lista. Los enteros son varint (LEB128) y las cadenas
+ * varint de longitud + bytes.
+ *
+ * Los tokens de bot se internan: un índice ya visto lo reutiliza y el índice
+ * siguiente al último va acompañado del token nuevo, así que la tabla se
+ * construye sobre la marcha y el escritor no necesita conocerla de antemano.
+ * En los chunks, número y tamaño se guardan como diferencia con el anterior,
+ * totalChunks una vez por archivo y los hashes SHA-256 en binario.
+ *
+ * El sobre cifrado (salt | iv | AES-256-CBC) es el mismo que en v1; el lector
+ * distingue ambos por los primeros bytes (v1 empieza por '{').
+ */
+class LinkWriter {
+public:
+    static constexpr uint8_t LINK_FLAG_DEFLATE = 0x01;
+
+    explicit LinkWriter(LinkType type, bool compress = true);
+    ~LinkWriter();
+
+    LinkWriter(const LinkWriter&) = delete;
+    LinkWriter& operator=(const LinkWriter&) = delete;
+
+    /**
+     * @brief Añade un archivo; el registro se comprime en cuanto se escribe
+     */
+    bool addFile(const FileInfo& fileInfo, const std::vector<ChunkInfo>& chunks);
+
+    /**
+     * @brief Cierra la lista y devuelve el contenido completo en out
+     */
+    bool finish(std::string& out);
+
+    size_t filesWritten() const { return m_files; }
+
+private:
+    struct Compressor;
+
+    bool emit(const std::string& record);
+    void putToken(std::string& record, const std::string& token);
+
+    std::string m_output;
+    std::vector<std::string> m_tokens;
+    std::unique_ptr<Compressor> m_compressor;   // nullptr = sin comprimir
+    bool m_ok;
+    bool m_finished;
+    size_t m_files;
+};
+
+/**
+ * @brief Lectura de .link descifrados: v2 binario y v1 JSON
+ *
+ * Los JSON se recorren en una sola pasada rellenando FileInfo/ChunkInfo
+ * según llegan las claves, sin construir el árbol, sin subcadenas
+ * intermedias y sin volver a buscar desde el principio.
+ */
+class LinkReader {
+public:
+    // Tope del contenido v2 pendiente de decodificar: un .link corrupto no agota
+    // la memoria. Los v1 JSON no lo aplican (enlaces grandes ya publicados)
+    static constexpr size_t MAX_PLAINTEXT_SIZE = 256 * 1024 * 1024;
+
+    static bool isBinary(const std::string& plaintext);
+
+    static bool parse(const std::string& plaintext,
+                      std::vector<FileInfo>& filesInfo,
+                      std::vector<std::vector<ChunkInfo>>& filesChunks,
+                      LinkType* type = nullptr);
+
+    /**
+     * @brief JSON v1 de UniversalLinkGenerator: {"type":"single","file":{...}}
+     * o {"type":"batch","files":[...]}, con "chunks" dentro de cada archivo
+     */
+    static bool parseJson(const std::string& json,
+                          std::vector<FileInfo>& filesInfo,
+                          std::vector<std::vector<ChunkInfo>>& filesChunks,
+                          LinkType* type = nullptr);
+
+    /**
+     * @brief Datos de enlace de LinkDownloadManager: el objeto raíz es el
+     * archivo (file_id, filename, size, encrypted, telegram_file_id) y sus
+     * chunks usan claves cortas (n, tid, s, h). fileType recibe "type".
+     */
+    static bool parseShareJson(const std::string& json,
+                               FileInfo& fileInfo,
+                               std::vector<ChunkInfo>& chunks,
+                               std::string& fileType);
+};
+
+/**
+ * @brief Lectura incremental de un .link cifrado (salt | iv | AES-256-CBC)
+ *
+ * feed() recibe el archivo por bloques: se descifra, se descomprime y cada
+ * registro v2 se entrega al visitor en cuanto está completo, sin esperar al
+ * resto del enlace. Los v1 JSON no se pueden decodificar por partes; se
+ * descifran enteros y se recorren en finish(), archivo a archivo.
+ *
+ * El relleno PKCS#7 solo se comprueba al final: un enlace truncado o
+ * corrupto se detecta en finish(), después de entregar los archivos previos.
+ */
+class LinkStreamReader {
+public:
+    LinkStreamReader(const std::string& password, LinkFileVisitor visitor,
+                     int iterations = CryptoEngine::LINK_PBKDF2_ITERATIONS);
+    ~LinkStreamReader();
+
+    LinkStreamReader(const LinkStreamReader&) = delete;
+    LinkStreamReader& operator=(const LinkStreamReader&) = delete;
+
+    bool feed(const char* data, size_t length);
+    bool finish();
+
+    /**
+     * @brief Lee el archivo completo por bloques de STREAM_BUFFER_SIZE
+     */
+    bool readFile(const std::string& path);
+
+    bool stopped() const;                 // el visitor pidió parar
+    size_t filesDecoded() const { return m_files; }
+    LinkType type() const;
+    const std::string& error() const { return m_error; }
+
+private:
+    struct BodyDecoder;
+    enum class Format { Unknown, Binary, Json };
+
+    bool fail(const std::string& message);
+    bool consume(std::string& plaintext);
+    bool visit(FileInfo fileInfo, std::vector<ChunkInfo> chunks);
+
+    std::string m_password;
+    int m_iterations;
+    LinkFileVisitor m_visitor;
+
+    std::string m_header;                 // salt | iv hasta tener los 32 bytes
+    CipherStream m_cipher;
+    bool m_cipherReady;
+
+    Format m_format;
+    std::string m_pending;                // texto plano aún sin formato o JSON completo
+    std::unique_ptr<BodyDecoder> m_decoder;
+    LinkType m_jsonType;
+
+    size_t m_files;
+    bool m_stopped;
+    bool m_failed;
+    bool m_finished;
+    std::string m_error;
+};
+
+} // namespace TelegramCloud
+
+#endif // LINKFORMAT_H
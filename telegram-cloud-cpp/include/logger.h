@@ -2,8 +2,17 @@
 #define LOGGER_H
 
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include <ctime>
 #include <sstream>
 #include <iostream>
@@ -18,8 +27,75 @@ enum class LogLevel {
     LOG_CRITICAL
 };
 
+/**
+ * @brief Qué hacer cuando el buffer de logs está lleno
+ */
+enum class LogOverflowPolicy {
+    DROP_LOW_PRIORITY,   // DEBUG/INFO se descartan; WARNING o superior esperan hueco
+    DROP_ALL,            // todo se descarta sin esperar
+    BLOCK                // todo espera hueco
+};
+
+namespace LogArgs {
+
+// Codificación de argumentos de logFormat: tag + valor en binario. El
+// flusher los vuelve a texto, así que el hilo que registra no formatea
+inline void append(std::string& out, bool value) {
+    out.push_back('b');
+    out.push_back(value ? 1 : 0);
+}
+
+inline void append(std::string& out, std::string_view value) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    out.push_back('s');
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.append(value.data(), value.size());
+}
+
+inline void append(std::string& out, const char* value) {
+    append(out, std::string_view(value ? value : "(null)"));
+}
+
+inline void append(std::string& out, const std::string& value) {
+    append(out, std::string_view(value));
+}
+
+template <typename T>
+inline void append(std::string& out, T value) requires std::is_arithmetic_v<T> {
+    if constexpr (std::is_floating_point_v<T>) {
+        double number = value;
+        out.push_back('d');
+        out.append(reinterpret_cast<const char*>(&number), sizeof(number));
+    } else if constexpr (std::is_signed_v<T>) {
+        int64_t number = value;
+        out.push_back('i');
+        out.append(reinterpret_cast<const char*>(&number), sizeof(number));
+    } else {
+        uint64_t number = value;
+        out.push_back('u');
+        out.append(reinterpret_cast<const char*>(&number), sizeof(number));
+    }
+}
+
+} // namespace LogArgs
+
+/**
+ * @brief Logger asíncrono: los hilos encolan y un flusher escribe
+ *
+ * log() solo reserva un hueco en un buffer circular MPSC sin locks, copia
+ * el mensaje (o los argumentos de logFormat) y vuelve. El hilo flusher pone
+ * la marca de tiempo, formatea y escribe a archivo/logcat/consola por lotes.
+ * Si el buffer se llena se aplica LogOverflowPolicy y los descartes se
+ * anotan en el propio log. CRITICAL espera a que todo esté escrito.
+ */
 class Logger {
 public:
+    // Huecos del buffer circular (potencia de 2)
+    static constexpr size_t RING_CAPACITY = 4096;
+    
+    // Intervalo máximo entre vaciados del buffer a archivo
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{200};
+    
     static Logger& instance();
     
     void log(LogLevel level, const std::string& message);
@@ -29,22 +105,77 @@ public:
     void error(const std::string& message);
     void critical(const std::string& message);
     
+    /**
+     * @brief Registra format con sus argumentos; cada "{}" se sustituye en el flusher
+     *
+     * format debe ser un literal (se guarda el puntero, no el texto).
+     */
+    template <typename... Args>
+    void logFormat(LogLevel level, const char* format, const Args&... args) {
+        if (!isEnabled(level)) {
+            return;
+        }
+        thread_local std::string encoded;
+        encoded.clear();
+        (LogArgs::append(encoded, args), ...);
+        enqueue(level, format, encoded);
+    }
+    
+    bool isEnabled(LogLevel level) const {
+        return level >= m_minLevel.load(std::memory_order_relaxed);
+    }
+    
+    /**
+     * @brief Espera a que todo lo encolado hasta ahora esté en el archivo
+     */
+    void flush();
+    
     void setLogFile(const std::string& filename);
     void setLogLevel(LogLevel level);
+    void setOverflowPolicy(LogOverflowPolicy policy);
     
+    uint64_t droppedMessages() const { return m_droppedTotal.load(); }
+
 private:
+    struct LogSlot;
+    
     Logger();
     ~Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
     
-    std::string getCurrentTimestamp() const;
+    void enqueue(LogLevel level, const char* format, std::string_view payload);
+    void flusherThread();
+    size_t drain();
+    void writeLine(LogLevel level, const std::string& line);
+    
+    std::string formatTimestamp(std::chrono::system_clock::time_point time);
     std::string levelToString(LogLevel level) const;
     
     std::ofstream m_logFile;
-    LogLevel m_minLevel;
-    std::mutex m_mutex;
+    std::atomic<LogLevel> m_minLevel;
+    std::atomic<LogOverflowPolicy> m_overflowPolicy;
+    std::mutex m_mutex;                  // archivo; escritura directa si no hay flusher
     std::string m_logFilename;
+    
+    // Buffer circular: productores con CAS sobre m_enqueuePos, un único consumidor
+    std::unique_ptr<LogSlot[]> m_ring;
+    std::atomic<size_t> m_enqueuePos;
+    size_t m_dequeuePos;                 // solo el flusher
+    std::atomic<uint64_t> m_dropped;     // pendientes de anotar en el log
+    std::atomic<uint64_t> m_droppedTotal;
+    
+    std::thread m_flusher;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_flusherIdle;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    std::atomic<size_t> m_writtenPos;    // posiciones ya escritas en archivo
+    std::condition_variable m_writtenCv;
+    
+    // Caché de la marca de tiempo por segundo (solo el flusher)
+    std::time_t m_timestampSecond;
+    std::string m_timestampText;
 };
 
 // Conmutador de logs en código fuente
@@ -55,22 +186,63 @@ private:
 #define TELEGRAM_CLOUD_LOGS TELEGRAM_CLOUD_LOGS_OFF
 #endif
 
-// Macros para facilitar el uso (no-op si los logs están OFF)
-#if TELEGRAM_CLOUD_LOGS
-#define LOG_DEBUG(msg) TelegramCloud::Logger::instance().debug(msg)
-#define LOG_INFO(msg) TelegramCloud::Logger::instance().info(msg)
-#define LOG_WARNING(msg) TelegramCloud::Logger::instance().warning(msg)
-#define LOG_ERROR(msg) TelegramCloud::Logger::instance().error(msg)
-#define LOG_CRITICAL(msg) TelegramCloud::Logger::instance().critical(msg)
+// Nivel mínimo compilado: 0=DEBUG, 1=INFO, 2=WARNING, 3=ERROR, 4=CRITICAL.
+// Por debajo de él las macros desaparecen y sus argumentos no se evalúan
+#ifndef TELEGRAM_CLOUD_LOG_LEVEL
+#define TELEGRAM_CLOUD_LOG_LEVEL 0
+#endif
+
+// El mensaje solo se construye si el nivel está activo en tiempo de ejecución
+#define TELEGRAM_CLOUD_LOG_IF(level, call) \
+    do { \
+        TelegramCloud::Logger& tcLogger = TelegramCloud::Logger::instance(); \
+        if (tcLogger.isEnabled(level)) { \
+            tcLogger.call; \
+        } \
+    } while(0)
+
+// Macros para facilitar el uso (no-op si los logs están OFF o por debajo del nivel).
+// Las variantes *F difieren el formateo al flusher: LOG_INFOF("Chunk {}/{}", n, total)
+#if TELEGRAM_CLOUD_LOGS && TELEGRAM_CLOUD_LOG_LEVEL <= 0
+#define LOG_DEBUG(msg) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_DEBUG, debug(msg))
+#define LOG_DEBUGF(...) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_DEBUG, logFormat(TelegramCloud::LogLevel::LOG_DEBUG, __VA_ARGS__))
 #else
 #define LOG_DEBUG(msg) do { (void)0; } while(0)
+#define LOG_DEBUGF(...) do { (void)0; } while(0)
+#endif
+
+#if TELEGRAM_CLOUD_LOGS && TELEGRAM_CLOUD_LOG_LEVEL <= 1
+#define LOG_INFO(msg) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_INFO, info(msg))
+#define LOG_INFOF(...) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_INFO, logFormat(TelegramCloud::LogLevel::LOG_INFO, __VA_ARGS__))
+#else
 #define LOG_INFO(msg) do { (void)0; } while(0)
+#define LOG_INFOF(...) do { (void)0; } while(0)
+#endif
+
+#if TELEGRAM_CLOUD_LOGS && TELEGRAM_CLOUD_LOG_LEVEL <= 2
+#define LOG_WARNING(msg) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_WARNING, warning(msg))
+#define LOG_WARNINGF(...) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_WARNING, logFormat(TelegramCloud::LogLevel::LOG_WARNING, __VA_ARGS__))
+#else
 #define LOG_WARNING(msg) do { (void)0; } while(0)
+#define LOG_WARNINGF(...) do { (void)0; } while(0)
+#endif
+
+#if TELEGRAM_CLOUD_LOGS && TELEGRAM_CLOUD_LOG_LEVEL <= 3
+#define LOG_ERROR(msg) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_ERROR, error(msg))
+#define LOG_ERRORF(...) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_ERROR, logFormat(TelegramCloud::LogLevel::LOG_ERROR, __VA_ARGS__))
+#else
 #define LOG_ERROR(msg) do { (void)0; } while(0)
+#define LOG_ERRORF(...) do { (void)0; } while(0)
+#endif
+
+#if TELEGRAM_CLOUD_LOGS && TELEGRAM_CLOUD_LOG_LEVEL <= 4
+#define LOG_CRITICAL(msg) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_CRITICAL, critical(msg))
+#define LOG_CRITICALF(...) TELEGRAM_CLOUD_LOG_IF(TelegramCloud::LogLevel::LOG_CRITICAL, logFormat(TelegramCloud::LogLevel::LOG_CRITICAL, __VA_ARGS__))
+#else
 #define LOG_CRITICAL(msg) do { (void)0; } while(0)
+#define LOG_CRITICALF(...) do { (void)0; } while(0)
 #endif
 
 } // namespace TelegramCloud
 
 #endif // LOGGER_H
-
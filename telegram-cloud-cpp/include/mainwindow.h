@@ -79,6 +79,7 @@ public:
     std::string aesDecrypt(const std::string& ciphertext, const std::string& password);
     std::string generateRandomSalt();
     std::string deriveKey(const std::string& password, const std::string& salt);
+    std::string deriveCombinedKey(const std::string& password, const std::string& salt);
     
     // Métodos de encriptación de archivos completos
     bool encryptFile(const std::string& inputPath, const std::string& outputPath, const std::string& password);
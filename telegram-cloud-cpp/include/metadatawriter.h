@@ -0,0 +1,126 @@
+#ifndef METADATAWRITER_H
+#define METADATAWRITER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+struct sqlite3;
+
+namespace TelegramCloud {
+
+/**
+ * @brief Escritura diferida de metadatos con group commit
+ *
+ * Los workers de subida/descarga encolan sus escrituras y siguen sin esperar
+ * al disco. Un hilo propio las agrupa y las confirma en una sola transacción
+ * cada INTERVAL o cuando hay MAX_BATCH pendientes, de modo que N chunks
+ * cuestan un fsync en lugar de N.
+ *
+ * Las operaciones con clave de coalescencia (p. ej. el progreso de una
+ * transferencia) sustituyen a la pendiente con la misma clave: solo se
+ * escribe el estado más reciente.
+ *
+ * Si el proceso muere antes del commit se pierden las últimas operaciones.
+ * Es seguro porque la reanudación solo da por buenos los chunks registrados
+ * en la BD (mapa de bits + hash); los no confirmados se vuelven a transferir.
+ *
+ * Un lote que no se confirma se descarta, pero queda anotado: flush() devuelve
+ * false para que quien esperaba esas escrituras no dé la transferencia por
+ * terminada.
+ */
+class MetadataWriter {
+public:
+    // false si la escritura falla; el lote entero se deshace
+    using Operation = std::function<bool()>;
+
+    /**
+     * @brief Ejecuta un lote dentro de una transacción; false si no se confirma
+     */
+    using BatchRunner = std::function<bool(const std::vector<Operation>& operations)>;
+
+    /**
+     * @brief BatchRunner común sobre una conexión SQLite
+     *
+     * BEGIN IMMEDIATE (reintenta mientras la base esté ocupada), ejecuta las
+     * operaciones y confirma. Si BEGIN no se consigue, una operación falla o
+     * el COMMIT falla, hace ROLLBACK y devuelve false: nada del lote queda escrito.
+     */
+    static bool runInTransaction(sqlite3* db, const std::vector<Operation>& operations);
+
+    static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{250};
+    static constexpr size_t DEFAULT_MAX_BATCH = 256;
+    static constexpr int BEGIN_ATTEMPTS = 5;
+    static constexpr std::chrono::milliseconds BEGIN_RETRY_DELAY{20};
+
+    explicit MetadataWriter(BatchRunner runner,
+                            std::chrono::milliseconds interval = DEFAULT_INTERVAL,
+                            size_t maxBatch = DEFAULT_MAX_BATCH);
+    ~MetadataWriter();
+
+    MetadataWriter(const MetadataWriter&) = delete;
+    MetadataWriter& operator=(const MetadataWriter&) = delete;
+
+    void enqueue(Operation operation);
+    void enqueue(const std::string& coalesceKey, Operation operation);
+
+    /**
+     * @brief Secuencia de la última operación encolada
+     *
+     * Marca para flush(since): solo cuentan los fallos de lo encolado después.
+     */
+    uint64_t sequence() const;
+
+    /**
+     * @brief Esperar a que todo lo encolado hasta ahora esté procesado
+     * @return false si algún lote con operaciones posteriores a since no se confirmó
+     */
+    bool flush(uint64_t since = 0);
+
+    /**
+     * @brief Confirmar lo pendiente y detener el hilo; lo que llegue después se ejecuta en el acto
+     */
+    void stop();
+
+    uint64_t batchesCommitted() const;
+    uint64_t operationsCommitted() const;
+
+private:
+    struct Pending {
+        std::string key;
+        Operation operation;
+    };
+
+    void run();
+
+    BatchRunner m_runner;
+    std::chrono::milliseconds m_interval;
+    size_t m_maxBatch;
+
+    std::vector<Pending> m_queue;
+    std::unordered_map<std::string, size_t> m_keyIndex;   // clave -> posición en m_queue
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_drained;
+
+    uint64_t m_enqueued;     // secuencia de la última operación encolada
+    uint64_t m_committed;    // secuencia hasta la que todo está procesado
+    uint64_t m_lastFailure;  // secuencia final del último lote que no se confirmó
+    uint64_t m_batches;
+    uint64_t m_operations;
+    bool m_flushRequested;
+    bool m_stopping;
+
+    std::thread m_thread;
+};
+
+} // namespace TelegramCloud
+
+#endif // METADATAWRITER_H
@@ -0,0 +1,97 @@
+#ifndef READCONNECTIONPOOL_H
+#define READCONNECTIONPOOL_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <sqlite3.h>
+
+namespace TelegramCloud {
+
+/**
+ * @brief Conexiones de solo lectura a la base principal
+ *
+ * Con WAL los lectores no bloquean al escritor ni entre sí: el listado, la
+ * búsqueda y las estadísticas de la UI no esperan a que termine un lote de
+ * escrituras de una transferencia. Las conexiones se abren bajo demanda
+ * (cada una deriva la clave de SQLCipher) hasta maxConnections; cada una la
+ * usa un único hilo a la vez mediante un Lease y guarda sus propias
+ * sentencias preparadas.
+ */
+class ReadConnectionPool {
+    struct Connection;
+
+public:
+    // Abre y configura (clave, pragmas) una conexión de solo lectura; nullptr si falla
+    using Opener = std::function<sqlite3*()>;
+
+    ReadConnectionPool(Opener opener, size_t maxConnections);
+    ~ReadConnectionPool();
+
+    ReadConnectionPool(const ReadConnectionPool&) = delete;
+    ReadConnectionPool& operator=(const ReadConnectionPool&) = delete;
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        explicit operator bool() const { return m_connection != nullptr; }
+        sqlite3* db() const;
+
+        // Equivalentes a Database::prepareCached/releaseStatement
+        int prepare(const char* sql, sqlite3_stmt** stmt);
+        void release(sqlite3_stmt* stmt);
+
+    private:
+        friend class ReadConnectionPool;
+        Lease(ReadConnectionPool* pool, Connection* connection);
+        void reset();
+
+        ReadConnectionPool* m_pool = nullptr;
+        Connection* m_connection = nullptr;
+    };
+
+    /**
+     * @brief Toma una conexión libre (o abre otra); espera si están todas en uso
+     *
+     * Un Lease vacío indica que el pool está cerrado o no pudo abrir ninguna
+     * conexión: el llamador debe usar la conexión principal.
+     */
+    Lease acquire();
+
+    /**
+     * @brief Espera a que se devuelvan los Lease y cierra todas las conexiones
+     */
+    void close();
+
+    size_t openConnections() const;
+
+private:
+    struct Connection {
+        sqlite3* db = nullptr;
+        std::unordered_map<std::string, sqlite3_stmt*> statements;
+        bool inUse = false;
+    };
+
+    void giveBack(Connection* connection);
+
+    Opener m_opener;
+    size_t m_maxConnections;
+    std::vector<Connection*> m_connections;
+    size_t m_opening;        // aperturas en curso (fuera del mutex)
+    bool m_closed;
+    bool m_openFailed;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_available;
+};
+
+} // namespace TelegramCloud
+
+#endif // READCONNECTIONPOOL_H
@@ -39,7 +39,9 @@ public:
     );
     
     // Download operations
-    bool downloadFile(const std::string& fileId, const std::string& savePath, const std::string& botToken = "");
+    // sha256Out: si no es nulo, recibe el SHA-256 (hex) calculado mientras se escriben los bytes
+    bool downloadFile(const std::string& fileId, const std::string& savePath, const std::string& botToken = "",
+                      std::string* sha256Out = nullptr);
     std::string getFilePath(const std::string& fileId, const std::string& botToken = "");
     
     // Delete operations
@@ -5,8 +5,12 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
-#include <map>
+#include <condition_variable>
+#include <unordered_map>
+#include <vector>
 #include <memory>
+#include <chrono>
+#include <cstdint>
 
 namespace TelegramCloud {
 
@@ -22,7 +26,25 @@ enum class OperationType {
 };
 
 /**
- * @brief Estado de operación activa
+ * @brief Estado de una operación en curso
+ */
+enum class OperationStatus : uint8_t {
+    UPLOADING,
+    DOWNLOADING,
+    RECONSTRUCTING
+};
+
+/**
+ * @brief Identificador compacto de una operación registrada (slot + generación)
+ *
+ * Lo devuelve registerOperation y evita buscar por operationId en cada
+ * actualización. Un handle de una operación ya retirada se ignora.
+ */
+using OperationHandle = uint32_t;
+constexpr OperationHandle INVALID_OPERATION_HANDLE = 0;
+
+/**
+ * @brief Copia del estado de una operación activa (informes)
  */
 struct ActiveOperation {
     std::string operationId;
@@ -41,6 +63,11 @@ struct ActiveOperation {
  * 
  * Envía notificaciones automáticas cuando se completan operaciones
  * y responde al símbolo "%" con el progreso actual.
+ *
+ * El progreso de cada operación vive en un slot de atómicos: los workers lo
+ * actualizan con el handle sin tomar ningún mutex y los informes leen una
+ * instantánea sin bloquearlos. El informe de "%" se mantiene como un único
+ * mensaje que se edita cada LIVE_REPORT_INTERVAL mientras haya operaciones.
  */
 class TelegramNotifier {
 public:
@@ -57,39 +84,62 @@ public:
      */
     void stop();
     
+    // Operaciones seguidas a la vez; con la tabla llena no se registran más
+    static constexpr size_t MAX_OPERATIONS = 256;
+    
+    // Intervalo mínimo entre ediciones del mensaje de progreso
+    static constexpr std::chrono::seconds LIVE_REPORT_INTERVAL{10};
+    
+    // Long poll de getUpdates: Telegram responde en cuanto llega un comando
+    static constexpr std::chrono::seconds POLL_TIMEOUT{50};
+    
+    // Espera tras errores de polling: se duplica hasta el máximo
+    static constexpr std::chrono::seconds POLL_RETRY_MIN{1};
+    static constexpr std::chrono::seconds POLL_RETRY_MAX{60};
+    
     /**
      * @brief Registra una operación activa
+     * @return Handle para las actualizaciones, o INVALID_OPERATION_HANDLE si no hay slots
      */
-    void registerOperation(const std::string& operationId, 
-                          OperationType type,
-                          const std::string& fileName,
-                          int64_t totalSize,
-                          int64_t totalChunks);
+    OperationHandle registerOperation(const std::string& operationId, 
+                                      OperationType type,
+                                      const std::string& fileName,
+                                      int64_t totalSize,
+                                      int64_t totalChunks);
     
     /**
-     * @brief Actualiza el progreso de una operación
+     * @brief Actualiza el progreso de una operación (sin bloqueos)
      */
-    void updateOperationProgress(const std::string& operationId,
+    void updateOperationProgress(OperationHandle handle,
                                  int64_t completedChunks,
-                                 double progressPercent,
-                                 const std::string& status = "");
+                                 double progressPercent);
+    
+    /**
+     * @brief Cambia el estado mostrado de una operación (sin bloqueos)
+     */
+    void setOperationStatus(OperationHandle handle, OperationStatus status);
     
     /**
      * @brief Notifica operación completada
      */
-    void notifyOperationCompleted(const std::string& operationId,
+    void notifyOperationCompleted(OperationHandle handle,
                                   const std::string& destination = "");
     
     /**
      * @brief Notifica operación fallida
      */
-    void notifyOperationFailed(const std::string& operationId,
+    void notifyOperationFailed(OperationHandle handle,
                               const std::string& errorMessage = "");
     
     /**
      * @brief Elimina operación del tracking
      */
-    void removeOperation(const std::string& operationId);
+    void removeOperation(OperationHandle handle);
+    
+    /**
+     * @brief Instantánea de las operaciones activas, sin bloquear a los workers
+     */
+    std::vector<ActiveOperation> snapshotOperations() const;
     
     /**
      * @brief Verifica si el notificador está activo
@@ -97,25 +147,64 @@ public:
     bool isActive() const { return m_isActive; }
 
 private:
+    struct OperationMeta;
+    struct OperationSlot;
+    struct PollConnection;
+    
+    /**
+     * @brief Slot del handle si sigue siendo de la misma operación
+     */
+    OperationSlot* slotFor(OperationHandle handle) const;
+    
+    /**
+     * @brief Retira el slot y devuelve su estado final (requiere m_operationsMutex)
+     */
+    bool retireOperationLocked(OperationHandle handle, ActiveOperation* finalState);
+    
+    /**
+     * @brief Libera las descripciones retiradas si no hay lecturas en curso
+     */
+    void reclaimRetiredLocked();
+    
     /**
      * @brief Thread principal de polling de mensajes
      */
     void pollingThread();
     
+    /**
+     * @brief Long poll hasta el próximo evento propio (edición del informe vivo)
+     */
+    std::chrono::seconds nextPollTimeout() const;
+    
     /**
      * @brief Procesa comandos del usuario
      */
     void processCommand(const std::string& command);
     
     /**
-     * @brief Envía mensaje de progreso actual
+     * @brief Envía mensaje de progreso actual; pasa a ser el mensaje que se edita
      */
     void sendProgressReport();
     
+    /**
+     * @brief Edita el mensaje de progreso si cambió y pasó LIVE_REPORT_INTERVAL
+     */
+    void refreshLiveReport();
+    
+    /**
+     * @brief Texto del informe de progreso
+     */
+    std::string formatProgressReport(const std::vector<ActiveOperation>& operations);
+    
     /**
      * @brief Envía mensaje formateado a Telegram
      */
-    bool sendMessage(const std::string& message);
+    bool sendMessage(const std::string& message, int64_t* messageId = nullptr);
+    
+    /**
+     * @brief Reemplaza el texto de un mensaje ya enviado
+     */
+    bool editMessageText(int64_t messageId, const std::string& message);
     
     /**
      * @brief Formatea tamaño en MB/GB
@@ -123,9 +212,10 @@ private:
     std::string formatSize(int64_t bytes);
     
     /**
-     * @brief Obtiene actualizaciones de Telegram
+     * @brief Obtiene actualizaciones de Telegram con un long poll
+     * @return false si falló la petición (se reintenta con espera creciente)
      */
-    void getUpdates();
+    bool getUpdates(std::chrono::seconds timeout);
     
     Database* m_database;
     TelegramHandler* m_telegramHandler;
@@ -134,13 +224,26 @@ private:
     std::atomic<bool> m_shouldStop;
     std::thread m_pollingThread;
     
-    // Tracking de operaciones activas
-    std::map<std::string, ActiveOperation> m_activeOperations;
+    // Tracking de operaciones activas: slots de atómicos indexados por handle.
+    // El mutex solo protege altas y bajas, nunca las actualizaciones
+    std::unique_ptr<OperationSlot[]> m_slots;
+    std::unordered_map<std::string, OperationHandle> m_handles;
+    std::vector<std::unique_ptr<const OperationMeta>> m_retired;
+    mutable std::atomic<int> m_snapshotReaders;
+    size_t m_nextSlot;
     std::mutex m_operationsMutex;
     
-    // Control de polling
+    // Mensaje de progreso que se edita (solo lo usa el thread de polling)
+    int64_t m_liveMessageId;
+    std::string m_liveMessageText;
+    std::chrono::steady_clock::time_point m_lastLiveEdit;
+    
+    // Control de polling: conexión persistente del thread de polling y
+    // despertar inmediato desde stop()
     int64_t m_lastUpdateId;
-    std::mutex m_pollingMutex;
+    std::unique_ptr<PollConnection> m_poll;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
 };
 
 } // namespace TelegramCloud
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "metadatawriter.h"
 
 struct sqlite3;
 
@@ -37,6 +38,7 @@ public:
     
     // Guardar/actualizar descarga
     bool saveDownload(const LinkDownloadInfo& info);
+    // Diferido: se coalesce por descarga y se confirma por lotes (MetadataWriter)
     bool updateDownloadProgress(const std::string& downloadId, int64_t completedChunks, double progressPercent);
     bool updateDownloadStatus(const std::string& downloadId, const std::string& status);
     
@@ -58,8 +60,14 @@ private:
     sqlite3* m_db;
     std::string m_dbPath;
     std::string m_encryptionKey;
+    std::unique_ptr<MetadataWriter> m_writer;
     
     bool createTables();
+    bool writeDownloadProgress(const std::string& downloadId, int64_t completedChunks,
+                               double progressPercent, const std::string& timestamp);
+    bool runBatch(const std::vector<MetadataWriter::Operation>& operations);
+    void flushPendingWrites();
+    void stopWriter();
     std::string generateEncryptionKey();
     bool encryptDatabase(const std::string& key);
 };
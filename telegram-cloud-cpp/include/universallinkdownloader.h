@@ -6,12 +6,16 @@
 #include <functional>
 #include "database.h"
 #include "telegramhandler.h"
+#include "linkformat.h"
 
 namespace TelegramCloud {
 
 class TelegramNotifier;
 
-// Callback para progreso de descarga desde link universal
+// Callback para progreso de descarga desde link universal. Por archivo:
+// chunks completados/total con su nombre (negativos durante la reconstrucción).
+// Con fileName vacío es el agregado del enlace: archivos terminados/conocidos y
+// porcentaje por bytes. Se invoca desde los hilos de descarga.
 using UniversalLinkProgressCallback = std::function<void(int current, int total, const std::string& fileName, double percent)>;
 
 /**
@@ -26,6 +30,14 @@ public:
     
     /**
      * @brief Inicia descarga desde un archivo .link
+     *
+     * El enlace se lee en streaming: la descarga del primer archivo empieza
+     * en cuanto se decodifica su registro. Un enlace truncado o corrupto se
+     * detecta al final, con los archivos anteriores ya descargados.
+     *
+     * Todos los archivos comparten una ventana de descargas en vuelo
+     * (Config::downloadMaxInFlight): los pequeños se descargan en paralelo y
+     * los chunked reparten sus chunks en la misma ventana.
      * @param linkFilePath Ruta al archivo .link
      * @param password Contraseña para desencriptar el link
      * @param destinationDir Directorio donde guardar los archivos
@@ -53,60 +65,49 @@ public:
     );
     
 private:
+    // Tareas sin arrancar admitidas antes de seguir leyendo el enlace
+    static constexpr size_t MAX_QUEUED_TASKS = 256;
+    
     TelegramHandler* m_telegramHandler;
     Database* m_database;
     TelegramNotifier* m_notifier;
     
     /**
-     * @brief Lee y desencripta un archivo .link
+     * @brief Lee el .link por bloques y entrega cada archivo al visitor en
+     * cuanto se decodifica (binario v2 o JSON v1)
      */
-    std::string readAndDecryptLinkFile(
+    bool streamLinkFile(
         const std::string& linkFilePath,
-        const std::string& password
+        const std::string& password,
+        LinkFileVisitor visitor
     );
     
+    struct LinkFileJob;
+    
     /**
-     * @brief Parsea los datos JSON del link
+     * @brief Prepara un archivo chunked: directorio temporal, registro en BD
+     * y en TelegramNotifier, y checkpoint de progreso
      */
-    bool parseLinkData(
-        const std::string& jsonData,
-        std::vector<FileInfo>& filesInfo,
-        std::vector<std::vector<ChunkInfo>>& filesChunks
-    );
+    bool startChunkedJob(LinkFileJob& job);
     
     /**
-     * @brief Descarga un archivo individual desde los datos del link
+     * @brief Descarga y verifica un chunk del archivo (tarea de la cola)
      */
-    bool downloadSingleFile(
-        const FileInfo& fileInfo,
-        const std::vector<ChunkInfo>& chunks,
-        const std::string& destinationDir,
-        const std::string& filePassword,
-        UniversalLinkProgressCallback progressCallback,
-        int currentIndex,
-        int totalFiles
-    );
+    bool downloadJobChunk(LinkFileJob& job, const ChunkInfo& chunk);
     
     /**
-     * @brief Descarga archivo chunked usando los datos del link
+     * @brief Reconstruye y descifra el archivo cuando ya están todos sus chunks
      */
-    bool downloadChunkedFromLink(
-        const FileInfo& fileInfo,
-        const std::vector<ChunkInfo>& chunks,
-        const std::string& destPath,
-        const std::string& filePassword
+    bool finishChunkedJob(
+        LinkFileJob& job,
+        const std::string& filePassword,
+        const UniversalLinkProgressCallback& progressCallback
     );
     
     /**
-     * @brief Descarga archivo chunked con callback de progreso
+     * @brief Limpia un archivo chunked que no se completó y lo marca como fallido
      */
-    bool downloadChunkedFromLinkWithProgress(
-        const FileInfo& fileInfo,
-        const std::vector<ChunkInfo>& chunks,
-        const std::string& destPath,
-        const std::string& filePassword,
-        std::function<void(int64_t completed, int64_t total)> progressCallback
-    );
+    void abortChunkedJob(LinkFileJob& job, const std::string& reason);
     
     /**
      * @brief Descarga archivo directo usando los datos del link
@@ -126,16 +127,6 @@ private:
         const std::string& password
     );
     
-    /**
-     * @brief Desencripta datos con AES-256
-     */
-    std::string decryptData(const std::string& encrypted, const std::string& password);
-    
-    /**
-     * @brief Deriva clave de encriptación desde contraseña
-     */
-    std::string deriveKey(const std::string& password, const std::string& salt);
-    
     /**
      * @brief Genera UUID para download ID
      */
@@ -12,6 +12,7 @@ namespace TelegramCloud {
  * 
  * Crea archivos .link que contienen toda la información necesaria
  * para descargar archivos sin depender de la base de datos local.
+ * El contenido usa el formato binario v2 (LinkWriter); el JSON v1 solo se lee.
  */
 class UniversalLinkGenerator {
 public:
@@ -46,30 +47,10 @@ public:
 private:
     Database* m_database;
     
-    /**
-     * @brief Serializa la información de un archivo a JSON
-     */
-    std::string serializeFileData(const FileInfo& fileInfo, const std::vector<ChunkInfo>& chunks);
-    
-    /**
-     * @brief Serializa múltiples archivos a JSON
-     */
-    std::string serializeBatchData(const std::vector<std::pair<FileInfo, std::vector<ChunkInfo>>>& filesData);
-    
     /**
      * @brief Encripta los datos con AES-256
      */
     std::string encryptData(const std::string& data, const std::string& password);
-    
-    /**
-     * @brief Genera salt aleatorio para encriptación
-     */
-    std::string generateSalt();
-    
-    /**
-     * @brief Deriva clave de encriptación desde contraseña
-     */
-    std::string deriveKey(const std::string& password, const std::string& salt);
 };
 
 } // namespace TelegramCloud
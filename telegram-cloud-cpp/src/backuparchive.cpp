@@ -0,0 +1,705 @@
+#include "backuparchive.h"
+#include "logger.h"
+#include <zlib.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <ctime>
+#include <algorithm>
+#include <sstream>
+
+namespace TelegramCloud {
+
+namespace {
+
+const uint32_t LOCAL_HEADER_SIG = 0x04034b50;
+const uint32_t CENTRAL_HEADER_SIG = 0x02014b50;
+const uint32_t END_OF_CENTRAL_SIG = 0x06054b50;
+const uint32_t ZIP64_END_SIG = 0x06064b50;
+const uint32_t ZIP64_LOCATOR_SIG = 0x07064b50;
+const uint16_t ZIP64_EXTRA_ID = 0x0001;
+const uint16_t FLAG_UTF8 = 0x0800;
+const uint16_t VERSION_DEFAULT = 20;
+const uint16_t VERSION_ZIP64 = 45;
+const uint32_t MAX32 = 0xFFFFFFFFu;
+const uint16_t MAX16 = 0xFFFF;
+
+// Margen para la expansión de deflate/cifrado sobre el tamaño del origen
+const uint64_t ZIP64_THRESHOLD = 0xF0000000ull;
+
+const size_t PIPELINE_BLOCK_SIZE = 1024 * 1024;
+const size_t PIPELINE_DEPTH = 4;
+
+void put16(std::string& buf, uint16_t v) {
+    buf.push_back(static_cast<char>(v & 0xFF));
+    buf.push_back(static_cast<char>((v >> 8) & 0xFF));
+}
+
+void put32(std::string& buf, uint32_t v) {
+    put16(buf, static_cast<uint16_t>(v & 0xFFFF));
+    put16(buf, static_cast<uint16_t>(v >> 16));
+}
+
+void put64(std::string& buf, uint64_t v) {
+    put32(buf, static_cast<uint32_t>(v & MAX32));
+    put32(buf, static_cast<uint32_t>(v >> 32));
+}
+
+uint16_t get16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const unsigned char* p) {
+    return static_cast<uint32_t>(get16(p)) | (static_cast<uint32_t>(get16(p + 2)) << 16);
+}
+
+uint64_t get64(const unsigned char* p) {
+    return static_cast<uint64_t>(get32(p)) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+}
+
+/**
+ * Cola acotada entre etapas del pipeline. close() marca el final del flujo;
+ * abort() despierta a todos para abandonar tras un error.
+ */
+class BlockQueue {
+public:
+    explicit BlockQueue(size_t capacity) : m_capacity(capacity) {}
+
+    bool push(std::string block) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_aborted || m_blocks.size() < m_capacity; });
+        if (m_aborted) return false;
+        m_blocks.push_back(std::move(block));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // false = flujo terminado (o abortado) y sin más bloques
+    bool pop(std::string& block) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_aborted || m_closed || !m_blocks.empty(); });
+        if (m_aborted || m_blocks.empty()) return false;
+        block = std::move(m_blocks.front());
+        m_blocks.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+    void abort() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_aborted = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    bool aborted() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_aborted;
+    }
+
+private:
+    size_t m_capacity;
+    std::deque<std::string> m_blocks;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    bool m_closed = false;
+    bool m_aborted = false;
+};
+
+/**
+ * Deflate "raw" (sin cabecera zlib), como exige el formato ZIP.
+ */
+class RawDeflater {
+public:
+    RawDeflater() {
+        m_ok = deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                            Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~RawDeflater() {
+        if (m_ok) deflateEnd(&m_stream);
+    }
+
+    bool update(const char* data, size_t length, std::string& out) {
+        return run(data, length, Z_NO_FLUSH, out);
+    }
+
+    bool finish(std::string& out) {
+        return run(nullptr, 0, Z_FINISH, out);
+    }
+
+private:
+    bool run(const char* data, size_t length, int flush, std::string& out) {
+        if (!m_ok) return false;
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_stream.avail_in = static_cast<uInt>(length);
+
+        char buffer[64 * 1024];
+        int rc = Z_OK;
+        do {
+            m_stream.next_out = reinterpret_cast<Bytef*>(buffer);
+            m_stream.avail_out = sizeof(buffer);
+            rc = deflate(&m_stream, flush);
+            if (rc == Z_STREAM_ERROR) return false;
+            out.append(buffer, sizeof(buffer) - m_stream.avail_out);
+        } while (m_stream.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+        return true;
+    }
+
+    z_stream m_stream{};
+    bool m_ok = false;
+};
+
+void currentDosDateTime(uint16_t& dosTime, uint16_t& dosDate) {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    dosTime = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+    dosDate = static_cast<uint16_t>(((std::max(local.tm_year, 80) - 80) << 9) |
+                                    ((local.tm_mon + 1) << 5) | local.tm_mday);
+}
+
+} // namespace
+
+// ============================================================================
+// ZipArchiveWriter
+// ============================================================================
+
+ZipArchiveWriter::ZipArchiveWriter()
+    : m_dosTime(0)
+    , m_dosDate(0)
+    , m_failed(false) {
+    currentDosDateTime(m_dosTime, m_dosDate);
+}
+
+ZipArchiveWriter::~ZipArchiveWriter() {
+    if (m_out.is_open()) {
+        m_out.close();
+    }
+}
+
+bool ZipArchiveWriter::open(const std::string& path) {
+    m_out.open(path, std::ios::binary | std::ios::trunc);
+    m_entries.clear();
+    m_failed = !m_out;
+    if (m_failed) {
+        LOG_ERROR("Failed to create archive: " + path);
+    }
+    return !m_failed;
+}
+
+bool ZipArchiveWriter::writeLocalHeader(CentralEntry& entry) {
+    std::string header;
+    put32(header, LOCAL_HEADER_SIG);
+    put16(header, entry.zip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+    put16(header, FLAG_UTF8);
+    put16(header, entry.method);
+    put16(header, m_dosTime);
+    put16(header, m_dosDate);
+    // CRC y tamaños se parchean al terminar la entrada
+    put32(header, 0);
+    put32(header, entry.zip64 ? MAX32 : 0);
+    put32(header, entry.zip64 ? MAX32 : 0);
+    put16(header, static_cast<uint16_t>(entry.name.size()));
+    put16(header, entry.zip64 ? 20 : 0);
+    header += entry.name;
+    if (entry.zip64) {
+        put16(header, ZIP64_EXTRA_ID);
+        put16(header, 16);
+        put64(header, 0);
+        put64(header, 0);
+    }
+
+    entry.localHeaderOffset = static_cast<uint64_t>(m_out.tellp());
+    m_out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    return static_cast<bool>(m_out);
+}
+
+bool ZipArchiveWriter::patchLocalHeader(const CentralEntry& entry) {
+    std::streampos end = m_out.tellp();
+
+    std::string fields;
+    put32(fields, entry.crc);
+    put32(fields, entry.zip64 ? MAX32 : static_cast<uint32_t>(entry.compressedSize));
+    put32(fields, entry.zip64 ? MAX32 : static_cast<uint32_t>(entry.uncompressedSize));
+    m_out.seekp(static_cast<std::streamoff>(entry.localHeaderOffset + 14));
+    m_out.write(fields.data(), static_cast<std::streamsize>(fields.size()));
+
+    if (entry.zip64) {
+        std::string extra;
+        put64(extra, entry.uncompressedSize);
+        put64(extra, entry.compressedSize);
+        m_out.seekp(static_cast<std::streamoff>(entry.localHeaderOffset + 30 + entry.name.size() + 4));
+        m_out.write(extra.data(), static_cast<std::streamsize>(extra.size()));
+    }
+
+    m_out.seekp(end);
+    return static_cast<bool>(m_out);
+}
+
+bool ZipArchiveWriter::addEntry(const std::string& name, std::istream& source, Method method,
+                                BlockTransform* transform, uint64_t sizeHint) {
+    if (m_failed || !m_out.is_open()) {
+        return false;
+    }
+
+    CentralEntry entry;
+    entry.name = name;
+    entry.method = static_cast<uint16_t>(method);
+    entry.zip64 = sizeHint >= ZIP64_THRESHOLD;
+    if (!writeLocalHeader(entry)) {
+        m_failed = true;
+        return false;
+    }
+
+    BlockQueue readQueue(PIPELINE_DEPTH);
+    BlockQueue writeQueue(PIPELINE_DEPTH);
+    std::atomic<bool> readFailed{false};
+    std::atomic<bool> writeFailed{false};
+    uint64_t written = 0;
+
+    // Etapa 1: lectura del origen
+    std::thread reader([&]() {
+        while (source) {
+            std::string block(PIPELINE_BLOCK_SIZE, '\0');
+            source.read(&block[0], static_cast<std::streamsize>(block.size()));
+            std::streamsize got = source.gcount();
+            if (got <= 0) break;
+            block.resize(static_cast<size_t>(got));
+            if (!readQueue.push(std::move(block))) return;
+        }
+        if (source.bad()) {
+            readFailed = true;
+            readQueue.abort();
+            writeQueue.abort();
+            return;
+        }
+        readQueue.close();
+    });
+
+    // Etapa 3: escritura en disco
+    std::thread writer([&]() {
+        std::string block;
+        while (writeQueue.pop(block)) {
+            m_out.write(block.data(), static_cast<std::streamsize>(block.size()));
+            if (!m_out) {
+                writeFailed = true;
+                readQueue.abort();
+                writeQueue.abort();
+                return;
+            }
+            written += block.size();
+        }
+    });
+
+    // Etapa 2: transformación, CRC y compresión
+    RawDeflater deflater;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    bool ok = true;
+
+    auto emit = [&](const std::string& data) -> bool {
+        if (data.empty()) return true;
+        entry.uncompressedSize += data.size();
+        for (size_t offset = 0; offset < data.size(); offset += MAX32 >> 1) {
+            size_t len = std::min<size_t>(data.size() - offset, MAX32 >> 1);
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(data.data() + offset), static_cast<uInt>(len));
+        }
+        if (method == Method::Stored) {
+            return writeQueue.push(data);
+        }
+        std::string compressed;
+        if (!deflater.update(data.data(), data.size(), compressed)) return false;
+        return compressed.empty() || writeQueue.push(std::move(compressed));
+    };
+
+    std::string block;
+    std::string transformed;
+    while (ok && readQueue.pop(block)) {
+        if (transform) {
+            transformed.clear();
+            ok = transform->update(block.data(), block.size(), transformed) && emit(transformed);
+        } else {
+            ok = emit(block);
+        }
+    }
+
+    if (ok && !readQueue.aborted()) {
+        if (transform) {
+            transformed.clear();
+            ok = transform->finish(transformed) && emit(transformed);
+        }
+        if (ok && method == Method::Deflate) {
+            std::string tail;
+            ok = deflater.finish(tail) && (tail.empty() || writeQueue.push(std::move(tail)));
+        }
+    }
+
+    if (ok && !readFailed) {
+        writeQueue.close();
+    } else {
+        readQueue.abort();
+        writeQueue.abort();
+    }
+    reader.join();
+    writer.join();
+
+    if (!ok || readFailed || writeFailed) {
+        LOG_ERROR("Failed to write archive entry: " + name);
+        m_failed = true;
+        return false;
+    }
+
+    entry.crc = static_cast<uint32_t>(crc);
+    entry.compressedSize = written;
+    if (!entry.zip64 && (entry.compressedSize >= MAX32 || entry.uncompressedSize >= MAX32)) {
+        LOG_ERROR("Archive entry exceeded 4 GB without ZIP64 reservation: " + name);
+        m_failed = true;
+        return false;
+    }
+
+    if (!patchLocalHeader(entry)) {
+        m_failed = true;
+        return false;
+    }
+
+    m_entries.push_back(entry);
+    LOG_DEBUG("Archive entry written: " + name + " (" + std::to_string(entry.uncompressedSize) +
+              " -> " + std::to_string(entry.compressedSize) + " bytes)");
+    return true;
+}
+
+bool ZipArchiveWriter::addEntry(const std::string& name, const std::string& data, Method method) {
+    std::istringstream source(data);
+    return addEntry(name, source, method, nullptr, data.size());
+}
+
+bool ZipArchiveWriter::writeCentralDirectory() {
+    uint64_t centralOffset = static_cast<uint64_t>(m_out.tellp());
+    bool needZip64 = m_entries.size() >= MAX16 || centralOffset >= MAX32;
+
+    std::string central;
+    for (const auto& entry : m_entries) {
+        bool bigSizes = entry.zip64 || entry.compressedSize >= MAX32 || entry.uncompressedSize >= MAX32;
+        bool bigOffset = entry.localHeaderOffset >= MAX32;
+
+        std::string extra;
+        if (bigSizes || bigOffset) {
+            std::string fields;
+            if (bigSizes) {
+                put64(fields, entry.uncompressedSize);
+                put64(fields, entry.compressedSize);
+            }
+            if (bigOffset) {
+                put64(fields, entry.localHeaderOffset);
+            }
+            put16(extra, ZIP64_EXTRA_ID);
+            put16(extra, static_cast<uint16_t>(fields.size()));
+            extra += fields;
+            needZip64 = true;
+        }
+
+        uint16_t version = (bigSizes || bigOffset) ? VERSION_ZIP64 : VERSION_DEFAULT;
+        put32(central, CENTRAL_HEADER_SIG);
+        put16(central, version);
+        put16(central, version);
+        put16(central, FLAG_UTF8);
+        put16(central, entry.method);
+        put16(central, m_dosTime);
+        put16(central, m_dosDate);
+        put32(central, entry.crc);
+        put32(central, bigSizes ? MAX32 : static_cast<uint32_t>(entry.compressedSize));
+        put32(central, bigSizes ? MAX32 : static_cast<uint32_t>(entry.uncompressedSize));
+        put16(central, static_cast<uint16_t>(entry.name.size()));
+        put16(central, static_cast<uint16_t>(extra.size()));
+        put16(central, 0);      // comentario
+        put16(central, 0);      // disco
+        put16(central, 0);      // atributos internos
+        put32(central, 0);      // atributos externos
+        put32(central, bigOffset ? MAX32 : static_cast<uint32_t>(entry.localHeaderOffset));
+        central += entry.name;
+        central += extra;
+    }
+
+    uint64_t centralSize = central.size();
+    uint64_t zip64EndOffset = centralOffset + centralSize;
+    needZip64 = needZip64 || centralSize >= MAX32;
+
+    if (needZip64) {
+        put32(central, ZIP64_END_SIG);
+        put64(central, 44);
+        put16(central, VERSION_ZIP64);
+        put16(central, VERSION_ZIP64);
+        put32(central, 0);
+        put32(central, 0);
+        put64(central, m_entries.size());
+        put64(central, m_entries.size());
+        put64(central, centralSize);
+        put64(central, centralOffset);
+
+        put32(central, ZIP64_LOCATOR_SIG);
+        put32(central, 0);
+        put64(central, zip64EndOffset);
+        put32(central, 1);
+    }
+
+    uint16_t count = needZip64 ? MAX16 : static_cast<uint16_t>(m_entries.size());
+    put32(central, END_OF_CENTRAL_SIG);
+    put16(central, 0);
+    put16(central, 0);
+    put16(central, count);
+    put16(central, count);
+    put32(central, needZip64 ? MAX32 : static_cast<uint32_t>(centralSize));
+    put32(central, needZip64 ? MAX32 : static_cast<uint32_t>(centralOffset));
+    put16(central, 0);
+
+    m_out.write(central.data(), static_cast<std::streamsize>(central.size()));
+    return static_cast<bool>(m_out);
+}
+
+bool ZipArchiveWriter::close() {
+    if (!m_out.is_open()) {
+        return false;
+    }
+    bool ok = !m_failed && writeCentralDirectory();
+    m_out.close();
+    return ok && !m_out.fail();
+}
+
+// ============================================================================
+// ZipArchiveReader
+// ============================================================================
+
+bool ZipArchiveReader::open(const std::string& path) {
+    m_entries.clear();
+    m_in.open(path, std::ios::binary);
+    if (!m_in) {
+        LOG_ERROR("Failed to open archive: " + path);
+        return false;
+    }
+
+    m_in.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(m_in.tellg());
+    if (!readCentralDirectory(fileSize)) {
+        LOG_ERROR("Invalid or unsupported ZIP archive: " + path);
+        return false;
+    }
+    return true;
+}
+
+bool ZipArchiveReader::readCentralDirectory(uint64_t fileSize) {
+    // EOCD: 22 bytes + comentario de hasta 64 KB
+    uint64_t tailSize = std::min<uint64_t>(fileSize, 22 + 0xFFFF);
+    if (tailSize < 22) return false;
+
+    std::vector<unsigned char> tail(static_cast<size_t>(tailSize));
+    m_in.seekg(static_cast<std::streamoff>(fileSize - tailSize));
+    if (!m_in.read(reinterpret_cast<char*>(tail.data()), static_cast<std::streamsize>(tailSize))) {
+        return false;
+    }
+
+    int64_t eocd = -1;
+    for (int64_t i = static_cast<int64_t>(tailSize) - 22; i >= 0; i--) {
+        if (get32(&tail[static_cast<size_t>(i)]) == END_OF_CENTRAL_SIG) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) return false;
+
+    const unsigned char* e = &tail[static_cast<size_t>(eocd)];
+    uint64_t entryCount = get16(e + 10);
+    uint64_t centralSize = get32(e + 12);
+    uint64_t centralOffset = get32(e + 16);
+
+    if (entryCount == MAX16 || centralSize == MAX32 || centralOffset == MAX32) {
+        // Localizador ZIP64 justo antes del EOCD
+        if (eocd < 20) return false;
+        const unsigned char* locator = e - 20;
+        if (get32(locator) != ZIP64_LOCATOR_SIG) return false;
+
+        unsigned char record[56];
+        m_in.seekg(static_cast<std::streamoff>(get64(locator + 8)));
+        if (!m_in.read(reinterpret_cast<char*>(record), sizeof(record)) || get32(record) != ZIP64_END_SIG) {
+            return false;
+        }
+        entryCount = get64(record + 32);
+        centralSize = get64(record + 40);
+        centralOffset = get64(record + 48);
+    }
+
+    if (centralOffset + centralSize > fileSize) return false;
+
+    std::vector<unsigned char> central(static_cast<size_t>(centralSize));
+    m_in.seekg(static_cast<std::streamoff>(centralOffset));
+    if (centralSize > 0 &&
+        !m_in.read(reinterpret_cast<char*>(central.data()), static_cast<std::streamsize>(centralSize))) {
+        return false;
+    }
+
+    size_t pos = 0;
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (pos + 46 > central.size() || get32(&central[pos]) != CENTRAL_HEADER_SIG) return false;
+        const unsigned char* h = &central[pos];
+
+        Entry entry;
+        entry.method = get16(h + 10);
+        entry.crc = get32(h + 16);
+        entry.compressedSize = get32(h + 20);
+        entry.uncompressedSize = get32(h + 24);
+        uint16_t nameLen = get16(h + 28);
+        uint16_t extraLen = get16(h + 30);
+        uint16_t commentLen = get16(h + 32);
+        entry.localHeaderOffset = get32(h + 42);
+
+        if (pos + 46 + nameLen + extraLen + commentLen > central.size()) return false;
+        entry.name.assign(reinterpret_cast<const char*>(h + 46), nameLen);
+        // Compress-Archive antiguo usa '\' como separador
+        std::replace(entry.name.begin(), entry.name.end(), '\\', '/');
+
+        // Campos ZIP64: solo los que valen 0xFFFFFFFF, en orden fijo
+        const unsigned char* extra = h + 46 + nameLen;
+        size_t extraPos = 0;
+        while (extraPos + 4 <= extraLen) {
+            uint16_t id = get16(extra + extraPos);
+            uint16_t size = get16(extra + extraPos + 2);
+            if (extraPos + 4 + size > extraLen) break;
+            if (id == ZIP64_EXTRA_ID) {
+                const unsigned char* f = extra + extraPos + 4;
+                size_t fpos = 0;
+                if (entry.uncompressedSize == MAX32 && fpos + 8 <= size) { entry.uncompressedSize = get64(f + fpos); fpos += 8; }
+                if (entry.compressedSize == MAX32 && fpos + 8 <= size) { entry.compressedSize = get64(f + fpos); fpos += 8; }
+                if (entry.localHeaderOffset == MAX32 && fpos + 8 <= size) { entry.localHeaderOffset = get64(f + fpos); fpos += 8; }
+            }
+            extraPos += 4 + size;
+        }
+
+        m_entries.push_back(entry);
+        pos += 46 + nameLen + extraLen + commentLen;
+    }
+    return true;
+}
+
+const ZipArchiveReader::Entry* ZipArchiveReader::find(const std::string& name) const {
+    for (const auto& entry : m_entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool ZipArchiveReader::extract(const Entry& entry, const Sink& sink) {
+    if (entry.method != 0 && entry.method != 8) {
+        LOG_ERROR("Unsupported compression method in archive entry: " + entry.name);
+        return false;
+    }
+
+    unsigned char local[30];
+    m_in.clear();
+    m_in.seekg(static_cast<std::streamoff>(entry.localHeaderOffset));
+    if (!m_in.read(reinterpret_cast<char*>(local), sizeof(local)) || get32(local) != LOCAL_HEADER_SIG) {
+        LOG_ERROR("Corrupted local header in archive entry: " + entry.name);
+        return false;
+    }
+    m_in.seekg(get16(local + 26) + get16(local + 28), std::ios::cur);
+
+    z_stream inflater{};
+    bool inflating = entry.method == 8;
+    if (inflating && inflateInit2(&inflater, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint64_t remaining = entry.compressedSize;
+    uint64_t produced = 0;
+    std::vector<char> input(64 * 1024);
+    std::vector<char> output(256 * 1024);
+    bool ok = true;
+    bool streamEnded = !inflating;
+
+    auto deliver = [&](const char* data, size_t length) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(length));
+        produced += length;
+        return sink(data, length);
+    };
+
+    while (ok && remaining > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, input.size()));
+        if (!m_in.read(input.data(), static_cast<std::streamsize>(chunk))) {
+            ok = false;
+            break;
+        }
+        remaining -= chunk;
+
+        if (!inflating) {
+            ok = deliver(input.data(), chunk);
+            continue;
+        }
+
+        inflater.next_in = reinterpret_cast<Bytef*>(input.data());
+        inflater.avail_in = static_cast<uInt>(chunk);
+        while (ok && inflater.avail_in > 0 && !streamEnded) {
+            inflater.next_out = reinterpret_cast<Bytef*>(output.data());
+            inflater.avail_out = static_cast<uInt>(output.size());
+            int rc = inflate(&inflater, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END) {
+                ok = false;
+                break;
+            }
+            size_t have = output.size() - inflater.avail_out;
+            if (have > 0) {
+                ok = deliver(output.data(), have);
+            }
+            streamEnded = (rc == Z_STREAM_END);
+        }
+    }
+
+    // Vaciar lo que inflate pudiera retener
+    while (ok && inflating && !streamEnded) {
+        inflater.next_in = nullptr;
+        inflater.avail_in = 0;
+        inflater.next_out = reinterpret_cast<Bytef*>(output.data());
+        inflater.avail_out = static_cast<uInt>(output.size());
+        int rc = inflate(&inflater, Z_FINISH);
+        size_t have = output.size() - inflater.avail_out;
+        if (have > 0) ok = deliver(output.data(), have);
+        if (rc == Z_STREAM_END) streamEnded = true;
+        else if (rc != Z_OK && rc != Z_BUF_ERROR) ok = false;
+        else if (have == 0) ok = false;
+    }
+
+    if (inflating) {
+        inflateEnd(&inflater);
+    }
+
+    if (ok && (static_cast<uint32_t>(crc) != entry.crc || produced != entry.uncompressedSize)) {
+        LOG_ERROR("CRC/size mismatch in archive entry: " + entry.name);
+        ok = false;
+    }
+    return ok;
+}
+
+bool ZipArchiveReader::extractToString(const Entry& entry, std::string& out, size_t maxBytes) {
+    out.clear();
+    if (entry.uncompressedSize > maxBytes) {
+        return false;
+    }
+    return extract(entry, [&out](const char* data, size_t length) {
+        out.append(data, length);
+        return true;
+    });
+}
+
+} // namespace TelegramCloud
@@ -1,12 +1,13 @@
 #include "backupmanager.h"
 #include "logger.h"
+#include "cryptoengine.h"
+#include "backuparchive.h"
+#include "database.h"
 #include <filesystem>
-#include <cstdlib>
-#include <sstream>
 #include <fstream>
-#include <random>
-#include <openssl/evp.h>
-#include <openssl/rand.h>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
 #include <nlohmann/json.hpp>
 
 #ifdef TELEGRAMCLOUD_ANDROID
@@ -25,58 +26,121 @@ namespace TelegramCloud {
 
 using nlohmann::json;
 
-static bool writeFile(const std::string& path, const std::string& data) {
-    std::ofstream f(path, std::ios::binary);
-    if (!f) return false;
-    f.write(data.data(), (std::streamsize)data.size());
-    return (bool)f;
-}
+// Formato de archivo: BKP1 | salt(16) | iv(16) | ciphertext, clave = SHA256(password || salt)
+static const char BACKUP_MAGIC[] = "BKP1";
+static const size_t BACKUP_MAGIC_SIZE = 4;
+static const size_t BKP1_HEADER_SIZE = BACKUP_MAGIC_SIZE + CryptoEngine::SALT_SIZE + CryptoEngine::IV_SIZE;
 
-std::string BackupManager::randomBytes(size_t n) {
-    std::string s;
-    s.resize(n);
-    RAND_bytes(reinterpret_cast<unsigned char*>(&s[0]), (int)n);
-    return s;
-}
+namespace {
+
+// Cifrado BKP1 como etapa del escritor ZIP: la cabecera sale con el primer bloque
+class Bkp1Encryptor : public BlockTransform {
+public:
+    explicit Bkp1Encryptor(const std::string& password)
+        : m_salt(CryptoEngine::randomBytes(CryptoEngine::SALT_SIZE))
+        , m_iv(CryptoEngine::randomBytes(CryptoEngine::IV_SIZE)) {
+        m_ready = m_cipher.init(CipherStream::Mode::Encrypt, CryptoEngine::sha256(password, m_salt), m_iv);
+    }
+
+    bool update(const char* data, size_t length, std::string& out) override {
+        writeHeader(out);
+        return m_ready && m_cipher.update(data, length, out);
+    }
+
+    bool finish(std::string& out) override {
+        writeHeader(out);
+        return m_ready && m_cipher.finish(out);
+    }
+
+private:
+    void writeHeader(std::string& out) {
+        if (m_headerWritten) return;
+        out.append(BACKUP_MAGIC, BACKUP_MAGIC_SIZE);
+        out += m_salt;
+        out += m_iv;
+        m_headerWritten = true;
+    }
+
+    CipherStream m_cipher;
+    std::string m_salt;
+    std::string m_iv;
+    bool m_ready = false;
+    bool m_headerWritten = false;
+};
+
+// Descifrado BKP1 alimentado por bloques desde el lector ZIP
+class Bkp1Decryptor {
+public:
+    Bkp1Decryptor(const std::string& password, std::ostream& out)
+        : m_password(password), m_out(out) {}
+
+    bool update(const char* data, size_t length) {
+        if (!m_ready) {
+            size_t take = std::min(length, BKP1_HEADER_SIZE - m_header.size());
+            m_header.append(data, take);
+            data += take;
+            length -= take;
+            if (m_header.size() < BKP1_HEADER_SIZE) return true;
+            if (m_header.compare(0, BACKUP_MAGIC_SIZE, BACKUP_MAGIC) != 0) {
+                BACKUP_LOG_ERROR("Bkp1Decryptor: Invalid magic header");
+                return false;
+            }
+            std::string salt = m_header.substr(BACKUP_MAGIC_SIZE, CryptoEngine::SALT_SIZE);
+            std::string iv = m_header.substr(BACKUP_MAGIC_SIZE + CryptoEngine::SALT_SIZE, CryptoEngine::IV_SIZE);
+            if (!m_cipher.init(CipherStream::Mode::Decrypt, CryptoEngine::sha256(m_password, salt), iv)) {
+                return false;
+            }
+            m_ready = true;
+        }
+        if (length == 0) return true;
+        m_buffer.clear();
+        if (!m_cipher.update(data, length, m_buffer)) return false;
+        m_out.write(m_buffer.data(), (std::streamsize)m_buffer.size());
+        return (bool)m_out;
+    }
+
+    bool finish() {
+        if (!m_ready) return false;
+        m_buffer.clear();
+        if (!m_cipher.finish(m_buffer)) return false;
+        m_out.write(m_buffer.data(), (std::streamsize)m_buffer.size());
+        return (bool)m_out;
+    }
+
+private:
+    std::string m_password;
+    std::ostream& m_out;
+    CipherStream m_cipher;
+    std::string m_header;
+    std::string m_buffer;
+    bool m_ready = false;
+};
+
+} // namespace
 
 bool BackupManager::encryptFile(const std::string& in, const std::string& out, const std::string& password) {
     try {
         std::ifstream fi(in, std::ios::binary);
         if (!fi) return false;
-        std::string plain((std::istreambuf_iterator<char>(fi)), std::istreambuf_iterator<char>());
-
-        std::string salt = randomBytes(16);
-        std::string iv = randomBytes(16);
-
-        unsigned char key[32];
-        // Derive key = SHA256(password || salt)
-        EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-        EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
-        EVP_DigestUpdate(mdctx, password.data(), password.size());
-        EVP_DigestUpdate(mdctx, salt.data(), salt.size());
-        unsigned int outlen = 0;
-        EVP_DigestFinal_ex(mdctx, key, &outlen);
-        EVP_MD_CTX_free(mdctx);
-
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr,
-                           key, reinterpret_cast<const unsigned char*>(iv.data()));
-
-        std::string outbuf;
-        outbuf.resize(plain.size() + 16);
-        int len = 0, total = 0;
-        EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(&outbuf[0]), &len,
-                          reinterpret_cast<const unsigned char*>(plain.data()), (int)plain.size());
-        total = len;
-        EVP_EncryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&outbuf[0]) + total, &len);
-        total += len;
-        outbuf.resize(total);
-        EVP_CIPHER_CTX_free(ctx);
-
-        // File format: BKP1 | salt(16) | iv(16) | ciphertext
-        std::string magic = "BKP1";
-        std::string all = magic + salt + iv + outbuf;
-        return writeFile(out, all);
+
+        std::string salt = CryptoEngine::randomBytes(CryptoEngine::SALT_SIZE);
+        std::string iv = CryptoEngine::randomBytes(CryptoEngine::IV_SIZE);
+        std::string key = CryptoEngine::sha256(password, salt);
+
+        bool ok = false;
+        {
+            std::ofstream fo(out, std::ios::binary | std::ios::trunc);
+            if (!fo) return false;
+            fo.write(BACKUP_MAGIC, BACKUP_MAGIC_SIZE);
+            fo.write(salt.data(), (std::streamsize)salt.size());
+            fo.write(iv.data(), (std::streamsize)iv.size());
+            ok = fo && CryptoEngine::encryptStream(fi, fo, key, iv);
+        }
+        if (!ok) {
+            std::error_code ec;
+            fs::remove(out, ec);
+        }
+        return ok;
     } catch (...) {
         return false;
     }
@@ -90,81 +154,42 @@ bool BackupManager::decryptFile(const std::string& in, const std::string& out, c
             BACKUP_LOG_ERROR(("decryptFile: Cannot open input file: " + in).c_str());
             return false;
         }
-        std::string enc((std::istreambuf_iterator<char>(fi)), std::istreambuf_iterator<char>());
-        BACKUP_LOG_INFO(("decryptFile: Read " + std::to_string(enc.size()) + " bytes").c_str());
-        
-        if (enc.size() < 4 + 16 + 16) {
+
+        char header[BACKUP_MAGIC_SIZE + CryptoEngine::SALT_SIZE + CryptoEngine::IV_SIZE];
+        if (!fi.read(header, sizeof(header))) {
             BACKUP_LOG_ERROR("decryptFile: File too small (< 36 bytes header)");
             return false;
         }
-        
-        std::string magic = enc.substr(0, 4);
-        BACKUP_LOG_INFO(("decryptFile: Magic header = '" + magic + "'").c_str());
-        
-        if (magic != std::string("BKP1")) {
+
+        std::string magic(header, BACKUP_MAGIC_SIZE);
+        if (magic != std::string(BACKUP_MAGIC)) {
             BACKUP_LOG_ERROR(("decryptFile: Invalid magic header, expected 'BKP1' got '" + magic + "'").c_str());
             return false;
         }
-        
-        std::string salt = enc.substr(4, 16);
-        std::string iv = enc.substr(20, 16);
-        std::string cipher = enc.substr(36);
-        
-        BACKUP_LOG_INFO(("decryptFile: salt=" + std::to_string(salt.size()) + "B iv=" + std::to_string(iv.size()) + "B cipher=" + std::to_string(cipher.size()) + "B").c_str());
-
-        unsigned char key[32];
-        EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-        if (!mdctx) {
-            BACKUP_LOG_ERROR("decryptFile: EVP_MD_CTX_new failed");
-            return false;
-        }
-        EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
-        EVP_DigestUpdate(mdctx, password.data(), password.size());
-        EVP_DigestUpdate(mdctx, salt.data(), salt.size());
-        unsigned int outlen = 0;
-        EVP_DigestFinal_ex(mdctx, key, &outlen);
-        EVP_MD_CTX_free(mdctx);
-        BACKUP_LOG_INFO(("decryptFile: Derived key, len=" + std::to_string(outlen)).c_str());
-
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            BACKUP_LOG_ERROR("decryptFile: EVP_CIPHER_CTX_new failed");
-            return false;
-        }
-        
-        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr,
-                           key, reinterpret_cast<const unsigned char*>(iv.data())) != 1) {
-            BACKUP_LOG_ERROR("decryptFile: EVP_DecryptInit_ex failed");
-            EVP_CIPHER_CTX_free(ctx);
-            return false;
-        }
 
-        std::string outbuf;
-        outbuf.resize(cipher.size() + 16);
-        int len = 0, total = 0;
-        if (EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&outbuf[0]), &len,
-                              reinterpret_cast<const unsigned char*>(cipher.data()), (int)cipher.size()) != 1) {
-            BACKUP_LOG_ERROR("decryptFile: EVP_DecryptUpdate failed - wrong password?");
-            EVP_CIPHER_CTX_free(ctx);
-            return false;
+        std::string salt(header + BACKUP_MAGIC_SIZE, CryptoEngine::SALT_SIZE);
+        std::string iv(header + BACKUP_MAGIC_SIZE + CryptoEngine::SALT_SIZE, CryptoEngine::IV_SIZE);
+        std::string key = CryptoEngine::sha256(password, salt);
+
+        bool ok = false;
+        {
+            std::ofstream fo(out, std::ios::binary | std::ios::trunc);
+            if (!fo) {
+                BACKUP_LOG_ERROR(("decryptFile: Cannot create output file: " + out).c_str());
+                return false;
+            }
+            ok = CryptoEngine::decryptStream(fi, fo, key, iv);
         }
-        total = len;
-        BACKUP_LOG_INFO(("decryptFile: DecryptUpdate produced " + std::to_string(len) + " bytes").c_str());
-        
-        if (EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&outbuf[0]) + total, &len) != 1) {
-            BACKUP_LOG_ERROR("decryptFile: EVP_DecryptFinal_ex failed - wrong password or corrupted data");
-            EVP_CIPHER_CTX_free(ctx);
+
+        if (!ok) {
+            BACKUP_LOG_ERROR("decryptFile: Decryption failed - wrong password or corrupted data");
+            std::error_code ec;
+            fs::remove(out, ec);
             return false;
         }
-        total += len;
-        outbuf.resize(total);
-        EVP_CIPHER_CTX_free(ctx);
-
-        BACKUP_LOG_INFO(("decryptFile: Decrypted " + std::to_string(total) + " bytes total").c_str());
 
-        bool written = writeFile(out, outbuf);
-        BACKUP_LOG_INFO(("decryptFile: writeFile result=" + std::to_string(written)).c_str());
-        return written;
+        BACKUP_LOG_INFO("decryptFile: Decryption completed");
+        return true;
     } catch (const std::exception& e) {
         BACKUP_LOG_ERROR(("decryptFile: Exception: " + std::string(e.what())).c_str());
         return false;
@@ -174,103 +199,345 @@ bool BackupManager::decryptFile(const std::string& in, const std::string& out, c
     }
 }
 
-bool BackupManager::createZipBackup(const std::string& archivePath, const std::string& password) {
+namespace {
+
+const char* const DB_PATH = "database/telegram_cloud.db";
+
+struct BackupSource {
+    std::string path;
+    std::string plainName;
+    std::string encName;
+    ZipArchiveWriter::Method method;
+};
+
+// El snapshot/delta temporal se crea junto al archivo final
+void ensureParentDir(const std::string& archivePath) {
+    fs::path parent = fs::path(archivePath).parent_path();
+    if (!parent.empty()) fs::create_directories(parent);
+}
+
+std::string newChainId() {
+    return CryptoEngine::toHex(CryptoEngine::randomBytes(8));
+}
+
+// Escribir manifest + entradas en archivePath.part y renombrar al terminar
+bool writeBackupArchive(const std::string& archivePath, const json& manifest,
+                        const std::vector<BackupSource>& sources, const std::string& password) {
+    const std::string partPath = archivePath + ".part";
+    const bool encrypted = !password.empty();
+    std::error_code ec;
+
+    ZipArchiveWriter zip;
+    bool ok = zip.open(partPath);
+    ok = ok && zip.addEntry("backup_manifest.json", manifest.dump(), ZipArchiveWriter::Method::Deflate);
+
+    for (const auto& source : sources) {
+        if (!ok) break;
+        std::ifstream in(source.path, std::ios::binary);
+        if (!in) {
+            LOG_ERROR("Cannot open file for backup: " + source.path);
+            ok = false;
+            break;
+        }
+        uint64_t size = fs::file_size(source.path, ec);
+        if (!encrypted) {
+            ok = zip.addEntry(source.plainName, in, source.method, nullptr, size);
+        } else {
+            // El texto cifrado no se comprime: la entrada va STORED
+            Bkp1Encryptor encryptor(password);
+            ok = zip.addEntry(source.encName, in, ZipArchiveWriter::Method::Stored, &encryptor,
+                              size + BKP1_HEADER_SIZE + CryptoEngine::IV_SIZE);
+        }
+    }
+    ok = zip.close() && ok;
+
+    if (!ok) {
+        fs::remove(partPath, ec);
+        LOG_ERROR("Failed to write ZIP backup: " + archivePath);
+        return false;
+    }
+
+    fs::rename(partPath, archivePath);
+    return true;
+}
+
+bool readManifest(ZipArchiveReader& zip, json& manifest) {
+    manifest = json::object();
+    const auto* entry = zip.find("backup_manifest.json");
+    if (!entry) return true;   // backups muy antiguos: sin manifest, sin cifrar
     try {
-        // Prepare temp dir with files to include
-        fs::path tempDir = fs::path("backup_temp_pack");
-        if (fs::exists(tempDir)) fs::remove_all(tempDir);
-        fs::create_directories(tempDir);
-
-        bool encrypted = !password.empty();
-        if (encrypted) {
-            encryptFile(".env", (tempDir / ".env.enc").string(), password);
-            encryptFile("database/telegram_cloud.db", (tempDir / "telegram_cloud.db.enc").string(), password);
+        std::string text;
+        if (!zip.extractToString(*entry, text)) return false;
+        manifest = json::parse(text);
+        return manifest.is_object();
+    } catch (...) {
+        return false;
+    }
+}
+
+// Extraer una entrada a un temporal, descifrando al vuelo si hay password
+bool extractEntryTo(ZipArchiveReader& zip, const ZipArchiveReader::Entry& entry,
+                    const std::string& tempPath, const std::string& password) {
+    bool ok = false;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            LOG_ERROR("Cannot create file for restore: " + tempPath);
+            return false;
+        }
+        if (password.empty()) {
+            ok = zip.extract(entry, [&out](const char* data, size_t length) {
+                out.write(data, (std::streamsize)length);
+                return (bool)out;
+            });
         } else {
-            fs::copy_file(".env", tempDir / ".env", fs::copy_options::overwrite_existing);
-            fs::create_directories(tempDir / "database");
-            fs::copy_file("database/telegram_cloud.db", tempDir / "database/telegram_cloud.db", fs::copy_options::overwrite_existing);
+            Bkp1Decryptor decryptor(password, out);
+            ok = zip.extract(entry, [&decryptor](const char* data, size_t length) {
+                return decryptor.update(data, length);
+            }) && decryptor.finish();
         }
+        ok = ok && (bool)out;
+    }
+    if (!ok) {
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+    }
+    return ok;
+}
+
+} // namespace
 
-        // manifest
-        json j;
-        j["encrypted"] = encrypted;
-        std::string manifest = j.dump();
-        writeFile((tempDir / "backup_manifest.json").string(), manifest);
+bool BackupManager::createZipBackup(const std::string& archivePath, const std::string& password,
+                                    Database* database) {
+    const std::string snapshotPath = archivePath + ".db.snapshot";
+    std::error_code ec;
 
-        // Compress tempDir
-        fs::create_directories(fs::path(archivePath).parent_path());
-        std::ostringstream cmd;
-        cmd << "pwsh -NoLogo -NoProfile -Command \"Compress-Archive -Path '"
-            << (tempDir.string()) << "/*' -DestinationPath '" << archivePath << "' -Force\"";
+    try {
+        ensureParentDir(archivePath);
+
+        json manifest;
+        manifest["encrypted"] = !password.empty();
+        manifest["type"] = "full";
+
+        // Snapshot consistente de la DB abierta; sin Database se lee el archivo en disco.
+        // La secuencia se lee antes del snapshot: el primer delta puede repetir
+        // algún cambio ya incluido, pero reaplicarlo es idempotente.
+        std::string dbSource = DB_PATH;
+        int64_t seq = -1;
+        if (database) {
+            // El diario debe registrar desde antes del snapshot para que el
+            // primer incremental no pierda cambios
+            database->enableChangeJournal();
+            seq = database->getChangeSeq();
+            if (!database->backupTo(snapshotPath)) {
+                LOG_ERROR("Failed to snapshot database for backup");
+                return false;
+            }
+            dbSource = snapshotPath;
+            if (seq >= 0) {
+                manifest["chain"] = newChainId();
+                manifest["seq"] = seq;
+            }
+        }
 
         LOG_INFO("Creating ZIP backup: " + archivePath);
-        int rc = std::system(cmd.str().c_str());
-        fs::remove_all(tempDir);
-        if (rc != 0) {
-            LOG_ERROR("Compress-Archive returned error code: " + std::to_string(rc));
-            return false;
+        // Las páginas de SQLCipher ya están cifradas; deflate no reduciría nada
+        bool ok = writeBackupArchive(archivePath, manifest, {
+            {".env", ".env", ".env.enc", ZipArchiveWriter::Method::Deflate},
+            {dbSource, "database/telegram_cloud.db", "telegram_cloud.db.enc", ZipArchiveWriter::Method::Stored}
+        }, password);
+
+        if (database) fs::remove(snapshotPath, ec);
+
+        if (ok && manifest.contains("chain")) {
+            database->setBackupCheckpoint(manifest["chain"].get<std::string>(), seq);
         }
-        return fs::exists(archivePath);
+        return ok;
 
     } catch (const std::exception& e) {
+        fs::remove(archivePath + ".part", ec);
+        fs::remove(snapshotPath, ec);
         LOG_ERROR("Backup creation failed: " + std::string(e.what()));
         return false;
     }
 }
 
-bool BackupManager::restoreZipBackup(const std::string& archivePath, const std::string& password) {
+bool BackupManager::createIncrementalBackup(const std::string& archivePath, const std::string& password,
+                                            Database& database) {
+    std::string chainId;
+    int64_t fromSeq = 0;
+    if (!database.getBackupCheckpoint(chainId, fromSeq)) {
+        LOG_INFO("No previous backup to build on, creating full backup");
+        return createZipBackup(archivePath, password, &database);
+    }
+
+    const std::string deltaPath = archivePath + ".delta";
+    std::error_code ec;
+
     try {
-        if (!fs::exists(archivePath)) {
-            LOG_ERROR("Backup archive not found: " + archivePath);
+        ensureParentDir(archivePath);
+
+        int64_t toSeq = -1;
+        if (!database.exportChangesSince(fromSeq, deltaPath, toSeq)) {
+            LOG_ERROR("Failed to export database changes for incremental backup");
             return false;
         }
 
-        // Expand to temp dir
-        fs::path tempDir = fs::path("backup_temp_unpack");
-        if (fs::exists(tempDir)) fs::remove_all(tempDir);
-        fs::create_directories(tempDir);
+        json manifest;
+        manifest["encrypted"] = !password.empty();
+        manifest["type"] = "incremental";
+        manifest["chain"] = chainId;
+        manifest["from_seq"] = fromSeq;
+        manifest["to_seq"] = toSeq;
+
+        LOG_INFO("Creating incremental backup: " + archivePath + " (changes " +
+                 std::to_string(fromSeq) + ".." + std::to_string(toSeq) + ")");
+        // El delta es una base SQLCipher: ya va cifrado
+        bool ok = writeBackupArchive(archivePath, manifest, {
+            {".env", ".env", ".env.enc", ZipArchiveWriter::Method::Deflate},
+            {deltaPath, "catalog.delta", "catalog.delta.enc", ZipArchiveWriter::Method::Stored}
+        }, password);
+
+        fs::remove(deltaPath, ec);
+
+        if (ok) {
+            database.setBackupCheckpoint(chainId, toSeq);
+        }
+        return ok;
 
-        std::ostringstream cmd;
-        cmd << "pwsh -NoLogo -NoProfile -Command \"Expand-Archive -Path '"
-            << archivePath << "' -DestinationPath '" << tempDir.string() << "' -Force\"";
+    } catch (const std::exception& e) {
+        fs::remove(archivePath + ".part", ec);
+        fs::remove(deltaPath, ec);
+        LOG_ERROR("Incremental backup failed: " + std::string(e.what()));
+        return false;
+    }
+}
 
-        LOG_INFO("Restoring ZIP backup: " + archivePath);
-        int rc = std::system(cmd.str().c_str());
-        if (rc != 0) {
-            LOG_ERROR("Expand-Archive returned error code: " + std::to_string(rc));
-            fs::remove_all(tempDir);
+bool BackupManager::restoreZipBackup(const std::string& archivePath, const std::string& password) {
+    return restoreBackupChain({archivePath}, password);
+}
+
+bool BackupManager::restoreBackupChain(const std::vector<std::string>& archivePaths, const std::string& password) {
+    const std::string deltaDir = Database::pendingChangesDir(DB_PATH);
+    const std::string stagedDeltaDir = deltaDir + ".restore";
+    std::vector<std::pair<std::string, std::string>> staged;   // temporal -> destino
+    std::error_code ec;
+
+    auto discardStaged = [&]() {
+        for (const auto& s : staged) fs::remove(s.first, ec);
+        fs::remove_all(stagedDeltaDir, ec);
+    };
+
+    try {
+        if (archivePaths.empty()) {
+            LOG_ERROR("No backup archives to restore");
             return false;
         }
 
-        // read manifest
-        bool encrypted = false;
-        try {
-            std::ifstream mf((tempDir / "backup_manifest.json").string());
-            if (mf) {
-                json j; mf >> j;
-                if (j.contains("encrypted")) encrypted = j["encrypted"].get<bool>();
+        fs::create_directories("database");
+        fs::remove_all(stagedDeltaDir, ec);
+
+        std::string chainId;
+        int64_t seq = -1;
+        size_t deltaCount = 0;
+
+        // Extraer todo a temporales y solo sobrescribir si la cadena completa es válida
+        for (size_t i = 0; i < archivePaths.size(); i++) {
+            const std::string& archivePath = archivePaths[i];
+            if (!fs::exists(archivePath)) {
+                LOG_ERROR("Backup archive not found: " + archivePath);
+                discardStaged();
+                return false;
+            }
+
+            LOG_INFO("Restoring ZIP backup: " + archivePath);
+            ZipArchiveReader zip;
+            json manifest;
+            if (!zip.open(archivePath) || !readManifest(zip, manifest)) {
+                discardStaged();
+                return false;
             }
-        } catch (...) {}
 
-        if (encrypted) {
-            if (password.empty()) {
+            bool encrypted = manifest.value("encrypted", false);
+            std::string type = manifest.value("type", std::string("full"));
+            if (encrypted && password.empty()) {
                 LOG_ERROR("Backup requires password but none provided");
-                fs::remove_all(tempDir);
+                discardStaged();
                 return false;
             }
-            decryptFile((tempDir / ".env.enc").string(), ".env", password);
-            decryptFile((tempDir / "telegram_cloud.db.enc").string(), "database/telegram_cloud.db", password);
-        } else {
-            // Copy plain files
-            fs::copy_file(tempDir / ".env", ".env", fs::copy_options::overwrite_existing);
-            fs::create_directories("database");
-            fs::copy_file(tempDir / "database/telegram_cloud.db", "database/telegram_cloud.db", fs::copy_options::overwrite_existing);
+            const std::string key = encrypted ? password : std::string();
+
+            if (i == 0) {
+                if (type != "full") {
+                    LOG_ERROR("Backup chain must start with a full backup: " + archivePath);
+                    discardStaged();
+                    return false;
+                }
+                chainId = manifest.value("chain", std::string());
+                seq = manifest.value("seq", (int64_t)-1);
+
+                // Los backups de Compress-Archive guardaban la DB sin el directorio
+                const ZipArchiveReader::Entry* dbEntry = encrypted
+                    ? zip.find("telegram_cloud.db.enc")
+                    : (zip.find("database/telegram_cloud.db") ? zip.find("database/telegram_cloud.db")
+                                                              : zip.find("telegram_cloud.db"));
+                staged.emplace_back(std::string(DB_PATH) + ".restore", DB_PATH);
+                if (!dbEntry || !extractEntryTo(zip, *dbEntry, staged.back().first, key)) {
+                    LOG_ERROR("Failed to restore database (wrong password or corrupted backup)");
+                    discardStaged();
+                    return false;
+                }
+            } else {
+                int64_t fromSeq = manifest.value("from_seq", (int64_t)-1);
+                if (type != "incremental" || chainId.empty() ||
+                    manifest.value("chain", std::string()) != chainId || fromSeq != seq) {
+                    LOG_ERROR("Incremental backup does not continue the chain: " + archivePath);
+                    discardStaged();
+                    return false;
+                }
+                seq = manifest.value("to_seq", (int64_t)-1);
+
+                const ZipArchiveReader::Entry* deltaEntry = zip.find(encrypted ? "catalog.delta.enc" : "catalog.delta");
+                char name[32];
+                std::snprintf(name, sizeof(name), "%020lld.delta", (long long)seq);
+                fs::create_directories(stagedDeltaDir);
+                std::string deltaTemp = (fs::path(stagedDeltaDir) / name).string();
+                if (!deltaEntry || !extractEntryTo(zip, *deltaEntry, deltaTemp, key)) {
+                    LOG_ERROR("Failed to restore incremental changes (wrong password or corrupted backup)");
+                    discardStaged();
+                    return false;
+                }
+                deltaCount++;
+            }
+
+            // .env del backup más reciente de la cadena
+            if (i + 1 == archivePaths.size()) {
+                const ZipArchiveReader::Entry* envEntry = zip.find(encrypted ? ".env.enc" : ".env");
+                staged.emplace_back(".env.restore", ".env");
+                if (!envEntry || !extractEntryTo(zip, *envEntry, staged.back().first, key)) {
+                    LOG_ERROR("Failed to restore .env (wrong password or corrupted backup)");
+                    discardStaged();
+                    return false;
+                }
+            }
         }
 
-        fs::remove_all(tempDir);
+        // Los deltas se reaplican en Database::initialize, con la clave ya disponible.
+        // Un WAL de la base anterior corrompería la restaurada
+        fs::remove_all(deltaDir, ec);
+        fs::remove(std::string(DB_PATH) + "-wal", ec);
+        fs::remove(std::string(DB_PATH) + "-shm", ec);
+        for (const auto& s : staged) {
+            fs::rename(s.first, s.second);
+        }
+        if (deltaCount > 0) {
+            fs::rename(stagedDeltaDir, deltaDir);
+            LOG_INFO("Staged " + std::to_string(deltaCount) + " incremental deltas for replay");
+        }
         return true;
 
     } catch (const std::exception& e) {
+        discardStaged();
         LOG_ERROR("Backup restore failed: " + std::string(e.what()));
         return false;
     }
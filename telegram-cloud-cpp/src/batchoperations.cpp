@@ -1,5 +1,9 @@
 #include "batchoperations.h"
 #include "logger.h"
+#include "chunkintegrity.h"
+#include "downloadqueue.h"
+#include "config.h"
+#include "cryptoengine.h"
 #ifndef TELEGRAMCLOUD_ANDROID
 #include <wx/filename.h>
 #include <wx/msgdlg.h>
@@ -9,10 +13,9 @@
 #include <future>
 #include <algorithm>
 #include <map>
-#include <openssl/aes.h>
-#include <openssl/rand.h>
-#include <openssl/evp.h>
-#include <openssl/sha.h>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 namespace TelegramCloud {
 
@@ -73,12 +76,33 @@ bool BatchOperations::downloadFiles(const std::set<long>& selectedIndices,
                                     BatchProgressCallback progressCallback) {
     LOG_INFO("Starting batch download for " + std::to_string(selectedIndices.size()) + " files");
     
+    int failedDownloads = 0;
+    std::vector<std::string> fileIds;
+    std::set<std::string> selectedIds;
+    for (long index : selectedIndices) {
+        auto it = itemToFileId.find(index);
+        if (it == itemToFileId.end()) {
+            LOG_ERROR("File ID not found for index: " + std::to_string(index));
+            failedDownloads++;
+            continue;
+        }
+        // Dos filas del mismo archivo escribirían a la vez el mismo destino
+        if (selectedIds.insert(it->second).second) {
+            fileIds.push_back(it->second);
+        }
+    }
+    
+    // Una sola consulta para la información de todo el lote
+    std::vector<FileInfo> files = m_database->getFilesInfo(fileIds);
+    if (files.size() < fileIds.size()) {
+        LOG_ERROR(std::to_string(fileIds.size() - files.size()) + " file(s) not found in database");
+        failedDownloads += static_cast<int>(fileIds.size() - files.size());
+    }
+    
     // Verificar si hay archivos encriptados
     bool hasEncryptedFiles = false;
-    std::vector<BatchFileInfo> batchFiles = getBatchFileInfo(selectedIndices, itemToFileId);
-    
-    for (const auto& file : batchFiles) {
-        if (file.isEncrypted) {
+    for (const auto& fileInfo : files) {
+        if (fileInfo.isEncrypted) {
             hasEncryptedFiles = true;
             break;
         }
@@ -108,58 +132,139 @@ bool BatchOperations::downloadFiles(const std::set<long>& selectedIndices,
 #endif
     }
     
-    int totalFiles = selectedIndices.size();
-    int successfulDownloads = 0;
-    int failedDownloads = 0;
-    int current = 0;
+    // Preparar un trabajo por archivo; sus chunks se reparten en una cola global
+    std::vector<std::unique_ptr<BatchDownloadJob>> jobs;
+    std::map<std::string, BatchDownloadJob*> chunkedJobs;
+    std::vector<std::string> chunkedIds;
     
-    for (long index : selectedIndices) {
-        current++;
-        
-        auto it = itemToFileId.find(index);
-        if (it == itemToFileId.end()) {
-            LOG_ERROR("File ID not found for index: " + std::to_string(index));
-            failedDownloads++;
-            continue;
-        }
-        
-        std::string fileId = it->second;
-        
-        // Obtener información del archivo
-        FileInfo fileInfo = m_database->getFileInfo(fileId);
-        if (fileInfo.fileId.empty()) {
-            LOG_ERROR("File not found in database: " + fileId);
-            failedDownloads++;
-            continue;
+    for (const auto& fileInfo : files) {
+        auto job = std::make_unique<BatchDownloadJob>();
+        job->info.fileId = fileInfo.fileId;
+        job->info.fileName = fileInfo.fileName;
+        job->info.fileSize = formatFileSize(fileInfo.fileSize);
+        job->info.mimeType = fileInfo.mimeType;
+        job->info.uploadDate = fileInfo.uploadDate;
+        job->info.isEncrypted = fileInfo.isEncrypted;
+        job->info.category = fileInfo.category;
+        job->telegramFileId = fileInfo.telegramFileId;
+        job->botToken = fileInfo.uploaderBotToken;
+        job->fullPath = destinationDir + "/" + fileInfo.fileName;
+        job->password = fileInfo.isEncrypted ? password : "";
+        
+        if (job->info.category == "chunked") {
+            chunkedJobs[fileInfo.fileId] = job.get();
+            chunkedIds.push_back(fileInfo.fileId);
+        }
+        jobs.push_back(std::move(job));
+    }
+    
+    // Tablas de chunks de todos los archivos fragmentados en una sola consulta
+    if (!chunkedIds.empty() &&
+        !m_database->getChunksForFiles(chunkedIds, [&](const std::string& fileId, std::vector<ChunkInfo>& chunks) {
+            auto it = chunkedJobs.find(fileId);
+            if (it != chunkedJobs.end()) {
+                it->second->chunks = std::move(chunks);
+            }
+            return true;
+        })) {
+        LOG_ERROR("Failed to load chunk tables for batch download");
+        return false;
+    }
+    
+    int totalUnits = 0;
+    for (auto jobIt = jobs.begin(); jobIt != jobs.end();) {
+        BatchDownloadJob* job = jobIt->get();
+        
+        if (job->info.category == "chunked") {
+            if (job->chunks.empty()) {
+                LOG_ERROR("No chunks found for file: " + job->info.fileName);
+                failedDownloads++;
+                jobIt = jobs.erase(jobIt);
+                continue;
+            }
+            job->tempDir = "temp_batch_download_" + job->info.fileId;
+            std::filesystem::create_directories(job->tempDir);
         }
         
-        BatchFileInfo batchFileInfo;
-        batchFileInfo.fileId = fileId;
-        batchFileInfo.fileName = fileInfo.fileName;
-        batchFileInfo.fileSize = formatFileSize(fileInfo.fileSize);
-        batchFileInfo.mimeType = fileInfo.mimeType;
-        batchFileInfo.uploadDate = fileInfo.uploadDate;
-        batchFileInfo.isEncrypted = fileInfo.isEncrypted;
-        batchFileInfo.category = fileInfo.category;
-        
+        int units = job->chunks.empty() ? 1 : static_cast<int>(job->chunks.size());
+        job->remaining = units;
+        totalUnits += units;
+        ++jobIt;
+    }
+    
+    // Progreso agregado en unidades (chunks o archivos directos) de todo el lote
+    std::mutex progressMutex;
+    int completedUnits = 0;
+    std::atomic<int> successfulDownloads(0);
+    
+    auto reportUnit = [&](const std::string& fileName) {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        completedUnits++;
         if (progressCallback) {
-            progressCallback(current, totalFiles, "Downloading", batchFileInfo.fileName);
+            progressCallback(completedUnits, totalUnits, "Downloading", fileName);
+        }
+    };
+    
+    auto finishJob = [&](BatchDownloadJob* job) {
+        bool ok = !job->failed;
+        if (ok && !job->chunks.empty()) {
+            ok = assembleChunkedFile(job->chunks, job->tempDir, job->fullPath, job->password);
+        }
+        if (!job->tempDir.empty()) {
+            std::error_code ec;
+            std::filesystem::remove_all(job->tempDir, ec);
         }
         
-        LOG_INFO("Downloading file " + std::to_string(current) + "/" + std::to_string(totalFiles) + ": " + batchFileInfo.fileName);
-        
-        std::string filePassword = batchFileInfo.isEncrypted ? password : "";
-        
-        if (downloadSingleFile(batchFileInfo, destinationDir, filePassword)) {
+        if (ok) {
             successfulDownloads++;
-            LOG_INFO("Successfully downloaded: " + batchFileInfo.fileName);
+            LOG_INFO("Successfully downloaded: " + job->info.fileName);
         } else {
-            failedDownloads++;
-            LOG_ERROR("Failed to download: " + batchFileInfo.fileName);
+            LOG_ERROR("Failed to download: " + job->info.fileName);
+        }
+    };
+    
+    {
+        // Cota global de concurrencia sobre todo el pool de bots
+        Config& config = Config::instance();
+        DownloadQueue queue(config.downloadMaxInFlight(), config.downloadPerTokenLimit());
+        
+        for (auto& jobPtr : jobs) {
+            BatchDownloadJob* job = jobPtr.get();
+            
+            if (job->chunks.empty()) {
+                queue.submit(job->botToken, [this, job, &reportUnit, &finishJob]() {
+                    bool ok = downloadDirectFile(job->telegramFileId, job->botToken, job->fullPath, job->password);
+                    job->failed = !ok;
+                    reportUnit(job->info.fileName);
+                    finishJob(job);
+                    return ok;
+                });
+                continue;
+            }
+            
+            for (const auto& chunk : job->chunks) {
+                queue.submit(chunk.uploaderBotToken, [this, job, chunk, &reportUnit, &finishJob]() {
+                    bool ok = downloadBatchChunk(chunk, job->tempDir);
+                    if (!ok) {
+                        job->failed = true;
+                    }
+                    reportUnit(job->info.fileName);
+                    
+                    // El último chunk en terminar reconstruye el archivo
+                    if (--job->remaining == 0) {
+                        finishJob(job);
+                    }
+                    return ok;
+                });
+            }
         }
+        
+        queue.waitAll();
     }
     
-    LOG_INFO("Batch download completed: " + std::to_string(successfulDownloads) + " successful, " + std::to_string(failedDownloads) + " failed");
+    failedDownloads += static_cast<int>(jobs.size()) - successfulDownloads.load();
+    
+    LOG_INFO("Batch download completed: " + std::to_string(successfulDownloads.load()) + " successful, " + std::to_string(failedDownloads) + " failed");
     return failedDownloads == 0;
 }
 
@@ -185,20 +290,17 @@ std::string BatchOperations::generateGlobalShareLink(const std::set<long>& selec
 std::vector<BatchFileInfo> BatchOperations::getBatchFileInfo(const std::set<long>& selectedIndices,
                                                             const std::map<long, std::string>& itemToFileId) {
     std::vector<BatchFileInfo> batchFiles;
+    std::vector<std::string> fileIds;
     
     for (long index : selectedIndices) {
         auto it = itemToFileId.find(index);
-        if (it == itemToFileId.end()) {
-            continue;
-        }
-        
-        std::string fileId = it->second;
-        FileInfo fileInfo = m_database->getFileInfo(fileId);
-        
-        if (fileInfo.fileId.empty()) {
-            continue;
+        if (it != itemToFileId.end()) {
+            fileIds.push_back(it->second);
         }
-        
+    }
+    
+    // Los archivos que ya no existen no aparecen en el resultado
+    for (const auto& fileInfo : m_database->getFilesInfo(fileIds)) {
         BatchFileInfo batchFileInfo;
         batchFileInfo.fileId = fileInfo.fileId;
         batchFileInfo.fileName = fileInfo.fileName;
@@ -275,52 +377,23 @@ bool BatchOperations::deleteSingleFile(const std::string& fileId, const std::str
     }
 }
 
-bool BatchOperations::downloadSingleFile(const BatchFileInfo& fileInfo, const std::string& destinationDir, const std::string& decryptionPassword) {
-    try {
-        std::string fileName = fileInfo.fileName;
-        std::string fullPath = destinationDir + "/" + fileName;
-        
-        bool success = false;
-        
-        if (fileInfo.category == "chunked") {
-            // Descargar archivo chunked
-            auto chunks = m_database->getFileChunks(fileInfo.fileId);
-            if (!chunks.empty()) {
-                success = downloadChunkedFile(fileInfo, chunks, fullPath, decryptionPassword);
-            }
-        } else {
-            // Descargar archivo directo
-            success = downloadDirectFile(fileInfo, fullPath, decryptionPassword);
-        }
-        
-        return success;
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("Exception during file download: " + std::string(e.what()));
-        return false;
+bool BatchOperations::downloadBatchChunk(const ChunkInfo& chunk, const std::string& tempDir) {
+    std::string chunkPath = tempDir + "/chunk_" + std::to_string(chunk.chunkNumber) + ".tmp";
+    
+    // Caché local o red con el bot que subió el chunk; hash verificado al escribir
+    if (ChunkIntegrity::fetchVerifiedChunk(m_telegramHandler, chunk, chunkPath, chunk.uploaderBotToken)) {
+        return true;
     }
+    
+    LOG_ERROR("Failed to download chunk " + std::to_string(chunk.chunkNumber) + " into " + tempDir);
+    return false;
 }
 
-bool BatchOperations::downloadChunkedFile(const BatchFileInfo& fileInfo, const std::vector<ChunkInfo>& chunks, const std::string& fullPath, const std::string& decryptionPassword) {
+bool BatchOperations::assembleChunkedFile(const std::vector<ChunkInfo>& chunks, const std::string& tempDir, const std::string& fullPath, const std::string& decryptionPassword) {
     try {
-        // Crear directorio temporal
-        std::string tempDir = "temp_batch_download_" + fileInfo.fileId;
-        std::filesystem::create_directories(tempDir);
-        
-        // Descargar chunks
-        for (const auto& chunk : chunks) {
-            std::string chunkPath = tempDir + "/chunk_" + std::to_string(chunk.chunkNumber) + ".tmp";
-            
-            if (!m_telegramHandler->downloadFile(chunk.telegramFileId, chunkPath)) {
-                std::filesystem::remove_all(tempDir);
-                return false;
-            }
-        }
-        
         // Reconstruir archivo
         std::ofstream finalFile(fullPath, std::ios::binary);
         if (!finalFile.is_open()) {
-            std::filesystem::remove_all(tempDir);
             return false;
         }
         
@@ -335,9 +408,6 @@ bool BatchOperations::downloadChunkedFile(const BatchFileInfo& fileInfo, const s
         
         finalFile.close();
         
-        // Limpiar archivos temporales
-        std::filesystem::remove_all(tempDir);
-        
         // Desencriptar si es necesario
         if (!decryptionPassword.empty()) {
             std::string tempEncryptedPath = fullPath + ".tmp";
@@ -359,10 +429,9 @@ bool BatchOperations::downloadChunkedFile(const BatchFileInfo& fileInfo, const s
     }
 }
 
-bool BatchOperations::downloadDirectFile(const BatchFileInfo& fileInfo, const std::string& fullPath, const std::string& decryptionPassword) {
+bool BatchOperations::downloadDirectFile(const std::string& telegramFileId, const std::string& botToken, const std::string& fullPath, const std::string& decryptionPassword) {
     try {
-        FileInfo dbFileInfo = m_database->getFileInfo(fileInfo.fileId);
-        bool success = m_telegramHandler->downloadFile(dbFileInfo.telegramFileId, fullPath);
+        bool success = m_telegramHandler->downloadFile(telegramFileId, fullPath, botToken);
         
         if (success && !decryptionPassword.empty()) {
             std::string tempEncryptedPath = fullPath + ".tmp";
@@ -385,172 +454,13 @@ bool BatchOperations::downloadDirectFile(const BatchFileInfo& fileInfo, const st
 }
 
 bool BatchOperations::decryptFile(const std::string& inputPath, const std::string& outputPath, const std::string& password) {
-    try {
-        // Leer archivo encriptado
-        std::ifstream inFile(inputPath, std::ios::binary);
-        if (!inFile) {
-            return false;
-        }
-        
-        std::vector<char> fileData((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
-        inFile.close();
-        
-        std::string ciphertext(fileData.begin(), fileData.end());
-        
-        // Desencriptar
-        std::string decrypted = aesDecrypt(ciphertext, password);
-        
-        // Escribir archivo desencriptado
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) {
-            return false;
-        }
-        
-        outFile.write(decrypted.c_str(), decrypted.size());
-        outFile.close();
-        
-        return true;
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("File decryption failed: " + std::string(e.what()));
-        return false;
-    }
-}
-
-std::string BatchOperations::aesDecrypt(const std::string& ciphertext, const std::string& password) {
-    try {
-        if (ciphertext.length() < 32) {
-            throw std::runtime_error("Invalid ciphertext length");
-        }
-        
-        // Extraer salt, IV y datos encriptados
-        std::string salt = ciphertext.substr(0, 16);
-        std::string iv = ciphertext.substr(16, 16);
-        std::string encrypted_data = ciphertext.substr(32);
-        
-        // Derivar clave
-        std::string key = deriveKey(password, salt);
-        
-        // Inicializar contexto de desencriptación
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            throw std::runtime_error("Failed to create decryption context");
-        }
-        
-        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                              reinterpret_cast<const unsigned char*>(key.c_str()),
-                              reinterpret_cast<const unsigned char*>(iv.c_str())) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Failed to initialize decryption");
-        }
-        
-        // Desencriptar datos
-        int len;
-        int plaintext_len;
-        std::string plaintext(encrypted_data.length() + AES_BLOCK_SIZE, 0);
-        
-        if (EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]), &len,
-                             reinterpret_cast<const unsigned char*>(encrypted_data.c_str()), encrypted_data.length()) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Decryption update failed");
-        }
-        plaintext_len = len;
-        
-        if (EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]) + len, &len) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Decryption finalization failed");
-        }
-        plaintext_len += len;
-        
-        EVP_CIPHER_CTX_free(ctx);
-        plaintext.resize(plaintext_len);
-        
-        return plaintext;
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("AES decryption error: " + std::string(e.what()));
-        return "";
-    }
-}
-
-std::string BatchOperations::deriveKey(const std::string& password, const std::string& salt) {
-    std::string key(32, 0);
-    
-    if (PKCS5_PBKDF2_HMAC(
-        password.c_str(), password.length(),
-        reinterpret_cast<const unsigned char*>(salt.c_str()), salt.length(),
-        10000,
-        EVP_sha256(),
-        32,
-        reinterpret_cast<unsigned char*>(&key[0])
-    ) != 1) {
-        throw std::runtime_error("Key derivation failed");
-    }
-    
-    return key;
+    // Descifrado en streaming: la memoria no depende del tamaño del archivo
+    return CryptoEngine::decryptFileWithPassword(inputPath, outputPath, password);
 }
 
 std::string BatchOperations::encryptShareData(const std::string& data, const std::string& password) {
     try {
-        // Generar salt aleatorio
-        std::string salt(16, 0);
-        if (RAND_bytes(reinterpret_cast<unsigned char*>(&salt[0]), 16) != 1) {
-            throw std::runtime_error("Failed to generate salt");
-        }
-        
-        // Derivar clave
-        std::string key = deriveKey(password, salt);
-        
-        // Inicializar contexto de encriptación
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            throw std::runtime_error("Failed to create encryption context");
-        }
-        
-        // Generar IV aleatorio
-        unsigned char iv[AES_BLOCK_SIZE];
-        if (RAND_bytes(iv, AES_BLOCK_SIZE) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Failed to generate IV");
-        }
-        
-        // Inicializar encriptación
-        if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                              reinterpret_cast<const unsigned char*>(key.c_str()), iv) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Failed to initialize encryption");
-        }
-        
-        // Encriptar datos
-        int len;
-        int ciphertext_len;
-        std::string ciphertext(data.length() + AES_BLOCK_SIZE, 0);
-        
-        if (EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(&ciphertext[0]), &len,
-                             reinterpret_cast<const unsigned char*>(data.c_str()), data.length()) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Encryption update failed");
-        }
-        ciphertext_len = len;
-        
-        if (EVP_EncryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&ciphertext[0]) + len, &len) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Encryption finalization failed");
-        }
-        ciphertext_len += len;
-        
-        EVP_CIPHER_CTX_free(ctx);
-        ciphertext.resize(ciphertext_len);
-        
-        // Combinar: salt + iv + ciphertext
-        std::string result;
-        result.reserve(16 + 16 + ciphertext.length());
-        result += salt;
-        result += std::string(reinterpret_cast<char*>(iv), AES_BLOCK_SIZE);
-        result += ciphertext;
-        
-        return result;
-        
+        return CryptoEngine::encryptWithPassword(data, password);
     } catch (const std::exception& e) {
         LOG_ERROR("Share data encryption error: " + std::string(e.what()));
         return "";
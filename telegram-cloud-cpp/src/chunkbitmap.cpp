@@ -0,0 +1,246 @@
+#include "chunkbitmap.h"
+#include <bitset>
+#include <algorithm>
+
+namespace TelegramCloud {
+
+void ChunkBitmap::resize(int64_t size) {
+    m_size = size < 0 ? 0 : size;
+    m_words.resize(static_cast<size_t>((m_size + 63) / 64), 0);
+
+    // Limpiar bits sobrantes de la última palabra
+    if (m_size % 64 != 0 && !m_words.empty()) {
+        m_words.back() &= (uint64_t(1) << (m_size % 64)) - 1;
+    }
+}
+
+void ChunkBitmap::set(int64_t index) {
+    if (index < 0) return;
+    if (index >= m_size) {
+        resize(index + 1);
+    }
+    m_words[index / 64] |= uint64_t(1) << (index % 64);
+}
+
+void ChunkBitmap::reset(int64_t index) {
+    if (index < 0 || index >= m_size) return;
+    m_words[index / 64] &= ~(uint64_t(1) << (index % 64));
+}
+
+bool ChunkBitmap::test(int64_t index) const {
+    if (index < 0 || index >= m_size) return false;
+    return (m_words[index / 64] >> (index % 64)) & 1;
+}
+
+int64_t ChunkBitmap::count() const {
+    int64_t total = 0;
+    for (uint64_t word : m_words) {
+        total += static_cast<int64_t>(std::bitset<64>(word).count());
+    }
+    return total;
+}
+
+void ChunkBitmap::clear() {
+    std::fill(m_words.begin(), m_words.end(), 0);
+}
+
+namespace {
+
+// Cabecera del formato comprimido: "CB" + codificación
+const char BITMAP_MAGIC[] = {'C', 'B'};
+const char ENCODING_RUNS = 1;
+const char ENCODING_RAW = 2;
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool getVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+std::string ChunkBitmap::serialize() const {
+    // Runs alternos empezando por ceros: 111000 -> [0, 3, 3]
+    std::string runs;
+    runs.append(BITMAP_MAGIC, 2);
+    runs.push_back(ENCODING_RUNS);
+    putVarint(runs, static_cast<uint64_t>(m_size));
+
+    bool current = false;
+    uint64_t runLength = 0;
+    for (int64_t i = 0; i < m_size; i++) {
+        bool bit = test(i);
+        if (bit != current) {
+            putVarint(runs, runLength);
+            current = bit;
+            runLength = 0;
+        }
+        runLength++;
+    }
+    putVarint(runs, runLength);
+
+    // Patrones muy fragmentados: palabras crudas ocupan menos
+    size_t rawSize = 3 + 10 + m_words.size() * 8;
+    if (runs.size() <= rawSize) {
+        return runs;
+    }
+
+    std::string raw;
+    raw.append(BITMAP_MAGIC, 2);
+    raw.push_back(ENCODING_RAW);
+    putVarint(raw, static_cast<uint64_t>(m_size));
+    for (uint64_t word : m_words) {
+        for (int i = 0; i < 8; i++) {
+            raw.push_back(static_cast<char>((word >> (i * 8)) & 0xFF));
+        }
+    }
+    return raw;
+}
+
+ChunkBitmap ChunkBitmap::deserialize(const std::string& blob, int64_t expectedSize) {
+    ChunkBitmap bitmap;
+    if (blob.size() < 3 || blob[0] != BITMAP_MAGIC[0] || blob[1] != BITMAP_MAGIC[1]) {
+        return bitmap;
+    }
+
+    size_t pos = 3;
+    uint64_t size = 0;
+    if (!getVarint(blob, pos, size)) {
+        return bitmap;
+    }
+
+    // El tamaño viene del blob: no reservar nada que no cuadre con la transferencia
+    if (expectedSize >= 0 ? size != static_cast<uint64_t>(expectedSize) : size > static_cast<uint64_t>(MAX_SIZE)) {
+        return bitmap;
+    }
+
+    if (blob[2] == ENCODING_RUNS) {
+        // Primera pasada sin reservar: los runs deben sumar exactamente size
+        size_t runsStart = pos;
+        uint64_t total = 0;
+        uint64_t runLength = 0;
+        while (total < size && getVarint(blob, pos, runLength)) {
+            if (runLength > size - total) {
+                return bitmap;
+            }
+            total += runLength;
+        }
+        if (total != size) {
+            return bitmap; // blob truncado o corrupto
+        }
+
+        bitmap.resize(static_cast<int64_t>(size));
+        pos = runsStart;
+        bool current = false;
+        uint64_t offset = 0;
+        while (offset < size && getVarint(blob, pos, runLength)) {
+            uint64_t end = offset + runLength;
+            if (current) {
+                for (uint64_t i = offset; i < end; i++) {
+                    bitmap.m_words[i / 64] |= uint64_t(1) << (i % 64);
+                }
+            }
+            offset = end;
+            current = !current;
+        }
+        return bitmap;
+    }
+
+    if (blob[2] == ENCODING_RAW) {
+        size_t wordCount = static_cast<size_t>((size + 63) / 64);
+        if ((blob.size() - pos) / 8 < wordCount) {
+            return bitmap; // blob truncado
+        }
+        bitmap.resize(static_cast<int64_t>(size));
+        for (size_t w = 0; w < wordCount; w++) {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; i++) {
+                word |= static_cast<uint64_t>(static_cast<unsigned char>(blob[pos + w * 8 + i])) << (i * 8);
+            }
+            bitmap.m_words[w] = word;
+        }
+        bitmap.resize(bitmap.m_size); // descartar bits fuera de rango
+    }
+
+    return bitmap;
+}
+
+// ============================================================================
+// TransferCheckpoint
+// ============================================================================
+
+void TransferCheckpoint::reset(const ChunkBitmap& bitmap, FlushFunction flushFunction) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bitmap = bitmap;
+    m_flushFunction = std::move(flushFunction);
+    m_pendingChanges = 0;
+    m_lastFlush = std::chrono::steady_clock::now();
+}
+
+int64_t TransferCheckpoint::markCompleted(int64_t index) {
+    int64_t completed = 0;
+    bool flushDue = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bitmap.test(index)) {
+            m_bitmap.set(index);
+            m_pendingChanges++;
+        }
+        completed = m_bitmap.count();
+        flushDue = m_pendingChanges >= FLUSH_EVERY_CHUNKS ||
+                   (m_pendingChanges > 0 && std::chrono::steady_clock::now() - m_lastFlush >= FLUSH_INTERVAL);
+    }
+
+    if (flushDue) {
+        flush();
+    }
+    return completed;
+}
+
+bool TransferCheckpoint::isCompleted(int64_t index) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bitmap.test(index);
+}
+
+int64_t TransferCheckpoint::completedCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bitmap.count();
+}
+
+void TransferCheckpoint::flush() {
+    // m_flushMutex mantiene el orden de los volcados: nunca se escribe un estado más viejo encima
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+
+    std::string blob;
+    int64_t completed = 0;
+    FlushFunction flushFunction;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_flushFunction || m_pendingChanges == 0) {
+            return;
+        }
+        blob = m_bitmap.serialize();
+        completed = m_bitmap.count();
+        flushFunction = m_flushFunction;
+        m_pendingChanges = 0;
+        m_lastFlush = std::chrono::steady_clock::now();
+    }
+
+    flushFunction(blob, completed);
+}
+
+} // namespace TelegramCloud
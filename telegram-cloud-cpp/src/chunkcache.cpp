@@ -0,0 +1,388 @@
+#include "chunkcache.h"
+#include "config.h"
+#include "logger.h"
+#include "cryptoengine.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace TelegramCloud {
+
+namespace {
+const char* INDEX_FILE_NAME = "index.lru";
+const char* PART_SUFFIX = ".part";
+std::atomic<uint64_t> s_partCounter{0};
+}
+
+ChunkCache& ChunkCache::instance() {
+    static ChunkCache instance;
+    return instance;
+}
+
+ChunkCache::ChunkCache()
+    : m_maxBytes(0)
+    , m_totalBytes(0)
+    , m_accessClock(1)
+    , m_opsSinceFlush(0)
+    , m_initialized(false)
+    , m_disabled(false)
+    , m_seenSequence(0) {
+}
+
+ChunkCache::~ChunkCache() {
+    if (m_initialized) {
+        flushIndex();
+    }
+}
+
+bool ChunkCache::initialize(const std::string& cacheDir, int64_t maxBytes) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_initialized) {
+        return true;
+    }
+
+    std::error_code ec;
+    if (cacheDir.empty() || maxBytes <= 0) {
+        LOG_WARNING("Chunk cache disabled: no directory or budget configured");
+        m_disabled = true;
+        return false;
+    }
+    fs::create_directories(cacheDir, ec);
+    if (ec) {
+        LOG_ERROR("Failed to create chunk cache directory: " + cacheDir + " (" + ec.message() + ")");
+        m_disabled = true;
+        return false;
+    }
+
+    m_cacheDir = cacheDir;
+    m_maxBytes = maxBytes;
+    loadIndex();
+    m_initialized = true;
+    m_disabled = false;
+
+    // El presupuesto pudo reducirse desde la última ejecución
+    evictLocked(0);
+
+    LOG_INFO("Chunk cache ready: " + m_cacheDir + " (" + std::to_string(m_entries.size()) +
+             " chunks, " + std::to_string(m_totalBytes.load()) + "/" + std::to_string(maxBytes) + " bytes)");
+    return true;
+}
+
+bool ChunkCache::ensureInitialized() {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (m_initialized) {
+            return true;
+        }
+    }
+    // Un fallo previo desactiva la caché: no reintentar en cada chunk
+    if (m_disabled) {
+        return false;
+    }
+    Config& cfg = Config::instance();
+    return initialize(cfg.chunkCachePath(), cfg.chunkCacheMaxBytes());
+}
+
+void ChunkCache::loadIndex() {
+    m_entries.clear();
+    m_totalBytes = 0;
+
+    // Orden LRU persistido (solo una pista; el directorio es la fuente de verdad)
+    std::unordered_map<std::string, uint64_t> persisted;
+    std::ifstream index(objectPath(INDEX_FILE_NAME));
+    std::string line;
+    while (std::getline(index, line)) {
+        std::istringstream iss(line);
+        std::string name;
+        uint64_t tick = 0;
+        if (iss >> name >> tick) {
+            persisted[name] = tick;
+        }
+    }
+
+    uint64_t maxTick = 0;
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(m_cacheDir, ec)) {
+        if (!item.is_regular_file()) continue;
+
+        std::string name = item.path().filename().string();
+        if (name == INDEX_FILE_NAME) continue;
+
+        // Restos de escrituras interrumpidas
+        if (item.path().extension() == PART_SUFFIX || name.find(".tmp") != std::string::npos) {
+            fs::remove(item.path(), ec);
+            continue;
+        }
+
+        int64_t size = static_cast<int64_t>(item.file_size(ec));
+        if (ec || size <= 0) {
+            fs::remove(item.path(), ec);
+            continue;
+        }
+
+        auto it = persisted.find(name);
+        uint64_t tick = (it != persisted.end()) ? it->second : 0;
+        maxTick = std::max(maxTick, tick);
+
+        Entry& entry = m_entries[name];
+        entry.size = size;
+        entry.lastAccess = tick;
+        m_totalBytes += size;
+    }
+
+    m_accessClock = maxTick + 1;
+}
+
+std::string ChunkCache::objectName(const std::string& key) const {
+    return CryptoEngine::sha256Hex(key.data(), key.size());
+}
+
+std::string ChunkCache::objectPath(const std::string& name) const {
+    return (fs::path(m_cacheDir) / name).string();
+}
+
+bool ChunkCache::fetch(const std::string& key, const std::string& destPath) {
+    if (key.empty() || !ensureInitialized()) {
+        return false;
+    }
+
+    std::string name = objectName(key);
+    bool stale = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_entries.find(name);
+        if (it == m_entries.end()) {
+            return false;
+        }
+
+        // destPath podría ser un enlace al propio objeto (restos de una sesión previa)
+        std::error_code ec;
+        fs::remove(destPath, ec);
+        fs::copy_file(objectPath(name), destPath, fs::copy_options::overwrite_existing, ec);
+        if (!ec) {
+            it->second.lastAccess = m_accessClock.fetch_add(1);
+        } else {
+            LOG_WARNING("Chunk cache entry unreadable, dropping: " + name + " (" + ec.message() + ")");
+            stale = true;
+        }
+    }
+
+    if (stale) {
+        remove(key);
+        return false;
+    }
+
+    LOG_DEBUG("Chunk cache hit: " + key);
+    if (++m_opsSinceFlush >= FLUSH_EVERY_OPS) {
+        flushIndex();
+    }
+    return true;
+}
+
+bool ChunkCache::store(const std::string& key, const std::string& srcPath) {
+    if (key.empty() || !ensureInitialized()) {
+        return false;
+    }
+
+    std::error_code ec;
+    int64_t size = static_cast<int64_t>(fs::file_size(srcPath, ec));
+    if (ec || size <= 0 || size > m_maxBytes.load()) {
+        return false;
+    }
+
+    std::string name = objectName(key);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_entries.find(name);
+        if (it != m_entries.end()) {
+            it->second.lastAccess = m_accessClock.fetch_add(1);
+            return true;
+        }
+    }
+
+    if (!shouldAdmit(name)) {
+        return false;
+    }
+
+    // Enlazar fuera del lock a un nombre temporal único; copiar solo si el
+    // sistema de archivos no admite hard links o está en otro volumen
+    std::string partPath = objectPath(name) + "." + std::to_string(s_partCounter.fetch_add(1)) + PART_SUFFIX;
+    fs::create_hard_link(srcPath, partPath, ec);
+    if (ec) {
+        ec.clear();
+        fs::copy_file(srcPath, partPath, fs::copy_options::overwrite_existing, ec);
+    }
+    if (ec) {
+        LOG_WARNING("Failed to copy chunk into cache: " + ec.message());
+        fs::remove(partPath, ec);
+        return false;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_entries.count(name)) {
+            // Otro hilo lo insertó mientras copiábamos
+            fs::remove(partPath, ec);
+            return true;
+        }
+
+        evictLocked(size);
+
+        fs::rename(partPath, objectPath(name), ec);
+        if (ec) {
+            LOG_WARNING("Failed to commit chunk into cache: " + ec.message());
+            fs::remove(partPath, ec);
+            return false;
+        }
+
+        Entry& entry = m_entries[name];
+        entry.size = size;
+        entry.lastAccess = m_accessClock.fetch_add(1);
+        m_totalBytes += size;
+    }
+
+    if (++m_opsSinceFlush >= FLUSH_EVERY_OPS) {
+        flushIndex();
+    }
+    return true;
+}
+
+bool ChunkCache::shouldAdmit(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_seenMutex);
+    if (m_seenOnce.erase(name) > 0) {
+        // Segundo acceso: se admite; su hueco en m_seenOrder caduca solo
+        return true;
+    }
+
+    uint64_t sequence = m_seenSequence++;
+    m_seenOnce[name] = sequence;
+    m_seenOrder.emplace_back(sequence, name);
+    while (m_seenOrder.size() > SEEN_ONCE_CAPACITY) {
+        auto& [oldSequence, oldName] = m_seenOrder.front();
+        auto it = m_seenOnce.find(oldName);
+        if (it != m_seenOnce.end() && it->second == oldSequence) {
+            m_seenOnce.erase(it);
+        }
+        m_seenOrder.pop_front();
+    }
+    return false;
+}
+
+bool ChunkCache::contains(const std::string& key) {
+    if (key.empty() || !ensureInitialized()) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_entries.count(objectName(key)) > 0;
+}
+
+void ChunkCache::remove(const std::string& key) {
+    if (key.empty() || !ensureInitialized()) {
+        return;
+    }
+
+    std::string name = objectName(key);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_entries.find(name);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    std::error_code ec;
+    fs::remove(objectPath(name), ec);
+    m_totalBytes -= it->second.size;
+    m_entries.erase(it);
+}
+
+void ChunkCache::clear() {
+    if (!ensureInitialized()) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::error_code ec;
+    for (const auto& [name, entry] : m_entries) {
+        fs::remove(objectPath(name), ec);
+    }
+    m_entries.clear();
+    m_totalBytes = 0;
+    fs::remove(objectPath(INDEX_FILE_NAME), ec);
+}
+
+void ChunkCache::setMaxBytes(int64_t maxBytes) {
+    m_maxBytes = maxBytes;
+    if (!ensureInitialized()) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    evictLocked(0);
+}
+
+void ChunkCache::evictLocked(int64_t incomingBytes) {
+    int64_t budget = m_maxBytes.load();
+    if (m_totalBytes + incomingBytes <= budget) {
+        return;
+    }
+
+    // Ordenar por último acceso (más antiguo primero)
+    std::vector<std::pair<uint64_t, std::string>> order;
+    order.reserve(m_entries.size());
+    for (const auto& [name, entry] : m_entries) {
+        order.emplace_back(entry.lastAccess.load(), name);
+    }
+    std::sort(order.begin(), order.end());
+
+    std::error_code ec;
+    for (const auto& [tick, name] : order) {
+        if (m_totalBytes + incomingBytes <= budget) {
+            break;
+        }
+        auto it = m_entries.find(name);
+        fs::remove(objectPath(name), ec);
+        m_totalBytes -= it->second.size;
+        m_entries.erase(it);
+        LOG_DEBUG("Chunk cache evicted: " + name);
+    }
+}
+
+void ChunkCache::flushIndex() {
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+    m_opsSinceFlush = 0;
+
+    std::ostringstream oss;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (!m_initialized) {
+            return;
+        }
+        for (const auto& [name, entry] : m_entries) {
+            oss << name << ' ' << entry.lastAccess.load() << '\n';
+        }
+    }
+
+    // Escritura atómica: temporal + rename
+    std::string indexPath = objectPath(INDEX_FILE_NAME);
+    std::string tmpPath = indexPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            LOG_WARNING("Failed to write chunk cache index");
+            return;
+        }
+        out << oss.str();
+    }
+
+    std::error_code ec;
+    fs::rename(tmpPath, indexPath, ec);
+    if (ec) {
+        LOG_WARNING("Failed to commit chunk cache index: " + ec.message());
+        fs::remove(tmpPath, ec);
+    }
+}
+
+} // namespace TelegramCloud
@@ -4,6 +4,8 @@
 #include "logger.h"
 #include "config.h"
 #include "telegramnotifier.h"
+#include "downloadqueue.h"
+#include "chunkintegrity.h"
 
 // Inicializar miembros estáticos
 namespace TelegramCloud {
@@ -31,6 +33,7 @@ ChunkedDownload::ChunkedDownload(Database* database, TelegramHandler* telegramHa
     : m_database(database)
     , m_telegramHandler(telegramHandler)
     , m_notifier(notifier)
+    , m_notifierHandle(INVALID_OPERATION_HANDLE)
     , m_fileSize(0)
     , m_isActive(false)
     , m_isCanceled(false)
@@ -115,11 +118,12 @@ std::string ChunkedDownload::startDownload(const std::string& fileId, const std:
     m_isCanceled = false;
     m_isPaused = false;
     m_completedChunks = 0;
+    resetCheckpoint(ChunkBitmap(m_totalChunks));
     
     // Registrar operación en notificador
     if (m_notifier) {
-        m_notifier->registerOperation(m_downloadId, OperationType::DOWNLOAD, 
-                                     m_fileName, m_fileSize, m_totalChunks);
+        m_notifierHandle = m_notifier->registerOperation(m_downloadId, OperationType::DOWNLOAD, 
+                                                        m_fileName, m_fileSize, m_totalChunks);
     }
     
     // Descargar chunks en paralelo
@@ -129,6 +133,9 @@ std::string ChunkedDownload::startDownload(const std::string& fileId, const std:
     if (!m_isPaused && !m_isCanceled) {
         if (m_completedChunks == m_totalChunks) {
             LOG_INFO("All chunks downloaded, reconstructing file...");
+            if (m_notifier) {
+                m_notifier->setOperationStatus(m_notifierHandle, OperationStatus::RECONSTRUCTING);
+            }
             
             if (reconstructFile(tempDir, m_destPath)) {
                 LOG_INFO("File reconstructed successfully: " + m_destPath);
@@ -140,7 +147,7 @@ std::string ChunkedDownload::startDownload(const std::string& fileId, const std:
                 
                 // Notificar completado
                 if (m_notifier) {
-                    m_notifier->notifyOperationCompleted(m_downloadId, m_destPath);
+                    m_notifier->notifyOperationCompleted(m_notifierHandle, m_destPath);
                 }
                 
                 // Eliminar directorio temporal
@@ -158,13 +165,13 @@ std::string ChunkedDownload::startDownload(const std::string& fileId, const std:
                 
                 // Notificar fallido
                 if (m_notifier) {
-                    m_notifier->notifyOperationFailed(m_downloadId, "Failed to reconstruct file");
+                    m_notifier->notifyOperationFailed(m_notifierHandle, "Failed to reconstruct file");
                 }
             }
         } else {
             LOG_ERROR("Download incomplete: " + std::to_string(m_completedChunks) + "/" + std::to_string(m_totalChunks));
             if (m_notifier) {
-                m_notifier->notifyOperationFailed(m_downloadId, "Download incomplete");
+                m_notifier->notifyOperationFailed(m_notifierHandle, "Download incomplete");
             }
         }
     }
@@ -215,8 +222,8 @@ std::string ChunkedDownload::resumeDownload(const std::string& downloadId, const
     
     // Registrar operación en notificador
     if (m_notifier) {
-        m_notifier->registerOperation(m_downloadId, OperationType::DOWNLOAD, 
-                                     m_fileName, m_fileSize, m_totalChunks);
+        m_notifierHandle = m_notifier->registerOperation(m_downloadId, OperationType::DOWNLOAD, 
+                                                        m_fileName, m_fileSize, m_totalChunks);
     }
     
     // Continuar descarga, omitiendo chunks válidos
@@ -226,6 +233,9 @@ std::string ChunkedDownload::resumeDownload(const std::string& downloadId, const
     if (!m_isPaused && !m_isCanceled) {
         if (m_completedChunks == m_totalChunks) {
             LOG_INFO("All chunks downloaded, reconstructing file...");
+            if (m_notifier) {
+                m_notifier->setOperationStatus(m_notifierHandle, OperationStatus::RECONSTRUCTING);
+            }
             
             if (reconstructFile(tempDir, m_destPath)) {
                 LOG_INFO("File reconstructed successfully: " + m_destPath);
@@ -237,7 +247,7 @@ std::string ChunkedDownload::resumeDownload(const std::string& downloadId, const
                 
                 // Notificar completado
                 if (m_notifier) {
-                    m_notifier->notifyOperationCompleted(m_downloadId, m_destPath);
+                    m_notifier->notifyOperationCompleted(m_notifierHandle, m_destPath);
                 }
                 
                 // Eliminar directorio temporal
@@ -255,13 +265,13 @@ std::string ChunkedDownload::resumeDownload(const std::string& downloadId, const
                 
                 // Notificar fallido
                 if (m_notifier) {
-                    m_notifier->notifyOperationFailed(m_downloadId, "Failed to reconstruct file");
+                    m_notifier->notifyOperationFailed(m_notifierHandle, "Failed to reconstruct file");
                 }
             }
         } else {
             LOG_ERROR("Download incomplete: " + std::to_string(m_completedChunks) + "/" + std::to_string(m_totalChunks));
             if (m_notifier) {
-                m_notifier->notifyOperationFailed(m_downloadId, "Download incomplete");
+                m_notifier->notifyOperationFailed(m_notifierHandle, "Download incomplete");
             }
         }
     }
@@ -332,8 +342,9 @@ bool ChunkedDownload::cancelDownload(const std::string& downloadId) {
         m_isPaused = false;
     }
     
-    // Eliminar progreso de base de datos
+    // Eliminar progreso de base de datos (después de lo que quedara en cola)
     if (m_database) {
+        m_database->flushQueuedWrites();
         m_database->deleteDownloadProgress(downloadId);
     }
     
@@ -367,59 +378,41 @@ void ChunkedDownload::downloadChunksParallel(const std::set<int64_t>& skipChunks
         return;
     }
     
-    // Vector de futures para paralelización
-    std::vector<std::future<bool>> futures;
-    // Config& config = Config::instance(); // Not used in this scope
-    const int MAX_PARALLEL = 5; // Descargas paralelas simultáneas
-    
-    for (size_t i = 0; i < m_chunks.size(); ++i) {
-        // Verificar si fue cancelada o pausada
-        {
-            std::lock_guard<std::mutex> lock(s_controlMutex);
-            if (s_canceledDownloads[m_downloadId]) {
-                LOG_WARNING("Download canceled, stopping chunk download");
-                m_isCanceled = true;
-                break;
-            }
-            if (s_pausedDownloads[m_downloadId]) {
-                LOG_INFO("Download paused, stopping chunk download");
-                m_isPaused = true;
-                break;
-            }
-        }
-        
-        if (m_isCanceled || m_isPaused) {
-            break;
+    // Ventana de descargas en vuelo: cada slot libre arranca el siguiente chunk
+    Config& config = Config::instance();
+    DownloadQueue queue(config.downloadMaxInFlight(), config.downloadPerTokenLimit());
+    queue.setStopPredicate([this]() {
+        std::lock_guard<std::mutex> lock(s_controlMutex);
+        if (s_canceledDownloads[m_downloadId]) {
+            LOG_WARNING("Download canceled, stopping chunk download");
+            m_isCanceled = true;
+        } else if (s_pausedDownloads[m_downloadId]) {
+            LOG_INFO("Download paused, stopping chunk download");
+            m_isPaused = true;
         }
-        
-        const ChunkInfo& chunk = m_chunks[i];
-        
+        return m_isCanceled || m_isPaused;
+    });
+    
+    for (const auto& chunk : m_chunks) {
         // Omitir chunks ya completados
         if (skipChunks.find(chunk.chunkNumber) != skipChunks.end()) {
             LOG_DEBUG("Skipping already completed chunk: " + std::to_string(chunk.chunkNumber));
             continue;
         }
         
-        // Lanzar descarga asíncrona
-        auto future = std::async(std::launch::async, [this, chunk, tempDir]() {
+        queue.submit(chunk.uploaderBotToken, [this, chunk, tempDir]() {
             return downloadSingleChunk(chunk, tempDir);
         });
-        
-        futures.push_back(std::move(future));
-        
-        // Limitar descargas paralelas
-        if (futures.size() >= MAX_PARALLEL) {
-            // Esperar al menos uno
-            for (auto& f : futures) {
-                f.get();
-            }
-            futures.clear();
-        }
     }
     
-    // Esperar a que terminen todos los futuros restantes
-    for (auto& f : futures) {
-        f.get();
+    queue.waitAll();
+    
+    // Volcar el estado de reanudación (pausa, parada o fin)
+    if (!m_isCanceled) {
+        m_checkpoint.flush();
+        if (m_database) {
+            m_database->flushQueuedWrites();
+        }
     }
     
     LOG_INFO("All chunks download completed. Completed: " + 
@@ -431,24 +424,14 @@ bool ChunkedDownload::downloadSingleChunk(const ChunkInfo& chunk, const std::str
     
     LOG_INFO("Starting download: " + chunk.telegramFileId + " to " + chunkPath);
     
-    // Reintentar hasta 3 veces
-    bool success = false;
-    for (int retry = 0; retry < 3 && !success; retry++) {
-        if (retry > 0) {
-            LOG_WARNING("Retrying chunk " + std::to_string(chunk.chunkNumber) + " (attempt " + std::to_string(retry + 1) + "/3)");
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
-        success = m_telegramHandler->downloadFile(chunk.telegramFileId, chunkPath);
-    }
+    // Caché local o red; el SHA-256 se verifica al escribir y solo se reintenta este chunk
+    bool success = ChunkIntegrity::fetchVerifiedChunk(m_telegramHandler, chunk, chunkPath, chunk.uploaderBotToken);
     
     if (success) {
         m_completedChunks++;
         
-        // Guardar progreso en BD
-        if (m_database) {
-            m_database->updateDownloadChunkState(m_downloadId, chunk.chunkNumber, "completed");
-            m_database->updateDownloadProgress(m_downloadId, m_completedChunks);
-        }
+        // Progreso en memoria; se vuelca a BD por lotes (TransferCheckpoint)
+        m_checkpoint.markCompleted(chunk.chunkNumber);
         
         // Notificar progreso
         if (m_progressCallback) {
@@ -459,11 +442,10 @@ bool ChunkedDownload::downloadSingleChunk(const ChunkInfo& chunk, const std::str
         // Actualizar progreso en TelegramNotifier
         if (m_notifier) {
             double percent = progress();
-            m_notifier->updateOperationProgress(m_downloadId, m_completedChunks, percent, "downloading");
+            m_notifier->updateOperationProgress(m_notifierHandle, m_completedChunks, percent);
         }
         
-        LOG_INFO("Chunk " + std::to_string(chunk.chunkNumber + 1) + "/" + 
-                std::to_string(m_totalChunks) + " downloaded successfully");
+        LOG_INFOF("Chunk {}/{} downloaded successfully", chunk.chunkNumber + 1, m_totalChunks);
         
         return true;
     } else {
@@ -552,11 +534,24 @@ bool ChunkedDownload::validateExistingChunks(const std::string& tempDir, std::se
         return false;
     }
     
-    // Obtener chunks completados de la BD
-    std::vector<int64_t> completedChunks = m_database->getCompletedDownloadChunks(m_downloadId);
+    // Estado completo de reanudación en una sola consulta
+    ChunkBitmap stored = ChunkBitmap::deserialize(m_database->loadTransferBitmap(m_downloadId, "verified"), m_totalChunks);
+    
+    std::vector<int64_t> completedChunks;
+    if (stored.size() > 0) {
+        for (int64_t i = 0; i < stored.size(); i++) {
+            if (stored.test(i)) {
+                completedChunks.push_back(i);
+            }
+        }
+    } else {
+        // Descargas anteriores al mapa de bits: una fila por chunk
+        completedChunks = m_database->getCompletedDownloadChunks(m_downloadId);
+    }
     
     LOG_INFO("Validating " + std::to_string(completedChunks.size()) + " completed chunks");
     
+    ChunkBitmap valid(m_totalChunks);
     int validCount = 0;
     for (int64_t chunkNum : completedChunks) {
         std::string chunkPath = tempDir + "/chunk_" + std::to_string(chunkNum) + ".tmp";
@@ -564,6 +559,7 @@ bool ChunkedDownload::validateExistingChunks(const std::string& tempDir, std::se
         // Verificar si el archivo existe
         if (std::filesystem::exists(chunkPath)) {
             validChunks.insert(chunkNum);
+            valid.set(chunkNum);
             validCount++;
         } else {
             LOG_WARNING("Chunk file missing: " + chunkPath);
@@ -574,10 +570,20 @@ bool ChunkedDownload::validateExistingChunks(const std::string& tempDir, std::se
              std::to_string(completedChunks.size()) + " chunks successfully");
     
     m_completedChunks = validCount;
+    resetCheckpoint(valid);
     
     return true;
 }
 
+void ChunkedDownload::resetCheckpoint(const ChunkBitmap& bitmap) {
+    std::string downloadId = m_downloadId;
+    m_checkpoint.reset(bitmap, [this, downloadId](const std::string& blob, int64_t completed) {
+        if (m_database) {
+            m_database->queueDownloadCheckpoint(downloadId, blob, completed);
+        }
+    });
+}
+
 bool ChunkedDownload::loadDownloadState(const std::string& downloadId) {
     if (!m_database) {
         LOG_ERROR("Database not initialized");
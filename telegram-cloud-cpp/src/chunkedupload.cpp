@@ -4,6 +4,8 @@
 #include "logger.h"
 #include "config.h"
 #include "telegramnotifier.h"
+#include "chunkintegrity.h"
+#include "cryptoengine.h"
 
 // Inicializar miembros estáticos
 namespace TelegramCloud {
@@ -29,6 +31,7 @@ ChunkedUpload::ChunkedUpload(Database* database, TelegramHandler* telegramHandle
     : m_database(database)
     , m_telegramHandler(telegramHandler)
     , m_notifier(notifier)
+    , m_notifierHandle(INVALID_OPERATION_HANDLE)
     , m_fileSize(0)
     , m_isActive(false)
     , m_isCanceled(false)
@@ -36,6 +39,7 @@ ChunkedUpload::ChunkedUpload(Database* database, TelegramHandler* telegramHandle
     , m_totalChunks(0)
     , m_completedChunks(0)
     , m_currentChunkIndex(0)
+    , m_metadataCommitted(true)
 {
 }
 
@@ -120,6 +124,7 @@ std::string ChunkedUpload::startUpload(const std::string& filePath) {
     m_isCanceled = false;
     m_isPaused = false;
     m_completedChunks = 0;
+    resetCheckpoint(ChunkBitmap(m_totalChunks));
     
     // Actualizar estado en BD
     if (m_database) {
@@ -128,8 +133,8 @@ std::string ChunkedUpload::startUpload(const std::string& filePath) {
     
     // Registrar operación en notificador
     if (m_notifier) {
-        m_notifier->registerOperation(m_uploadId, OperationType::UPLOAD, 
-                                     m_fileName, m_fileSize, m_totalChunks);
+        m_notifierHandle = m_notifier->registerOperation(m_uploadId, OperationType::UPLOAD, 
+                                                        m_fileName, m_fileSize, m_totalChunks);
     }
     
     // Subir chunks en paralelo
@@ -137,15 +142,20 @@ std::string ChunkedUpload::startUpload(const std::string& filePath) {
     
     // Verificar resultado y notificar
     if (!m_isPaused && !m_isCanceled) {
-        if (m_completedChunks == m_totalChunks) {
+        if (!m_metadataCommitted) {
+            LOG_ERROR("Upload metadata was not saved, resume to re-upload missing chunks: " + m_uploadId);
+            if (m_notifier) {
+                m_notifier->notifyOperationFailed(m_notifierHandle, "Upload metadata was not saved");
+            }
+        } else if (m_completedChunks == m_totalChunks) {
             LOG_INFO("Upload completed successfully: " + m_uploadId);
             if (m_notifier) {
-                m_notifier->notifyOperationCompleted(m_uploadId);
+                m_notifier->notifyOperationCompleted(m_notifierHandle);
             }
         } else {
             LOG_ERROR("Upload incomplete: " + std::to_string(m_completedChunks) + "/" + std::to_string(m_totalChunks));
             if (m_notifier) {
-                m_notifier->notifyOperationFailed(m_uploadId, "Upload incomplete");
+                m_notifier->notifyOperationFailed(m_notifierHandle, "Upload incomplete");
             }
         }
     }
@@ -195,8 +205,8 @@ std::string ChunkedUpload::resumeUpload(const std::string& uploadId, const std::
     
     // Registrar operación en notificador
     if (m_notifier) {
-        m_notifier->registerOperation(m_uploadId, OperationType::UPLOAD, 
-                                     m_fileName, m_fileSize, m_totalChunks);
+        m_notifierHandle = m_notifier->registerOperation(m_uploadId, OperationType::UPLOAD, 
+                                                        m_fileName, m_fileSize, m_totalChunks);
     }
     
     // Continuar subida, omitiendo chunks válidos
@@ -204,15 +214,20 @@ std::string ChunkedUpload::resumeUpload(const std::string& uploadId, const std::
     
     // Verificar resultado y notificar
     if (!m_isPaused && !m_isCanceled) {
-        if (m_completedChunks == m_totalChunks) {
+        if (!m_metadataCommitted) {
+            LOG_ERROR("Upload metadata was not saved, resume to re-upload missing chunks: " + m_uploadId);
+            if (m_notifier) {
+                m_notifier->notifyOperationFailed(m_notifierHandle, "Upload metadata was not saved");
+            }
+        } else if (m_completedChunks == m_totalChunks) {
             LOG_INFO("Upload completed successfully: " + m_uploadId);
             if (m_notifier) {
-                m_notifier->notifyOperationCompleted(m_uploadId);
+                m_notifier->notifyOperationCompleted(m_notifierHandle);
             }
         } else {
             LOG_ERROR("Upload incomplete: " + std::to_string(m_completedChunks) + "/" + std::to_string(m_totalChunks));
             if (m_notifier) {
-                m_notifier->notifyOperationFailed(m_uploadId, "Upload incomplete");
+                m_notifier->notifyOperationFailed(m_notifierHandle, "Upload incomplete");
             }
         }
     }
@@ -283,8 +298,9 @@ bool ChunkedUpload::cancelUpload(const std::string& uploadId) {
         m_isPaused = false;
     }
     
-    // Eliminar progreso de base de datos
+    // Eliminar progreso de base de datos (después de lo que quedara en cola)
     if (m_database) {
+        m_database->flushQueuedWrites();
         m_database->deleteUploadProgress(uploadId);
     }
     
@@ -304,6 +320,10 @@ void ChunkedUpload::uploadChunksParallel(const std::set<int64_t>& skipChunks) {
     int64_t chunkSize = config.chunkSize();
     std::vector<std::string> botTokens = m_telegramHandler->getAllTokens();
     
+    // Solo cuentan los lotes con escrituras de esta pasada
+    m_metadataCommitted = true;
+    uint64_t writeMark = m_database ? m_database->queuedWriteSequence() : 0;
+    
     // Abrir archivo
     std::ifstream file(m_filePath, std::ios::binary);
     if (!file.is_open()) {
@@ -344,10 +364,8 @@ void ChunkedUpload::uploadChunksParallel(const std::set<int64_t>& skipChunks) {
         // Asignar bot token (round-robin)
         std::string botToken = botTokens[static_cast<size_t>(chunkIndex % botTokens.size())];
         
-        LOG_DEBUG("Chunk " + std::to_string(chunkIndex + 1) + "/" + 
-                 std::to_string(m_totalChunks) + " - Size: " + 
-                 std::to_string(bytesRead) + " bytes, Bot: " + 
-                 std::to_string(chunkIndex % botTokens.size()));
+        LOG_DEBUGF("Chunk {}/{} - Size: {} bytes, Bot: {}",
+                   chunkIndex + 1, m_totalChunks, bytesRead, chunkIndex % botTokens.size());
         
         // Upload chunk en thread separado
         auto future = std::async(std::launch::async, 
@@ -390,10 +408,23 @@ void ChunkedUpload::uploadChunksParallel(const std::set<int64_t>& skipChunks) {
         }
     }
     
+    // Volcar el estado de reanudación (pausa, parada o fin)
+    if (!m_isCanceled) {
+        m_checkpoint.flush();
+        // finalizeChunkedFile cuenta los chunks registrados: si se perdió un lote,
+        // no se finaliza y la reanudación vuelve a subir los que falten
+        if (m_database && !m_database->flushQueuedWrites(writeMark)) {
+            LOG_ERROR("Chunk metadata batch was rolled back; upload left resumable: " + m_uploadId);
+            m_metadataCommitted = false;
+        }
+    }
+    
     LOG_INFO("All chunks upload completed. Completed: " + 
              std::to_string(m_completedChunks) + "/" + std::to_string(m_totalChunks));
     
-    if (m_completedChunks == m_totalChunks) {
+    if (!m_metadataCommitted) {
+        LOG_ERROR("Upload not finalized: chunk metadata was not saved");
+    } else if (m_completedChunks == m_totalChunks) {
         LOG_INFO("Upload successful!");
         
         // Finalizar archivo: actualizar status y crear entrada en tabla 'files'
@@ -469,10 +500,8 @@ bool ChunkedUpload::uploadSingleChunk(int64_t chunkIndex, const std::vector<char
     if (result.success) {
         m_completedChunks++;
         
-        LOG_INFO("Chunk " + std::to_string(chunkIndex + 1) + "/" + 
-                std::to_string(m_totalChunks) + " uploaded successfully. " +
-                "File ID: " + result.fileId + ", Message ID: " + 
-                std::to_string(result.messageId));
+        LOG_INFOF("Chunk {}/{} uploaded successfully. File ID: {}, Message ID: {}",
+                  chunkIndex + 1, m_totalChunks, result.fileId, result.messageId);
         
         // Guardar chunk en base de datos
         if (m_database) {
@@ -487,10 +516,13 @@ bool ChunkedUpload::uploadSingleChunk(int64_t chunkIndex, const std::vector<char
             chunkInfo.status = "completed";
             chunkInfo.uploaderBotToken = botToken;
             
-            m_database->saveChunkInfo(chunkInfo);
-            m_database->updateUploadProgress(m_uploadId, m_completedChunks);
+            // Sin esperar al disco: se confirma en el próximo lote
+            m_database->queueChunkInfo(chunkInfo);
         }
         
+        // Progreso en memoria; se vuelca a BD por lotes (TransferCheckpoint)
+        m_checkpoint.markCompleted(chunkIndex);
+        
         // Notificar progreso
         if (m_progressCallback) {
             double percent = progress();
@@ -500,7 +532,7 @@ bool ChunkedUpload::uploadSingleChunk(int64_t chunkIndex, const std::vector<char
         // Actualizar progreso en TelegramNotifier
         if (m_notifier) {
             double percent = progress();
-            m_notifier->updateOperationProgress(m_uploadId, m_completedChunks, percent, "uploading");
+            m_notifier->updateOperationProgress(m_notifierHandle, m_completedChunks, percent);
         }
         
         return true;
@@ -586,8 +618,8 @@ std::string ChunkedUpload::detectMimeType(const std::string& fileName) {
 }
 
 std::string ChunkedUpload::calculateChunkHash(const std::vector<char>& data) {
-    // TODO: Implementar SHA256 real
-    return "chunk_hash_" + std::to_string(data.size());
+    // SHA-256 real: las descargas lo verifican contra los bytes recibidos
+    return CryptoEngine::sha256Hex(data.data(), data.size());
 }
 
 std::string ChunkedUpload::generateUUID() {
@@ -671,11 +703,33 @@ bool ChunkedUpload::validateExistingChunks(const std::string& filePath, std::set
     Config& config = Config::instance();
     int64_t chunkSize = config.chunkSize();
     
-    // Obtener chunks completados de la BD
-    std::vector<int64_t> completedChunks = m_database->getCompletedChunks(m_uploadId);
+    // Estado de reanudación en una sola consulta
+    ChunkBitmap stored = ChunkBitmap::deserialize(m_database->loadTransferBitmap(m_uploadId, "uploaded"), m_totalChunks);
+    
+    std::vector<int64_t> completedChunks;
+    if (stored.size() > 0) {
+        for (int64_t i = 0; i < stored.size(); i++) {
+            if (stored.test(i)) {
+                completedChunks.push_back(i);
+            }
+        }
+    } else {
+        // Subidas anteriores al mapa de bits
+        completedChunks = m_database->getCompletedChunks(m_uploadId);
+    }
+    
+    // Hashes guardados de todos los chunks, también en una sola consulta
+    std::map<int64_t, std::string> storedHashes;
+    for (const auto& chunk : m_database->getFileChunks(m_uploadId)) {
+        if (chunk.status == "completed") {
+            storedHashes[chunk.chunkNumber] = chunk.chunkHash;
+        }
+    }
     
     LOG_INFO("Validating " + std::to_string(completedChunks.size()) + " completed chunks");
     
+    ChunkBitmap valid(m_totalChunks);
+    
     // Validar integridad de cada chunk
     for (int64_t chunkNumber : completedChunks) {
         // Leer chunk del archivo
@@ -689,8 +743,10 @@ bool ChunkedUpload::validateExistingChunks(const std::string& filePath, std::set
         std::string currentHash = calculateChunkHash(chunkData);
         
         // Validar contra BD
-        if (m_database->validateChunkIntegrity(m_uploadId, chunkNumber, currentHash)) {
+        auto hashIt = storedHashes.find(chunkNumber);
+        if (hashIt != storedHashes.end() && hashIt->second == currentHash) {
             validChunks.insert(chunkNumber);
+            valid.set(chunkNumber);
             LOG_DEBUG("Chunk " + std::to_string(chunkNumber) + " validated successfully");
         } else {
             LOG_WARNING("Chunk " + std::to_string(chunkNumber) + 
@@ -700,6 +756,8 @@ bool ChunkedUpload::validateExistingChunks(const std::string& filePath, std::set
         }
     }
     
+    resetCheckpoint(valid);
+    
     file.close();
     
     LOG_INFO("Validated " + std::to_string(validChunks.size()) + "/" + 
@@ -711,6 +769,15 @@ bool ChunkedUpload::validateExistingChunks(const std::string& filePath, std::set
     return true;
 }
 
+void ChunkedUpload::resetCheckpoint(const ChunkBitmap& bitmap) {
+    std::string uploadId = m_uploadId;
+    m_checkpoint.reset(bitmap, [this, uploadId](const std::string& blob, int64_t completed) {
+        if (m_database) {
+            m_database->queueUploadCheckpoint(uploadId, blob, completed);
+        }
+    });
+}
+
 std::vector<ChunkedFileInfo> ChunkedUpload::getIncompleteUploads() {
     if (!m_database) {
         LOG_ERROR("Database not available");
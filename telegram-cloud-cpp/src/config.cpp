@@ -6,6 +6,7 @@
 #include <iostream>
 #include <algorithm>
 #include <cstdlib>
+#include <filesystem>
 
 // Constantes de validación de integridad (parte 1/3)
 const char* VALIDATION_TOKEN_A = "ot";
@@ -38,8 +39,12 @@ Config::Config()
     , m_chunkThreshold(DEFAULT_CHUNK_THRESHOLD)
     , m_maxRetries(DEFAULT_MAX_RETRIES)
     , m_apiPort(DEFAULT_API_PORT)
+    , m_downloadMaxInFlight(DEFAULT_DOWNLOAD_MAX_IN_FLIGHT)
+    , m_downloadPerTokenLimit(DEFAULT_DOWNLOAD_PER_TOKEN_LIMIT)
     , m_apiHost(OBF_STR("127.0.0.1"))
     , m_databasePath(OBF_STR("./database/telegram_cloud.db"))
+    , m_chunkCachePath()
+    , m_chunkCacheMaxBytes(DEFAULT_CHUNK_CACHE_MAX_BYTES)
     , m_logLevel(OBF_STR("INFO"))
     , m_logPath(OBF_STR("./logs/"))
     , m_telegramApiBase(OBF_STR_KEY("https://api.telegram.org", 0xA5))
@@ -149,12 +154,24 @@ void Config::loadFromFile() {
     if (!(value = envMgr.get("API_PORT")).empty()) {
         m_apiPort = std::stoi(value);
     }
+    if (!(value = envMgr.get("DOWNLOAD_MAX_IN_FLIGHT")).empty()) {
+        m_downloadMaxInFlight = std::stoi(value);
+    }
+    if (!(value = envMgr.get("DOWNLOAD_PER_TOKEN_LIMIT")).empty()) {
+        m_downloadPerTokenLimit = std::stoi(value);
+    }
     if (!(value = envMgr.get("API_HOST")).empty()) {
         m_apiHost = value;
     }
     if (!(value = envMgr.get("DB_PATH")).empty()) {
         m_databasePath = value;
     }
+    if (!(value = envMgr.get("CHUNK_CACHE_PATH")).empty()) {
+        m_chunkCachePath = value;
+    }
+    if (!(value = envMgr.get("CHUNK_CACHE_MAX_MB")).empty()) {
+        m_chunkCacheMaxBytes = std::stoll(value) * 1024 * 1024;
+    }
     if (!(value = envMgr.get("LOG_LEVEL")).empty()) {
         m_logLevel = value;
     }
@@ -184,7 +201,11 @@ void Config::loadFromEnvironment() {
     if (!(value = getEnv("MAX_RETRIES")).empty()) m_maxRetries = std::stoi(value);
     if (!(value = getEnv("API_PORT")).empty()) m_apiPort = std::stoi(value);
     if (!(value = getEnv("API_HOST")).empty()) m_apiHost = value;
+    if (!(value = getEnv("DOWNLOAD_MAX_IN_FLIGHT")).empty()) m_downloadMaxInFlight = std::stoi(value);
+    if (!(value = getEnv("DOWNLOAD_PER_TOKEN_LIMIT")).empty()) m_downloadPerTokenLimit = std::stoi(value);
     if (!(value = getEnv("DB_PATH")).empty()) m_databasePath = value;
+    if (!(value = getEnv("CHUNK_CACHE_PATH")).empty()) m_chunkCachePath = value;
+    if (!(value = getEnv("CHUNK_CACHE_MAX_MB")).empty()) m_chunkCacheMaxBytes = std::stoll(value) * 1024 * 1024;
 }
 
 void Config::validateConfiguration() {
@@ -226,6 +247,14 @@ std::vector<std::string> Config::allTokens() const {
     return tokens;
 }
 
+std::string Config::chunkCachePath() const {
+    if (!m_chunkCachePath.empty()) {
+        return m_chunkCachePath;
+    }
+    // Junto a la base de datos: en Android es el almacenamiento privado de la app
+    return (std::filesystem::path(m_databasePath).parent_path() / "chunk_cache").string();
+}
+
 // Helper functions
 std::string uploadStateToString(UploadState state) {
     switch (state) {
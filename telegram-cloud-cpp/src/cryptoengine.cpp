@@ -0,0 +1,578 @@
+#include "cryptoengine.h"
+#include "logger.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#define CRYPTOENGINE_X86 1
+#elif (defined(__aarch64__) || defined(__arm__)) && defined(__linux__)
+#include <sys/auxv.h>
+#define CRYPTOENGINE_ARM_LINUX 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace TelegramCloud {
+
+// ===== CipherStream =====
+
+CipherStream::CipherStream()
+    : m_ctx(EVP_CIPHER_CTX_new())
+    , m_ready(false) {
+}
+
+CipherStream::~CipherStream() {
+    if (m_ctx) {
+        EVP_CIPHER_CTX_free(m_ctx);
+    }
+}
+
+bool CipherStream::init(Mode mode, const std::string& key, const std::string& iv) {
+    m_ready = false;
+    if (!m_ctx || key.size() != CryptoEngine::KEY_SIZE || iv.size() != CryptoEngine::IV_SIZE) {
+        return false;
+    }
+
+    // Reutilizar el contexto: reset en lugar de free/new
+    EVP_CIPHER_CTX_reset(m_ctx);
+
+    const unsigned char* k = reinterpret_cast<const unsigned char*>(key.data());
+    const unsigned char* v = reinterpret_cast<const unsigned char*>(iv.data());
+    int rc = (mode == Mode::Encrypt)
+        ? EVP_EncryptInit_ex(m_ctx, EVP_aes_256_cbc(), nullptr, k, v)
+        : EVP_DecryptInit_ex(m_ctx, EVP_aes_256_cbc(), nullptr, k, v);
+
+    m_ready = (rc == 1);
+    return m_ready;
+}
+
+bool CipherStream::update(const void* data, size_t length, std::string& out) {
+    if (!m_ready) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+
+    size_t offset = out.size();
+    out.resize(offset + length + EVP_MAX_BLOCK_LENGTH);
+
+    int outLen = 0;
+    if (EVP_CipherUpdate(m_ctx, reinterpret_cast<unsigned char*>(&out[offset]), &outLen,
+                         reinterpret_cast<const unsigned char*>(data), static_cast<int>(length)) != 1) {
+        out.resize(offset);
+        m_ready = false;
+        return false;
+    }
+    out.resize(offset + outLen);
+    return true;
+}
+
+bool CipherStream::finish(std::string& out) {
+    if (!m_ready) {
+        return false;
+    }
+    m_ready = false;
+
+    size_t offset = out.size();
+    out.resize(offset + EVP_MAX_BLOCK_LENGTH);
+
+    int outLen = 0;
+    if (EVP_CipherFinal_ex(m_ctx, reinterpret_cast<unsigned char*>(&out[offset]), &outLen) != 1) {
+        out.resize(offset);
+        return false;
+    }
+    out.resize(offset + outLen);
+    return true;
+}
+
+// ===== Hardware =====
+
+std::string CryptoHardwareInfo::describe() const {
+    if (aesni) return "AES-NI";
+    if (armCrypto) return "ARMv8 Crypto Extensions";
+    return "software";
+}
+
+static CryptoHardwareInfo detectHardware() {
+    CryptoHardwareInfo info;
+#if defined(CRYPTOENGINE_X86)
+#if defined(_MSC_VER)
+    int regs[4] = {0, 0, 0, 0};
+    __cpuid(regs, 1);
+    info.aesni = (regs[2] & (1 << 25)) != 0;
+#else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        info.aesni = (ecx & (1u << 25)) != 0;
+    }
+#endif
+#elif defined(CRYPTOENGINE_ARM_LINUX)
+#if defined(__aarch64__)
+    // HWCAP_AES (bit 3) en AT_HWCAP
+    info.armCrypto = (getauxval(AT_HWCAP) & (1ul << 3)) != 0;
+#else
+    // HWCAP2_AES (bit 0) en AT_HWCAP2 para ARMv7 ejecutando sobre núcleo v8
+    info.armCrypto = (getauxval(AT_HWCAP2) & 1ul) != 0;
+#endif
+#elif defined(__APPLE__) && defined(__aarch64__)
+    info.armCrypto = true;
+#endif
+    return info;
+}
+
+const CryptoHardwareInfo& CryptoEngine::hardwareInfo() {
+    static const CryptoHardwareInfo info = [] {
+        CryptoHardwareInfo detected = detectHardware();
+        LOG_INFO("AES acceleration: " + detected.describe());
+        return detected;
+    }();
+    return info;
+}
+
+// ===== Sha256Stream =====
+
+Sha256Stream::Sha256Stream()
+    : m_ctx(EVP_MD_CTX_new())
+    , m_ok(false) {
+    m_ok = m_ctx && EVP_DigestInit_ex(m_ctx, EVP_sha256(), nullptr) == 1;
+}
+
+Sha256Stream::~Sha256Stream() {
+    if (m_ctx) {
+        EVP_MD_CTX_free(m_ctx);
+    }
+}
+
+void Sha256Stream::update(const void* data, size_t length) {
+    if (m_ok && length > 0) {
+        m_ok = EVP_DigestUpdate(m_ctx, data, length) == 1;
+    }
+}
+
+std::string Sha256Stream::finish() {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLen = 0;
+    if (!m_ok || EVP_DigestFinal_ex(m_ctx, digest, &digestLen) != 1) {
+        m_ok = false;
+        return "";
+    }
+    m_ok = false;
+    return std::string(reinterpret_cast<char*>(digest), digestLen);
+}
+
+// ===== SecretWipe =====
+
+SecretWipe::~SecretWipe() {
+    if (!m_secret.empty()) {
+        OPENSSL_cleanse(&m_secret[0], m_secret.size());
+    }
+}
+
+// ===== DerivedKeyCache =====
+
+DerivedKeyCache& DerivedKeyCache::instance() {
+    static DerivedKeyCache instance;
+    return instance;
+}
+
+DerivedKeyCache::DerivedKeyCache()
+    : m_sessionSecret(CryptoEngine::randomBytes(32))
+    , m_capacity(DEFAULT_CAPACITY)
+    , m_hits(0)
+    , m_misses(0) {
+}
+
+DerivedKeyCache::~DerivedKeyCache() {
+    clear();
+    OPENSSL_cleanse(&m_sessionSecret[0], m_sessionSecret.size());
+}
+
+std::string DerivedKeyCache::cacheKey(const std::string& password, const std::string& salt, int iterations) const {
+    // Huella de la contraseña: HMAC-SHA256 con el secreto de la sesión
+    unsigned char fingerprint[EVP_MAX_MD_SIZE];
+    unsigned int fingerprintLen = 0;
+    if (!HMAC(EVP_sha256(), m_sessionSecret.data(), static_cast<int>(m_sessionSecret.size()),
+              reinterpret_cast<const unsigned char*>(password.data()), password.size(),
+              fingerprint, &fingerprintLen)) {
+        throw std::runtime_error("Failed to fingerprint password");
+    }
+
+    std::string key(reinterpret_cast<char*>(fingerprint), fingerprintLen);
+    key += salt;
+    key += "|pbkdf2-sha256|" + std::to_string(iterations);
+    return key;
+}
+
+void DerivedKeyCache::evictLocked(std::unordered_map<std::string, Entry>::iterator it) {
+    OPENSSL_cleanse(&it->second.key[0], it->second.key.size());
+    m_lru.erase(it->second.lruPosition);
+    m_entries.erase(it);
+}
+
+void DerivedKeyCache::expireLocked(Clock::time_point now) {
+    // Las entradas menos usadas están al final de la lista
+    while (!m_lru.empty()) {
+        auto it = m_entries.find(m_lru.back());
+        if (now - it->second.lastUse < IDLE_TIMEOUT && m_entries.size() <= m_capacity) {
+            break;
+        }
+        evictLocked(it);
+    }
+}
+
+std::string DerivedKeyCache::pbkdf2(const std::string& password, const std::string& salt, int iterations) {
+    std::string id = cacheKey(password, salt, iterations);
+    Clock::time_point now = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        expireLocked(now);
+
+        auto it = m_entries.find(id);
+        if (it != m_entries.end()) {
+            it->second.lastUse = now;
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lruPosition);
+            m_hits++;
+            return it->second.key;
+        }
+    }
+
+    // PBKDF2 fuera del lock: otras derivaciones pueden avanzar en paralelo
+    m_misses++;
+    std::string key = CryptoEngine::deriveKeyPbkdf2(password, salt, iterations);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capacity == 0 || m_entries.count(id)) {
+        return key;
+    }
+
+    m_lru.push_front(id);
+    Entry& entry = m_entries[id];
+    entry.key = key;
+    entry.lastUse = now;
+    entry.lruPosition = m_lru.begin();
+    expireLocked(now);
+    return key;
+}
+
+void DerivedKeyCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [id, entry] : m_entries) {
+        OPENSSL_cleanse(&entry.key[0], entry.key.size());
+    }
+    m_entries.clear();
+    m_lru.clear();
+}
+
+void DerivedKeyCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = capacity;
+    expireLocked(Clock::now());
+}
+
+size_t DerivedKeyCache::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+// ===== Primitivas =====
+
+std::string CryptoEngine::randomBytes(size_t length) {
+    std::string bytes(length, '\0');
+    if (length > 0 &&
+        RAND_bytes(reinterpret_cast<unsigned char*>(&bytes[0]), static_cast<int>(length)) != 1) {
+        throw std::runtime_error("Failed to generate random bytes");
+    }
+    return bytes;
+}
+
+std::string CryptoEngine::sha256(const std::string& a, const std::string& b) {
+    Sha256Stream hasher;
+    hasher.update(a.data(), a.size());
+    hasher.update(b.data(), b.size());
+    std::string digest = hasher.finish();
+    if (digest.empty()) {
+        throw std::runtime_error("SHA-256 failed");
+    }
+    return digest;
+}
+
+std::string CryptoEngine::sha256Hex(const void* data, size_t length) {
+    Sha256Stream hasher;
+    hasher.update(data, length);
+    return toHex(hasher.finish());
+}
+
+std::string CryptoEngine::toHex(const std::string& bytes) {
+    return toHex(bytes.data(), bytes.size());
+}
+
+std::string CryptoEngine::toHex(const void* data, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::string hex;
+    hex.reserve(length * 2);
+    for (size_t i = 0; i < length; i++) {
+        hex.push_back(digits[bytes[i] >> 4]);
+        hex.push_back(digits[bytes[i] & 0x0f]);
+    }
+    return hex;
+}
+
+std::string CryptoEngine::deriveKeyPbkdf2(const std::string& password, const std::string& salt, int iterations) {
+    std::string key(KEY_SIZE, '\0');
+    if (PKCS5_PBKDF2_HMAC(password.c_str(), static_cast<int>(password.length()),
+                          reinterpret_cast<const unsigned char*>(salt.data()), static_cast<int>(salt.length()),
+                          iterations, EVP_sha256(),
+                          static_cast<int>(KEY_SIZE), reinterpret_cast<unsigned char*>(&key[0])) != 1) {
+        throw std::runtime_error("Key derivation failed");
+    }
+    return key;
+}
+
+std::string CryptoEngine::deriveKeyPbkdf2Sha1(const std::string& password, const std::string& salt, int iterations) {
+    std::string key(KEY_SIZE, '\0');
+    if (PKCS5_PBKDF2_HMAC(password.c_str(), static_cast<int>(password.length()),
+                          reinterpret_cast<const unsigned char*>(salt.data()), static_cast<int>(salt.length()),
+                          iterations, EVP_sha1(),
+                          static_cast<int>(KEY_SIZE), reinterpret_cast<unsigned char*>(&key[0])) != 1) {
+        throw std::runtime_error("Key derivation failed");
+    }
+    return key;
+}
+
+std::string CryptoEngine::deriveKeyPbkdf2Cached(const std::string& password, const std::string& salt, int iterations) {
+    return DerivedKeyCache::instance().pbkdf2(password, salt, iterations);
+}
+
+std::string CryptoEngine::encrypt(const std::string& plaintext, const std::string& key, const std::string& iv) {
+    CipherStream cipher;
+    std::string out;
+    out.reserve(plaintext.size() + IV_SIZE);
+
+    if (!cipher.init(CipherStream::Mode::Encrypt, key, iv)) {
+        throw std::runtime_error("Failed to initialize encryption");
+    }
+    if (!cipher.update(plaintext.data(), plaintext.size(), out) || !cipher.finish(out)) {
+        throw std::runtime_error("Encryption failed");
+    }
+    return out;
+}
+
+std::string CryptoEngine::decrypt(const std::string& ciphertext, const std::string& key, const std::string& iv) {
+    CipherStream cipher;
+    std::string out;
+    out.reserve(ciphertext.size());
+
+    if (!cipher.init(CipherStream::Mode::Decrypt, key, iv)) {
+        throw std::runtime_error("Failed to initialize decryption");
+    }
+    if (!cipher.update(ciphertext.data(), ciphertext.size(), out)) {
+        throw std::runtime_error("Decryption failed (corrupted data)");
+    }
+    if (!cipher.finish(out)) {
+        throw std::runtime_error("Decryption failed (wrong password or corrupted data)");
+    }
+    return out;
+}
+
+std::string CryptoEngine::encryptWithPassword(const std::string& plaintext, const std::string& password,
+                                              int iterations) {
+    // Salt propio: la caché no sirve aquí (nunca se repite) y se evita
+    // que dos artefactos con la misma contraseña compartan clave
+    std::string salt = randomBytes(SALT_SIZE);
+    std::string iv = randomBytes(IV_SIZE);
+    std::string key = deriveKeyPbkdf2(password, salt, iterations);
+    SecretWipe wipeKey(key);
+
+    std::string result;
+    result.reserve(SALT_SIZE + IV_SIZE + plaintext.size() + IV_SIZE);
+    result += salt;
+    result += iv;
+    result += encrypt(plaintext, key, iv);
+    return result;
+}
+
+std::string CryptoEngine::decryptWithPassword(const std::string& blob, const std::string& password,
+                                              int iterations) {
+    if (blob.size() < SALT_SIZE + IV_SIZE) {
+        throw std::runtime_error("Invalid ciphertext length");
+    }
+
+    std::string salt = blob.substr(0, SALT_SIZE);
+    std::string iv = blob.substr(SALT_SIZE, IV_SIZE);
+    std::string key = deriveKeyPbkdf2Cached(password, salt, iterations);
+    SecretWipe wipeKey(key);
+
+    // Descifrar sin copiar el payload a un string intermedio
+    CipherStream cipher;
+    std::string out;
+    out.reserve(blob.size() - SALT_SIZE - IV_SIZE);
+    if (!cipher.init(CipherStream::Mode::Decrypt, key, iv)) {
+        throw std::runtime_error("Failed to initialize decryption");
+    }
+    if (!cipher.update(blob.data() + SALT_SIZE + IV_SIZE, blob.size() - SALT_SIZE - IV_SIZE, out)) {
+        throw std::runtime_error("Decryption failed (corrupted data)");
+    }
+    if (!cipher.finish(out)) {
+        throw std::runtime_error("Decryption failed (wrong password or corrupted data)");
+    }
+    return out;
+}
+
+// ===== Streaming =====
+
+static bool pumpStream(CipherStream& cipher, std::istream& in, std::ostream& out) {
+    std::vector<char> buffer(CryptoEngine::STREAM_BUFFER_SIZE);
+    std::string processed;
+    processed.reserve(buffer.size() + EVP_MAX_BLOCK_LENGTH);
+
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        std::streamsize got = in.gcount();
+        if (got <= 0) {
+            break;
+        }
+
+        processed.clear();
+        if (!cipher.update(buffer.data(), static_cast<size_t>(got), processed)) {
+            return false;
+        }
+        out.write(processed.data(), static_cast<std::streamsize>(processed.size()));
+        if (!out) {
+            return false;
+        }
+    }
+    if (in.bad()) {
+        return false;
+    }
+
+    processed.clear();
+    if (!cipher.finish(processed)) {
+        return false;
+    }
+    out.write(processed.data(), static_cast<std::streamsize>(processed.size()));
+    return static_cast<bool>(out);
+}
+
+bool CryptoEngine::encryptStream(std::istream& in, std::ostream& out, const std::string& key, const std::string& iv) {
+    CipherStream cipher;
+    if (!cipher.init(CipherStream::Mode::Encrypt, key, iv)) {
+        LOG_ERROR("Failed to initialize stream encryption");
+        return false;
+    }
+    if (!pumpStream(cipher, in, out)) {
+        LOG_ERROR("Stream encryption failed");
+        return false;
+    }
+    return true;
+}
+
+bool CryptoEngine::decryptStream(std::istream& in, std::ostream& out, const std::string& key, const std::string& iv) {
+    CipherStream cipher;
+    if (!cipher.init(CipherStream::Mode::Decrypt, key, iv)) {
+        LOG_ERROR("Failed to initialize stream decryption");
+        return false;
+    }
+    if (!pumpStream(cipher, in, out)) {
+        LOG_ERROR("Stream decryption failed (wrong password or corrupted data)");
+        return false;
+    }
+    return true;
+}
+
+bool CryptoEngine::encryptFileWithPassword(const std::string& inputPath, const std::string& outputPath,
+                                           const std::string& password, int iterations) {
+    try {
+        std::ifstream in(inputPath, std::ios::binary);
+        if (!in) {
+            LOG_ERROR("Cannot open file for encryption: " + inputPath);
+            return false;
+        }
+
+        std::string salt = randomBytes(SALT_SIZE);
+        std::string iv = randomBytes(IV_SIZE);
+        std::string key = deriveKeyPbkdf2(password, salt, iterations);
+        SecretWipe wipeKey(key);
+
+        bool ok = false;
+        {
+            std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                LOG_ERROR("Cannot create encrypted file: " + outputPath);
+                return false;
+            }
+            out.write(salt.data(), static_cast<std::streamsize>(salt.size()));
+            out.write(iv.data(), static_cast<std::streamsize>(iv.size()));
+            ok = out && encryptStream(in, out, key, iv);
+        }
+
+        if (!ok) {
+            std::error_code ec;
+            fs::remove(outputPath, ec);
+        }
+        return ok;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("File encryption failed: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool CryptoEngine::decryptFileWithPassword(const std::string& inputPath, const std::string& outputPath,
+                                           const std::string& password, int iterations) {
+    try {
+        std::ifstream in(inputPath, std::ios::binary);
+        if (!in) {
+            LOG_ERROR("Cannot open file for decryption: " + inputPath);
+            return false;
+        }
+
+        char header[SALT_SIZE + IV_SIZE];
+        if (!in.read(header, sizeof(header))) {
+            LOG_ERROR("Encrypted file too short: " + inputPath);
+            return false;
+        }
+
+        std::string salt(header, SALT_SIZE);
+        std::string iv(header + SALT_SIZE, IV_SIZE);
+        std::string key = deriveKeyPbkdf2Cached(password, salt, iterations);
+        SecretWipe wipeKey(key);
+
+        bool ok = false;
+        {
+            std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                LOG_ERROR("Cannot create decrypted file: " + outputPath);
+                return false;
+            }
+            ok = decryptStream(in, out, key, iv);
+        }
+
+        // El padding se valida al final: no dejar salida parcial
+        if (!ok) {
+            std::error_code ec;
+            fs::remove(outputPath, ec);
+        }
+        return ok;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("File decryption failed: " + std::string(e.what()));
+        return false;
+    }
+}
+
+} // namespace TelegramCloud
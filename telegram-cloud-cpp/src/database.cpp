@@ -4,12 +4,139 @@
 #include "string_obfuscation.h"
 #include "obfuscated_strings.h"
 #include "anti_debug.h"
+#include "metadatawriter.h"
+#include "cryptoengine.h"
 #include <iostream>
+#include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
 
 namespace TelegramCloud {
 
-Database::Database() : m_db(nullptr), m_isEncrypted(false) {
+namespace {
+
+// Iteraciones del KDF de SQLCipher; cacheRawKey deriva con el mismo valor
+constexpr int SQLCIPHER_KDF_ITERATIONS = 256000;
+
+// Parámetros SQLCipher comunes a la base principal, sus copias de backup y
+// los deltas adjuntos (schema = "delta." para una base ATTACH)
+void applyCipherPragmas(sqlite3* db, const std::string& schema = "") {
+    const std::string encryptionPragmas[] = {
+        "cipher_page_size = 4096",
+        "cipher_kdf_iter = " + std::to_string(SQLCIPHER_KDF_ITERATIONS),
+        "cipher_hmac_algorithm = HMAC_SHA1",
+        "cipher_kdf_algorithm = PBKDF2_HMAC_SHA1"
+    };
+    
+    for (const std::string& pragma : encryptionPragmas) {
+        std::string sql = "PRAGMA " + schema + pragma;
+        char* errMsg = nullptr;
+        int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+        if (rc != SQLITE_OK) {
+            LOG_WARNING("Failed to set encryption pragma: " + std::string(errMsg ? errMsg : "unknown"));
+            sqlite3_free(errMsg);
+        }
+    }
+}
+
+// PRAGMA key con frase (SQLCipher aplica el KDF) o con clave en bruto x'...'
+std::string keyPragma(const std::string& key) {
+    if (key.rfind("x'", 0) == 0) {
+        return "PRAGMA key = \"" + key + "\"";
+    }
+    return "PRAGMA key = '" + key + "'";
+}
+
+// Salt de SQLCipher: los primeros 16 bytes del archivo; vacío si la base aún
+// no tiene ninguna página escrita
+std::string readCipherSalt(const std::string& dbPath) {
+    std::ifstream in(dbPath, std::ios::binary);
+    std::string salt(CryptoEngine::SALT_SIZE, '\0');
+    if (!in.read(&salt[0], static_cast<std::streamsize>(salt.size()))) {
+        return std::string();
+    }
+    return salt;
+}
+
+// Clave en bruto con salt explícito: x'<64 hex de clave><32 hex de salt>'
+std::string rawKeyLiteral(const std::string& key, const std::string& salt) {
+    return "x'" + CryptoEngine::toHex(key) + CryptoEngine::toHex(salt) + "'";
+}
+
+bool rawKeyMatchesSalt(const std::string& rawKey, const std::string& salt) {
+    std::string suffix = CryptoEngine::toHex(salt) + "'";
+    return rawKey.size() == 2 + CryptoEngine::KEY_SIZE * 2 + suffix.size() &&
+           rawKey.rfind("x'", 0) == 0 &&
+           rawKey.compare(rawKey.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Escapar cadenas para los toJson() de esta unidad
+std::string jsonEscape(const std::string& str) {
+    std::ostringstream out;
+    for (char c : str) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                        << static_cast<int>(c) << std::dec;
+                } else {
+                    out << c;
+                }
+        }
+    }
+    return out.str();
+}
+
+// Tablas cuyo contenido se registra en change_journal para backups incrementales.
+// Solo el catálogo: el estado de transferencias en curso no se restaura
+const char* const JOURNALED_TABLES[] = {
+    "files",
+    "chunked_files",
+    "file_chunks"
+};
+
+// Tablas que el diario v3 registraba y v7 dejó de registrar
+const char* const UNJOURNALED_TABLES[] = {
+    "downloads",
+    "download_chunks",
+    "transfer_bitmaps"
+};
+
+const char* const JOURNAL_EVENTS[][2] = {{"INSERT", "NEW"}, {"UPDATE", "NEW"}, {"DELETE", "OLD"}};
+
+// Triggers del diario para table; when (opcional) condiciona el registro
+std::string journalTriggersSql(const std::string& table, const std::string& when) {
+    std::string sql;
+    for (const auto& event : JOURNAL_EVENTS) {
+        std::string trigger = "trg_journal_" + table + "_" + event[0];
+        sql += "CREATE TRIGGER IF NOT EXISTS " + trigger + " AFTER " + event[0] + " ON " + table +
+               (when.empty() ? "" : " WHEN " + when) +
+               " BEGIN "
+               "UPDATE change_counter SET seq = seq + 1 WHERE id = 1; "
+               "INSERT OR REPLACE INTO change_journal (tbl, row_id, seq) VALUES ('" + table + "', " +
+               event[1] + ".rowid, (SELECT seq FROM change_counter WHERE id = 1)); "
+               "END;";
+    }
+    return sql;
+}
+
+} // namespace
+
+Database::Database()
+    : m_db(nullptr), m_isEncrypted(false), m_searchIndexAvailable(false),
+      m_firstQueryDone(false), m_firstQueryMillis(0.0) {
 }
 
 Database::~Database() {
@@ -20,6 +147,10 @@ bool Database::initialize(const std::string& dbPath) {
     ANTI_DEBUG_CHECK(); // Verificar debugger al iniciar DB
     
     m_dbPath = dbPath;
+    m_initStart = std::chrono::steady_clock::now();
+    m_startupTiming = DatabaseStartupTiming();
+    m_firstQueryDone = false;
+    m_firstQueryMillis = 0.0;
     
     LOG_INFO("Initializing database at: " + dbPath);
     
@@ -37,27 +168,27 @@ bool Database::initialize(const std::string& dbPath) {
         return false;
     }
     
-    int rc = sqlite3_open(dbPath.c_str(), &m_db);
-    if (rc != SQLITE_OK) {
-        std::string error = "Failed to open database: " + getLastError();
-        LOG_ERROR(error);
-        std::cerr << error << std::endl;
+    if (!openConnection()) {
         return false;
     }
+    m_startupTiming.openMillis = millisSince(m_initStart);
     
     LOG_INFO("Database opened successfully: " + dbPath);
     
     // Configurar encriptación SQLCipher
+    auto phaseStart = std::chrono::steady_clock::now();
     if (!configureEncryption()) {
         LOG_ERROR("Failed to configure database encryption");
         close();
         return false;
     }
+    m_startupTiming.keyMillis = millisSince(phaseStart);
+    m_startupTiming.rawKey = !m_rawKey.empty();
     
     // Habilitar foreign keys
     const char* pragmaSQL = "PRAGMA foreign_keys = ON";
     char* errMsg = nullptr;
-    rc = sqlite3_exec(m_db, pragmaSQL, nullptr, nullptr, &errMsg);
+    int rc = sqlite3_exec(m_db, pragmaSQL, nullptr, nullptr, &errMsg);
     if (rc != SQLITE_OK) {
         LOG_WARNING("Failed to enable foreign keys: " + std::string(errMsg));
         sqlite3_free(errMsg);
@@ -65,9 +196,37 @@ bool Database::initialize(const std::string& dbPath) {
         LOG_DEBUG("Foreign keys enabled");
     }
     
+    phaseStart = std::chrono::steady_clock::now();
+    configureJournal();
+    
     bool tablesCreated = setupTables();
+    m_startupTiming.schemaMillis = millisSince(phaseStart);
     if (tablesCreated) {
         LOG_INFO("Database tables created successfully");
+        m_searchIndexAvailable = tableExists("files_fts");
+        if (!m_metadataWriter) {
+            m_metadataWriter = std::make_unique<MetadataWriter>(
+                [this](const std::vector<MetadataWriter::Operation>& operations) {
+                    return runBatch(operations);
+                });
+        }
+        // Deltas dejados por BackupManager::restoreBackupChain
+        replayPendingChanges();
+        
+        if (!m_readers) {
+            size_t readers = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 2, 4);
+            m_readers = std::make_unique<ReadConnectionPool>([this]() { return openReadConnection(); }, readers);
+        }
+        
+        // Base recién creada o clave en caché obsoleta: el próximo arranque se salta el KDF
+        if (m_isEncrypted && m_rawKey.empty()) {
+            cacheRawKey();
+        }
+        
+        m_startupTiming.readyMillis = millisSince(m_initStart);
+        LOG_INFO("Database ready in " + std::to_string(m_startupTiming.readyMillis) + " ms (key " +
+                 std::to_string(m_startupTiming.keyMillis) + " ms" +
+                 (m_startupTiming.rawKey ? ", cached raw key)" : ", passphrase KDF)"));
     } else {
         LOG_ERROR("Failed to create database tables");
     }
@@ -75,14 +234,339 @@ bool Database::initialize(const std::string& dbPath) {
     return tablesCreated;
 }
 
+bool Database::openConnection() {
+    // Conexión de escritura compartida entre hilos: modo serializado explícito
+    int rc = sqlite3_open_v2(m_dbPath.c_str(), &m_db,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
+    if (rc != SQLITE_OK) {
+        std::string error = "Failed to open database: " + getLastError();
+        LOG_ERROR(error);
+        std::cerr << error << std::endl;
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return false;
+    }
+    return true;
+}
+
+DatabaseStartupTiming Database::startupTiming() const {
+    DatabaseStartupTiming timing = m_startupTiming;
+    timing.firstQueryMillis = m_firstQueryMillis;
+    return timing;
+}
+
 void Database::close() {
+    // Esperar a las lecturas en curso; el checkpoint TRUNCATE necesita el WAL libre
+    if (m_readers) {
+        m_readers->close();
+        m_readers.reset();
+    }
+    
+    // Confirmar las escrituras diferidas antes de cerrar
+    if (m_metadataWriter) {
+        m_metadataWriter->stop();
+        m_metadataWriter.reset();
+    }
+    
     if (m_db) {
+        // sqlite3_close falla con sentencias sin finalizar
+        clearStatementCache();
+        // Dejar el WAL vacío para que la copia en disco sea autosuficiente
+        sqlite3_exec(m_db, "PRAGMA wal_checkpoint(TRUNCATE)", nullptr, nullptr, nullptr);
         sqlite3_close(m_db);
         m_db = nullptr;
     }
 }
 
 bool Database::setupTables() {
+    int version = schemaVersion();
+    if (version < 0) {
+        LOG_ERROR("Failed to read schema version: " + getLastError());
+        return false;
+    }
+    if (version >= SCHEMA_VERSION) {
+        if (version > SCHEMA_VERSION) {
+            LOG_WARNING("Database schema v" + std::to_string(version) +
+                        " is newer than this build (v" + std::to_string(SCHEMA_VERSION) + ")");
+        }
+        LOG_DEBUG("Database schema up to date (v" + std::to_string(version) + ")");
+        // v5 se registra aunque SQLite no tenga FTS5; reintentar por si ya lo tiene
+        if (!tableExists("files_fts")) {
+            std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+            ensureSearchIndex();
+        }
+        return true;
+    }
+    
+    return migrateSchema(version);
+}
+
+int Database::schemaVersion() {
+    std::string value = pragmaValue("PRAGMA user_version");
+    if (value.empty()) {
+        return -1;
+    }
+    return std::stoi(value);
+}
+
+bool Database::migrateSchema(int fromVersion) {
+    // Cada migración se aplica una sola vez, en su propia transacción junto
+    // con el nuevo user_version. Nunca editar una ya publicada: añadir otra.
+    struct Migration {
+        int version;
+        const char* description;
+        bool (Database::*apply)();
+    };
+    static const Migration migrations[] = {
+        {1, "base tables",            &Database::createBaseTables},
+        {2, "hot query indexes",      &Database::createHotQueryIndexes},
+        {3, "change journal",         &Database::setupChangeJournal},
+        {4, "file listing indexes",   &Database::createListingIndexes},
+        {5, "file search index",      &Database::migrateSearchIndex},
+        {6, "catalog statistics",     &Database::createStatsTable},
+        {7, "catalog-only journal",   &Database::narrowChangeJournal},
+    };
+    static_assert(sizeof(migrations) / sizeof(migrations[0]) == SCHEMA_VERSION,
+                  "SCHEMA_VERSION must match the last migration");
+    
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    for (const auto& migration : migrations) {
+        if (migration.version <= fromVersion) {
+            continue;
+        }
+        
+        LOG_INFO("Migrating database schema to v" + std::to_string(migration.version) +
+                 " (" + migration.description + ")");
+        if (!executeQuery("BEGIN IMMEDIATE")) {
+            return false;
+        }
+        std::string setVersion = "PRAGMA user_version = " + std::to_string(migration.version);
+        if (!(this->*migration.apply)() || !executeQuery(setVersion) || !executeQuery("COMMIT")) {
+            LOG_ERROR("Schema migration v" + std::to_string(migration.version) + " failed");
+            sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return false;
+        }
+    }
+    
+    LOG_INFO("Database schema migrated from v" + std::to_string(fromVersion) +
+             " to v" + std::to_string(SCHEMA_VERSION));
+    return true;
+}
+
+bool Database::columnExists(const char* table, const char* column) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+bool Database::createHotQueryIndexes() {
+    // file_chunks: cubre getCompletedChunks/validateChunkIntegrity sin tocar la tabla
+    // ni ordenar; el resto evita recorrer la tabla completa al filtrar por estado
+    return executeQuery(
+        "CREATE INDEX IF NOT EXISTS idx_file_chunks_status ON file_chunks(file_id, status, chunk_number);"
+        "CREATE INDEX IF NOT EXISTS idx_chunked_files_status ON chunked_files(status);"
+        "CREATE INDEX IF NOT EXISTS idx_downloads_status ON downloads(status);"
+        "CREATE INDEX IF NOT EXISTS idx_files_upload_date ON files(upload_date);");
+}
+
+bool Database::createListingIndexes() {
+    // La fecha ya tiene idx_files_upload_date; el rowid (= id) completa la clave
+    return executeQuery(
+        "CREATE INDEX IF NOT EXISTS idx_files_name ON files(file_name);"
+        "CREATE INDEX IF NOT EXISTS idx_files_size ON files(file_size);");
+}
+
+bool Database::tableExists(const char* table) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT 1 FROM sqlite_master WHERE name = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+bool Database::createSearchIndex() {
+    // Índice FTS5 de contenido externo (no duplica el texto de files). El
+    // tokenizador trigram permite buscar subcadenas sin distinguir mayúsculas.
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(m_db,
+        "CREATE VIRTUAL TABLE IF NOT EXISTS files_fts USING fts5("
+        "file_name, mime_type, category, "
+        "content='files', content_rowid='id', tokenize='trigram')",
+        nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        // SQLite sin FTS5 o anterior a 3.34: search() recurre a LIKE
+        LOG_WARNING("Full-text search unavailable: " + std::string(errMsg ? errMsg : "unknown"));
+        sqlite3_free(errMsg);
+        return false;
+    }
+    
+    return executeQuery(
+        "CREATE TRIGGER IF NOT EXISTS trg_files_fts_insert AFTER INSERT ON files BEGIN "
+        "INSERT INTO files_fts (rowid, file_name, mime_type, category) "
+        "VALUES (NEW.id, NEW.file_name, NEW.mime_type, NEW.category); END;"
+        "CREATE TRIGGER IF NOT EXISTS trg_files_fts_delete AFTER DELETE ON files BEGIN "
+        "INSERT INTO files_fts (files_fts, rowid, file_name, mime_type, category) "
+        "VALUES ('delete', OLD.id, OLD.file_name, OLD.mime_type, OLD.category); END;"
+        "CREATE TRIGGER IF NOT EXISTS trg_files_fts_update AFTER UPDATE OF file_name, mime_type, category ON files BEGIN "
+        "INSERT INTO files_fts (files_fts, rowid, file_name, mime_type, category) "
+        "VALUES ('delete', OLD.id, OLD.file_name, OLD.mime_type, OLD.category); "
+        "INSERT INTO files_fts (rowid, file_name, mime_type, category) "
+        "VALUES (NEW.id, NEW.file_name, NEW.mime_type, NEW.category); END;"
+        // El nombre pesa más que el tipo o la categoría en el ranking
+        "INSERT INTO files_fts (files_fts, rank) VALUES ('rank', 'bm25(10.0, 1.0, 1.0)');"
+        "INSERT INTO files_fts (files_fts) VALUES ('rebuild');");
+}
+
+bool Database::ensureSearchIndex() {
+    // Savepoint propio: un fallo a medias no deja la tabla sin triggers
+    if (!executeQuery("SAVEPOINT search_index")) {
+        return false;
+    }
+    if (!createSearchIndex()) {
+        executeQuery("ROLLBACK TO search_index; RELEASE search_index");
+        return false;
+    }
+    return executeQuery("RELEASE search_index");
+}
+
+bool Database::migrateSearchIndex() {
+    // Sin FTS5 la versión avanza igualmente (las migraciones siguientes no
+    // dependen del índice) y setupTables lo reintenta en cada arranque
+    if (!ensureSearchIndex()) {
+        LOG_WARNING("File search index deferred until SQLite supports FTS5");
+    }
+    return true;
+}
+
+bool Database::createStatsTable() {
+    // Contadores por dimensión (total, categoría, tipo MIME, bot, chunks)
+    // mantenidos por triggers en la misma transacción que la escritura
+    std::string sql =
+        "CREATE TABLE IF NOT EXISTS catalog_stats ("
+        "dimension TEXT NOT NULL,"
+        "key TEXT NOT NULL,"
+        "items INTEGER NOT NULL DEFAULT 0,"
+        "bytes INTEGER NOT NULL DEFAULT 0,"
+        "PRIMARY KEY (dimension, key)) WITHOUT ROWID;";
+    
+    // Suma (sign = +1) o resta (-1) la fila row en una dimensión; where filtra
+    auto bump = [](const char* dimension, const std::string& key, const std::string& bytes,
+                   const char* sign, const std::string& where) {
+        return std::string("INSERT INTO catalog_stats (dimension, key, items, bytes) SELECT '") +
+               dimension + "', " + key + ", " + sign + "1, " + sign + "(" + bytes + ")" +
+               (where.empty() ? " WHERE 1" : " WHERE " + where) +
+               " ON CONFLICT (dimension, key) DO UPDATE SET "
+               "items = items + excluded.items, bytes = bytes + excluded.bytes; ";
+    };
+    auto fileRows = [&bump](const char* row, const char* sign) {
+        std::string r(row);
+        std::string size = "COALESCE(" + r + ".file_size, 0)";
+        return bump("total", "''", size, sign, "") +
+               bump("category", "COALESCE(" + r + ".category, '')", size, sign, "") +
+               bump("mime", "COALESCE(" + r + ".mime_type, '')", size, sign, "") +
+               bump("bot", r + ".uploader_bot_token", size, sign,
+                    "COALESCE(" + r + ".uploader_bot_token, '') != ''");
+    };
+    auto chunkRows = [&bump](const char* row, const char* sign) {
+        std::string r(row);
+        std::string size = "COALESCE(" + r + ".chunk_size, 0)";
+        return bump("chunks", "''", size, sign, "") +
+               bump("bot", r + ".uploader_bot_token", size, sign,
+                    "COALESCE(" + r + ".uploader_bot_token, '') != ''");
+    };
+    
+    sql += "CREATE TRIGGER IF NOT EXISTS trg_stats_files_insert AFTER INSERT ON files BEGIN " +
+           fileRows("NEW", "+") + "END;"
+           "CREATE TRIGGER IF NOT EXISTS trg_stats_files_delete AFTER DELETE ON files BEGIN " +
+           fileRows("OLD", "-") + "END;"
+           "CREATE TRIGGER IF NOT EXISTS trg_stats_files_update AFTER UPDATE OF "
+           "file_size, category, mime_type, uploader_bot_token ON files BEGIN " +
+           fileRows("OLD", "-") + fileRows("NEW", "+") + "END;"
+           "CREATE TRIGGER IF NOT EXISTS trg_stats_chunks_insert AFTER INSERT ON file_chunks BEGIN " +
+           chunkRows("NEW", "+") + "END;"
+           "CREATE TRIGGER IF NOT EXISTS trg_stats_chunks_delete AFTER DELETE ON file_chunks BEGIN " +
+           chunkRows("OLD", "-") + "END;"
+           "CREATE TRIGGER IF NOT EXISTS trg_stats_chunks_update AFTER UPDATE OF "
+           "chunk_size, uploader_bot_token ON file_chunks BEGIN " +
+           chunkRows("OLD", "-") + chunkRows("NEW", "+") + "END;";
+    
+    // Estado inicial a partir del catálogo existente (única agregación completa)
+    sql += "DELETE FROM catalog_stats;"
+           "INSERT INTO catalog_stats SELECT 'total', '', COUNT(*), COALESCE(SUM(file_size), 0) FROM files;"
+           "INSERT INTO catalog_stats SELECT 'chunks', '', COUNT(*), COALESCE(SUM(chunk_size), 0) FROM file_chunks;"
+           "INSERT INTO catalog_stats SELECT 'category', COALESCE(category, ''), COUNT(*), COALESCE(SUM(file_size), 0) "
+           "FROM files GROUP BY 2;"
+           "INSERT INTO catalog_stats SELECT 'mime', COALESCE(mime_type, ''), COUNT(*), COALESCE(SUM(file_size), 0) "
+           "FROM files GROUP BY 2;"
+           "INSERT INTO catalog_stats SELECT 'bot', token, COUNT(*), COALESCE(SUM(size), 0) FROM ("
+           "SELECT uploader_bot_token AS token, file_size AS size FROM files "
+           "WHERE COALESCE(uploader_bot_token, '') != '' UNION ALL "
+           "SELECT uploader_bot_token, chunk_size FROM file_chunks "
+           "WHERE COALESCE(uploader_bot_token, '') != '') GROUP BY token;";
+    
+    return executeQuery(sql);
+}
+
+bool Database::verifyQueryPlans(std::vector<std::string>* problems) {
+    if (!m_db) {
+        return false;
+    }
+    
+    // Consultas de listado y reanudación que crecen con el catálogo
+    static const char* hotQueries[] = {
+        "SELECT * FROM files ORDER BY upload_date DESC",
+        "SELECT * FROM files WHERE (file_name, id) > (?, ?) ORDER BY file_name ASC, id ASC LIMIT ?",
+        "SELECT * FROM files WHERE (file_size, id) < (?, ?) ORDER BY file_size DESC, id DESC LIMIT ?",
+        "SELECT * FROM files WHERE (upload_date, id) < (?, ?) ORDER BY upload_date DESC, id DESC LIMIT ?",
+        "SELECT * FROM files WHERE file_id = ?",
+        "SELECT * FROM file_chunks WHERE file_id = ? ORDER BY chunk_number",
+        "SELECT f.* FROM json_each(?) AS ids CROSS JOIN files AS f ON f.file_id = ids.value",
+        "SELECT c.* FROM json_each(?) AS ids CROSS JOIN file_chunks AS c ON c.file_id = ids.value",
+        "SELECT chunk_number FROM file_chunks WHERE file_id = ? AND status = 'completed' ORDER BY chunk_number",
+        "SELECT chunk_hash FROM file_chunks WHERE file_id = ? AND chunk_number = ? AND status = 'completed'",
+        "SELECT file_id FROM chunked_files WHERE status IN ('uploading', 'paused', 'stopped', 'pending')",
+        "UPDATE chunked_files SET status = 'paused' WHERE status = 'uploading'",
+        "SELECT download_id FROM downloads WHERE status IN ('pending', 'downloading', 'paused', 'stopped')",
+        "UPDATE downloads SET status = 'paused' WHERE status = 'downloading'",
+        "SELECT chunk_number FROM download_chunks WHERE download_id = ? AND status = 'completed' ORDER BY chunk_number",
+    };
+    
+    bool indexed = true;
+    for (const char* query : hotQueries) {
+        sqlite3_stmt* stmt;
+        std::string explain = std::string("EXPLAIN QUERY PLAN ") + query;
+        if (sqlite3_prepare_v2(m_db, explain.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            if (problems) problems->push_back(std::string(query) + " -> " + getLastError());
+            indexed = false;
+            continue;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            std::string plan = detail ? detail : "";
+            // "SCAN t" sin índice = tabla completa; "TEMP B-TREE" = ordenación en memoria.
+            // Recorrer json_each (la lista de ids de entrada) no es un recorrido de tabla
+            bool fullScan = plan.rfind("SCAN ", 0) == 0 && plan.find(" USING ") == std::string::npos &&
+                            plan.find(" VIRTUAL TABLE") == std::string::npos;
+            if (fullScan || plan.find("TEMP B-TREE") != std::string::npos) {
+                if (problems) problems->push_back(std::string(query) + " -> " + plan);
+                indexed = false;
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    return indexed;
+}
+
+bool Database::createBaseTables() {
     LOG_INFO(OBF_STR("Creating database tables..."));
     
     std::string createFilesTable = 
@@ -189,18 +673,30 @@ bool Database::setupTables() {
     }
     LOG_DEBUG("Download chunks table created");
     
-    // Agregar columna is_encrypted si no existe (para bases de datos existentes)
-    const char* addEncryptedColumnFiles = ObfuscatedStrings::SQL_ALTER_FILES();
-    const char* addEncryptedColumnChunked = ObfuscatedStrings::SQL_ALTER_CHUNKED();
+    // Mapas de bits por transferencia (rangos verificados, progreso)
+    std::string createTransferBitmapsTable = 
+        "CREATE TABLE IF NOT EXISTS transfer_bitmaps ("
+        "transfer_id TEXT NOT NULL,"
+        "kind TEXT NOT NULL,"
+        "bitmap BLOB NOT NULL,"
+        "last_updated TEXT DEFAULT CURRENT_TIMESTAMP,"
+        "PRIMARY KEY (transfer_id, kind));";
     
-    // Ignorar errores si la columna ya existe (ejecutar sin logging de errores)
-    char* errMsg = nullptr;
-    sqlite3_exec(m_db, addEncryptedColumnFiles, nullptr, nullptr, &errMsg);
-    if (errMsg) sqlite3_free(errMsg);
+    if (!executeQuery(createTransferBitmapsTable)) {
+        LOG_ERROR("Failed to create transfer_bitmaps table");
+        return false;
+    }
+    LOG_DEBUG("Transfer bitmaps table created");
     
-    errMsg = nullptr;
-    sqlite3_exec(m_db, addEncryptedColumnChunked, nullptr, nullptr, &errMsg);
-    if (errMsg) sqlite3_free(errMsg);
+    // Bases anteriores a is_encrypted (sin versión de esquema): añadir la columna
+    if (!columnExists("files", "is_encrypted") &&
+        !executeQuery(ObfuscatedStrings::SQL_ALTER_FILES())) {
+        return false;
+    }
+    if (!columnExists("chunked_files", "is_encrypted") &&
+        !executeQuery(ObfuscatedStrings::SQL_ALTER_CHUNKED())) {
+        return false;
+    }
     
     LOG_INFO("All database tables created successfully");
     return true;
@@ -227,6 +723,7 @@ bool Database::executeQuery(const std::string& query) {
 }
 
 bool Database::saveFileInfo(const FileInfo& fileInfo) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -235,7 +732,7 @@ bool Database::saveFileInfo(const FileInfo& fileInfo) {
     const char* insertSQL = ObfuscatedStrings::SQL_INSERT_FILE();
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, insertSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(insertSQL, &stmt);
     
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare insert statement: " + getLastError());
@@ -253,7 +750,7 @@ bool Database::saveFileInfo(const FileInfo& fileInfo) {
     sqlite3_bind_int(stmt, 9, fileInfo.isEncrypted ? 1 : 0);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to insert file info: " + getLastError());
@@ -264,6 +761,107 @@ bool Database::saveFileInfo(const FileInfo& fileInfo) {
     return true;
 }
 
+namespace {
+
+// Columnas de SELECT * FROM files
+void readFileRow(sqlite3_stmt* stmt, FileInfo& info) {
+    info.id = sqlite3_column_int64(stmt, 0);
+    
+    const char* fileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    info.fileId = fileId ? fileId : "";
+    
+    const char* fileName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    info.fileName = fileName ? fileName : "";
+    
+    info.fileSize = sqlite3_column_int64(stmt, 3);
+    
+    const char* mimeType = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    info.mimeType = mimeType ? mimeType : "";
+    
+    const char* category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    info.category = category ? category : "";
+    
+    const char* uploadDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+    info.uploadDate = uploadDate ? uploadDate : "";
+    
+    info.messageId = sqlite3_column_int64(stmt, 7);
+    
+    const char* telegramFileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+    info.telegramFileId = telegramFileId ? telegramFileId : "";
+    
+    const char* uploaderBotToken = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
+    info.uploaderBotToken = uploaderBotToken ? uploaderBotToken : "";
+    
+    info.isEncrypted = sqlite3_column_int(stmt, 10) == 1;
+}
+
+// Columnas de SELECT * FROM file_chunks
+void readChunkRow(sqlite3_stmt* stmt, ChunkInfo& info) {
+    info.id = sqlite3_column_int64(stmt, 0);
+    
+    const char* fid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    info.fileId = fid ? fid : "";
+    
+    info.chunkNumber = sqlite3_column_int(stmt, 2);
+    info.totalChunks = sqlite3_column_int(stmt, 3);
+    info.chunkSize = sqlite3_column_int64(stmt, 4);
+    
+    const char* hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    info.chunkHash = hash ? hash : "";
+    
+    const char* tgFileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+    info.telegramFileId = tgFileId ? tgFileId : "";
+    
+    info.messageId = sqlite3_column_int64(stmt, 7);
+    
+    const char* status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
+    info.status = status ? status : "";
+    
+    const char* botToken = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 12));
+    info.uploaderBotToken = botToken ? botToken : "";
+}
+
+// Lista de file_id como array JSON para json_each(?): un solo parámetro
+// sea cual sea el número de archivos
+std::string fileIdArray(const std::vector<std::string>& fileIds) {
+    static const char digits[] = "0123456789abcdef";
+    std::string json = "[";
+    for (size_t i = 0; i < fileIds.size(); i++) {
+        if (i > 0) json += ',';
+        json += '"';
+        for (unsigned char c : fileIds[i]) {
+            if (c == '"' || c == '\\') {
+                json += '\\';
+                json += static_cast<char>(c);
+            } else if (c < 0x20) {
+                json += "\\u00";
+                json += digits[c >> 4];
+                json += digits[c & 0x0f];
+            } else {
+                json += static_cast<char>(c);
+            }
+        }
+        json += '"';
+    }
+    json += ']';
+    return json;
+}
+
+// fileIds sin repetidos, en el orden de su primera aparición
+std::vector<std::string> uniqueFileIds(const std::vector<std::string>& fileIds) {
+    std::vector<std::string> unique;
+    std::unordered_set<std::string> seen;
+    unique.reserve(fileIds.size());
+    for (const auto& fileId : fileIds) {
+        if (seen.insert(fileId).second) {
+            unique.push_back(fileId);
+        }
+    }
+    return unique;
+}
+
+} // namespace
+
 std::vector<FileInfo> Database::getFiles() {
     std::vector<FileInfo> files;
     
@@ -272,126 +870,363 @@ std::vector<FileInfo> Database::getFiles() {
         return files;
     }
     
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    
     const char* selectSQL = "SELECT * FROM files ORDER BY upload_date DESC";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, selectSQL, -1, &stmt, nullptr);
+    int rc = prepareRead(reader, selectSQL, &stmt);
     
     if (rc != SQLITE_OK) {
-        LOG_ERROR("Failed to prepare select statement: " + getLastError());
+        LOG_ERROR("Failed to prepare select statement: " + readError(reader));
         return files;
     }
     
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
         FileInfo info;
-        info.id = sqlite3_column_int64(stmt, 0);
-        
-        const char* fileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        info.fileId = fileId ? fileId : "";
-        
-        const char* fileName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        info.fileName = fileName ? fileName : "";
-        
-        info.fileSize = sqlite3_column_int64(stmt, 3);
-        
-        const char* mimeType = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        info.mimeType = mimeType ? mimeType : "";
-        
-        const char* category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        info.category = category ? category : "";
-        
-        const char* uploadDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        info.uploadDate = uploadDate ? uploadDate : "";
-        
-        info.messageId = sqlite3_column_int64(stmt, 7);
-        
-        const char* telegramFileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-        info.telegramFileId = telegramFileId ? telegramFileId : "";
-        
-        const char* uploaderBotToken = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
-        info.uploaderBotToken = uploaderBotToken ? uploaderBotToken : "";
-        
-        info.isEncrypted = sqlite3_column_int(stmt, 10) == 1;
-        
+        readFileRow(stmt, info);
         files.push_back(info);
     }
     
-    sqlite3_finalize(stmt);
+    releaseRead(reader, stmt);
     
     LOG_DEBUG("Retrieved " + std::to_string(files.size()) + " files from database");
     return files;
 }
 
-FileInfo Database::getFileInfo(const std::string& fileId) {
-    FileInfo info;
+bool Database::listFiles(const FileListOptions& options, const FileVisitor& visitor, std::string& nextCursor) {
+    nextCursor.clear();
     
     if (!m_db) {
         LOG_ERROR("Database not initialized");
-        return info;
+        return false;
     }
     
-    const char* selectSQL = "SELECT * FROM files WHERE file_id = ?";
-    sqlite3_stmt* stmt;
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
     
-    int rc = sqlite3_prepare_v2(m_db, selectSQL, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        LOG_ERROR("Failed to prepare select statement: " + getLastError());
-        return info;
+    const char* column = "upload_date";
+    char tag = 'd';
+    if (options.sortBy == FileSortOrder::Name) {
+        column = "file_name";
+        tag = 'n';
+    } else if (options.sortBy == FileSortOrder::Size) {
+        column = "file_size";
+        tag = 's';
     }
+    std::string prefix = std::string(1, tag) + (options.ascending ? 'a' : 'd') + ":";
     
-    sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_STATIC);
-    
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        info.id = sqlite3_column_int64(stmt, 0);
-        
-        const char* fid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        info.fileId = fid ? fid : "";
-        
-        const char* fname = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        info.fileName = fname ? fname : "";
-        
-        info.fileSize = sqlite3_column_int64(stmt, 3);
-        
-        const char* mime = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        info.mimeType = mime ? mime : "";
-        
-        const char* cat = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        info.category = cat ? cat : "";
-        
-        const char* date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        info.uploadDate = date ? date : "";
-        
-        info.messageId = sqlite3_column_int64(stmt, 7);
-        
-        const char* tgFileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-        info.telegramFileId = tgFileId ? tgFileId : "";
-        
-        const char* botToken = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
-        info.uploaderBotToken = botToken ? botToken : "";
-        
-        info.isEncrypted = sqlite3_column_int(stmt, 10) != 0;
+    // Cursor: "<orden><dirección>:<id>:<clave>" de la última fila entregada
+    bool hasCursor = !options.cursor.empty();
+    int64_t afterId = 0;
+    std::string afterKey;
+    if (hasCursor) {
+        size_t idEnd = options.cursor.find(':', prefix.size());
+        if (options.cursor.compare(0, prefix.size(), prefix) != 0 || idEnd == std::string::npos) {
+            LOG_ERROR("Invalid file listing cursor for this sort order");
+            return false;
+        }
+        try {
+            afterId = std::stoll(options.cursor.substr(prefix.size(), idEnd - prefix.size()));
+        } catch (const std::exception&) {
+            LOG_ERROR("Invalid file listing cursor");
+            return false;
+        }
+        afterKey = options.cursor.substr(idEnd + 1);
     }
     
-    sqlite3_finalize(stmt);
+    // Paginación por clave: los índices de files terminan en rowid, así que
+    // (clave, id) se recorre en el índice sin OFFSET ni ordenación en memoria
+    const char* dir = options.ascending ? "ASC" : "DESC";
+    std::string sql = "SELECT * FROM files";
+    if (hasCursor) {
+        sql += std::string(" WHERE (") + column + ", id) " + (options.ascending ? ">" : "<") + " (?, ?)";
+    }
+    sql += std::string(" ORDER BY ") + column + " " + dir + ", id " + dir + " LIMIT ?";
     
-    LOG_DEBUG("Retrieved file info for: " + fileId);
-    return info;
-}
-
-bool Database::registerChunkedFile(const ChunkedFileInfo& fileInfo) {
-    if (!m_db) {
-        LOG_ERROR("Database not initialized");
+    sqlite3_stmt* stmt;
+    if (prepareRead(reader, sql.c_str(), &stmt) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare file listing: " + readError(reader));
         return false;
     }
     
-    const char* insertSQL = R"(
-        INSERT INTO chunked_files (file_id, original_filename, mime_type, total_size,
-                                   total_chunks, completed_chunks, status, original_file_hash)
+    int param = 1;
+    if (hasCursor) {
+        if (options.sortBy == FileSortOrder::Size) {
+            sqlite3_bind_int64(stmt, param++, std::strtoll(afterKey.c_str(), nullptr, 10));
+        } else {
+            sqlite3_bind_text(stmt, param++, afterKey.c_str(), -1, SQLITE_STATIC);
+        }
+        sqlite3_bind_int64(stmt, param++, afterId);
+    }
+    sqlite3_bind_int(stmt, param, options.limit > 0 ? options.limit : -1);
+    
+    FileInfo info;
+    int rows = 0;
+    bool stopped = false;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        readFileRow(stmt, info);
+        rows++;
+        if (!visitor(info)) {
+            stopped = true;
+            break;
+        }
+    }
+    releaseRead(reader, stmt);
+    
+    if (!stopped && rc != SQLITE_DONE) {
+        LOG_ERROR("Failed to list files: " + readError(reader));
+        return false;
+    }
+    
+    // Hay más si se llenó la página o si el visitante cortó antes
+    if (rows > 0 && (stopped || (options.limit > 0 && rows == options.limit))) {
+        std::string key = options.sortBy == FileSortOrder::Name ? info.fileName
+                        : options.sortBy == FileSortOrder::Size ? std::to_string(info.fileSize)
+                        : info.uploadDate;
+        nextCursor = prefix + std::to_string(info.id) + ":" + key;
+    }
+    return true;
+}
+
+FileSearchPage Database::search(const std::string& query, int limit, const std::string& cursor) {
+    FileSearchPage page;
+    
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return page;
+    }
+    
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    if (limit <= 0) {
+        limit = 50;
+    }
+    
+    // Términos separados por espacios; todos deben aparecer (AND)
+    std::vector<std::string> longTerms;
+    std::vector<std::string> shortTerms;
+    std::istringstream words(query);
+    std::string word;
+    while (words >> word) {
+        // trigram necesita al menos 3 caracteres (no bytes) para usar el índice
+        size_t chars = 0;
+        for (unsigned char c : word) {
+            if ((c & 0xC0) != 0x80) chars++;
+        }
+        (m_searchIndexAvailable && chars >= 3 ? longTerms : shortTerms).push_back(word);
+    }
+    if (longTerms.empty() && shortTerms.empty()) {
+        page.ok = true;
+        return page;
+    }
+    
+    bool useIndex = !longTerms.empty();
+    std::string match;
+    for (const auto& term : longTerms) {
+        // Cada término como frase entre comillas: sin sintaxis FTS5 del usuario
+        std::string quoted;
+        for (char c : term) {
+            quoted += c;
+            if (c == '"') quoted += '"';
+        }
+        match += (match.empty() ? "\"" : " \"") + quoted + "\"";
+    }
+    
+    // Cursor: "r<rank>:<id>" por relevancia, "i<id>" por id descendente
+    bool hasCursor = !cursor.empty();
+    bool ranked = false;
+    double afterRank = 0.0;
+    int64_t afterId = 0;
+    if (hasCursor) {
+        try {
+            if (cursor[0] == 'r' && useIndex) {
+                size_t sep = cursor.rfind(':');
+                if (sep == std::string::npos) throw std::invalid_argument("cursor");
+                ranked = true;
+                afterRank = std::stod(cursor.substr(1, sep - 1));
+                afterId = std::stoll(cursor.substr(sep + 1));
+            } else if (cursor[0] == 'i') {
+                afterId = std::stoll(cursor.substr(1));
+            } else {
+                throw std::invalid_argument("cursor");
+            }
+        } catch (const std::exception&) {
+            LOG_ERROR("Invalid search cursor");
+            return page;
+        }
+    } else if (useIndex) {
+        // bm25 puntúa todas las coincidencias antes de ordenar: solo se ordena por
+        // relevancia si son pocas; con términos muy comunes (el caso de las primeras
+        // teclas) se devuelven las más recientes sin recorrer el resto
+        ranked = true;
+        sqlite3_stmt* countStmt;
+        if (prepareRead(reader, "SELECT count(*) FROM (SELECT 1 FROM files_fts WHERE files_fts MATCH ? LIMIT ?)", &countStmt) == SQLITE_OK) {
+            sqlite3_bind_text(countStmt, 1, match.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(countStmt, 2, RANKED_SEARCH_LIMIT + 1);
+            if (sqlite3_step(countStmt) == SQLITE_ROW) {
+                ranked = sqlite3_column_int(countStmt, 0) <= RANKED_SEARCH_LIMIT;
+            }
+            releaseRead(reader, countStmt);
+        }
+    }
+    
+    std::string sql;
+    if (useIndex) {
+        sql = std::string("SELECT f.*, ") + (ranked ? "files_fts.rank" : "0.0") +
+              " FROM files_fts JOIN files f ON f.id = files_fts.rowid WHERE files_fts MATCH ?";
+    } else {
+        sql = "SELECT f.*, 0.0 FROM files f WHERE 1";
+    }
+    // Términos cortos: subcadena en el nombre sobre las filas ya filtradas
+    for (size_t i = 0; i < shortTerms.size(); i++) {
+        sql += " AND f.file_name LIKE ? ESCAPE '\\'";
+    }
+    // Ordenar por files_fts.rowid (no f.id) para que FTS5 recorra el índice
+    // en orden inverso y el LIMIT corte pronto, sin ordenación temporal
+    const char* idColumn = useIndex ? "files_fts.rowid" : "f.id";
+    if (ranked) {
+        if (hasCursor) {
+            sql += " AND (files_fts.rank > ? OR (files_fts.rank = ? AND files_fts.rowid > ?))";
+        }
+        sql += " ORDER BY files_fts.rank, files_fts.rowid LIMIT ?";
+    } else {
+        if (hasCursor) {
+            sql += std::string(" AND ") + idColumn + " < ?";
+        }
+        sql += std::string(" ORDER BY ") + idColumn + " DESC LIMIT ?";
+    }
+    
+    sqlite3_stmt* stmt;
+    if (prepareRead(reader, sql.c_str(), &stmt) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare search: " + readError(reader));
+        return page;
+    }
+    
+    int param = 1;
+    if (useIndex) {
+        sqlite3_bind_text(stmt, param++, match.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    for (const auto& term : shortTerms) {
+        std::string pattern = "%";
+        for (char c : term) {
+            if (c == '%' || c == '_' || c == '\\') pattern += '\\';
+            pattern += c;
+        }
+        pattern += "%";
+        sqlite3_bind_text(stmt, param++, pattern.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (hasCursor) {
+        if (ranked) {
+            sqlite3_bind_double(stmt, param++, afterRank);
+            sqlite3_bind_double(stmt, param++, afterRank);
+        }
+        sqlite3_bind_int64(stmt, param++, afterId);
+    }
+    sqlite3_bind_int(stmt, param, limit);
+    
+    double lastRank = 0.0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        FileInfo info;
+        readFileRow(stmt, info);
+        lastRank = sqlite3_column_double(stmt, 11);
+        page.files.push_back(std::move(info));
+    }
+    releaseRead(reader, stmt);
+    
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("Search failed: " + readError(reader));
+        page.files.clear();
+        return page;
+    }
+    
+    if (static_cast<int>(page.files.size()) == limit) {
+        std::ostringstream next;
+        if (ranked) {
+            next << 'r' << std::setprecision(17) << lastRank << ':';
+        } else {
+            next << 'i';
+        }
+        next << page.files.back().id;
+        page.nextCursor = next.str();
+    }
+    page.ok = true;
+    return page;
+}
+
+FileInfo Database::getFileInfo(const std::string& fileId) {
+    FileInfo info;
+    
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return info;
+    }
+    
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    
+    const char* selectSQL = "SELECT * FROM files WHERE file_id = ?";
+    sqlite3_stmt* stmt;
+    
+    int rc = prepareRead(reader, selectSQL, &stmt);
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare select statement: " + readError(reader));
+        return info;
+    }
+    
+    sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_STATIC);
+    
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        info.id = sqlite3_column_int64(stmt, 0);
+        
+        const char* fid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        info.fileId = fid ? fid : "";
+        
+        const char* fname = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        info.fileName = fname ? fname : "";
+        
+        info.fileSize = sqlite3_column_int64(stmt, 3);
+        
+        const char* mime = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        info.mimeType = mime ? mime : "";
+        
+        const char* cat = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        info.category = cat ? cat : "";
+        
+        const char* date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+        info.uploadDate = date ? date : "";
+        
+        info.messageId = sqlite3_column_int64(stmt, 7);
+        
+        const char* tgFileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+        info.telegramFileId = tgFileId ? tgFileId : "";
+        
+        const char* botToken = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
+        info.uploaderBotToken = botToken ? botToken : "";
+        
+        info.isEncrypted = sqlite3_column_int(stmt, 10) != 0;
+    }
+    
+    releaseRead(reader, stmt);
+    
+    LOG_DEBUG("Retrieved file info for: " + fileId);
+    return info;
+}
+
+bool Database::registerChunkedFile(const ChunkedFileInfo& fileInfo) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    const char* insertSQL = R"(
+        INSERT INTO chunked_files (file_id, original_filename, mime_type, total_size,
+                                   total_chunks, completed_chunks, status, original_file_hash)
         VALUES (?, ?, ?, ?, ?, ?, ?, ?)
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, insertSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(insertSQL, &stmt);
     
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare chunked file insert: " + getLastError());
@@ -408,7 +1243,7 @@ bool Database::registerChunkedFile(const ChunkedFileInfo& fileInfo) {
     sqlite3_bind_text(stmt, 8, fileInfo.originalFileHash.c_str(), -1, SQLITE_STATIC);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to register chunked file: " + getLastError());
@@ -421,6 +1256,7 @@ bool Database::registerChunkedFile(const ChunkedFileInfo& fileInfo) {
 }
 
 bool Database::saveChunkInfo(const ChunkInfo& chunkInfo) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -433,7 +1269,7 @@ bool Database::saveChunkInfo(const ChunkInfo& chunkInfo) {
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, insertSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(insertSQL, &stmt);
     
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare chunk insert: " + getLastError());
@@ -451,7 +1287,7 @@ bool Database::saveChunkInfo(const ChunkInfo& chunkInfo) {
     sqlite3_bind_text(stmt, 9, chunkInfo.uploaderBotToken.c_str(), -1, SQLITE_STATIC);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to save chunk info: " + getLastError());
@@ -470,12 +1306,14 @@ std::vector<ChunkInfo> Database::getFileChunks(const std::string& fileId) {
         return chunks;
     }
     
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    
     const char* selectSQL = "SELECT * FROM file_chunks WHERE file_id = ? ORDER BY chunk_number";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, selectSQL, -1, &stmt, nullptr);
+    int rc = prepareRead(reader, selectSQL, &stmt);
     if (rc != SQLITE_OK) {
-        LOG_ERROR("Failed to prepare chunk select: " + getLastError());
+        LOG_ERROR("Failed to prepare chunk select: " + readError(reader));
         return chunks;
     }
     
@@ -483,38 +1321,216 @@ std::vector<ChunkInfo> Database::getFileChunks(const std::string& fileId) {
     
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         ChunkInfo info;
-        info.id = sqlite3_column_int64(stmt, 0);
-        
-        const char* fid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        info.fileId = fid ? fid : "";
-        
-        info.chunkNumber = sqlite3_column_int(stmt, 2);
-        info.totalChunks = sqlite3_column_int(stmt, 3);
-        info.chunkSize = sqlite3_column_int64(stmt, 4);
-        
-        const char* hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        info.chunkHash = hash ? hash : "";
-        
-        const char* tgFileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        info.telegramFileId = tgFileId ? tgFileId : "";
-        
-        info.messageId = sqlite3_column_int64(stmt, 7);
-        
-        const char* status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
-        info.status = status ? status : "";
-        
-        const char* botToken = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 12));
-        info.uploaderBotToken = botToken ? botToken : "";
-        
+        readChunkRow(stmt, info);
         chunks.push_back(info);
     }
     
-    sqlite3_finalize(stmt);
+    releaseRead(reader, stmt);
     
     LOG_INFO("Retrieved " + std::to_string(chunks.size()) + " chunks for file: " + fileId);
     return chunks;
 }
 
+std::vector<FileInfo> Database::getFilesInfo(const std::vector<std::string>& fileIds) {
+    std::vector<FileInfo> files;
+    
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return files;
+    }
+    if (fileIds.empty()) {
+        return files;
+    }
+    
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    
+    // CROSS JOIN fija json_each como bucle exterior: una búsqueda por índice
+    // por archivo y las filas salen en el orden de fileIds
+    const char* selectSQL =
+        "SELECT f.* FROM json_each(?) AS ids CROSS JOIN files AS f ON f.file_id = ids.value";
+    
+    sqlite3_stmt* stmt;
+    if (prepareRead(reader, selectSQL, &stmt) != SQLITE_OK) {
+        // SQLite sin JSON1: una consulta por archivo, como antes
+        LOG_WARNING("Bulk file lookup unavailable (" + readError(reader) + "), falling back to per-file queries");
+        reader = ReadConnectionPool::Lease();
+        for (const auto& fileId : fileIds) {
+            FileInfo info = getFileInfo(fileId);
+            if (!info.fileId.empty()) {
+                files.push_back(std::move(info));
+            }
+        }
+        return files;
+    }
+    
+    // Cada archivo se consulta una vez; los repetidos se copian a cada posición pedida
+    std::string idArray = fileIdArray(uniqueFileIds(fileIds));
+    sqlite3_bind_text(stmt, 1, idArray.c_str(), static_cast<int>(idArray.size()), SQLITE_STATIC);
+    
+    std::unordered_map<std::string, FileInfo> found;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        FileInfo info;
+        readFileRow(stmt, info);
+        found.emplace(info.fileId, std::move(info));
+    }
+    releaseRead(reader, stmt);
+    
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("Failed to read files: " + readError(reader));
+    }
+    
+    files.reserve(fileIds.size());
+    for (const auto& fileId : fileIds) {
+        auto it = found.find(fileId);
+        if (it != found.end()) {
+            files.push_back(it->second);
+        }
+    }
+    
+    LOG_DEBUG("Retrieved " + std::to_string(files.size()) + "/" + std::to_string(fileIds.size()) +
+              " files in one query");
+    return files;
+}
+
+bool Database::getChunksForFiles(const std::vector<std::string>& fileIds, const FileChunksVisitor& visitor) {
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    if (fileIds.empty()) {
+        return true;
+    }
+    
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    
+    // Los chunks de cada archivo salen contiguos y en el orden de fileIds. Sin
+    // ORDER BY: ordenar el resultado entero pasaría por un B-tree temporal y
+    // retrasaría la primera fila; cada grupo se ordena por chunk_number al cerrarlo
+    const char* selectSQL =
+        "SELECT c.* FROM json_each(?) AS ids CROSS JOIN file_chunks AS c ON c.file_id = ids.value";
+    
+    sqlite3_stmt* stmt;
+    if (prepareRead(reader, selectSQL, &stmt) != SQLITE_OK) {
+        LOG_WARNING("Bulk chunk lookup unavailable (" + readError(reader) + "), falling back to per-file queries");
+        reader = ReadConnectionPool::Lease();
+        return getChunksPerFile(fileIds, visitor);
+    }
+    
+    // Cada archivo se consulta una vez (un id repetido duplicaría su grupo);
+    // el resultado se entrega a cada posición pedida, en el orden de fileIds
+    std::unordered_map<std::string, size_t> firstPosition;
+    std::unordered_map<std::string, std::vector<ChunkInfo>> repeated;   // grupos de ids repetidos
+    for (size_t i = 0; i < fileIds.size(); i++) {
+        if (!firstPosition.emplace(fileIds[i], i).second) {
+            repeated.emplace(fileIds[i], std::vector<ChunkInfo>());
+        }
+    }
+    
+    std::string idArray = fileIdArray(uniqueFileIds(fileIds));
+    sqlite3_bind_text(stmt, 1, idArray.c_str(), static_cast<int>(idArray.size()), SQLITE_STATIC);
+    
+    // Posiciones anteriores a end: las repeticiones reciben la copia guardada;
+    // las primeras apariciones sin grupo no tienen chunks
+    size_t nextPosition = 0;
+    auto emitRepeatsUntil = [&](size_t end) {
+        for (; nextPosition < end; nextPosition++) {
+            const std::string& fileId = fileIds[nextPosition];
+            auto it = repeated.find(fileId);
+            if (it == repeated.end() || firstPosition[fileId] == nextPosition || it->second.empty()) {
+                continue;
+            }
+            std::vector<ChunkInfo> copy = it->second;
+            if (!visitor(fileId, copy)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    std::vector<ChunkInfo> group;
+    std::string groupFileId;
+    auto emitGroup = [&]() {
+        std::sort(group.begin(), group.end(), [](const ChunkInfo& a, const ChunkInfo& b) {
+            return a.chunkNumber < b.chunkNumber;
+        });
+        size_t position = firstPosition[groupFileId];
+        if (!emitRepeatsUntil(position)) {
+            return false;
+        }
+        auto it = repeated.find(groupFileId);
+        if (it != repeated.end()) {
+            it->second = group;
+        }
+        nextPosition = position + 1;
+        bool keepGoing = visitor(groupFileId, group);
+        group.clear();
+        return keepGoing;
+    };
+    
+    bool stopped = false;
+    int64_t rows = 0;
+    int rc;
+    ChunkInfo info;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        readChunkRow(stmt, info);
+        rows++;
+        if (!group.empty() && info.fileId != groupFileId) {
+            if (!emitGroup()) {
+                stopped = true;
+                break;
+            }
+        }
+        if (group.empty()) {
+            groupFileId = info.fileId;
+        }
+        group.push_back(info);
+    }
+    releaseRead(reader, stmt);
+    
+    if (!stopped && rc != SQLITE_DONE) {
+        LOG_ERROR("Failed to read chunks: " + readError(reader));
+        return false;
+    }
+    if (!stopped && (group.empty() || emitGroup())) {
+        emitRepeatsUntil(fileIds.size());
+    }
+    
+    LOG_DEBUG("Retrieved " + std::to_string(rows) + " chunks for " + std::to_string(fileIds.size()) +
+              " files in one query");
+    return true;
+}
+
+bool Database::getChunksPerFile(const std::vector<std::string>& fileIds, const FileChunksVisitor& visitor) {
+    // Solo se guardan los grupos de ids repetidos, para no releerlos
+    std::unordered_map<std::string, size_t> occurrences;
+    for (const auto& fileId : fileIds) {
+        occurrences[fileId]++;
+    }
+    std::unordered_map<std::string, std::vector<ChunkInfo>> repeated;
+    
+    for (const auto& fileId : fileIds) {
+        std::vector<ChunkInfo> chunks;
+        auto it = repeated.find(fileId);
+        if (it != repeated.end()) {
+            chunks = it->second;
+        } else {
+            chunks = getFileChunks(fileId);
+            if (occurrences[fileId] > 1) {
+                repeated.emplace(fileId, chunks);
+            }
+        }
+        if (chunks.empty()) {
+            continue;
+        }
+        // Como en la consulta en bloque: false termina el recorrido aquí
+        if (!visitor(fileId, chunks)) {
+            return true;
+        }
+    }
+    return true;
+}
+
 bool Database::deleteFile(const std::string& fileId) {
     if (!m_db) {
         LOG_ERROR("Database not initialized");
@@ -527,6 +1543,7 @@ bool Database::deleteFile(const std::string& fileId) {
     bool success = false;
     
     // Iniciar transacción
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     int rc = sqlite3_exec(m_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to begin transaction: " + std::string(sqlite3_errmsg(m_db)));
@@ -537,7 +1554,7 @@ bool Database::deleteFile(const std::string& fileId) {
         // Primero obtener información de los chunks para eliminarlos de Telegram
         const char* chunksSQL = "SELECT message_id, uploader_bot_token FROM file_chunks WHERE file_id = ? AND message_id IS NOT NULL AND uploader_bot_token IS NOT NULL";
         
-        rc = sqlite3_prepare_v2(m_db, chunksSQL, -1, &stmt, nullptr);
+        rc = prepareCached(chunksSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare chunks query: " + std::string(sqlite3_errmsg(m_db)));
             sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
@@ -558,14 +1575,14 @@ bool Database::deleteFile(const std::string& fileId) {
             }
         }
         
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         stmt = nullptr;
         
         LOG_INFO("Found " + std::to_string(messagesToDelete.size()) + " chunks to delete from Telegram for file: " + fileId);
         
         // Eliminar de chunked_files (esto también eliminará file_chunks por CASCADE)
         const char* deleteChunkedSQL = "DELETE FROM chunked_files WHERE file_id = ?";
-        rc = sqlite3_prepare_v2(m_db, deleteChunkedSQL, -1, &stmt, nullptr);
+        rc = prepareCached(deleteChunkedSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare delete chunked files query: " + std::string(sqlite3_errmsg(m_db)));
             sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
@@ -574,7 +1591,7 @@ bool Database::deleteFile(const std::string& fileId) {
         
         sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_STATIC);
         rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         stmt = nullptr;
         
         if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
@@ -585,7 +1602,7 @@ bool Database::deleteFile(const std::string& fileId) {
         
         // Eliminar de files
         const char* deleteFileSQL = "DELETE FROM files WHERE file_id = ?";
-        rc = sqlite3_prepare_v2(m_db, deleteFileSQL, -1, &stmt, nullptr);
+        rc = prepareCached(deleteFileSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare delete file query: " + std::string(sqlite3_errmsg(m_db)));
             sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
@@ -594,7 +1611,7 @@ bool Database::deleteFile(const std::string& fileId) {
         
         sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_STATIC);
         rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         stmt = nullptr;
         
         if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
@@ -620,7 +1637,7 @@ bool Database::deleteFile(const std::string& fileId) {
     } catch (const std::exception& e) {
         LOG_ERROR("Exception in deleteFile: " + std::string(e.what()));
         if (stmt) {
-            sqlite3_finalize(stmt);
+            releaseStatement(stmt);
         }
         sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
         return false;
@@ -645,7 +1662,7 @@ std::vector<std::pair<int64_t, std::string>> Database::getMessagesToDelete(const
         // Obtener mensajes de chunks
         const char* chunksSQL = "SELECT message_id, uploader_bot_token FROM file_chunks WHERE file_id = ? AND message_id IS NOT NULL AND uploader_bot_token IS NOT NULL";
         
-        int rc = sqlite3_prepare_v2(m_db, chunksSQL, -1, &stmt, nullptr);
+        int rc = prepareCached(chunksSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare chunks query: " + std::string(sqlite3_errmsg(m_db)));
             return messagesToDelete;
@@ -663,13 +1680,13 @@ std::vector<std::pair<int64_t, std::string>> Database::getMessagesToDelete(const
             }
         }
         
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         stmt = nullptr;
         
         // Obtener mensaje de archivo directo
         const char* fileSQL = "SELECT message_id, uploader_bot_token FROM files WHERE file_id = ? AND message_id IS NOT NULL AND uploader_bot_token IS NOT NULL";
         
-        rc = sqlite3_prepare_v2(m_db, fileSQL, -1, &stmt, nullptr);
+        rc = prepareCached(fileSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare file query: " + std::string(sqlite3_errmsg(m_db)));
             return messagesToDelete;
@@ -687,14 +1704,14 @@ std::vector<std::pair<int64_t, std::string>> Database::getMessagesToDelete(const
             }
         }
         
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         
         LOG_INFO("Found " + std::to_string(messagesToDelete.size()) + " messages to delete for file: " + fileId);
         
     } catch (const std::exception& e) {
         LOG_ERROR("Exception in getMessagesToDelete: " + std::string(e.what()));
         if (stmt) {
-            sqlite3_finalize(stmt);
+            releaseStatement(stmt);
         }
     }
     
@@ -702,47 +1719,89 @@ std::vector<std::pair<int64_t, std::string>> Database::getMessagesToDelete(const
 }
 
 int64_t Database::getTotalStorageUsed() {
+    int64_t files = 0;
+    int64_t bytes = 0;
+    readStatsCounter("total", "", files, bytes);
+    return bytes;
+}
+
+int Database::getTotalFilesCount() {
+    int64_t files = 0;
+    int64_t bytes = 0;
+    readStatsCounter("total", "", files, bytes);
+    return static_cast<int>(files);
+}
+
+bool Database::readStatsCounter(const char* dimension, const char* key, int64_t& items, int64_t& bytes) {
+    items = 0;
+    bytes = 0;
     if (!m_db) {
-        return 0;
+        return false;
     }
     
-    const char* sumSQL = "SELECT SUM(file_size) FROM files";
-    sqlite3_stmt* stmt;
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
     
-    int rc = sqlite3_prepare_v2(m_db, sumSQL, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return 0;
+    // Búsqueda por clave primaria en catalog_stats: O(1) sea cual sea el catálogo
+    const char* sql = "SELECT items, bytes FROM catalog_stats WHERE dimension = ? AND key = ?";
+    sqlite3_stmt* stmt;
+    if (prepareRead(reader, sql, &stmt) != SQLITE_OK) {
+        LOG_ERROR("Failed to read catalog stats: " + readError(reader));
+        return false;
     }
     
-    int64_t totalSize = 0;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        totalSize = sqlite3_column_int64(stmt, 0);
+    sqlite3_bind_text(stmt, 1, dimension, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, key, -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        items = sqlite3_column_int64(stmt, 0);
+        bytes = sqlite3_column_int64(stmt, 1);
     }
-    
-    sqlite3_finalize(stmt);
-    return totalSize;
+    releaseRead(reader, stmt);
+    return found;
 }
 
-int Database::getTotalFilesCount() {
+CatalogStats Database::getCatalogStats() {
+    CatalogStats stats;
     if (!m_db) {
-        return 0;
+        return stats;
     }
     
-    const char* countSQL = "SELECT COUNT(*) FROM files";
-    sqlite3_stmt* stmt;
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
     
-    int rc = sqlite3_prepare_v2(m_db, countSQL, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        return 0;
+    const char* sql = "SELECT dimension, key, items, bytes FROM catalog_stats WHERE items != 0";
+    sqlite3_stmt* stmt;
+    if (prepareRead(reader, sql, &stmt) != SQLITE_OK) {
+        LOG_ERROR("Failed to read catalog stats: " + readError(reader));
+        return stats;
     }
     
-    int count = 0;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        count = sqlite3_column_int(stmt, 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* dimension = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        const char* key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        std::string dim = dimension ? dimension : "";
+        StatsCounter counter;
+        counter.key = key ? key : "";
+        counter.items = sqlite3_column_int64(stmt, 2);
+        counter.bytes = sqlite3_column_int64(stmt, 3);
+        
+        if (dim == "total") {
+            stats.totalFiles = counter.items;
+            stats.totalBytes = counter.bytes;
+        } else if (dim == "chunks") {
+            stats.totalChunks = counter.items;
+            stats.chunkBytes = counter.bytes;
+        } else if (dim == "category") {
+            stats.categories.push_back(std::move(counter));
+        } else if (dim == "mime") {
+            stats.mimeTypes.push_back(std::move(counter));
+        } else if (dim == "bot") {
+            // Solo el id numérico del bot ("123456:ABC..." -> "123456"), nunca el token
+            counter.key = counter.key.substr(0, counter.key.find(':'));
+            stats.bots.push_back(std::move(counter));
+        }
     }
-    
-    sqlite3_finalize(stmt);
-    return count;
+    releaseRead(reader, stmt);
+    return stats;
 }
 
 std::string Database::getLastError() const {
@@ -792,19 +1851,81 @@ bool Database::isDatabaseEncrypted() {
     return m_isEncrypted;
 }
 
-bool Database::configureEncryption() {
+bool Database::backupTo(const std::string& destPath, int pagesPerStep) {
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
     }
     
-    // Obtener o generar clave de encriptación desde EnvManager
-    EnvManager& envMgr = EnvManager::instance();
+    std::error_code ec;
+    std::filesystem::remove(destPath, ec);
     
-    // CRÍTICO: Asegurar que EnvManager ha cargado el archivo encriptado
-    envMgr.load();
+    sqlite3* dest = nullptr;
+    if (sqlite3_open(destPath.c_str(), &dest) != SQLITE_OK) {
+        LOG_ERROR("Failed to open backup destination: " + destPath);
+        sqlite3_close(dest);
+        return false;
+    }
     
-    if (m_encryptionKey.empty()) {
+    // La copia queda cifrada con la misma clave y parámetros que el original
+    if (m_isEncrypted) {
+        std::string pragmaSQL = "PRAGMA key = '" + m_encryptionKey + "'";
+        if (sqlite3_exec(dest, pragmaSQL.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            LOG_ERROR("Failed to set encryption key on backup destination");
+            sqlite3_close(dest);
+            std::filesystem::remove(destPath, ec);
+            return false;
+        }
+        applyCipherPragmas(dest);
+    }
+    
+    // API de backup online: copia por pasos sin cerrar la base ni bloquear
+    // a los escritores más que lo que dura cada paso
+    sqlite3_backup* backup = sqlite3_backup_init(dest, "main", m_db, "main");
+    if (!backup) {
+        LOG_ERROR("Failed to start online backup: " + std::string(sqlite3_errmsg(dest)));
+        sqlite3_close(dest);
+        std::filesystem::remove(destPath, ec);
+        return false;
+    }
+    
+    int rc;
+    do {
+        rc = sqlite3_backup_step(backup, pagesPerStep);
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            sqlite3_sleep(50);
+        }
+    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+    
+    sqlite3_backup_finish(backup);
+    bool ok = (rc == SQLITE_DONE);
+    if (!ok) {
+        LOG_ERROR("Online backup failed: " + std::string(sqlite3_errmsg(dest)));
+    }
+    sqlite3_close(dest);
+    
+    if (!ok) {
+        std::filesystem::remove(destPath, ec);
+        return false;
+    }
+    
+    LOG_INFO("Database snapshot written to: " + destPath);
+    return true;
+}
+
+bool Database::configureEncryption() {
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    // Obtener o generar clave de encriptación desde EnvManager
+    EnvManager& envMgr = EnvManager::instance();
+    
+    // CRÍTICO: Asegurar que EnvManager ha cargado el archivo encriptado
+    envMgr.load();
+    
+    if (m_encryptionKey.empty()) {
         // Intentar cargar clave existente desde configuración encriptada
         std::string storedKey = envMgr.get("DB_ENCRYPTION_KEY");
         
@@ -824,6 +1945,36 @@ bool Database::configureEncryption() {
         }
     }
     
+    // Clave derivada en caché (cacheRawKey): PRAGMA key = x'...' no ejecuta
+    // las 256000 iteraciones del KDF. Solo vale para el salt de este archivo.
+    m_rawKey.clear();
+    std::string salt = readCipherSalt(m_dbPath);
+    std::string cachedKey = envMgr.get("DB_RAW_KEY");
+    if (!salt.empty() && rawKeyMatchesSalt(cachedKey, salt)) {
+        bool unlocked = sqlite3_exec(m_db, keyPragma(cachedKey).c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        if (unlocked) {
+            applyCipherPragmas(m_db);
+            unlocked = sqlite3_exec(m_db, "SELECT count(*) FROM sqlite_master", nullptr, nullptr, nullptr) == SQLITE_OK;
+        }
+        if (unlocked) {
+            m_rawKey = cachedKey;
+            m_isEncrypted = true;
+            LOG_INFO("Database unlocked with cached raw key");
+            return true;
+        }
+        
+        // La clave ya no corresponde a la base (p. ej. rekey): reabrir sin clave y usar la frase
+        LOG_WARNING("Cached raw database key rejected, falling back to passphrase");
+        envMgr.remove("DB_RAW_KEY");
+        envMgr.save();
+        clearStatementCache();
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        if (!openConnection()) {
+            return false;
+        }
+    }
+    
     // Configurar encriptación SQLCipher
     if (!setEncryptionKey(m_encryptionKey)) {
         LOG_ERROR("Failed to configure database encryption");
@@ -831,21 +1982,7 @@ bool Database::configureEncryption() {
     }
     
     // Configurar parámetros de encriptación adicionales (DESPUÉS del PRAGMA key)
-    const char* encryptionPragmas[] = {
-        "PRAGMA cipher_page_size = 4096",
-        "PRAGMA cipher_kdf_iter = 256000",
-        "PRAGMA cipher_hmac_algorithm = HMAC_SHA1",
-        "PRAGMA cipher_kdf_algorithm = PBKDF2_HMAC_SHA1"
-    };
-    
-    for (const char* pragma : encryptionPragmas) {
-        char* errMsg = nullptr;
-        int rc = sqlite3_exec(m_db, pragma, nullptr, nullptr, &errMsg);
-        if (rc != SQLITE_OK) {
-            LOG_WARNING("Failed to set encryption pragma: " + std::string(errMsg));
-            sqlite3_free(errMsg);
-        }
-    }
+    applyCipherPragmas(m_db);
     
     // AHORA verificar que la base de datos funciona correctamente
     char* errMsg = nullptr;
@@ -862,11 +1999,46 @@ bool Database::configureEncryption() {
     return true;
 }
 
+void Database::cacheRawKey() {
+    std::string salt = readCipherSalt(m_dbPath);
+    if (salt.empty()) {
+        return;
+    }
+    
+    std::string rawKey;
+    try {
+        rawKey = rawKeyLiteral(CryptoEngine::deriveKeyPbkdf2Sha1(m_encryptionKey, salt, SQLCIPHER_KDF_ITERATIONS), salt);
+    } catch (const std::exception& e) {
+        LOG_WARNING("Failed to derive raw database key: " + std::string(e.what()));
+        return;
+    }
+    
+    // Comprobarla contra el archivo antes de guardarla: una clave que no abre
+    // costaría dos KDF en cada arranque
+    m_rawKey = rawKey;
+    sqlite3* probe = openReadConnection();
+    if (!probe) {
+        m_rawKey.clear();
+        LOG_WARNING("Derived raw database key does not open the database; not cached");
+        return;
+    }
+    sqlite3_close(probe);
+    
+    EnvManager& envMgr = EnvManager::instance();
+    envMgr.set("DB_RAW_KEY", rawKey);
+    if (!envMgr.save()) {
+        LOG_WARNING("Failed to save raw database key to secure storage: " + envMgr.lastError());
+        return;
+    }
+    LOG_INFO("Cached raw database key in secure storage");
+}
+
 // ============================================================================
 // Upload Progress Persistence Implementation
 // ============================================================================
 
 bool Database::updateUploadState(const std::string& fileId, const std::string& state) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -875,7 +2047,7 @@ bool Database::updateUploadState(const std::string& fileId, const std::string& s
     const char* updateSQL = "UPDATE chunked_files SET status = ?, last_update = CURRENT_TIMESTAMP WHERE file_id = ?";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, updateSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(updateSQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare update upload state query: " + getLastError());
         return false;
@@ -885,7 +2057,7 @@ bool Database::updateUploadState(const std::string& fileId, const std::string& s
     sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_STATIC);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to update upload state: " + getLastError());
@@ -897,6 +2069,7 @@ bool Database::updateUploadState(const std::string& fileId, const std::string& s
 }
 
 bool Database::updateChunkState(const std::string& fileId, int64_t chunkNumber, const std::string& state) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -905,7 +2078,7 @@ bool Database::updateChunkState(const std::string& fileId, int64_t chunkNumber,
     const char* updateSQL = "UPDATE file_chunks SET status = ?, last_updated = CURRENT_TIMESTAMP WHERE file_id = ? AND chunk_number = ?";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, updateSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(updateSQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare update chunk state query: " + getLastError());
         return false;
@@ -916,7 +2089,7 @@ bool Database::updateChunkState(const std::string& fileId, int64_t chunkNumber,
     sqlite3_bind_int64(stmt, 3, chunkNumber);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to update chunk state: " + getLastError());
@@ -945,7 +2118,7 @@ std::vector<ChunkedFileInfo> Database::getIncompleteUploads() {
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, orphanedSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(orphanedSQL, &stmt);
     if (rc == SQLITE_OK) {
         std::vector<std::string> orphanedFileIds;
         while (sqlite3_step(stmt) == SQLITE_ROW) {
@@ -954,7 +2127,7 @@ std::vector<ChunkedFileInfo> Database::getIncompleteUploads() {
                 orphanedFileIds.push_back(fileId);
             }
         }
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         
         // Finalizar archivos huérfanos
         for (const auto& fileId : orphanedFileIds) {
@@ -966,7 +2139,7 @@ std::vector<ChunkedFileInfo> Database::getIncompleteUploads() {
     // Ahora buscar archivos realmente incompletos
     const char* querySQL = "SELECT file_id, original_filename, mime_type, total_size, total_chunks, completed_chunks, status, original_file_hash FROM chunked_files WHERE status IN ('uploading', 'paused', 'stopped', 'pending')";
     
-    rc = sqlite3_prepare_v2(m_db, querySQL, -1, &stmt, nullptr);
+    rc = prepareCached(querySQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare get incomplete uploads query: " + getLastError());
         return incompleteUploads;
@@ -993,7 +2166,7 @@ std::vector<ChunkedFileInfo> Database::getIncompleteUploads() {
         incompleteUploads.push_back(info);
     }
     
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     LOG_INFO("Found " + std::to_string(incompleteUploads.size()) + " incomplete uploads");
     return incompleteUploads;
 }
@@ -1009,7 +2182,7 @@ std::vector<int64_t> Database::getCompletedChunks(const std::string& fileId) {
     const char* querySQL = "SELECT chunk_number FROM file_chunks WHERE file_id = ? AND status = 'completed' ORDER BY chunk_number";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, querySQL, -1, &stmt, nullptr);
+    int rc = prepareCached(querySQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare get completed chunks query: " + getLastError());
         return completedChunks;
@@ -1021,7 +2194,7 @@ std::vector<int64_t> Database::getCompletedChunks(const std::string& fileId) {
         completedChunks.push_back(sqlite3_column_int64(stmt, 0));
     }
     
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     LOG_DEBUG("File " + fileId + " has " + std::to_string(completedChunks.size()) + " completed chunks");
     return completedChunks;
 }
@@ -1035,7 +2208,7 @@ bool Database::validateChunkIntegrity(const std::string& fileId, int64_t chunkNu
     const char* querySQL = "SELECT chunk_hash FROM file_chunks WHERE file_id = ? AND chunk_number = ? AND status = 'completed'";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, querySQL, -1, &stmt, nullptr);
+    int rc = prepareCached(querySQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare validate chunk query: " + getLastError());
         return false;
@@ -1054,11 +2227,12 @@ bool Database::validateChunkIntegrity(const std::string& fileId, int64_t chunkNu
         }
     }
     
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     return isValid;
 }
 
 bool Database::deleteUploadProgress(const std::string& fileId) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1068,7 +2242,7 @@ bool Database::deleteUploadProgress(const std::string& fileId) {
     const char* deleteSQL = "DELETE FROM chunked_files WHERE file_id = ?";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, deleteSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(deleteSQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare delete upload query: " + getLastError());
         return false;
@@ -1077,18 +2251,21 @@ bool Database::deleteUploadProgress(const std::string& fileId) {
     sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_STATIC);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to delete upload progress: " + getLastError());
         return false;
     }
     
+    deleteTransferBitmaps(fileId);
+    
     LOG_INFO("Deleted upload progress for: " + fileId);
     return true;
 }
 
 bool Database::updateUploadProgress(const std::string& fileId, int64_t completedChunks) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1097,7 +2274,7 @@ bool Database::updateUploadProgress(const std::string& fileId, int64_t completed
     const char* updateSQL = "UPDATE chunked_files SET completed_chunks = ?, last_update = CURRENT_TIMESTAMP WHERE file_id = ?";
     sqlite3_stmt* stmt;
     
-    int rc = sqlite3_prepare_v2(m_db, updateSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(updateSQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare update progress query: " + getLastError());
         return false;
@@ -1107,7 +2284,7 @@ bool Database::updateUploadProgress(const std::string& fileId, int64_t completed
     sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_STATIC);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to update upload progress: " + getLastError());
@@ -1118,6 +2295,7 @@ bool Database::updateUploadProgress(const std::string& fileId, int64_t completed
 }
 
 bool Database::markAllActiveUploadsAsPaused() {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1139,6 +2317,7 @@ bool Database::markAllActiveUploadsAsPaused() {
 }
 
 bool Database::finalizeChunkedFile(const std::string& fileId, const std::string& telegramFileId) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1157,7 +2336,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, checkSQL, -1, &stmt, nullptr);
+    int rc = prepareCached(checkSQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare check query: " + getLastError());
         return false;
@@ -1167,7 +2346,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
     
     if (sqlite3_step(stmt) != SQLITE_ROW) {
         LOG_ERROR("No chunked_files record found for: " + fileId);
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         return false;
     }
     
@@ -1181,7 +2360,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
     std::string status = statusPtr ? std::string(statusPtr) : "";
     int64_t completedCount = sqlite3_column_int64(stmt, 7);
     
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     // Verificar que todos los chunks estén completos
     if (completedCount < totalChunks) {
@@ -1195,7 +2374,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
     if (!alreadyCompleted) {
         const char* updateSQL = "UPDATE chunked_files SET status = 'completed', final_telegram_file_id = ?, last_update = CURRENT_TIMESTAMP WHERE file_id = ?";
         
-        rc = sqlite3_prepare_v2(m_db, updateSQL, -1, &stmt, nullptr);
+        rc = prepareCached(updateSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare update query: " + getLastError());
             return false;
@@ -1205,7 +2384,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
         sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_STATIC);
         
         rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         
         if (rc != SQLITE_DONE) {
             LOG_ERROR("Failed to update chunked_files status: " + getLastError());
@@ -1219,7 +2398,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
     
     // Verificar si ya existe en tabla 'files'
     const char* checkFileSQL = "SELECT 1 FROM files WHERE file_id = ?";
-    rc = sqlite3_prepare_v2(m_db, checkFileSQL, -1, &stmt, nullptr);
+    rc = prepareCached(checkFileSQL, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare check files query: " + getLastError());
         return false;
@@ -1227,7 +2406,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
     
     sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_STATIC);
     bool existsInFiles = (sqlite3_step(stmt) == SQLITE_ROW);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (!existsInFiles) {
         LOG_INFO("Creating entry in 'files' table for chunked file: " + fileId);
@@ -1242,7 +2421,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
             VALUES (?, ?, ?, ?, ?, NULL, ?, NULL, 0)
         )";
         
-        rc = sqlite3_prepare_v2(m_db, insertSQL, -1, &stmt, nullptr);
+        rc = prepareCached(insertSQL, &stmt);
         if (rc != SQLITE_OK) {
             LOG_ERROR("Failed to prepare insert files query: " + getLastError());
             return false;
@@ -1258,7 +2437,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
         sqlite3_bind_text(stmt, 6, finalTelegramFileId.c_str(), -1, SQLITE_TRANSIENT);
         
         rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        releaseStatement(stmt);
         
         if (rc != SQLITE_DONE) {
             LOG_ERROR("Failed to insert into files table: " + getLastError());
@@ -1272,14 +2451,14 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
         // Actualizar categoría y nombre de archivo con los valores correctos
         LOG_INFO("Updating file metadata for: " + fileId);
         const char* updateSQL = "UPDATE files SET category = 'chunked', file_name = ?, file_size = ?, mime_type = ? WHERE file_id = ?";
-        rc = sqlite3_prepare_v2(m_db, updateSQL, -1, &stmt, nullptr);
+        rc = prepareCached(updateSQL, &stmt);
         if (rc == SQLITE_OK) {
             sqlite3_bind_text(stmt, 1, originalFilename.c_str(), -1, SQLITE_TRANSIENT);
             sqlite3_bind_int64(stmt, 2, totalSize);
             sqlite3_bind_text(stmt, 3, mimeType.c_str(), -1, SQLITE_TRANSIENT);
             sqlite3_bind_text(stmt, 4, fileId.c_str(), -1, SQLITE_TRANSIENT);
             sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
+            releaseStatement(stmt);
             LOG_INFO("File metadata updated successfully");
         }
     }
@@ -1292,6 +2471,7 @@ bool Database::finalizeChunkedFile(const std::string& fileId, const std::string&
 // ============================================================================
 
 bool Database::registerDownload(const DownloadInfo& downloadInfo) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1305,7 +2485,7 @@ bool Database::registerDownload(const DownloadInfo& downloadInfo) {
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare register download query: " + getLastError());
         return false;
@@ -1322,7 +2502,7 @@ bool Database::registerDownload(const DownloadInfo& downloadInfo) {
     sqlite3_bind_text(stmt, 9, downloadInfo.tempDir.c_str(), -1, SQLITE_TRANSIENT);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to register download: " + getLastError());
@@ -1334,6 +2514,7 @@ bool Database::registerDownload(const DownloadInfo& downloadInfo) {
 }
 
 bool Database::updateDownloadState(const std::string& downloadId, const std::string& state) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1342,7 +2523,7 @@ bool Database::updateDownloadState(const std::string& downloadId, const std::str
     const char* sql = "UPDATE downloads SET status = ?, last_update = CURRENT_TIMESTAMP WHERE download_id = ?";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare update download state query: " + getLastError());
         return false;
@@ -1352,7 +2533,7 @@ bool Database::updateDownloadState(const std::string& downloadId, const std::str
     sqlite3_bind_text(stmt, 2, downloadId.c_str(), -1, SQLITE_TRANSIENT);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to update download state: " + getLastError());
@@ -1364,6 +2545,7 @@ bool Database::updateDownloadState(const std::string& downloadId, const std::str
 }
 
 bool Database::updateDownloadChunkState(const std::string& downloadId, int64_t chunkNumber, const std::string& state) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1377,7 +2559,7 @@ bool Database::updateDownloadChunkState(const std::string& downloadId, int64_t c
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare update download chunk state query: " + getLastError());
         return false;
@@ -1389,7 +2571,7 @@ bool Database::updateDownloadChunkState(const std::string& downloadId, int64_t c
     sqlite3_bind_text(stmt, 4, state.c_str(), -1, SQLITE_TRANSIENT);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to update download chunk state: " + getLastError());
@@ -1416,7 +2598,7 @@ std::vector<DownloadInfo> Database::getIncompleteDownloads() {
     )";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare get incomplete downloads query: " + getLastError());
         return downloads;
@@ -1438,7 +2620,7 @@ std::vector<DownloadInfo> Database::getIncompleteDownloads() {
         downloads.push_back(info);
     }
     
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     LOG_INFO("Found " + std::to_string(downloads.size()) + " incomplete downloads");
     
     return downloads;
@@ -1455,7 +2637,7 @@ std::vector<int64_t> Database::getCompletedDownloadChunks(const std::string& dow
     const char* sql = "SELECT chunk_number FROM download_chunks WHERE download_id = ? AND status = 'completed' ORDER BY chunk_number";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare get completed download chunks query: " + getLastError());
         return chunks;
@@ -1467,7 +2649,7 @@ std::vector<int64_t> Database::getCompletedDownloadChunks(const std::string& dow
         chunks.push_back(sqlite3_column_int64(stmt, 0));
     }
     
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     LOG_DEBUG("Found " + std::to_string(chunks.size()) + " completed download chunks for " + downloadId);
     
     return chunks;
@@ -1482,7 +2664,7 @@ bool Database::validateDownloadChunkExists(const std::string& downloadId, int64_
     const char* sql = "SELECT 1 FROM download_chunks WHERE download_id = ? AND chunk_number = ? AND status = 'completed'";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare validate download chunk query: " + getLastError());
         return false;
@@ -1492,12 +2674,13 @@ bool Database::validateDownloadChunkExists(const std::string& downloadId, int64_
     sqlite3_bind_int64(stmt, 2, chunkNumber);
     
     bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     return exists;
 }
 
 bool Database::deleteDownloadProgress(const std::string& downloadId) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1506,7 +2689,7 @@ bool Database::deleteDownloadProgress(const std::string& downloadId) {
     const char* sql = "DELETE FROM downloads WHERE download_id = ?";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare delete download query: " + getLastError());
         return false;
@@ -1515,18 +2698,21 @@ bool Database::deleteDownloadProgress(const std::string& downloadId) {
     sqlite3_bind_text(stmt, 1, downloadId.c_str(), -1, SQLITE_TRANSIENT);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to delete download progress: " + getLastError());
         return false;
     }
     
+    deleteTransferBitmaps(downloadId);
+    
     LOG_INFO("Download progress deleted: " + downloadId);
     return true;
 }
 
 bool Database::updateDownloadProgress(const std::string& downloadId, int64_t completedChunks) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1535,7 +2721,7 @@ bool Database::updateDownloadProgress(const std::string& downloadId, int64_t com
     const char* sql = "UPDATE downloads SET completed_chunks = ?, last_update = CURRENT_TIMESTAMP WHERE download_id = ?";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare update download progress query: " + getLastError());
         return false;
@@ -1545,7 +2731,7 @@ bool Database::updateDownloadProgress(const std::string& downloadId, int64_t com
     sqlite3_bind_text(stmt, 2, downloadId.c_str(), -1, SQLITE_TRANSIENT);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to update download progress: " + getLastError());
@@ -1555,7 +2741,101 @@ bool Database::updateDownloadProgress(const std::string& downloadId, int64_t com
     return true;
 }
 
+bool Database::saveTransferBitmap(const std::string& transferId, const std::string& kind, const std::string& bitmap) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    const char* sql = R"(
+        INSERT INTO transfer_bitmaps (transfer_id, kind, bitmap, last_updated)
+        VALUES (?, ?, ?, CURRENT_TIMESTAMP)
+        ON CONFLICT(transfer_id, kind)
+        DO UPDATE SET bitmap = excluded.bitmap, last_updated = CURRENT_TIMESTAMP
+    )";
+    
+    sqlite3_stmt* stmt;
+    int rc = prepareCached(sql, &stmt);
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare save transfer bitmap query: " + getLastError());
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, transferId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, kind.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 3, bitmap.data(), static_cast<int>(bitmap.size()), SQLITE_TRANSIENT);
+    
+    rc = sqlite3_step(stmt);
+    releaseStatement(stmt);
+    
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("Failed to save transfer bitmap: " + getLastError());
+        return false;
+    }
+    
+    return true;
+}
+
+std::string Database::loadTransferBitmap(const std::string& transferId, const std::string& kind) {
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return "";
+    }
+    
+    ReadConnectionPool::Lease reader = m_readers ? m_readers->acquire() : ReadConnectionPool::Lease();
+    
+    const char* sql = "SELECT bitmap FROM transfer_bitmaps WHERE transfer_id = ? AND kind = ?";
+    
+    sqlite3_stmt* stmt;
+    int rc = prepareRead(reader, sql, &stmt);
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare load transfer bitmap query: " + readError(reader));
+        return "";
+    }
+    
+    sqlite3_bind_text(stmt, 1, transferId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, kind.c_str(), -1, SQLITE_TRANSIENT);
+    
+    std::string bitmap;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void* data = sqlite3_column_blob(stmt, 0);
+        int size = sqlite3_column_bytes(stmt, 0);
+        if (data && size > 0) {
+            bitmap.assign(static_cast<const char*>(data), static_cast<size_t>(size));
+        }
+    }
+    
+    releaseRead(reader, stmt);
+    return bitmap;
+}
+
+bool Database::deleteTransferBitmaps(const std::string& transferId) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    const char* sql = "DELETE FROM transfer_bitmaps WHERE transfer_id = ?";
+    
+    sqlite3_stmt* stmt;
+    int rc = prepareCached(sql, &stmt);
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare delete transfer bitmaps query: " + getLastError());
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, transferId.c_str(), -1, SQLITE_TRANSIENT);
+    
+    rc = sqlite3_step(stmt);
+    releaseStatement(stmt);
+    
+    return rc == SQLITE_DONE;
+}
+
 bool Database::markAllActiveDownloadsAsPaused() {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
     if (!m_db) {
         LOG_ERROR("Database not initialized");
         return false;
@@ -1566,23 +2846,598 @@ bool Database::markAllActiveDownloadsAsPaused() {
     const char* sql = "UPDATE downloads SET status = 'paused', last_update = CURRENT_TIMESTAMP WHERE status = 'downloading'";
     
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
+    int rc = prepareCached(sql, &stmt);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Failed to prepare mark downloads as paused query: " + getLastError());
         return false;
     }
     
     rc = sqlite3_step(stmt);
-    // int changedRows = sqlite3_changes(m_db); // Not used
-    sqlite3_finalize(stmt);
+    releaseStatement(stmt);
     
     if (rc != SQLITE_DONE) {
         LOG_ERROR("Failed to mark downloads as paused: " + getLastError());
         return false;
     }
     
-    LOG_INFO("Marked " + std::to_string(changedRows) + " downloads as paused");
+    // sqlite3_changes sigue siendo el de este UPDATE: el lock de escritura está tomado
+    LOG_INFOF("Marked {} downloads as paused", sqlite3_changes(m_db));
+    return true;
+}
+
+// ============================================================================
+// Escrituras diferidas (group commit)
+// ============================================================================
+
+bool Database::runBatch(const std::vector<MetadataWriter::Operation>& operations) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    return MetadataWriter::runInTransaction(m_db, operations);
+}
+
+void Database::queueWrite(const std::string& coalesceKey, MetadataWriter::Operation operation) {
+    if (m_metadataWriter) {
+        m_metadataWriter->enqueue(coalesceKey, std::move(operation));
+    } else {
+        runBatch({operation});
+    }
+}
+
+void Database::queueChunkInfo(const ChunkInfo& chunkInfo) {
+    queueWrite(std::string(), [this, chunkInfo]() {
+        return saveChunkInfo(chunkInfo);
+    });
+}
+
+void Database::queueUploadCheckpoint(const std::string& fileId, const std::string& bitmap, int64_t completedChunks) {
+    queueWrite("upload:" + fileId, [this, fileId, bitmap, completedChunks]() {
+        return saveTransferBitmap(fileId, "uploaded", bitmap) &&
+               updateUploadProgress(fileId, completedChunks);
+    });
+}
+
+void Database::queueDownloadCheckpoint(const std::string& downloadId, const std::string& bitmap, int64_t completedChunks) {
+    queueWrite("download:" + downloadId, [this, downloadId, bitmap, completedChunks]() {
+        return saveTransferBitmap(downloadId, "verified", bitmap) &&
+               updateDownloadProgress(downloadId, completedChunks);
+    });
+}
+
+uint64_t Database::queuedWriteSequence() {
+    return m_metadataWriter ? m_metadataWriter->sequence() : 0;
+}
+
+bool Database::flushQueuedWrites(uint64_t since) {
+    if (m_metadataWriter) {
+        return m_metadataWriter->flush(since);
+    }
+    return true;
+}
+
+// ============================================================================
+// Caché de sentencias preparadas y configuración del journal
+// ============================================================================
+
+sqlite3* Database::openReadConnection() {
+    // Cada hilo usa su conexión en exclusiva (Lease): sin mutex de conexión
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(m_dbPath.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        LOG_WARNING("Failed to open read connection: " + std::string(db ? sqlite3_errmsg(db) : "out of memory"));
+        sqlite3_close(db);
+        return nullptr;
+    }
+    
+    if (m_isEncrypted) {
+        // Con la clave en bruto cada lector nuevo se ahorra el KDF
+        std::string pragmaSQL = keyPragma(m_rawKey.empty() ? m_encryptionKey : m_rawKey);
+        if (sqlite3_exec(db, pragmaSQL.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            LOG_WARNING("Failed to set encryption key on read connection");
+            sqlite3_close(db);
+            return nullptr;
+        }
+        applyCipherPragmas(db);
+    }
+    
+    if (sqlite3_exec(db, "SELECT count(*) FROM sqlite_master", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_WARNING("Read connection verification failed: " + std::string(sqlite3_errmsg(db)));
+        sqlite3_close(db);
+        return nullptr;
+    }
+    return db;
+}
+
+int Database::prepareRead(ReadConnectionPool::Lease& reader, const char* sql, sqlite3_stmt** stmt) {
+    return reader ? reader.prepare(sql, stmt) : prepareCached(sql, stmt);
+}
+
+void Database::releaseRead(ReadConnectionPool::Lease& reader, sqlite3_stmt* stmt) {
+    // Tiempo hasta la primera consulta del catálogo servida tras initialize()
+    if (!m_firstQueryDone.load(std::memory_order_relaxed) && !m_firstQueryDone.exchange(true)) {
+        m_firstQueryMillis = millisSince(m_initStart);
+        LOG_INFO("First catalog query completed " + std::to_string(m_firstQueryMillis.load()) + " ms after initialize");
+    }
+    if (reader) {
+        reader.release(stmt);
+    } else {
+        releaseStatement(stmt);
+    }
+}
+
+std::string Database::readError(const ReadConnectionPool::Lease& reader) const {
+    return reader ? std::string(sqlite3_errmsg(reader.db())) : getLastError();
+}
+
+int Database::prepareCached(const char* sql, sqlite3_stmt** stmt) {
+    {
+        std::lock_guard<std::mutex> lock(m_statementMutex);
+        auto it = m_statements.find(sql);
+        if (it == m_statements.end()) {
+            int rc = sqlite3_prepare_v3(m_db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, nullptr);
+            if (rc == SQLITE_OK) {
+                m_statements.emplace(sql, CachedStatement{*stmt, true});
+            }
+            return rc;
+        }
+        if (!it->second.inUse) {
+            it->second.inUse = true;
+            *stmt = it->second.stmt;
+            return SQLITE_OK;
+        }
+    }
+    // Otro hilo la está usando: sentencia temporal
+    return sqlite3_prepare_v2(m_db, sql, -1, stmt, nullptr);
+}
+
+void Database::releaseStatement(sqlite3_stmt* stmt) {
+    if (!stmt) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_statementMutex);
+        const char* sql = sqlite3_sql(stmt);
+        auto it = m_statements.find(sql ? sql : "");
+        if (it != m_statements.end() && it->second.stmt == stmt) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            it->second.inUse = false;
+            return;
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+void Database::clearStatementCache() {
+    std::lock_guard<std::mutex> lock(m_statementMutex);
+    for (auto& entry : m_statements) {
+        sqlite3_finalize(entry.second.stmt);
+    }
+    m_statements.clear();
+}
+
+std::string Database::pragmaValue(const char* pragma) {
+    std::string value;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, pragma, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            value = text ? text : "";
+        }
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+bool Database::configureJournal() {
+    // WAL: cada commit es un append secuencial y los lectores no bloquean al escritor
+    std::string mode = pragmaValue("PRAGMA journal_mode = WAL");
+    if (mode != "wal") {
+        LOG_WARNING("WAL journal mode not available, using: " + mode);
+        return false;
+    }
+    
+    // En WAL, NORMAL solo sincroniza en los checkpoints y sigue siendo a prueba
+    // de corrupción; lo último confirmado puede perderse ante un corte de luz
+    const char* journalPragmas[] = {
+        "PRAGMA synchronous = NORMAL",
+        "PRAGMA wal_autocheckpoint = 1000",         // ~4 MB con páginas de 4 KB
+        "PRAGMA journal_size_limit = 8388608"       // truncar el WAL tras cada checkpoint
+    };
+    for (const char* pragma : journalPragmas) {
+        sqlite3_exec(m_db, pragma, nullptr, nullptr, nullptr);
+    }
+    
+    LOG_INFO("Database journal configured: WAL, synchronous=NORMAL");
+    return true;
+}
+
+std::string CatalogStats::toJson() const {
+    auto counters = [](std::ostringstream& oss, const char* name, const std::vector<StatsCounter>& list) {
+        oss << ",\"" << name << "\":[";
+        for (size_t i = 0; i < list.size(); i++) {
+            oss << (i ? "," : "") << "{\"key\":\"" << jsonEscape(list[i].key) << "\""
+                << ",\"items\":" << list[i].items << ",\"bytes\":" << list[i].bytes << "}";
+        }
+        oss << "]";
+    };
+    
+    std::ostringstream oss;
+    oss << "{\"totalFiles\":" << totalFiles
+        << ",\"totalBytes\":" << totalBytes
+        << ",\"totalChunks\":" << totalChunks
+        << ",\"chunkBytes\":" << chunkBytes;
+    counters(oss, "categories", categories);
+    counters(oss, "mimeTypes", mimeTypes);
+    counters(oss, "bots", bots);
+    oss << "}";
+    return oss.str();
+}
+
+std::string DatabaseStartupTiming::toJson() const {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << "{\"openMillis\":" << openMillis
+        << ",\"keyMillis\":" << keyMillis
+        << ",\"schemaMillis\":" << schemaMillis
+        << ",\"readyMillis\":" << readyMillis
+        << ",\"firstQueryMillis\":" << firstQueryMillis
+        << ",\"rawKey\":" << (rawKey ? "true" : "false") << "}";
+    return oss.str();
+}
+
+// ============================================================================
+// Diario de cambios (backups incrementales)
+// ============================================================================
+
+bool Database::setupChangeJournal() {
+    // Una fila por registro modificado con la secuencia de su último cambio;
+    // el contador es monótono aunque se borren filas del diario
+    std::string sql =
+        "CREATE TABLE IF NOT EXISTS change_journal ("
+        "tbl TEXT NOT NULL,"
+        "row_id INTEGER NOT NULL,"
+        "seq INTEGER NOT NULL,"
+        "PRIMARY KEY (tbl, row_id));"
+        "CREATE INDEX IF NOT EXISTS idx_change_journal_seq ON change_journal(seq);"
+        "CREATE TABLE IF NOT EXISTS change_counter ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "seq INTEGER NOT NULL);"
+        "INSERT OR IGNORE INTO change_counter (id, seq) VALUES (1, 0);"
+        "CREATE TABLE IF NOT EXISTS backup_checkpoint ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "chain_id TEXT NOT NULL,"
+        "seq INTEGER NOT NULL);";
+    
+    for (const char* table : JOURNALED_TABLES) {
+        sql += journalTriggersSql(table, "");
+    }
+    
+    return executeQuery(sql);
+}
+
+bool Database::narrowChangeJournal() {
+    // Las tablas de transferencias se escriben en cada chunk y no forman
+    // parte de un backup: fuera del diario
+    std::string sql;
+    for (const char* table : UNJOURNALED_TABLES) {
+        for (const auto& event : JOURNAL_EVENTS) {
+            sql += std::string("DROP TRIGGER IF EXISTS trg_journal_") + table + "_" + event[0] + ";";
+        }
+        sql += std::string("DELETE FROM change_journal WHERE tbl = '") + table + "';";
+    }
+    
+    // Sin cadena de backups el diario no lo lee nadie: solo se registra
+    // mientras change_counter.enabled = 1 (lo activa el primer backup completo)
+    sql += "ALTER TABLE change_counter ADD COLUMN enabled INTEGER NOT NULL DEFAULT 0;"
+           "UPDATE change_counter SET enabled = EXISTS (SELECT 1 FROM backup_checkpoint) WHERE id = 1;"
+           "DELETE FROM change_journal WHERE NOT EXISTS (SELECT 1 FROM backup_checkpoint);";
+    for (const char* table : JOURNALED_TABLES) {
+        for (const auto& event : JOURNAL_EVENTS) {
+            sql += std::string("DROP TRIGGER IF EXISTS trg_journal_") + table + "_" + event[0] + ";";
+        }
+        sql += journalTriggersSql(table, "(SELECT enabled FROM change_counter WHERE id = 1) = 1");
+    }
+    
+    return executeQuery(sql);
+}
+
+bool Database::enableChangeJournal() {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    return executeQuery("UPDATE change_counter SET enabled = 1 WHERE id = 1");
+}
+
+int64_t Database::getChangeSeq() {
+    if (!m_db) {
+        return -1;
+    }
+    
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT seq FROM change_counter WHERE id = 1", -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare change sequence query: " + getLastError());
+        return -1;
+    }
+    
+    int64_t seq = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        seq = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return seq;
+}
+
+bool Database::attachDelta(const std::string& deltaPath) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "ATTACH DATABASE ? AS delta KEY ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare delta attach: " + getLastError());
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, deltaPath.c_str(), -1, SQLITE_TRANSIENT);
+    // El delta se cifra con la misma clave que la base principal
+    sqlite3_bind_text(stmt, 2, m_isEncrypted ? m_encryptionKey.c_str() : "", -1, SQLITE_TRANSIENT);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("Failed to attach delta database: " + getLastError());
+        return false;
+    }
+    
+    if (m_isEncrypted) {
+        applyCipherPragmas(m_db, "delta.");
+    }
+    return true;
+}
+
+void Database::detachDelta() {
+    sqlite3_exec(m_db, "DETACH DATABASE delta", nullptr, nullptr, nullptr);
+}
+
+bool Database::exportChangesSince(int64_t sinceSeq, const std::string& deltaPath, int64_t& toSeq) {
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    std::error_code ec;
+    std::filesystem::remove(deltaPath, ec);
+    
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!attachDelta(deltaPath)) {
+        return false;
+    }
+    
+    // Una sola transacción: la secuencia y las filas exportadas son coherentes
+    const std::string since = std::to_string(sinceSeq);
+    std::string sql =
+        "BEGIN;"
+        "CREATE TABLE delta.delta_info AS SELECT " + since + " AS from_seq, seq AS to_seq "
+        "FROM main.change_counter WHERE id = 1;"
+        "CREATE TABLE delta.deleted_rows (tbl TEXT NOT NULL, row_id INTEGER NOT NULL);";
+    
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &errMsg);
+    
+    for (const char* table : JOURNALED_TABLES) {
+        if (rc != SQLITE_OK) break;
+        const std::string t(table);
+        const std::string changed =
+            "SELECT row_id FROM main.change_journal WHERE tbl = '" + t + "' AND seq > " + since;
+        
+        // Las tablas sin cambios no se crean: cada una ocuparía al menos una página
+        bool hasChanges = false;
+        sqlite3_stmt* stmt;
+        std::string existsSql = "SELECT EXISTS (" + changed + ")";
+        if (sqlite3_prepare_v2(m_db, existsSql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            hasChanges = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) != 0;
+            sqlite3_finalize(stmt);
+        }
+        if (!hasChanges) continue;
+        
+        sql = "CREATE TABLE delta." + t + " AS SELECT rowid AS _rowid, * FROM main." + t +
+              " WHERE rowid IN (" + changed + ");"
+              "INSERT INTO delta.deleted_rows (tbl, row_id) SELECT '" + t + "', row_id FROM (" + changed +
+              ") WHERE row_id NOT IN (SELECT rowid FROM main." + t + ");";
+        rc = sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &errMsg);
+    }
+    
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, &errMsg);
+    }
+    
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to export changes: " + std::string(errMsg ? errMsg : "unknown"));
+        sqlite3_free(errMsg);
+        sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
+        detachDelta();
+        std::filesystem::remove(deltaPath, ec);
+        return false;
+    }
+    
+    toSeq = -1;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT to_seq FROM delta.delta_info", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            toSeq = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    detachDelta();
+    
+    LOG_INFO("Exported changes " + since + ".." + std::to_string(toSeq) + " to " + deltaPath);
+    return toSeq >= 0;
+}
+
+bool Database::applyChanges(const std::string& deltaPath) {
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!attachDelta(deltaPath)) {
+        return false;
+    }
+    
+    // REPLACE borra la fila en conflicto; sin esto ON DELETE CASCADE se
+    // llevaría los chunks de un chunked_files reescrito
+    sqlite3_exec(m_db, "PRAGMA foreign_keys = OFF", nullptr, nullptr, nullptr);
+    
+    std::string sql = "BEGIN;";
+    for (const char* table : JOURNALED_TABLES) {
+        const std::string t(table);
+        sql += "DELETE FROM main." + t + " WHERE rowid IN "
+               "(SELECT row_id FROM delta.deleted_rows WHERE tbl = '" + t + "');";
+    }
+    
+    for (const char* table : JOURNALED_TABLES) {
+        const std::string t(table);
+        
+        // Columnas comunes a ambas versiones de la tabla
+        std::string columns;
+        sqlite3_stmt* stmt;
+        std::string infoSql = "SELECT name FROM pragma_table_info('" + t + "', 'delta') "
+                              "WHERE name != '_rowid' AND name IN "
+                              "(SELECT name FROM pragma_table_info('" + t + "', 'main'))";
+        if (sqlite3_prepare_v2(m_db, infoSql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+                columns += std::string(", \"") + name + "\"";
+            }
+            sqlite3_finalize(stmt);
+        }
+        if (columns.empty()) {
+            continue;
+        }
+        
+        // Borrado explícito antes de reinsertar: REPLACE no dispara los triggers
+        // de DELETE y el índice de búsqueda (files_fts) se quedaría con la fila vieja
+        sql += "DELETE FROM main." + t + " WHERE rowid IN (SELECT _rowid FROM delta." + t + ");"
+               "INSERT OR REPLACE INTO main." + t + " (rowid" + columns + ") "
+               "SELECT _rowid" + columns + " FROM delta." + t + ";";
+    }
+    sql += "COMMIT;";
+    
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &errMsg);
+    bool ok = (rc == SQLITE_OK);
+    if (!ok) {
+        LOG_ERROR("Failed to apply changes from " + deltaPath + ": " + std::string(errMsg ? errMsg : "unknown"));
+        sqlite3_free(errMsg);
+        sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+    
+    sqlite3_exec(m_db, "PRAGMA foreign_keys = ON", nullptr, nullptr, nullptr);
+    detachDelta();
+    
+    if (ok) {
+        LOG_INFO("Applied changes from " + deltaPath);
+    }
+    return ok;
+}
+
+bool Database::replayPendingChanges() {
+    namespace fs = std::filesystem;
+    
+    const fs::path dir = pendingChangesDir();
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        return true;
+    }
+    
+    std::vector<fs::path> deltas;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".delta") {
+            deltas.push_back(entry.path());
+        }
+    }
+    // Los nombres llevan la secuencia con ceros a la izquierda
+    std::sort(deltas.begin(), deltas.end());
+    
+    LOG_INFO("Replaying " + std::to_string(deltas.size()) + " pending backup deltas");
+    for (const auto& delta : deltas) {
+        if (!applyChanges(delta.string())) {
+            // Se conservan para reintentar en el próximo arranque
+            return false;
+        }
+        fs::remove(delta, ec);
+    }
+    
+    fs::remove_all(dir, ec);
+    // La base restaurada empieza una cadena nueva con el próximo backup completo
+    clearBackupCheckpoint();
+    return true;
+}
+
+std::string Database::pendingChangesDir() const {
+    return pendingChangesDir(m_dbPath);
+}
+
+std::string Database::pendingChangesDir(const std::string& dbPath) {
+    return dbPath + ".deltas";
+}
+
+bool Database::getBackupCheckpoint(std::string& chainId, int64_t& seq) {
+    if (!m_db) {
+        return false;
+    }
+    
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT chain_id, seq FROM backup_checkpoint WHERE id = 1", -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare backup checkpoint query: " + getLastError());
+        return false;
+    }
+    
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* chain = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        chainId = chain ? chain : "";
+        seq = sqlite3_column_int64(stmt, 1);
+        found = !chainId.empty();
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+bool Database::setBackupCheckpoint(const std::string& chainId, int64_t seq) {
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    if (!m_db) {
+        LOG_ERROR("Database not initialized");
+        return false;
+    }
+    
+    sqlite3_stmt* stmt;
+    const char* sql = "INSERT OR REPLACE INTO backup_checkpoint (id, chain_id, seq) VALUES (1, ?, ?)";
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("Failed to prepare backup checkpoint update: " + getLastError());
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, chainId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, seq);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("Failed to update backup checkpoint: " + getLastError());
+        return false;
+    }
+    
+    // El diario anterior al checkpoint ya está en algún backup
+    std::string prune = "DELETE FROM change_journal WHERE seq <= " + std::to_string(seq);
+    sqlite3_exec(m_db, prune.c_str(), nullptr, nullptr, nullptr);
     return true;
 }
 
+bool Database::clearBackupCheckpoint() {
+    // Sin cadena el diario deja de registrar hasta el próximo backup completo
+    std::lock_guard<std::recursive_mutex> writeLock(m_writeMutex);
+    return executeQuery(
+        "DELETE FROM backup_checkpoint;"
+        "UPDATE change_counter SET enabled = 0 WHERE id = 1;"
+        "DELETE FROM change_journal;");
+}
+
 } // namespace TelegramCloud
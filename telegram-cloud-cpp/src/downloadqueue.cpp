@@ -0,0 +1,191 @@
+#include "downloadqueue.h"
+#include "logger.h"
+#include <algorithm>
+
+namespace TelegramCloud {
+
+DownloadQueue::DownloadQueue(int maxInFlight, int perTokenLimit, bool stopOnFailure)
+    : m_maxInFlight(std::max(1, maxInFlight))
+    , m_perTokenLimit(perTokenLimit)
+    , m_stopOnFailure(stopOnFailure)
+    , m_pendingCount(0)
+    , m_inFlight(0)
+    , m_shutdown(false)
+    , m_failed(false)
+    , m_dropped(false) {
+}
+
+DownloadQueue::~DownloadQueue() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+        dropPendingLocked();
+    }
+    m_workAvailable.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void DownloadQueue::submit(const std::string& token, Task task) {
+    bool becameReady = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        TokenQueue& queue = m_tokens[token];
+        queue.token = token;
+        queue.pending.push_back(std::move(task));
+        m_pendingCount++;
+
+        if (!queue.ready && hasRoomLocked(queue)) {
+            markReadyLocked(queue);
+            becameReady = true;
+        }
+
+        // Los workers se crean bajo demanda hasta llenar la ventana
+        if (static_cast<int>(m_workers.size()) < m_maxInFlight &&
+            m_workers.size() < m_pendingCount + static_cast<size_t>(m_inFlight.load())) {
+            m_workers.emplace_back(&DownloadQueue::workerLoop, this);
+        }
+    }
+    if (becameReady) {
+        m_workAvailable.notify_one();
+    }
+}
+
+void DownloadQueue::cancelPending() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        dropPendingLocked();
+    }
+    m_idle.notify_all();
+}
+
+bool DownloadQueue::hasRoomLocked(const TokenQueue& queue) const {
+    return m_perTokenLimit <= 0 || queue.active < m_perTokenLimit;
+}
+
+void DownloadQueue::markReadyLocked(TokenQueue& queue) {
+    queue.ready = true;
+    m_ready.push_back(&queue);
+}
+
+DownloadQueue::TokenQueue* DownloadQueue::takeNextLocked(Task& out) {
+    if (m_ready.empty()) {
+        return nullptr;
+    }
+
+    TokenQueue* queue = m_ready.front();
+    m_ready.pop_front();
+    queue->ready = false;
+
+    out = std::move(queue->pending.front());
+    queue->pending.pop_front();
+    queue->active++;
+    m_pendingCount--;
+
+    // Turno rotatorio: si aún le quedan tareas y slots, vuelve al final
+    if (!queue->pending.empty() && hasRoomLocked(*queue)) {
+        markReadyLocked(*queue);
+    }
+    return queue;
+}
+
+void DownloadQueue::dropPendingLocked() {
+    if (m_pendingCount > 0) {
+        m_dropped = true;
+    }
+    m_ready.clear();
+    m_pendingCount = 0;
+
+    // Las colas con tareas en vuelo se conservan: su worker las actualiza al terminar
+    for (auto it = m_tokens.begin(); it != m_tokens.end();) {
+        it->second.pending.clear();
+        it->second.ready = false;
+        if (it->second.active == 0) {
+            it = m_tokens.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DownloadQueue::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_workAvailable.wait(lock, [this] {
+            return m_shutdown || !m_ready.empty();
+        });
+        if (m_shutdown) {
+            return;
+        }
+
+        // Pausa/cancelación: no arrancar nada más
+        if (m_stopPredicate && m_stopPredicate()) {
+            dropPendingLocked();
+            m_idle.notify_all();
+            continue;
+        }
+
+        Task task;
+        TokenQueue* queue = takeNextLocked(task);
+        m_inFlight++;
+        bool moreReady = !m_ready.empty();
+        lock.unlock();
+
+        // Despertar en cadena: cada worker que arranca despierta a uno más
+        if (moreReady) {
+            m_workAvailable.notify_one();
+        }
+
+        bool ok = false;
+        try {
+            ok = task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Download task threw: " + std::string(e.what()));
+        }
+
+        lock.lock();
+        // Descartar antes de soltar el slot: la cola de este token sigue viva
+        if (!ok) {
+            m_failed = true;
+            if (m_stopOnFailure) {
+                dropPendingLocked();
+            }
+        }
+        m_inFlight--;
+        queue->active--;
+
+        // El slot liberado puede volver a poner el token en la lista de listos;
+        // este mismo worker la atiende en la siguiente vuelta
+        if (!queue->pending.empty() && !queue->ready && hasRoomLocked(*queue)) {
+            markReadyLocked(*queue);
+        } else if (queue->pending.empty() && queue->active == 0) {
+            std::string token = queue->token;
+            m_tokens.erase(token);
+        }
+
+        m_idle.notify_all();
+    }
+}
+
+bool DownloadQueue::waitForRoom(size_t maxPending) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&] {
+        return m_pendingCount < std::max<size_t>(maxPending, 1) || (m_stopOnFailure && m_failed);
+    });
+    return !(m_stopOnFailure && m_failed);
+}
+
+bool DownloadQueue::waitAll() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] {
+        return m_pendingCount == 0 && m_inFlight.load() == 0;
+    });
+    return !m_failed && !m_dropped;
+}
+
+} // namespace TelegramCloud
@@ -1,10 +1,10 @@
 #include "envmanager.h"
 #include "obfuscated_strings.h"
 #include "anti_debug.h"
+#include "cryptoengine.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <iomanip>
 #include <algorithm>
 #include <cstring>
 #include <openssl/evp.h>
@@ -80,19 +80,7 @@ bool EnvManager::load() {
         }
         
         // Derivar clave del hash del contenido
-        std::vector<unsigned char> key(KEY_SIZE);
-        const unsigned char* salt = reinterpret_cast<const unsigned char*>("TELEGRAM_CLOUD_SALT");
-        
-        PKCS5_PBKDF2_HMAC(
-            contentHash.c_str(),
-            contentHash.length(),
-            salt,
-            19,
-            PBKDF2_ITERATIONS,
-            EVP_sha256(),
-            KEY_SIZE,
-            key.data()
-        );
+        std::vector<unsigned char> key = deriveKeyFromSeed(contentHash);
         
         // Desencriptar
         std::string plaintext = decrypt(ciphertext, key, iv);
@@ -117,19 +105,7 @@ bool EnvManager::save() {
         std::string contentHash = sha256(plaintext);
         
         // Derivar clave del hash del contenido
-        std::vector<unsigned char> key(KEY_SIZE);
-        const unsigned char* salt = reinterpret_cast<const unsigned char*>("TELEGRAM_CLOUD_SALT");
-        
-        PKCS5_PBKDF2_HMAC(
-            contentHash.c_str(),
-            contentHash.length(),
-            salt,
-            19,
-            PBKDF2_ITERATIONS,
-            EVP_sha256(),
-            KEY_SIZE,
-            key.data()
-        );
+        std::vector<unsigned char> key = deriveKeyFromSeed(contentHash);
         
         // Generar IV aleatorio
         std::vector<unsigned char> iv(IV_SIZE);
@@ -284,60 +260,32 @@ std::vector<unsigned char> EnvManager::deriveMasterKey() const {
     }
     
     // Derivar clave usando PBKDF2-SHA256
-    std::vector<unsigned char> key(KEY_SIZE);
-    const unsigned char* salt = reinterpret_cast<const unsigned char*>("TELEGRAM_CLOUD_SALT");
-    
-    PKCS5_PBKDF2_HMAC(
-        seed.c_str(),
-        seed.length(),
-        salt,
-        19, // longitud de "TELEGRAM_CLOUD_SALT"
-        PBKDF2_ITERATIONS,
-        EVP_sha256(),
-        KEY_SIZE,
-        key.data()
-    );
+    std::vector<unsigned char> key = deriveKeyFromSeed(seed);
     
     return key;
 }
 
+std::vector<unsigned char> EnvManager::deriveKeyFromSeed(const std::string& seed) const {
+    // Salt fijo: la clave depende solo de la semilla (formato existente)
+    std::string key = CryptoEngine::deriveKeyPbkdf2Cached(seed, "TELEGRAM_CLOUD_SALT", PBKDF2_ITERATIONS);
+    SecretWipe wipeKey(key);
+    return std::vector<unsigned char>(key.begin(), key.end());
+}
+
 std::vector<unsigned char> EnvManager::encrypt(
     const std::string& plaintext,
     const std::vector<unsigned char>& key,
     const std::vector<unsigned char>& iv
 ) const {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Error al crear contexto de encriptación");
-    }
-    
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.data(), iv.data()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Error al inicializar encriptación");
-    }
-    
-    std::vector<unsigned char> ciphertext(plaintext.length() + EVP_CIPHER_block_size(EVP_aes_256_cbc()));
-    int len = 0;
-    int ciphertext_len = 0;
-    
-    if (EVP_EncryptUpdate(ctx, ciphertext.data(), &len,
-                          reinterpret_cast<const unsigned char*>(plaintext.data()),
-                          plaintext.length()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Error al encriptar datos");
-    }
-    ciphertext_len = len;
-    
-    if (EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Error al finalizar encriptación");
+    std::string ciphertext;
+    try {
+        ciphertext = CryptoEngine::encrypt(plaintext,
+                                           std::string(key.begin(), key.end()),
+                                           std::string(iv.begin(), iv.end()));
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string("Error al encriptar datos: ") + e.what());
     }
-    ciphertext_len += len;
-    
-    EVP_CIPHER_CTX_free(ctx);
-    
-    ciphertext.resize(ciphertext_len);
-    return ciphertext;
+    return std::vector<unsigned char>(ciphertext.begin(), ciphertext.end());
 }
 
 std::string EnvManager::decrypt(
@@ -345,35 +293,13 @@ std::string EnvManager::decrypt(
     const std::vector<unsigned char>& key,
     const std::vector<unsigned char>& iv
 ) const {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Error al crear contexto de desencriptación");
-    }
-    
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.data(), iv.data()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Error al inicializar desencriptación");
-    }
-    
-    std::vector<unsigned char> plaintext(ciphertext.size() + EVP_CIPHER_block_size(EVP_aes_256_cbc()));
-    int len = 0;
-    int plaintext_len = 0;
-    
-    if (EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext.data(), ciphertext.size()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Error al desencriptar datos");
-    }
-    plaintext_len = len;
-    
-    if (EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Error al finalizar desencriptación");
+    try {
+        return CryptoEngine::decrypt(std::string(ciphertext.begin(), ciphertext.end()),
+                                     std::string(key.begin(), key.end()),
+                                     std::string(iv.begin(), iv.end()));
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string("Error al desencriptar datos: ") + e.what());
     }
-    plaintext_len += len;
-    
-    EVP_CIPHER_CTX_free(ctx);
-    
-    return std::string(reinterpret_cast<char*>(plaintext.data()), plaintext_len);
 }
 
 std::string EnvManager::serialize() const {
@@ -412,37 +338,8 @@ void EnvManager::deserialize(const std::string& data) {
 }
 
 std::string EnvManager::sha256(const std::string& data) const {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    
-    // Use OpenSSL 3.x EVP API instead of deprecated SHA256_* functions
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (mdctx == nullptr) {
-        throw std::runtime_error("Failed to create EVP_MD_CTX");
-    }
-    
-    if (EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr) != 1 ||
-        EVP_DigestUpdate(mdctx, data.c_str(), data.length()) != 1 ||
-        EVP_DigestFinal_ex(mdctx, hash, nullptr) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("SHA256 digest failed");
-    }
-    
-    EVP_MD_CTX_free(mdctx);
-    
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
-    }
-    
-    return ss.str();
-}
-
-std::string EnvManager::toHex(const std::vector<unsigned char>& data) const {
-    std::stringstream ss;
-    for (unsigned char byte : data) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
-    }
-    return ss.str();
+    std::string digest = CryptoEngine::sha256(data);
+    return CryptoEngine::toHex(digest);
 }
 
 std::vector<unsigned char> EnvManager::fromHex(const std::string& hex) const {
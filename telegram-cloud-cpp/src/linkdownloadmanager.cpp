@@ -1,10 +1,12 @@
 #include "linkdownloadmanager.h"
 #include "logger.h"
+#include "chunkintegrity.h"
+#include "downloadqueue.h"
+#include "config.h"
+#include "cryptoengine.h"
+#include "linkformat.h"
 #include <openssl/rand.h>
-#include <openssl/evp.h>
-#include <openssl/aes.h>
 #include <sstream>
-#include <iomanip>
 #include <fstream>
 #include <filesystem>
 #include <future>
@@ -47,13 +49,7 @@ std::string LinkDownloadManager::generateDownloadId() {
         return "";
     }
     
-    std::stringstream ss;
-    ss << "linkdl_";
-    for (int i = 0; i < 16; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)bytes[i];
-    }
-    
-    return ss.str();
+    return "linkdl_" + CryptoEngine::toHex(bytes, sizeof(bytes));
 }
 
 bool LinkDownloadManager::parseLinkData(
@@ -66,106 +62,32 @@ bool LinkDownloadManager::parseLinkData(
     std::vector<ChunkInfo>& chunks,
     std::string& telegramFileId
 ) {
-    // Parser JSON simple
-    auto extractString = [&shareData](const std::string& key) -> std::string {
-        size_t pos = shareData.find("\"" + key + "\":\"");
-        if (pos == std::string::npos) return "";
-        pos += key.length() + 4;
-        size_t end = shareData.find("\"", pos);
-        return shareData.substr(pos, end - pos);
-    };
-    
-    auto extractNumber = [&shareData](const std::string& key) -> int64_t {
-        size_t pos = shareData.find("\"" + key + "\":");
-        if (pos == std::string::npos) return 0;
-        pos += key.length() + 3;
-        size_t end = shareData.find_first_of(",}", pos);
-        std::string numStr = shareData.substr(pos, end - pos);
-        try {
-            return std::stoll(numStr);
-        } catch (...) {
-            return 0;
-        }
-    };
-    
-    auto extractBool = [&shareData](const std::string& key) -> bool {
-        size_t pos = shareData.find("\"" + key + "\":");
-        if (pos == std::string::npos) return false;
-        pos += key.length() + 3;
-        return shareData.substr(pos, 4) == "true";
-    };
-    
-    // Extraer datos básicos
-    fileId = extractString("file_id");
-    fileName = extractString("filename");
-    fileType = extractString("type");
-    fileSize = extractNumber("size");
-    isEncrypted = extractBool("encrypted");
+    // Una sola pasada sobre el JSON (LinkReader::parseShareJson)
+    FileInfo fileInfo;
+    chunks.clear();
+    if (!LinkReader::parseShareJson(shareData, fileInfo, chunks, fileType)) {
+        LOG_ERROR("Failed to parse basic link data");
+        return false;
+    }
+    
+    fileId = fileInfo.fileId;
+    fileName = fileInfo.fileName;
+    fileSize = fileInfo.fileSize;
+    isEncrypted = fileInfo.isEncrypted;
     
     if (fileId.empty() || fileType.empty()) {
         LOG_ERROR("Failed to parse basic link data");
         return false;
     }
     
-    // Parsear chunks si es chunked
     if (fileType == "chunked") {
-        size_t chunksPos = shareData.find("\"chunks\":[");
-        if (chunksPos == std::string::npos) {
+        if (chunks.empty()) {
             LOG_ERROR("Chunked file but no chunks data");
             return false;
         }
-        
-        chunksPos += 10;
-        size_t chunksEnd = shareData.find("]", chunksPos);
-        std::string chunksData = shareData.substr(chunksPos, chunksEnd - chunksPos);
-        
-        size_t pos = 0;
-        while (pos < chunksData.length()) {
-            size_t chunkStart = chunksData.find("{", pos);
-            if (chunkStart == std::string::npos) break;
-            
-            size_t chunkEnd = chunksData.find("}", chunkStart);
-            if (chunkEnd == std::string::npos) break;
-            
-            std::string chunkStr = chunksData.substr(chunkStart, chunkEnd - chunkStart + 1);
-            
-            ChunkInfo chunk;
-            
-            size_t nPos = chunkStr.find("\"n\":");
-            if (nPos != std::string::npos) {
-                nPos += 4;
-                size_t nEnd = chunkStr.find_first_of(",}", nPos);
-                chunk.chunkNumber = std::stoi(chunkStr.substr(nPos, nEnd - nPos));
-            }
-            
-            size_t tidPos = chunkStr.find("\"tid\":\"");
-            if (tidPos != std::string::npos) {
-                tidPos += 7;
-                size_t tidEnd = chunkStr.find("\"", tidPos);
-                chunk.telegramFileId = chunkStr.substr(tidPos, tidEnd - tidPos);
-            }
-            
-            size_t sPos = chunkStr.find("\"s\":");
-            if (sPos != std::string::npos) {
-                sPos += 4;
-                size_t sEnd = chunkStr.find_first_of(",}", sPos);
-                chunk.chunkSize = std::stoll(chunkStr.substr(sPos, sEnd - sPos));
-            }
-            
-            size_t hPos = chunkStr.find("\"h\":\"");
-            if (hPos != std::string::npos) {
-                hPos += 5;
-                size_t hEnd = chunkStr.find("\"", hPos);
-                chunk.chunkHash = chunkStr.substr(hPos, hEnd - hPos);
-            }
-            
-            chunks.push_back(chunk);
-            pos = chunkEnd + 1;
-        }
-        
         LOG_INFO("Parsed " + std::to_string(chunks.size()) + " chunks from link data");
     } else if (fileType == "direct") {
-        telegramFileId = extractString("telegram_file_id");
+        telegramFileId = fileInfo.telegramFileId;
         if (telegramFileId.empty()) {
             LOG_ERROR("Direct file but no telegram_file_id");
             return false;
@@ -310,61 +232,42 @@ bool LinkDownloadManager::downloadChunkedFile(
     std::atomic<int> downloadedChunks(info.completedChunks);
     int totalChunks = chunks.size();
     
-    const int MAX_CONCURRENT = 5;
-    bool allSuccess = true;
+    // Ventana de descargas en vuelo; se detiene al primer chunk fallido
+    Config& config = Config::instance();
+    DownloadQueue queue(config.downloadMaxInFlight(), config.downloadPerTokenLimit(), true);
     
-    for (size_t i = 0; i < chunks.size(); i += MAX_CONCURRENT) {
-        std::vector<std::future<bool>> futures;
-        size_t batchEnd = std::min(i + MAX_CONCURRENT, chunks.size());
+    for (const auto& chunk : chunks) {
+        // Verificar si este chunk ya existe
+        std::string chunkPath = tempDir + "/chunk_" + std::to_string(chunk.chunkNumber) + ".tmp";
+        if (std::filesystem::exists(chunkPath)) {
+            downloadedChunks++;
+            continue;
+        }
         
-        for (size_t j = i; j < batchEnd; j++) {
-            const ChunkInfo& chunk = chunks[j];
-            
-            // Verificar si este chunk ya existe
+        queue.submit(chunk.uploaderBotToken, [this, chunk, tempDir, &downloadedChunks, totalChunks, downloadId, progressCallback]() {
             std::string chunkPath = tempDir + "/chunk_" + std::to_string(chunk.chunkNumber) + ".tmp";
-            if (std::filesystem::exists(chunkPath)) {
-                downloadedChunks++;
-                continue;
-            }
             
-            auto future = std::async(std::launch::async, [this, chunk, tempDir, &downloadedChunks, totalChunks, downloadId, progressCallback]() {
-                std::string chunkPath = tempDir + "/chunk_" + std::to_string(chunk.chunkNumber) + ".tmp";
+            // Caché local o red; el hash se verifica al escribir y solo se reintenta este chunk
+            bool success = ChunkIntegrity::fetchVerifiedChunk(m_telegramHandler, chunk, chunkPath, "");
+            
+            if (success) {
+                int completed = ++downloadedChunks;
+                double percent = (double)completed / totalChunks * 100.0;
                 
-                bool success = false;
-                for (int retry = 0; retry < 3 && !success; retry++) {
-                    if (retry > 0) {
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    }
-                    success = m_telegramHandler->downloadFile(chunk.telegramFileId, chunkPath);
-                }
+                // Actualizar BD
+                m_tempDB->updateDownloadProgress(downloadId, completed, percent);
                 
-                if (success) {
-                    int completed = ++downloadedChunks;
-                    double percent = (double)completed / totalChunks * 100.0;
-                    
-                    // Actualizar BD
-                    m_tempDB->updateDownloadProgress(downloadId, completed, percent);
-                    
-                    if (progressCallback) {
-                        progressCallback(completed, totalChunks, percent, "Downloading chunks");
-                    }
+                if (progressCallback) {
+                    progressCallback(completed, totalChunks, percent, "Downloading chunks");
                 }
-                
-                return success;
-            });
-            
-            futures.push_back(std::move(future));
-        }
-        
-        for (auto& f : futures) {
-            if (!f.get()) {
-                allSuccess = false;
             }
-        }
-        
-        if (!allSuccess) break;
+            
+            return success;
+        });
     }
     
+    bool allSuccess = queue.waitAll();
+    
     if (!allSuccess) {
         LOG_ERROR("Failed to download all chunks");
         m_tempDB->updateDownloadStatus(downloadId, "failed");
@@ -536,81 +439,8 @@ void LinkDownloadManager::cleanup() {
     }
 }
 
-// Función de desencriptación (copiada de mainwindow.cpp)
 bool LinkDownloadManager::decryptFile(const std::string& inputPath, const std::string& outputPath, const std::string& password) {
-    // Implementación AES-256 similar a mainwindow.cpp
-    try {
-        std::ifstream inFile(inputPath, std::ios::binary);
-        if (!inFile) return false;
-        
-        std::vector<char> fileData((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
-        inFile.close();
-        
-        if (fileData.size() < 32) return false;
-        
-        std::string ciphertext(fileData.begin(), fileData.end());
-        
-        // Extraer salt, IV y datos
-        std::string salt = ciphertext.substr(0, 16);
-        std::string iv = ciphertext.substr(16, 16);
-        std::string encrypted_data = ciphertext.substr(32);
-        
-        // Derivar clave
-        std::string key(32, 0);
-        if (PKCS5_PBKDF2_HMAC(
-            password.c_str(), password.length(),
-            reinterpret_cast<const unsigned char*>(salt.c_str()), salt.length(),
-            10000,
-            EVP_sha256(),
-            32,
-            reinterpret_cast<unsigned char*>(&key[0])
-        ) != 1) {
-            return false;
-        }
-        
-        // Desencriptar
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) return false;
-        
-        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                              reinterpret_cast<const unsigned char*>(key.c_str()),
-                              reinterpret_cast<const unsigned char*>(iv.c_str())) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            return false;
-        }
-        
-        int len, plaintext_len;
-        std::string plaintext(encrypted_data.length() + AES_BLOCK_SIZE, 0);
-        
-        if (EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]), &len,
-                             reinterpret_cast<const unsigned char*>(encrypted_data.c_str()), encrypted_data.length()) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            return false;
-        }
-        plaintext_len = len;
-        
-        if (EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]) + len, &len) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            return false;
-        }
-        plaintext_len += len;
-        
-        EVP_CIPHER_CTX_free(ctx);
-        plaintext.resize(plaintext_len);
-        
-        // Escribir archivo
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) return false;
-        
-        outFile.write(plaintext.c_str(), plaintext.size());
-        outFile.close();
-        
-        return true;
-        
-    } catch (...) {
-        return false;
-    }
+    return CryptoEngine::decryptFileWithPassword(inputPath, outputPath, password);
 }
 
 } // namespace TelegramCloud
-
@@ -0,0 +1,1280 @@
+#include "linkformat.h"
+#include "logger.h"
+#include <zlib.h>
+#include <algorithm>
+#include <fstream>
+#include <string_view>
+#include <cstring>
+#include <cstdlib>
+
+namespace TelegramCloud {
+
+namespace {
+
+const char LINK_MAGIC[] = {'T', 'C', 'L', 0x02};
+constexpr size_t LINK_HEADER_SIZE = sizeof(LINK_MAGIC) + 1;
+
+// Formas de chunkHash: vacío, SHA-256 en hex (se guarda en binario) u otra cadena
+enum HashKind : uint8_t {
+    HashEmpty = 0,
+    HashSha256 = 1,
+    HashText = 2
+};
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Diferencias con signo: zigzag para que las pequeñas negativas ocupen un byte
+void putSigned(std::string& out, int64_t value) {
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void putString(std::string& out, const std::string& value) {
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void putHash(std::string& out, const std::string& hash) {
+    if (hash.empty()) {
+        out.push_back(static_cast<char>(HashEmpty));
+        return;
+    }
+    // Solo hex en minúsculas: al releerlo debe quedar idéntico
+    if (hash.size() == 64 && std::all_of(hash.begin(), hash.end(), [](char c) { return hexValue(c) >= 0; })) {
+        out.push_back(static_cast<char>(HashSha256));
+        for (size_t i = 0; i < hash.size(); i += 2) {
+            out.push_back(static_cast<char>((hexValue(hash[i]) << 4) | hexValue(hash[i + 1])));
+        }
+        return;
+    }
+    out.push_back(static_cast<char>(HashText));
+    putString(out, hash);
+}
+
+// Lectura con comprobación de límites sobre el cuerpo ya descomprimido.
+// exhausted() distingue "faltan bytes" (en streaming, esperar a más) de
+// "datos inválidos".
+class Cursor {
+public:
+    Cursor(const std::string& data, size_t offset) : m_data(data), m_pos(offset), m_exhausted(false) {}
+
+    size_t position() const { return m_pos; }
+    bool exhausted() const { return m_exhausted; }
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_pos >= m_data.size()) return ranOut();
+            uint8_t byte = static_cast<uint8_t>(m_data[m_pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool signedVarint(int64_t& value) {
+        uint64_t raw;
+        if (!varint(raw)) return false;
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    bool integer(int64_t& value) {
+        uint64_t raw;
+        if (!varint(raw)) return false;
+        value = static_cast<int64_t>(raw);
+        return true;
+    }
+
+    bool byte(uint8_t& value) {
+        if (m_pos >= m_data.size()) return ranOut();
+        value = static_cast<uint8_t>(m_data[m_pos++]);
+        return true;
+    }
+
+    bool bytes(size_t length, std::string& value) {
+        if (length > m_data.size() - m_pos) return ranOut();
+        value.assign(m_data, m_pos, length);
+        m_pos += length;
+        return true;
+    }
+
+    bool string(std::string& value) {
+        uint64_t length;
+        return varint(length) && bytes(static_cast<size_t>(length), value);
+    }
+
+    bool hash(std::string& value) {
+        uint8_t kind;
+        if (!byte(kind)) return false;
+        switch (kind) {
+            case HashEmpty:
+                value.clear();
+                return true;
+            case HashSha256: {
+                std::string raw;
+                if (!bytes(32, raw)) return false;
+                value = CryptoEngine::toHex(raw);
+                return true;
+            }
+            case HashText:
+                return string(value);
+            default:
+                return false;
+        }
+    }
+
+    bool token(std::vector<std::string>& tokens, std::string& value) {
+        uint64_t index;
+        if (!varint(index) || index > tokens.size()) return false;
+        if (index == tokens.size()) {
+            std::string token;
+            if (!string(token)) return false;
+            tokens.push_back(std::move(token));
+        }
+        value = tokens[static_cast<size_t>(index)];
+        return true;
+    }
+
+private:
+    bool ranOut() {
+        m_exhausted = true;
+        return false;
+    }
+
+    const std::string& m_data;
+    size_t m_pos;
+    bool m_exhausted;
+};
+
+// Registro en curso: si la tabla de chunks llega incompleta se sigue
+// decodificando desde el último chunk completo
+struct PendingRecord {
+    FileInfo fileInfo;
+    std::vector<ChunkInfo> chunks;
+    uint64_t remaining = 0;
+    int64_t totalChunks = 0;
+    int64_t previousNumber = -1;
+    int64_t previousSize = 0;
+};
+
+// Marcador y campos del archivo; end indica el 0 que cierra la lista
+bool decodeRecordHeader(Cursor& in, std::vector<std::string>& tokens, PendingRecord& record, bool& end) {
+    uint64_t marker;
+    if (!in.varint(marker)) {
+        return false;
+    }
+    end = marker == 0;
+    if (end) {
+        return true;
+    }
+
+    FileInfo& fileInfo = record.fileInfo;
+    uint8_t encrypted;
+    if (!in.string(fileInfo.fileId) || !in.string(fileInfo.fileName) ||
+        !in.integer(fileInfo.fileSize) || !in.string(fileInfo.mimeType) ||
+        !in.string(fileInfo.category) || !in.string(fileInfo.uploadDate) ||
+        !in.string(fileInfo.telegramFileId) || !in.token(tokens, fileInfo.uploaderBotToken) ||
+        !in.byte(encrypted) || !in.varint(record.remaining)) {
+        return false;
+    }
+    fileInfo.isEncrypted = encrypted != 0;
+    if (record.remaining > 0 && !in.integer(record.totalChunks)) {
+        return false;
+    }
+    // El recuento viene del propio enlace: la reserva se acota y el vector
+    // crece con los chunks que realmente llegan
+    record.chunks.reserve(static_cast<size_t>(std::min<uint64_t>(record.remaining, 64 * 1024)));
+    return true;
+}
+
+// Chunks pendientes; resume queda tras el último chunk completo
+bool decodeRecordChunks(Cursor& in, std::vector<std::string>& tokens, PendingRecord& record, size_t& resume) {
+    while (record.remaining > 0) {
+        size_t knownTokens = tokens.size();
+        ChunkInfo chunk{};
+        int64_t numberDelta;
+        int64_t sizeDelta;
+        if (!in.signedVarint(numberDelta) || !in.signedVarint(sizeDelta) ||
+            !in.hash(chunk.chunkHash) || !in.string(chunk.telegramFileId) ||
+            !in.token(tokens, chunk.uploaderBotToken)) {
+            tokens.resize(knownTokens);
+            return false;
+        }
+        chunk.fileId = record.fileInfo.fileId;
+        chunk.chunkNumber = record.previousNumber + 1 + numberDelta;
+        chunk.chunkSize = record.previousSize + sizeDelta;
+        chunk.totalChunks = record.totalChunks;
+        record.previousNumber = chunk.chunkNumber;
+        record.previousSize = chunk.chunkSize;
+        record.chunks.push_back(std::move(chunk));
+        record.remaining--;
+        resume = in.position();
+    }
+    return true;
+}
+
+/**
+ * Cuerpo v2 (lo que sigue a la cabecera) recibido por partes. Los bytes se
+ * descomprimen según llegan y cada registro completo se entrega al visitor.
+ * Un registro con muchos chunks se decodifica por partes según llegan, sin
+ * volver a empezar en cada bloque.
+ */
+class RecordDecoder {
+public:
+    explicit RecordDecoder(LinkFileVisitor visitor)
+        : m_visitor(std::move(visitor))
+        , m_pos(0)
+        , m_retryAt(0)
+        , m_inflating(false)
+        , m_streamEnded(false)
+        , m_typeRead(false)
+        , m_recordOpen(false)
+        , m_type(LinkType::Single)
+        , m_ended(false)
+        , m_stopped(false)
+        , m_files(0) {
+    }
+
+    ~RecordDecoder() {
+        if (m_inflating) {
+            inflateEnd(&m_stream);
+        }
+    }
+
+    RecordDecoder(const RecordDecoder&) = delete;
+    RecordDecoder& operator=(const RecordDecoder&) = delete;
+
+    bool begin(uint8_t flags) {
+        if (flags & ~LinkWriter::LINK_FLAG_DEFLATE) {
+            return fail("Unsupported link flags: " + std::to_string(flags));
+        }
+        if (flags & LinkWriter::LINK_FLAG_DEFLATE) {
+            if (inflateInit(&m_stream) != Z_OK) {
+                return fail("Failed to initialize link decompression");
+            }
+            m_inflating = true;
+        }
+        return true;
+    }
+
+    bool push(const char* data, size_t length) {
+        if (!m_error.empty()) {
+            return false;
+        }
+        if (m_ended || m_stopped) {
+            return true;
+        }
+        if (!m_inflating) {
+            m_body.append(data, length);
+            return checkSize() && decode(false);
+        }
+        if (m_streamEnded) {
+            return true;   // lo que sigue al flujo zlib se ignora, igual que antes
+        }
+
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_stream.avail_in = static_cast<uInt>(length);
+        char buffer[64 * 1024];
+        while (m_stream.avail_in > 0 && !m_streamEnded) {
+            m_stream.next_out = reinterpret_cast<Bytef*>(buffer);
+            m_stream.avail_out = sizeof(buffer);
+            int rc = inflate(&m_stream, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+                return fail("Failed to decompress link data");
+            }
+            m_streamEnded = rc == Z_STREAM_END;
+            m_body.append(buffer, sizeof(buffer) - m_stream.avail_out);
+            // Decodificar por cada bloque descomprimido: el primer archivo sale
+            // sin esperar a descomprimir el resto de la entrada
+            if (!checkSize() || !decode(false)) {
+                return false;
+            }
+            if (m_ended || m_stopped) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool finish() {
+        if (!m_error.empty()) {
+            return false;
+        }
+        if (m_stopped) {
+            return true;
+        }
+        if (m_inflating && !m_streamEnded && !m_ended) {
+            return fail("Failed to decompress link data");
+        }
+        if (!decode(true)) {
+            return false;
+        }
+        return m_ended || fail("Truncated link data");
+    }
+
+    LinkType type() const { return m_type; }
+    bool stopped() const { return m_stopped; }
+    size_t files() const { return m_files; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message) {
+        if (m_error.empty()) {
+            m_error = message;
+        }
+        return false;
+    }
+
+    bool checkSize() {
+        if (m_body.size() - m_pos > LinkReader::MAX_PLAINTEXT_SIZE) {
+            return fail("Link content exceeds maximum size");
+        }
+        return true;
+    }
+
+    bool decode(bool final) {
+        while (!m_ended && !m_stopped) {
+            size_t available = m_body.size() - m_pos;
+            if (!final && available < m_retryAt) {
+                break;
+            }
+
+            Cursor in(m_body, m_pos);
+            if (!m_typeRead) {
+                uint64_t linkType;
+                if (!in.varint(linkType)) {
+                    if (in.exhausted() && !final) {
+                        m_retryAt = available + 1;
+                        break;
+                    }
+                    return fail("Invalid link type");
+                }
+                if (linkType > static_cast<uint8_t>(LinkType::Batch)) {
+                    return fail("Invalid link type");
+                }
+                m_type = static_cast<LinkType>(linkType);
+                m_typeRead = true;
+                m_pos = in.position();
+                continue;
+            }
+
+            if (!m_recordOpen) {
+                // Los tokens nuevos de una cabecera incompleta se descartan al reintentar
+                size_t knownTokens = m_tokens.size();
+                m_record = PendingRecord();
+                bool end = false;
+                if (!decodeRecordHeader(in, m_tokens, m_record, end)) {
+                    m_tokens.resize(knownTokens);
+                    if (!in.exhausted()) {
+                        return fail("Invalid file record in link data");
+                    }
+                    if (final) {
+                        return fail("Truncated link data");
+                    }
+                    m_retryAt = std::max<size_t>(available * 2, 64);
+                    break;
+                }
+                m_pos = in.position();
+                m_retryAt = 0;
+                if (end) {
+                    m_ended = true;
+                    break;
+                }
+                m_recordOpen = true;
+            }
+
+            size_t resume = m_pos;
+            bool complete = decodeRecordChunks(in, m_tokens, m_record, resume);
+            m_pos = resume;
+            if (!complete) {
+                if (!in.exhausted()) {
+                    return fail("Invalid chunk record in link data");
+                }
+                if (final) {
+                    return fail("Truncated link data");
+                }
+                // Lo decodificado se conserva: basta con que llegue algo más
+                m_retryAt = m_body.size() - m_pos + 1;
+                break;
+            }
+            m_retryAt = 0;
+            m_recordOpen = false;
+            m_files++;
+            if (!m_visitor(std::move(m_record.fileInfo), std::move(m_record.chunks))) {
+                m_stopped = true;
+            }
+        }
+
+        // Descartar lo ya decodificado para que la memoria no crezca con el enlace
+        if (m_pos > 0 && (m_pos == m_body.size() || m_pos >= m_body.size() / 2)) {
+            m_body.erase(0, m_pos);
+            m_pos = 0;
+        }
+        return true;
+    }
+
+    LinkFileVisitor m_visitor;
+    std::string m_body;
+    size_t m_pos;
+    size_t m_retryAt;
+    std::vector<std::string> m_tokens;
+
+    z_stream m_stream{};
+    bool m_inflating;
+    bool m_streamEnded;
+
+    bool m_typeRead;
+    bool m_recordOpen;
+    PendingRecord m_record;
+    LinkType m_type;
+    bool m_ended;
+    bool m_stopped;
+    size_t m_files;
+    std::string m_error;
+};
+
+// Campos reconocidos en los JSON de enlace; las claves del formato de
+// LinkDownloadManager son alias de las de UniversalLinkGenerator
+enum class LinkField {
+    None,
+    Type,
+    FileId,
+    FileName,
+    FileSize,
+    MimeType,
+    Category,
+    UploadDate,
+    TelegramFileId,
+    BotToken,
+    Encrypted,
+    ChunkNumber,
+    TotalChunks,
+    ChunkSize,
+    ChunkHash
+};
+
+LinkField linkField(std::string_view key) {
+    static const std::pair<std::string_view, LinkField> fields[] = {
+        {"type", LinkField::Type},
+        {"fileId", LinkField::FileId},
+        {"file_id", LinkField::FileId},
+        {"fileName", LinkField::FileName},
+        {"filename", LinkField::FileName},
+        {"fileSize", LinkField::FileSize},
+        {"size", LinkField::FileSize},
+        {"mimeType", LinkField::MimeType},
+        {"category", LinkField::Category},
+        {"uploadDate", LinkField::UploadDate},
+        {"telegramFileId", LinkField::TelegramFileId},
+        {"telegram_file_id", LinkField::TelegramFileId},
+        {"tid", LinkField::TelegramFileId},
+        {"uploaderBotToken", LinkField::BotToken},
+        {"isEncrypted", LinkField::Encrypted},
+        {"encrypted", LinkField::Encrypted},
+        {"chunkNumber", LinkField::ChunkNumber},
+        {"n", LinkField::ChunkNumber},
+        {"totalChunks", LinkField::TotalChunks},
+        {"chunkSize", LinkField::ChunkSize},
+        {"s", LinkField::ChunkSize},
+        {"chunkHash", LinkField::ChunkHash},
+        {"h", LinkField::ChunkHash}
+    };
+    for (const auto& field : fields) {
+        if (field.first == key) {
+            return field.second;
+        }
+    }
+    return LinkField::None;
+}
+
+/**
+ * Parser JSON de una sola pasada para los enlaces. Cada objeto se clasifica
+ * por su contenedor: archivo ("file", elementos de "files" o la raíz si
+ * rootIsFile) o chunk (elementos de "chunks" de un archivo). Las cadenas
+ * de los campos conocidos se decodifican directamente en FileInfo/ChunkInfo;
+ * el resto se salta sin copiarlo.
+ */
+class LinkJsonParser {
+public:
+    LinkJsonParser(const std::string& input, bool rootIsFile, LinkFileVisitor visitor)
+        : m_input(input)
+        , m_pos(0)
+        , m_rootIsFile(rootIsFile)
+        , m_visitor(std::move(visitor))
+        , m_stopped(false) {
+    }
+
+    bool parse() {
+        skipWhitespace();
+        if (!value(Container::None, 0)) {
+            return m_stopped;
+        }
+        skipWhitespace();
+        if (m_pos != m_input.size()) {
+            return fail("trailing data");
+        }
+        return true;
+    }
+
+    const std::string& rootType() const { return m_rootType; }
+    bool stopped() const { return m_stopped; }
+    const std::string& error() const { return m_error; }
+
+private:
+    // Objeto en curso y, para los arrays, qué contienen
+    enum class Frame { Root, File, Chunk, Other };
+    enum class Container { None, File, Files, Chunks, Other };
+
+    static constexpr int MAX_DEPTH = 32;
+
+    bool fail(const char* what) {
+        if (m_error.empty()) {
+            m_error = std::string(what) + " at byte " + std::to_string(m_pos);
+        }
+        return false;
+    }
+
+    void skipWhitespace() {
+        while (m_pos < m_input.size()) {
+            char c = m_input[m_pos];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') break;
+            m_pos++;
+        }
+    }
+
+    bool consume(char expected) {
+        skipWhitespace();
+        if (m_pos >= m_input.size() || m_input[m_pos] != expected) {
+            return false;
+        }
+        m_pos++;
+        return true;
+    }
+
+    bool value(Container container, int depth) {
+        if (depth > MAX_DEPTH) {
+            return fail("nesting too deep");
+        }
+        skipWhitespace();
+        if (m_pos >= m_input.size()) {
+            return fail("unexpected end");
+        }
+        switch (m_input[m_pos]) {
+            case '{': return object(container, depth);
+            case '[': return array(container, depth);
+            case '"': return stringValue();
+            case 't': return literal("true") && booleanValue(true);
+            case 'f': return literal("false") && booleanValue(false);
+            case 'n': return literal("null");
+            default: return numberValue();
+        }
+    }
+
+    bool object(Container container, int depth) {
+        Frame frame = Frame::Other;
+        if (m_frames.empty()) {
+            frame = m_rootIsFile ? Frame::File : Frame::Root;
+        } else if (container == Container::File || container == Container::Files) {
+            frame = Frame::File;
+        } else if (container == Container::Chunks) {
+            frame = Frame::Chunk;
+        }
+        if (frame == Frame::File) {
+            m_file = FileInfo();
+            m_chunks.clear();
+        } else if (frame == Frame::Chunk) {
+            m_chunk = ChunkInfo{};
+        }
+
+        m_pos++;   // '{'
+        m_frames.push_back(frame);
+        if (!consume('}')) {
+            do {
+                skipWhitespace();
+                if (m_pos >= m_input.size() || m_input[m_pos] != '"') {
+                    return fail("expected key");
+                }
+                m_key.clear();
+                if (!string(&m_key) || !consume(':')) {
+                    return fail("invalid key");
+                }
+                m_field = linkField(m_key);
+
+                Container child = Container::Other;
+                if (frame == Frame::Root && m_key == "file") {
+                    child = Container::File;
+                } else if (frame == Frame::Root && m_key == "files") {
+                    child = Container::Files;
+                } else if (frame == Frame::File && m_key == "chunks") {
+                    child = Container::Chunks;
+                }
+                if (!value(child, depth + 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume('}')) {
+                return fail("expected '}'");
+            }
+        }
+        m_frames.pop_back();
+        m_field = LinkField::None;
+
+        if (frame == Frame::Chunk) {
+            m_chunks.push_back(std::move(m_chunk));
+        } else if (frame == Frame::File) {
+            for (ChunkInfo& chunk : m_chunks) {
+                chunk.fileId = m_file.fileId;
+            }
+            FileInfo fileInfo = std::move(m_file);
+            std::vector<ChunkInfo> chunks = std::move(m_chunks);
+            m_chunks = std::vector<ChunkInfo>();
+            // El visitor pidió parar: se corta el recorrido sin marcarlo como error
+            if (!m_visitor(std::move(fileInfo), std::move(chunks))) {
+                m_stopped = true;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool array(Container container, int depth) {
+        // Solo los elementos de "files" y "chunks" son archivos o chunks
+        Container elements = (container == Container::Files || container == Container::Chunks)
+                           ? container : Container::Other;
+        m_pos++;   // '['
+        m_frames.push_back(Frame::Other);
+        if (!consume(']')) {
+            do {
+                if (!value(elements, depth + 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume(']')) {
+                return fail("expected ']'");
+            }
+        }
+        m_frames.pop_back();
+        return true;
+    }
+
+    std::string* stringTarget() {
+        Frame frame = m_frames.empty() ? Frame::Other : m_frames.back();
+        if (m_field == LinkField::Type && m_frames.size() == 1) {
+            m_rootType.clear();
+            return &m_rootType;
+        }
+        if (frame == Frame::File) {
+            switch (m_field) {
+                case LinkField::FileId: return &m_file.fileId;
+                case LinkField::FileName: return &m_file.fileName;
+                case LinkField::MimeType: return &m_file.mimeType;
+                case LinkField::Category: return &m_file.category;
+                case LinkField::UploadDate: return &m_file.uploadDate;
+                case LinkField::TelegramFileId: return &m_file.telegramFileId;
+                case LinkField::BotToken: return &m_file.uploaderBotToken;
+                default: return nullptr;
+            }
+        }
+        if (frame == Frame::Chunk) {
+            switch (m_field) {
+                case LinkField::ChunkHash: return &m_chunk.chunkHash;
+                case LinkField::TelegramFileId: return &m_chunk.telegramFileId;
+                case LinkField::BotToken: return &m_chunk.uploaderBotToken;
+                default: return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    bool stringValue() {
+        std::string* target = stringTarget();
+        if (target) {
+            target->clear();
+        }
+        return string(target);
+    }
+
+    // Decodifica la cadena en out (nullptr = solo saltarla)
+    bool string(std::string* out) {
+        m_pos++;   // '"'
+        while (true) {
+            size_t start = m_pos;
+            while (m_pos < m_input.size() && m_input[m_pos] != '"' && m_input[m_pos] != '\\') {
+                m_pos++;
+            }
+            if (m_pos >= m_input.size()) {
+                return fail("unterminated string");
+            }
+            if (out) {
+                out->append(m_input, start, m_pos - start);
+            }
+            if (m_input[m_pos++] == '"') {
+                return true;
+            }
+            if (m_pos >= m_input.size()) {
+                return fail("unterminated escape");
+            }
+            char escape = m_input[m_pos++];
+            char decoded;
+            switch (escape) {
+                case '"': decoded = '"'; break;
+                case '\\': decoded = '\\'; break;
+                case '/': decoded = '/'; break;
+                case 'b': decoded = '\b'; break;
+                case 'f': decoded = '\f'; break;
+                case 'n': decoded = '\n'; break;
+                case 'r': decoded = '\r'; break;
+                case 't': decoded = '\t'; break;
+                case 'u':
+                    if (!unicodeEscape(out)) return false;
+                    continue;
+                default:
+                    return fail("invalid escape");
+            }
+            if (out) {
+                out->push_back(decoded);
+            }
+        }
+    }
+
+    bool hex4(uint32_t& value) {
+        if (m_input.size() - m_pos < 4) {
+            return fail("invalid unicode escape");
+        }
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = m_input[m_pos++];
+            int digit = (c >= '0' && c <= '9') ? c - '0'
+                      : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                      : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (digit < 0) {
+                return fail("invalid unicode escape");
+            }
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    bool unicodeEscape(std::string* out) {
+        uint32_t code;
+        if (!hex4(code)) return false;
+        // Par sustituto UTF-16
+        if (code >= 0xD800 && code <= 0xDBFF && m_input.compare(m_pos, 2, "\\u") == 0) {
+            m_pos += 2;
+            uint32_t low;
+            if (!hex4(low)) return false;
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+        }
+        if (!out) {
+            return true;
+        }
+        if (code < 0x80) {
+            out->push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+            out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        return true;
+    }
+
+    bool literal(const char* text) {
+        size_t length = std::char_traits<char>::length(text);
+        if (m_input.compare(m_pos, length, text) != 0) {
+            return fail("invalid literal");
+        }
+        m_pos += length;
+        return true;
+    }
+
+    bool booleanValue(bool value) {
+        if (m_field == LinkField::Encrypted && !m_frames.empty() && m_frames.back() == Frame::File) {
+            m_file.isEncrypted = value;
+        }
+        return true;
+    }
+
+    bool numberValue() {
+        size_t start = m_pos;
+        bool negative = m_pos < m_input.size() && m_input[m_pos] == '-';
+        if (negative) m_pos++;
+        uint64_t integer = 0;
+        size_t digits = 0;
+        while (m_pos < m_input.size() && m_input[m_pos] >= '0' && m_input[m_pos] <= '9') {
+            integer = integer * 10 + static_cast<uint64_t>(m_input[m_pos++] - '0');
+            digits++;
+        }
+        if (digits == 0) {
+            return fail("unexpected character");
+        }
+        int64_t value = negative ? -static_cast<int64_t>(integer) : static_cast<int64_t>(integer);
+
+        // Fracción o exponente: los campos son enteros, se trunca
+        if (m_pos < m_input.size() && (m_input[m_pos] == '.' || m_input[m_pos] == 'e' || m_input[m_pos] == 'E')) {
+            while (m_pos < m_input.size() && std::strchr("0123456789.eE+-", m_input[m_pos])) {
+                m_pos++;
+            }
+            value = static_cast<int64_t>(std::strtod(m_input.substr(start, m_pos - start).c_str(), nullptr));
+        }
+
+        Frame frame = m_frames.empty() ? Frame::Other : m_frames.back();
+        if (frame == Frame::File && m_field == LinkField::FileSize) {
+            m_file.fileSize = value;
+        } else if (frame == Frame::Chunk) {
+            switch (m_field) {
+                case LinkField::ChunkNumber: m_chunk.chunkNumber = value; break;
+                case LinkField::ChunkSize: m_chunk.chunkSize = value; break;
+                case LinkField::TotalChunks:
+                    m_chunk.totalChunks = value;
+                    // Primer chunk del archivo: reservar (acotado por el tamaño de la entrada)
+                    if (m_chunks.empty() && value > 0) {
+                        m_chunks.reserve(std::min<size_t>(static_cast<size_t>(value), m_input.size() / 16));
+                    }
+                    break;
+                default: break;
+            }
+        }
+        return true;
+    }
+
+    const std::string& m_input;
+    size_t m_pos;
+    bool m_rootIsFile;
+    LinkFileVisitor m_visitor;
+    bool m_stopped;
+
+    std::vector<Frame> m_frames;
+    LinkField m_field = LinkField::None;
+    std::string m_key;
+    std::string m_rootType;
+    std::string m_error;
+
+    FileInfo m_file;
+    ChunkInfo m_chunk{};
+    std::vector<ChunkInfo> m_chunks;
+};
+
+} // namespace
+
+// ============================================================================
+// LinkWriter
+// ============================================================================
+
+struct LinkWriter::Compressor {
+    z_stream stream{};
+};
+
+LinkWriter::LinkWriter(LinkType type, bool compress)
+    : m_ok(true)
+    , m_finished(false)
+    , m_files(0) {
+    m_output.append(LINK_MAGIC, sizeof(LINK_MAGIC));
+    m_output.push_back(static_cast<char>(compress ? LINK_FLAG_DEFLATE : 0));
+
+    if (compress) {
+        m_compressor = std::make_unique<Compressor>();
+        if (deflateInit(&m_compressor->stream, Z_BEST_COMPRESSION) != Z_OK) {
+            LOG_ERROR("Failed to initialize link compressor");
+            m_compressor.reset();
+            m_ok = false;
+        }
+    }
+
+    std::string record;
+    putVarint(record, static_cast<uint8_t>(type));
+    emit(record);
+}
+
+LinkWriter::~LinkWriter() {
+    if (m_compressor) {
+        deflateEnd(&m_compressor->stream);
+    }
+}
+
+bool LinkWriter::emit(const std::string& record) {
+    if (!m_ok) {
+        return false;
+    }
+    if (!m_compressor) {
+        m_output.append(record);
+        return true;
+    }
+
+    z_stream& stream = m_compressor->stream;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(record.data()));
+    stream.avail_in = static_cast<uInt>(record.size());
+    int flush = m_finished ? Z_FINISH : Z_NO_FLUSH;
+
+    char buffer[16 * 1024];
+    int rc;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        rc = deflate(&stream, flush);
+        if (rc == Z_STREAM_ERROR) {
+            LOG_ERROR("Link compression failed");
+            m_ok = false;
+            return false;
+        }
+        m_output.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (stream.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+    return true;
+}
+
+void LinkWriter::putToken(std::string& record, const std::string& token) {
+    // Pocos bots por enlace: búsqueda lineal
+    auto it = std::find(m_tokens.begin(), m_tokens.end(), token);
+    putVarint(record, static_cast<uint64_t>(it - m_tokens.begin()));
+    if (it == m_tokens.end()) {
+        putString(record, token);
+        m_tokens.push_back(token);
+    }
+}
+
+bool LinkWriter::addFile(const FileInfo& fileInfo, const std::vector<ChunkInfo>& chunks) {
+    if (m_finished) {
+        return false;
+    }
+
+    std::string record;
+    putVarint(record, 1);
+    putString(record, fileInfo.fileId);
+    putString(record, fileInfo.fileName);
+    putVarint(record, static_cast<uint64_t>(std::max<int64_t>(fileInfo.fileSize, 0)));
+    putString(record, fileInfo.mimeType);
+    putString(record, fileInfo.category);
+    putString(record, fileInfo.uploadDate);
+    putString(record, fileInfo.telegramFileId);
+    putToken(record, fileInfo.uploaderBotToken);
+    record.push_back(static_cast<char>(fileInfo.isEncrypted ? 1 : 0));
+
+    putVarint(record, chunks.size());
+    if (!chunks.empty()) {
+        putVarint(record, static_cast<uint64_t>(std::max<int64_t>(chunks.front().totalChunks, 0)));
+        int64_t previousNumber = -1;
+        int64_t previousSize = 0;
+        for (const ChunkInfo& chunk : chunks) {
+            putSigned(record, chunk.chunkNumber - (previousNumber + 1));
+            putSigned(record, chunk.chunkSize - previousSize);
+            putHash(record, chunk.chunkHash);
+            putString(record, chunk.telegramFileId);
+            putToken(record, chunk.uploaderBotToken);
+            previousNumber = chunk.chunkNumber;
+            previousSize = chunk.chunkSize;
+        }
+    }
+
+    if (!emit(record)) {
+        return false;
+    }
+    m_files++;
+    return true;
+}
+
+bool LinkWriter::finish(std::string& out) {
+    if (m_finished) {
+        return false;
+    }
+    m_finished = true;
+
+    std::string terminator;
+    putVarint(terminator, 0);
+    if (!emit(terminator)) {
+        return false;
+    }
+    out = std::move(m_output);
+    m_output.clear();
+    return true;
+}
+
+// ============================================================================
+// LinkReader
+// ============================================================================
+
+bool LinkReader::isBinary(const std::string& plaintext) {
+    return plaintext.size() >= LINK_HEADER_SIZE &&
+           plaintext.compare(0, sizeof(LINK_MAGIC), LINK_MAGIC, sizeof(LINK_MAGIC)) == 0;
+}
+
+bool LinkReader::parse(const std::string& plaintext,
+                       std::vector<FileInfo>& filesInfo,
+                       std::vector<std::vector<ChunkInfo>>& filesChunks,
+                       LinkType* type) {
+    if (!isBinary(plaintext)) {
+        return false;
+    }
+
+    RecordDecoder decoder([&](FileInfo fileInfo, std::vector<ChunkInfo> chunks) {
+        filesInfo.push_back(std::move(fileInfo));
+        filesChunks.push_back(std::move(chunks));
+        return true;
+    });
+    if (!decoder.begin(static_cast<uint8_t>(plaintext[sizeof(LINK_MAGIC)])) ||
+        !decoder.push(plaintext.data() + LINK_HEADER_SIZE, plaintext.size() - LINK_HEADER_SIZE) ||
+        !decoder.finish()) {
+        LOG_ERROR(decoder.error());
+        return false;
+    }
+    if (type) {
+        *type = decoder.type();
+    }
+    return !filesInfo.empty();
+}
+
+bool LinkReader::parseJson(const std::string& json,
+                           std::vector<FileInfo>& filesInfo,
+                           std::vector<std::vector<ChunkInfo>>& filesChunks,
+                           LinkType* type) {
+    LinkJsonParser parser(json, false, [&](FileInfo fileInfo, std::vector<ChunkInfo> chunks) {
+        filesInfo.push_back(std::move(fileInfo));
+        filesChunks.push_back(std::move(chunks));
+        return true;
+    });
+    if (!parser.parse()) {
+        LOG_ERROR("Failed to parse link JSON: " + parser.error());
+        return false;
+    }
+    if (parser.rootType() != "single" && parser.rootType() != "batch") {
+        LOG_ERROR("Unknown link type: " + parser.rootType());
+        return false;
+    }
+    if (type) {
+        *type = parser.rootType() == "single" ? LinkType::Single : LinkType::Batch;
+    }
+    return !filesInfo.empty();
+}
+
+bool LinkReader::parseShareJson(const std::string& json,
+                                FileInfo& fileInfo,
+                                std::vector<ChunkInfo>& chunks,
+                                std::string& fileType) {
+    bool found = false;
+    LinkJsonParser parser(json, true, [&](FileInfo parsedInfo, std::vector<ChunkInfo> parsedChunks) {
+        fileInfo = std::move(parsedInfo);
+        chunks = std::move(parsedChunks);
+        found = true;
+        return true;
+    });
+    if (!parser.parse() || !found) {
+        LOG_ERROR("Failed to parse link JSON: " + parser.error());
+        return false;
+    }
+    fileType = parser.rootType();
+    return true;
+}
+
+// ============================================================================
+// LinkStreamReader
+// ============================================================================
+
+struct LinkStreamReader::BodyDecoder : RecordDecoder {
+    using RecordDecoder::RecordDecoder;
+};
+
+LinkStreamReader::LinkStreamReader(const std::string& password, LinkFileVisitor visitor, int iterations)
+    : m_password(password)
+    , m_iterations(iterations)
+    , m_visitor(std::move(visitor))
+    , m_cipherReady(false)
+    , m_format(Format::Unknown)
+    , m_jsonType(LinkType::Single)
+    , m_files(0)
+    , m_stopped(false)
+    , m_failed(false)
+    , m_finished(false) {
+}
+
+LinkStreamReader::~LinkStreamReader() = default;
+
+bool LinkStreamReader::fail(const std::string& message) {
+    if (!m_failed) {
+        m_failed = true;
+        m_error = message;
+    }
+    return false;
+}
+
+bool LinkStreamReader::visit(FileInfo fileInfo, std::vector<ChunkInfo> chunks) {
+    m_files++;
+    if (!m_visitor(std::move(fileInfo), std::move(chunks))) {
+        m_stopped = true;
+        return false;
+    }
+    return true;
+}
+
+bool LinkStreamReader::feed(const char* data, size_t length) {
+    if (m_failed || m_finished) {
+        return !m_failed;
+    }
+    if (stopped()) {
+        return true;
+    }
+
+    if (!m_cipherReady) {
+        size_t take = std::min(length, CryptoEngine::SALT_SIZE + CryptoEngine::IV_SIZE - m_header.size());
+        m_header.append(data, take);
+        data += take;
+        length -= take;
+        if (m_header.size() < CryptoEngine::SALT_SIZE + CryptoEngine::IV_SIZE) {
+            return true;
+        }
+        try {
+            std::string key = CryptoEngine::deriveKeyPbkdf2Cached(
+                m_password, m_header.substr(0, CryptoEngine::SALT_SIZE), m_iterations);
+            SecretWipe wipeKey(key);
+            if (!m_cipher.init(CipherStream::Mode::Decrypt, key, m_header.substr(CryptoEngine::SALT_SIZE))) {
+                return fail("Failed to initialize decryption");
+            }
+        } catch (const std::exception& e) {
+            return fail(std::string("Key derivation failed: ") + e.what());
+        }
+        m_cipherReady = true;
+    }
+
+    std::string plaintext;
+    plaintext.reserve(length + 16);
+    if (!m_cipher.update(data, length, plaintext)) {
+        return fail("Decryption failed (corrupted data)");
+    }
+    return consume(plaintext);
+}
+
+bool LinkStreamReader::consume(std::string& plaintext) {
+    if (m_format == Format::Unknown) {
+        m_pending.append(plaintext);
+        size_t first = m_pending.find_first_not_of(" \t\r\n");
+        if (first != std::string::npos && m_pending[first] == '{') {
+            m_format = Format::Json;
+            return true;
+        }
+        if (m_pending.size() < LINK_HEADER_SIZE) {
+            return true;
+        }
+        // Con la contraseña equivocada el texto descifrado es ruido: se ve
+        // en el primer bloque, sin esperar al relleno del final
+        if (!LinkReader::isBinary(m_pending)) {
+            return fail("Decryption failed (wrong password or corrupted data)");
+        }
+        m_format = Format::Binary;
+        m_decoder = std::make_unique<BodyDecoder>([this](FileInfo fileInfo, std::vector<ChunkInfo> chunks) {
+            return visit(std::move(fileInfo), std::move(chunks));
+        });
+        if (!m_decoder->begin(static_cast<uint8_t>(m_pending[sizeof(LINK_MAGIC)]))) {
+            return fail(m_decoder->error());
+        }
+        plaintext = m_pending.substr(LINK_HEADER_SIZE);
+        m_pending.clear();
+        m_pending.shrink_to_fit();
+    }
+
+    if (m_format == Format::Json) {
+        // Sin tope, como la lectura completa anterior: un v1 válido puede superar MAX_PLAINTEXT_SIZE
+        m_pending.append(plaintext);
+        return true;
+    }
+    if (!m_decoder->push(plaintext.data(), plaintext.size())) {
+        return fail(m_decoder->error());
+    }
+    return true;
+}
+
+bool LinkStreamReader::finish() {
+    if (m_failed || m_finished) {
+        return !m_failed;
+    }
+    m_finished = true;
+    if (stopped()) {
+        return true;
+    }
+    if (!m_cipherReady) {
+        return fail("Invalid link file (too short)");
+    }
+
+    std::string plaintext;
+    if (!m_cipher.finish(plaintext)) {
+        return fail("Decryption failed (wrong password or corrupted data)");
+    }
+    if (!plaintext.empty() && !consume(plaintext)) {
+        return false;
+    }
+
+    if (m_format == Format::Binary) {
+        if (!m_decoder->finish()) {
+            return fail(m_decoder->error());
+        }
+        return true;
+    }
+    if (m_format != Format::Json) {
+        return fail("Decryption failed (wrong password or corrupted data)");
+    }
+
+    LinkJsonParser parser(m_pending, false, [this](FileInfo fileInfo, std::vector<ChunkInfo> chunks) {
+        return visit(std::move(fileInfo), std::move(chunks));
+    });
+    if (!parser.parse()) {
+        return fail("Failed to parse link JSON: " + parser.error());
+    }
+    if (parser.rootType() != "single" && parser.rootType() != "batch") {
+        return fail("Unknown link type: " + parser.rootType());
+    }
+    m_jsonType = parser.rootType() == "single" ? LinkType::Single : LinkType::Batch;
+    m_pending.clear();
+    m_pending.shrink_to_fit();
+    return true;
+}
+
+bool LinkStreamReader::readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return fail("Cannot open link file: " + path);
+    }
+
+    std::vector<char> buffer(CryptoEngine::STREAM_BUFFER_SIZE);
+    while (file && !stopped()) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        std::streamsize got = file.gcount();
+        if (got <= 0) {
+            break;
+        }
+        if (!feed(buffer.data(), static_cast<size_t>(got))) {
+            return false;
+        }
+    }
+    if (file.bad()) {
+        return fail("Error reading link file: " + path);
+    }
+    return finish();
+}
+
+bool LinkStreamReader::stopped() const {
+    return m_stopped;
+}
+
+LinkType LinkStreamReader::type() const {
+    return m_decoder ? m_decoder->type() : m_jsonType;
+}
+
+} // namespace TelegramCloud
@@ -1,6 +1,7 @@
 #include "logger.h"
 #include <filesystem>
 #include <iomanip>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -15,12 +16,110 @@
 
 namespace TelegramCloud {
 
+static_assert((Logger::RING_CAPACITY & (Logger::RING_CAPACITY - 1)) == 0, "RING_CAPACITY debe ser potencia de 2");
+
+/**
+ * Hueco del buffer circular (cola acotada de Vyukov). sequence == posición
+ * indica hueco libre para esa posición; posición + 1, mensaje publicado.
+ * payload conserva su capacidad entre usos: en régimen estable encolar no
+ * reserva memoria.
+ */
+struct Logger::LogSlot {
+    std::atomic<size_t> sequence{0};
+    LogLevel level = LogLevel::LOG_INFO;
+    std::chrono::system_clock::time_point time;
+    const char* format = nullptr;        // nullptr: payload es el mensaje ya hecho
+    std::string payload;
+};
+
+namespace {
+
+template <typename T>
+T readArg(const std::string& payload, size_t& offset) {
+    T value{};
+    if (offset + sizeof(T) <= payload.size()) {
+        std::memcpy(&value, payload.data() + offset, sizeof(T));
+    }
+    offset += sizeof(T);
+    return value;
+}
+
+// Siguiente argumento codificado por LogArgs::append, como texto
+bool appendNextArg(std::string& out, const std::string& payload, size_t& offset) {
+    if (offset >= payload.size()) {
+        return false;
+    }
+    
+    char tag = payload[offset++];
+    switch (tag) {
+        case 'b':
+            out += payload[offset++] ? "true" : "false";
+            return true;
+        case 'i':
+            out += std::to_string(readArg<int64_t>(payload, offset));
+            return true;
+        case 'u':
+            out += std::to_string(readArg<uint64_t>(payload, offset));
+            return true;
+        case 'd': {
+            std::ostringstream oss;
+            oss << readArg<double>(payload, offset);
+            out += oss.str();
+            return true;
+        }
+        case 's': {
+            uint32_t length = readArg<uint32_t>(payload, offset);
+            out.append(payload, std::min<size_t>(offset, payload.size()), length);
+            offset += length;
+            return true;
+        }
+    }
+    
+    offset = payload.size();
+    return false;
+}
+
+// Sustituye cada "{}" por el siguiente argumento; "{{" y "}}" son llaves literales
+void formatMessage(std::string& out, const char* format, const std::string& payload) {
+    size_t offset = 0;
+    for (const char* p = format; *p; p++) {
+        if (p[0] == '{' && p[1] == '}') {
+            if (!appendNextArg(out, payload, offset)) {
+                out += "{}";
+            }
+            p++;
+        } else if ((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}')) {
+            out.push_back(*p);
+            p++;
+        } else {
+            out.push_back(*p);
+        }
+    }
+}
+
+} // namespace
+
 Logger& Logger::instance() {
     static Logger instance;
     return instance;
 }
 
-Logger::Logger() : m_minLevel(LogLevel::LOG_DEBUG) {
+Logger::Logger()
+    : m_minLevel(LogLevel::LOG_DEBUG)
+    , m_overflowPolicy(LogOverflowPolicy::DROP_LOW_PRIORITY)
+    , m_ring(new LogSlot[RING_CAPACITY])
+    , m_enqueuePos(0)
+    , m_dequeuePos(0)
+    , m_dropped(0)
+    , m_droppedTotal(0)
+    , m_running(false)
+    , m_flusherIdle(false)
+    , m_writtenPos(0)
+    , m_timestampSecond(0) {
+    for (size_t i = 0; i < RING_CAPACITY; i++) {
+        m_ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    
     // Crear directorio de logs si no existe
     std::filesystem::create_directories("logs");
     
@@ -37,6 +136,9 @@ Logger::Logger() : m_minLevel(LogLevel::LOG_DEBUG) {
     
     m_logFile.open(m_logFilename, std::ios::out | std::ios::app);
     
+    m_running = true;
+    m_flusher = std::thread(&Logger::flusherThread, this);
+    
     if (m_logFile.is_open()) {
         info("=======================================================");
         info("Telegram Cloud C++/wxWidgets - Log Session Started");
@@ -49,6 +151,20 @@ Logger::~Logger() {
         info("=======================================================");
         info("Log Session Ended");
         info("=======================================================");
+    }
+    
+    // El flusher vacía lo pendiente antes de salir; después log() escribe directo
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_running = false;
+    }
+    m_wakeCv.notify_all();
+    if (m_flusher.joinable()) {
+        m_flusher.join();
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_logFile.is_open()) {
         m_logFile.close();
     }
 }
@@ -68,13 +184,23 @@ void Logger::setLogLevel(LogLevel level) {
     m_minLevel = level;
 }
 
-std::string Logger::getCurrentTimestamp() const {
-    auto now = std::time(nullptr);
-    auto tm = *std::localtime(&now);
+void Logger::setOverflowPolicy(LogOverflowPolicy policy) {
+    m_overflowPolicy = policy;
+}
+
+std::string Logger::formatTimestamp(std::chrono::system_clock::time_point time) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
     
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+    // Los mensajes de un mismo segundo comparten el texto ya formateado
+    if (seconds != m_timestampSecond || m_timestampText.empty()) {
+        auto tm = *std::localtime(&seconds);
+        
+        std::ostringstream oss;
+        oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+        m_timestampText = oss.str();
+        m_timestampSecond = seconds;
+    }
+    return m_timestampText;
 }
 
 std::string Logger::levelToString(LogLevel level) const {
@@ -89,17 +215,189 @@ std::string Logger::levelToString(LogLevel level) const {
 }
 
 void Logger::log(LogLevel level, const std::string& message) {
-    if (level < m_minLevel) {
+    if (!isEnabled(level)) {
         return;
     }
+    enqueue(level, nullptr, message);
+}
+
+void Logger::enqueue(LogLevel level, const char* format, std::string_view payload) {
+    auto now = std::chrono::system_clock::now();
     
+    // Sin flusher (antes de arrancar o tras el destructor) se escribe directo
+    if (!m_running.load(std::memory_order_acquire)) {
+        std::string message;
+        if (format) {
+            formatMessage(message, format, std::string(payload));
+        } else {
+            message.assign(payload);
+        }
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
+        writeLine(level, "[" + formatTimestamp(now) + "] [" + levelToString(level) + "] " + message);
+        if (m_logFile.is_open()) {
+            m_logFile.flush();
+        }
+        return;
+    }
+    
+    LogOverflowPolicy policy = m_overflowPolicy.load(std::memory_order_relaxed);
+    bool mayDrop = policy == LogOverflowPolicy::DROP_ALL ||
+                   (policy == LogOverflowPolicy::DROP_LOW_PRIORITY && level < LogLevel::LOG_WARNING);
+    
+    // Reservar hueco: CAS sobre la posición de escritura
+    LogSlot* slot = nullptr;
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &m_ring[pos & (RING_CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Buffer lleno
+            if (mayDrop) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                m_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            m_wakeCv.notify_one();
+            std::this_thread::yield();
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    
+    slot->level = level;
+    slot->time = now;
+    slot->format = format;
+    slot->payload.assign(payload);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    
+    // Solo se paga el notify si el flusher está dormido
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_flusherIdle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wakeCv.notify_one();
+    }
+    
+    // Un CRITICAL suele preceder a un cierre: no volver hasta que esté escrito
+    if (level == LogLevel::LOG_CRITICAL) {
+        flush();
+    }
+}
+
+void Logger::flush() {
+    if (!m_running.load()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_logFile.is_open()) {
+            m_logFile.flush();
+        }
+        return;
+    }
+    
+    size_t target = m_enqueuePos.load();
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_wakeCv.notify_one();
+    m_writtenCv.wait(lock, [this, target]() {
+        return m_writtenPos.load() >= target || !m_running.load();
+    });
+}
+
+void Logger::flusherThread() {
+    for (;;) {
+        size_t written = drain();
+        
+        if (written > 0) {
+            {
+                std::lock_guard<std::mutex> lock(m_wakeMutex);
+                m_writtenPos.store(m_dequeuePos);
+            }
+            m_writtenCv.notify_all();
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_writtenPos.store(m_dequeuePos);
+        m_writtenCv.notify_all();
+        if (!m_running.load()) {
+            break;
+        }
+        
+        // Marcarse dormido y volver a mirar: un productor que publicó antes
+        // de ver la marca ya es visible aquí (barreras seq_cst en ambos lados)
+        m_flusherIdle.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const LogSlot& next = m_ring[m_dequeuePos & (RING_CAPACITY - 1)];
+        if (next.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1 &&
+            m_dropped.load(std::memory_order_relaxed) == 0) {
+            m_wakeCv.wait_for(lock, FLUSH_INTERVAL);
+        }
+        m_flusherIdle.store(false);
+    }
+    
+    // Lo que quede tras la última pasada
+    drain();
+    m_writtenPos.store(m_dequeuePos);
+    m_writtenCv.notify_all();
+}
+
+size_t Logger::drain() {
+    size_t count = 0;
+    std::string line;
     std::lock_guard<std::mutex> lock(m_mutex);
     
-    std::string timestamp = getCurrentTimestamp();
-    std::string levelStr = levelToString(level);
+    for (;;) {
+        LogSlot& slot = m_ring[m_dequeuePos & (RING_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+            break;
+        }
+        
+        line.clear();
+        line += "[";
+        line += formatTimestamp(slot.time);
+        line += "] [";
+        line += levelToString(slot.level);
+        line += "] ";
+        if (slot.format) {
+            formatMessage(line, slot.format, slot.payload);
+        } else {
+            line += slot.payload;
+        }
+        LogLevel level = slot.level;
+        
+        // Liberar el hueco antes de escribir: los productores no esperan al disco
+        slot.sequence.store(m_dequeuePos + RING_CAPACITY, std::memory_order_release);
+        m_dequeuePos++;
+        
+        writeLine(level, line);
+        count++;
+    }
     
-    std::string logLine = "[" + timestamp + "] [" + levelStr + "] " + message;
+    uint64_t dropped = m_dropped.exchange(0);
+    if (dropped > 0) {
+        writeLine(LogLevel::LOG_WARNING, "[" + formatTimestamp(std::chrono::system_clock::now()) +
+                  "] [WARNING] " + std::to_string(dropped) + " log message(s) dropped (buffer full)");
+        count++;
+    }
     
+    // Un flush por lote en lugar de uno por línea
+    if (count > 0) {
+        if (m_logFile.is_open()) {
+            m_logFile.flush();
+        }
+#ifndef TELEGRAMCLOUD_ANDROID
+        std::cout.flush();
+#endif
+    }
+    return count;
+}
+
+void Logger::writeLine(LogLevel level, const std::string& line) {
 #ifdef TELEGRAMCLOUD_ANDROID
     // En Android, usar __android_log_print para que aparezca en logcat
     android_LogPriority prio = ANDROID_LOG_DEBUG;
@@ -110,21 +408,20 @@ void Logger::log(LogLevel level, const std::string& message) {
         case LogLevel::LOG_ERROR: prio = ANDROID_LOG_ERROR; break;
         case LogLevel::LOG_CRITICAL: prio = ANDROID_LOG_FATAL; break;
     }
-    __android_log_print(prio, ANDROID_LOG_TAG, "%s", logLine.c_str());
+    __android_log_print(prio, ANDROID_LOG_TAG, "%s", line.c_str());
 #endif
-    
+
     // Escribir a archivo
     if (m_logFile.is_open()) {
-        m_logFile << logLine << std::endl;
-        m_logFile.flush(); // Flush inmediato para debugging
+        m_logFile << line << '\n';
     }
-    
+
 #ifndef TELEGRAMCLOUD_ANDROID
     // Escribir también a consola (solo en desktop)
     if (level >= LogLevel::LOG_WARNING) {
-        std::cerr << logLine << std::endl;
+        std::cerr << line << '\n';
     } else {
-        std::cout << logLine << std::endl;
+        std::cout << line << '\n';
     }
 #endif
 }
@@ -150,4 +447,3 @@ void Logger::critical(const std::string& message) {
 }
 
 } // namespace TelegramCloud
-
@@ -8,6 +8,7 @@
 #include "chunkeddownload.h"
 #include "batchoperations.h"
 #include "logger.h"
+#include "cryptoengine.h"
 #include "backupmanager.h"
 #include <wx/hyperlink.h>
 #include <wx/stdpaths.h>
@@ -36,10 +37,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
-#include <openssl/aes.h>
 #include <openssl/rand.h>
-#include <openssl/evp.h>
-#include <openssl/sha.h>
 
 namespace TelegramCloud {
 void MainWindow::OnCreateBackup(wxCommandEvent&) {
@@ -73,7 +71,7 @@ void MainWindow::OnCreateBackup(wxCommandEvent&) {
 
     // Ejecutar en thread secundario para no bloquear UI
     std::thread([this, outPath, pwd, label=wxString(buf)]() {
-        bool ok = BackupManager::createZipBackup(outPath, pwd);
+        bool ok = BackupManager::createZipBackup(outPath, pwd, m_database.get());
         if (!ok) {
             wxTheApp->CallAfter([this]() {
                 m_uploadProgress->Hide();
@@ -2329,48 +2327,8 @@ void MainWindow::LoadFiles() {
         return;
     }
     
-    std::vector<FileInfo> files = m_database->getFiles();
-    
-    // Apply search filter
-    if (!m_currentSearch.empty()) {
-        std::vector<FileInfo> filteredFiles;
-        for (const FileInfo& file : files) {
-            std::string fileName = file.fileName;
-            std::string searchTerm = m_currentSearch;
-            
-            // Convert to lowercase for case-insensitive search
-            std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
-            std::transform(searchTerm.begin(), searchTerm.end(), searchTerm.begin(), ::tolower);
-            
-            if (fileName.find(searchTerm) != std::string::npos) {
-                filteredFiles.push_back(file);
-            }
-        }
-        files = filteredFiles;
-    }
-    
-    // Apply sorting
-    std::sort(files.begin(), files.end(), [this](const FileInfo& a, const FileInfo& b) {
-        bool result = false;
-        
-        if (m_currentSortBy == "name") {
-            result = a.fileName < b.fileName;
-        } else if (m_currentSortBy == "size") {
-            result = a.fileSize < b.fileSize;
-        } else if (m_currentSortBy == "date") {
-            result = a.uploadDate < b.uploadDate;
-        } else if (m_currentSortBy == "type") {
-            result = a.mimeType < b.mimeType;
-        } else {
-            result = a.fileName < b.fileName; // Default to name
-        }
-        
-        return m_sortAscending ? result : !result;
-    });
-    
-    LOG_INFO("Loading " + std::to_string(files.size()) + " files into UI (search: '" + m_currentSearch + "', sort: " + m_currentSortBy + ")");
-    
-    for (const FileInfo& file : files) {
+    size_t loaded = 0;
+    auto addFileRow = [this, &loaded](const FileInfo& file) {
         // Agregar candado si está encriptado
         wxString displayName = wxString::FromUTF8(file.fileName);
         if (file.isEncrypted) {
@@ -2403,7 +2361,62 @@ void MainWindow::LoadFiles() {
         wxString correctMimeType = wxString::FromUTF8(detectMimeType(wxString::FromUTF8(file.fileName)));
         m_filesListCtrl->SetItem(index, 3, correctMimeType);
         m_filesListCtrl->SetItem(index, 4, wxString::FromUTF8(file.uploadDate));
+        loaded++;
+    };
+    
+    m_filesListCtrl->Freeze();
+    if (!m_currentSearch.empty() || m_currentSortBy == "type") {
+        // Búsqueda (índice FTS) o tipo (sin índice): conjunto acotado, ordenar en memoria
+        std::vector<FileInfo> files;
+        if (m_currentSearch.empty()) {
+            files = m_database->getFiles();
+        } else {
+            std::string cursor;
+            do {
+                FileSearchPage page = m_database->search(m_currentSearch, 500, cursor);
+                if (!page.ok) {
+                    break;
+                }
+                files.insert(files.end(), std::make_move_iterator(page.files.begin()),
+                             std::make_move_iterator(page.files.end()));
+                cursor = page.nextCursor;
+            } while (!cursor.empty());
+        }
+        
+        auto less = [this](const FileInfo& a, const FileInfo& b) {
+            if (m_currentSortBy == "size") {
+                return a.fileSize < b.fileSize;
+            } else if (m_currentSortBy == "date") {
+                return a.uploadDate < b.uploadDate;
+            } else if (m_currentSortBy == "type") {
+                return a.mimeType < b.mimeType;
+            }
+            return a.fileName < b.fileName; // Default to name
+        };
+        std::sort(files.begin(), files.end(), [this, &less](const FileInfo& a, const FileInfo& b) {
+            return m_sortAscending ? less(a, b) : less(b, a);
+        });
+        for (const FileInfo& file : files) {
+            addFileRow(file);
+        }
+    } else {
+        // Nombre, tamaño y fecha salen ya ordenados del índice, fila a fila
+        FileListOptions options;
+        options.sortBy = m_currentSortBy == "size" ? FileSortOrder::Size
+                       : m_currentSortBy == "date" ? FileSortOrder::Date
+                       : FileSortOrder::Name;   // Default to name
+        options.ascending = m_sortAscending;
+        options.limit = 0;
+        
+        std::string nextCursor;
+        m_database->listFiles(options, [&](const FileInfo& file) {
+            addFileRow(file);
+            return true;
+        }, nextCursor);
     }
+    m_filesListCtrl->Thaw();
+    
+    LOG_INFO("Loaded " + std::to_string(loaded) + " files into UI (search: '" + m_currentSearch + "', sort: " + m_currentSortBy + ")");
     
     LOG_DEBUG("Files loaded successfully into list");
 }
@@ -2431,36 +2444,38 @@ void MainWindow::UpdateStats() {
              std::to_string(totalStorage) + " bytes");
 }
 
-// Encriptación/desencriptación de archivos completos
+// Encriptación/desencriptación de archivos completos (streaming, formato salt | iv | ciphertext)
 bool MainWindow::encryptFile(const std::string& inputPath, const std::string& outputPath, const std::string& password) {
     try {
-        // Leer archivo completo
         std::ifstream inFile(inputPath, std::ios::binary);
         if (!inFile) {
             LOG_ERROR("Failed to open input file for encryption: " + inputPath);
             return false;
         }
         
-        std::vector<char> fileData((std::istreambuf_iterator<char>(inFile)),
-                                    std::istreambuf_iterator<char>());
-        inFile.close();
+        std::string salt = generateRandomSalt();
+        std::string iv = CryptoEngine::randomBytes(CryptoEngine::IV_SIZE);
+        std::string key = deriveCombinedKey(password, salt);
         
-        // Convertir a string
-        std::string plaintext(fileData.begin(), fileData.end());
-        
-        // Encriptar
-        std::string encrypted = aesEncrypt(plaintext, password);
+        bool ok = false;
+        {
+            std::ofstream outFile(outputPath, std::ios::binary | std::ios::trunc);
+            if (!outFile) {
+                LOG_ERROR("Failed to open output file for encryption: " + outputPath);
+                return false;
+            }
+            outFile.write(salt.data(), salt.size());
+            outFile.write(iv.data(), iv.size());
+            ok = outFile && CryptoEngine::encryptStream(inFile, outFile, key, iv);
+        }
         
-        // Escribir archivo encriptado
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) {
-            LOG_ERROR("Failed to open output file for encryption: " + outputPath);
+        if (!ok) {
+            LOG_ERROR("File encryption failed: " + inputPath);
+            std::error_code ec;
+            std::filesystem::remove(outputPath, ec);
             return false;
         }
         
-        outFile.write(encrypted.c_str(), encrypted.size());
-        outFile.close();
-        
         LOG_INFO("File encrypted successfully: " + outputPath);
         return true;
         
@@ -2474,58 +2489,37 @@ bool MainWindow::decryptFile(const std::string& inputPath, const std::string& ou
     try {
         LOG_INFO("Starting file decryption: " + inputPath);
         
-        // Leer archivo encriptado
         std::ifstream inFile(inputPath, std::ios::binary);
         if (!inFile) {
             LOG_ERROR("Failed to open input file for decryption: " + inputPath);
             return false;
         }
         
-        std::vector<char> fileData((std::istreambuf_iterator<char>(inFile)),
-                                    std::istreambuf_iterator<char>());
-        inFile.close();
-        
-        if (fileData.size() < 32) {
-            LOG_ERROR("File too small to be encrypted: " + std::to_string(fileData.size()) + " bytes");
+        char header[CryptoEngine::SALT_SIZE + CryptoEngine::IV_SIZE];
+        if (!inFile.read(header, sizeof(header))) {
+            LOG_ERROR("File too small to be encrypted: " + inputPath);
             return false;
         }
         
-        LOG_INFO("File read successfully, size: " + std::to_string(fileData.size()) + " bytes");
-        
-        // Convertir a string
-        std::string ciphertext(fileData.begin(), fileData.end());
-        
-        // Desencriptar
-        LOG_INFO("Attempting AES decryption...");
-        std::string decrypted;
-        try {
-            decrypted = aesDecrypt(ciphertext, password);
-        } catch (const std::exception& e) {
-            LOG_ERROR("AES decryption error: " + std::string(e.what()));
-            return false;
-        }
-        
-        // Verificar que la desencriptación produjo datos válidos
-        if (decrypted.empty()) {
-            LOG_ERROR("Decryption produced empty result");
-            return false;
-        }
+        std::string salt(header, CryptoEngine::SALT_SIZE);
+        std::string iv(header + CryptoEngine::SALT_SIZE, CryptoEngine::IV_SIZE);
+        std::string key = deriveCombinedKey(password, salt);
         
-        LOG_INFO("Decryption successful, output size: " + std::to_string(decrypted.size()) + " bytes");
-        
-        // Escribir archivo desencriptado
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) {
-            LOG_ERROR("Failed to open output file for decryption: " + outputPath);
-            return false;
+        bool ok = false;
+        {
+            std::ofstream outFile(outputPath, std::ios::binary | std::ios::trunc);
+            if (!outFile) {
+                LOG_ERROR("Failed to open output file for decryption: " + outputPath);
+                return false;
+            }
+            ok = CryptoEngine::decryptStream(inFile, outFile, key, iv);
         }
         
-        outFile.write(decrypted.c_str(), decrypted.size());
-        outFile.close();
-        
-        // Verificar que el archivo se escribió correctamente
-        if (!outFile.good()) {
-            LOG_ERROR("Error writing decrypted file to disk");
+        // El padding solo se valida al final: descartar la salida parcial
+        if (!ok) {
+            LOG_ERROR("AES decryption failed - wrong password?");
+            std::error_code ec;
+            std::filesystem::remove(outputPath, ec);
             return false;
         }
         
@@ -2554,94 +2548,24 @@ std::string MainWindow::generateRandomSalt() {
 }
 
 std::string MainWindow::deriveKey(const std::string& password, const std::string& salt) {
-    std::string key(32, 0); // 256 bits = 32 bytes
-    
-    if (PKCS5_PBKDF2_HMAC(
-        password.c_str(), password.length(),
-        reinterpret_cast<const unsigned char*>(salt.c_str()), salt.length(),
-        10000, // iterations
-        EVP_sha256(),
-        32,    // key length
-        reinterpret_cast<unsigned char*>(&key[0])
-    ) != 1) {
-        throw std::runtime_error("Key derivation failed");
-    }
-    
-    return key;
+    return CryptoEngine::deriveKeyPbkdf2Cached(password, salt);
+}
+
+std::string MainWindow::deriveCombinedKey(const std::string& password, const std::string& salt) {
+    // Clave PBKDF2 del usuario mezclada con la clave embebida ofuscada
+    std::string embedded(ObfuscatedStrings::LINK_SECRET());
+    std::string key = deriveKey(password, salt);
+    SecretWipe wipeKey(key);
+    return CryptoEngine::sha256(key, embedded);
 }
 
 std::string MainWindow::aesEncrypt(const std::string& plaintext, const std::string& password) {
-    // Generar salt aleatorio
     std::string salt = generateRandomSalt();
-    
-    // Derivar clave de 256 bits
-    std::string userKey = deriveKey(password, salt);
-    // Mezclar con clave embebida ofuscada
-    std::string embedded(ObfuscatedStrings::LINK_SECRET());
-    unsigned char combined[32];
-    EVP_MD_CTX* mdctx1 = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(mdctx1, EVP_sha256(), nullptr);
-    EVP_DigestUpdate(mdctx1, userKey.data(), userKey.size());
-    EVP_DigestUpdate(mdctx1, embedded.data(), embedded.size());
-    unsigned int outlen1 = 0;
-    EVP_DigestFinal_ex(mdctx1, combined, &outlen1);
-    EVP_MD_CTX_free(mdctx1);
-    std::string key(reinterpret_cast<char*>(combined), 32);
-    
-    // Inicializar contexto de encriptación
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Failed to create encryption context");
-    }
-    
-    // Generar IV aleatorio
-    unsigned char iv[AES_BLOCK_SIZE];
-    if (RAND_bytes(iv, AES_BLOCK_SIZE) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to generate IV");
-    }
-    
-    // Inicializar encriptación AES-256-CBC
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, 
-                          reinterpret_cast<const unsigned char*>(key.c_str()), iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to initialize encryption");
-    }
-    
-    // Preparar buffer de salida
-    int len;
-    int ciphertext_len;
-    std::string ciphertext(plaintext.length() + AES_BLOCK_SIZE, 0);
-    
-    // Encriptar datos
-    if (EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(&ciphertext[0]), &len,
-                         reinterpret_cast<const unsigned char*>(plaintext.c_str()), plaintext.length()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Encryption update failed");
-    }
-    ciphertext_len = len;
-    
-    // Finalizar encriptación
-    if (EVP_EncryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&ciphertext[0]) + len, &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Encryption finalization failed");
-    }
-    ciphertext_len += len;
-    
-    // Limpiar contexto
-    EVP_CIPHER_CTX_free(ctx);
-    
-    // Redimensionar resultado
-    ciphertext.resize(ciphertext_len);
+    std::string iv = CryptoEngine::randomBytes(CryptoEngine::IV_SIZE);
+    std::string key = deriveCombinedKey(password, salt);
     
     // Combinar: salt (16) + iv (16) + ciphertext
-    std::string result;
-    result.reserve(16 + 16 + ciphertext.length());
-    result += salt;
-    result += std::string(reinterpret_cast<char*>(iv), AES_BLOCK_SIZE);
-    result += ciphertext;
-    
-    return result;
+    return salt + iv + CryptoEngine::encrypt(plaintext, key, iv);
 }
 
 std::string MainWindow::aesDecrypt(const std::string& ciphertext, const std::string& password) {
@@ -2649,65 +2573,11 @@ std::string MainWindow::aesDecrypt(const std::string& ciphertext, const std::str
         throw std::runtime_error("Invalid ciphertext length");
     }
     
-    // Extraer salt, IV y datos encriptados
     std::string salt = ciphertext.substr(0, 16);
     std::string iv = ciphertext.substr(16, 16);
-    std::string encrypted_data = ciphertext.substr(32);
-    
-    // Derivar clave y mezclar con secreta embebida
-    std::string userKey = deriveKey(password, salt);
-    std::string embedded(ObfuscatedStrings::LINK_SECRET());
-    unsigned char combined[32];
-    EVP_MD_CTX* mdctx2 = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(mdctx2, EVP_sha256(), nullptr);
-    EVP_DigestUpdate(mdctx2, userKey.data(), userKey.size());
-    EVP_DigestUpdate(mdctx2, embedded.data(), embedded.size());
-    unsigned int outlen2 = 0;
-    EVP_DigestFinal_ex(mdctx2, combined, &outlen2);
-    EVP_MD_CTX_free(mdctx2);
-    std::string key(reinterpret_cast<char*>(combined), 32);
-    
-    // Inicializar contexto de desencriptación
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Failed to create decryption context");
-    }
-    
-    // Inicializar desencriptación AES-256-CBC
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                          reinterpret_cast<const unsigned char*>(key.c_str()),
-                          reinterpret_cast<const unsigned char*>(iv.c_str())) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to initialize decryption");
-    }
+    std::string key = deriveCombinedKey(password, salt);
     
-    // Preparar buffer de salida
-    int len;
-    int plaintext_len;
-    std::string plaintext(encrypted_data.length() + AES_BLOCK_SIZE, 0);
-    
-    // Desencriptar datos
-    if (EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]), &len,
-                         reinterpret_cast<const unsigned char*>(encrypted_data.c_str()), encrypted_data.length()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Decryption update failed");
-    }
-    plaintext_len = len;
-    
-    // Finalizar desencriptación
-    if (EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]) + len, &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Decryption finalization failed - wrong password?");
-    }
-    plaintext_len += len;
-    
-    // Limpiar contexto
-    EVP_CIPHER_CTX_free(ctx);
-    
-    // Redimensionar resultado
-    plaintext.resize(plaintext_len);
-    
-    return plaintext;
+    return CryptoEngine::decrypt(ciphertext.substr(32), key, iv);
 }
 
 std::string simpleEncrypt(const std::string& data, const std::string& key) {
@@ -3128,7 +2998,13 @@ void MainWindow::OnDownloadFromLink(wxCommandEvent& event) {
                 // Progress callback
                 UniversalLinkProgressCallback progressCallback = [this](int current, int total, const std::string& fileName, double percent) {
                     wxTheApp->CallAfter([this, current, total, fileName, percent]() {
-                        m_uploadProgress->SetValue((int)percent);
+                        // Sin nombre: progreso agregado del enlace, que mueve la barra;
+                        // el resto son detalles del archivo en curso para la etiqueta
+                        if (fileName.empty()) {
+                            m_uploadProgress->SetValue((int)percent);
+                            m_uploadProgress->SetToolTip(wxString::Format("Files %d/%d", current, total));
+                            return;
+                        }
                         
                         wxString statusText;
                         
@@ -0,0 +1,195 @@
+#include "metadatawriter.h"
+#include "logger.h"
+#include <sqlite3.h>
+#include <algorithm>
+
+namespace TelegramCloud {
+
+MetadataWriter::MetadataWriter(BatchRunner runner, std::chrono::milliseconds interval, size_t maxBatch)
+    : m_runner(std::move(runner))
+    , m_interval(interval)
+    , m_maxBatch(maxBatch)
+    , m_enqueued(0)
+    , m_committed(0)
+    , m_lastFailure(0)
+    , m_batches(0)
+    , m_operations(0)
+    , m_flushRequested(false)
+    , m_stopping(false) {
+    m_thread = std::thread(&MetadataWriter::run, this);
+}
+
+MetadataWriter::~MetadataWriter() {
+    stop();
+}
+
+void MetadataWriter::enqueue(Operation operation) {
+    enqueue(std::string(), std::move(operation));
+}
+
+void MetadataWriter::enqueue(const std::string& coalesceKey, Operation operation) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_stopping) {
+            m_enqueued++;
+            if (!coalesceKey.empty()) {
+                auto it = m_keyIndex.find(coalesceKey);
+                if (it != m_keyIndex.end()) {
+                    m_queue[it->second].operation = std::move(operation);
+                    return;
+                }
+                m_keyIndex[coalesceKey] = m_queue.size();
+            }
+            m_queue.push_back({coalesceKey, std::move(operation)});
+            // La primera abre la ventana de agrupación; un lote lleno la cierra
+            if (m_queue.size() == 1 || m_queue.size() >= m_maxBatch) {
+                m_wake.notify_one();
+            }
+            return;
+        }
+    }
+
+    // Detenido: escritura inmediata
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sequence = ++m_enqueued;
+    }
+    bool committed = m_runner({operation});
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!committed) {
+        LOG_WARNING("Metadata write was not committed");
+        m_lastFailure = std::max(m_lastFailure, sequence);
+    }
+    m_committed = std::max(m_committed, sequence);
+    m_drained.notify_all();
+}
+
+uint64_t MetadataWriter::sequence() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_enqueued;
+}
+
+bool MetadataWriter::flush(uint64_t since) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Una operación que llama a flush() desde el propio hilo escritor se bloquearía
+    if (std::this_thread::get_id() == m_thread.get_id()) {
+        return true;
+    }
+    uint64_t target = m_enqueued;
+    if (m_committed < target) {
+        m_flushRequested = true;
+        m_wake.notify_one();
+        m_drained.wait(lock, [this, target] { return m_committed >= target; });
+    }
+    return m_lastFailure <= since;
+}
+
+void MetadataWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+        m_wake.notify_one();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool MetadataWriter::runInTransaction(sqlite3* db, const std::vector<Operation>& operations) {
+    if (!db) {
+        return false;
+    }
+
+    // Otra conexión (lectores, backup) puede tener el lock de escritura un momento
+    int rc = SQLITE_BUSY;
+    for (int attempt = 0; attempt < BEGIN_ATTEMPTS; attempt++) {
+        rc = sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_BUSY && rc != SQLITE_LOCKED) {
+            break;
+        }
+        std::this_thread::sleep_for(BEGIN_RETRY_DELAY * (attempt + 1));
+    }
+    if (rc != SQLITE_OK) {
+        LOG_ERROR("Failed to begin metadata batch: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+
+    for (size_t i = 0; i < operations.size(); i++) {
+        if (!operations[i]()) {
+            LOG_ERROR("Metadata write " + std::to_string(i + 1) + "/" + std::to_string(operations.size()) +
+                      " failed; rolling back batch");
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return false;
+        }
+    }
+
+    if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("Failed to commit metadata batch: " + std::string(sqlite3_errmsg(db)));
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+uint64_t MetadataWriter::batchesCommitted() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_batches;
+}
+
+uint64_t MetadataWriter::operationsCommitted() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_operations;
+}
+
+void MetadataWriter::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            break;   // detenido y sin nada pendiente
+        }
+
+        // Ventana de agrupación: hasta INTERVAL, un lote lleno, flush() o stop()
+        m_wake.wait_for(lock, m_interval, [this] {
+            return m_stopping || m_flushRequested || m_queue.size() >= m_maxBatch;
+        });
+
+        std::vector<Pending> batch;
+        batch.swap(m_queue);
+        m_keyIndex.clear();
+        m_flushRequested = false;
+        uint64_t target = m_enqueued;
+        lock.unlock();
+
+        std::vector<Operation> operations;
+        operations.reserve(batch.size());
+        for (auto& pending : batch) {
+            operations.push_back(std::move(pending.operation));
+        }
+
+        bool committed = m_runner(operations);
+        if (!committed) {
+            // flush() lo notifica; en la reanudación los chunks sin registrar se repiten
+            LOG_WARNING("Metadata batch of " + std::to_string(operations.size()) + " writes was not committed");
+        }
+
+        lock.lock();
+        if (!committed) {
+            m_lastFailure = target;
+        }
+        m_committed = target;
+        m_batches++;
+        m_operations += operations.size();
+        m_drained.notify_all();
+    }
+
+    m_committed = m_enqueued;
+    m_drained.notify_all();
+}
+
+} // namespace TelegramCloud
@@ -0,0 +1,178 @@
+#include "readconnectionpool.h"
+#include "logger.h"
+
+namespace TelegramCloud {
+
+ReadConnectionPool::ReadConnectionPool(Opener opener, size_t maxConnections)
+    : m_opener(std::move(opener))
+    , m_maxConnections(maxConnections > 0 ? maxConnections : 1)
+    , m_opening(0)
+    , m_closed(false)
+    , m_openFailed(false) {
+}
+
+ReadConnectionPool::~ReadConnectionPool() {
+    close();
+}
+
+ReadConnectionPool::Lease ReadConnectionPool::acquire() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        if (m_closed) {
+            return Lease();
+        }
+
+        for (Connection* connection : m_connections) {
+            if (!connection->inUse) {
+                connection->inUse = true;
+                return Lease(this, connection);
+            }
+        }
+
+        // Abrir otra si queda hueco; la derivación de clave es lenta, fuera del mutex
+        if (!m_openFailed && m_connections.size() + m_opening < m_maxConnections) {
+            m_opening++;
+            lock.unlock();
+            sqlite3* db = m_opener();
+            lock.lock();
+            m_opening--;
+
+            if (!db) {
+                // No reintentar en cada lectura: el llamador usará la conexión principal
+                m_openFailed = true;
+                m_available.notify_all();
+                if (m_connections.empty()) {
+                    return Lease();
+                }
+                continue;
+            }
+            if (m_closed) {
+                sqlite3_close(db);
+                m_available.notify_all();
+                return Lease();
+            }
+
+            Connection* connection = new Connection();
+            connection->db = db;
+            connection->inUse = true;
+            m_connections.push_back(connection);
+            LOG_DEBUG("Read connection opened (" + std::to_string(m_connections.size()) + "/" +
+                      std::to_string(m_maxConnections) + ")");
+            return Lease(this, connection);
+        }
+
+        if (m_connections.empty() && m_opening == 0) {
+            return Lease();
+        }
+        m_available.wait(lock);
+    }
+}
+
+void ReadConnectionPool::giveBack(Connection* connection) {
+    // Las sentencias quedan preparadas para el siguiente Lease
+    for (auto& entry : connection->statements) {
+        sqlite3_reset(entry.second);
+        sqlite3_clear_bindings(entry.second);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    connection->inUse = false;
+    m_available.notify_all();
+}
+
+void ReadConnectionPool::close() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_available.wait(lock, [this] {
+        if (m_opening > 0) {
+            return false;
+        }
+        for (Connection* connection : m_connections) {
+            if (connection->inUse) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    for (Connection* connection : m_connections) {
+        for (auto& entry : connection->statements) {
+            sqlite3_finalize(entry.second);
+        }
+        sqlite3_close(connection->db);
+        delete connection;
+    }
+    m_connections.clear();
+}
+
+size_t ReadConnectionPool::openConnections() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_connections.size();
+}
+
+// ============================================================================
+// Lease
+// ============================================================================
+
+ReadConnectionPool::Lease::Lease(ReadConnectionPool* pool, Connection* connection)
+    : m_pool(pool)
+    , m_connection(connection) {
+}
+
+ReadConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : m_pool(other.m_pool)
+    , m_connection(other.m_connection) {
+    other.m_pool = nullptr;
+    other.m_connection = nullptr;
+}
+
+ReadConnectionPool::Lease& ReadConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        reset();
+        m_pool = other.m_pool;
+        m_connection = other.m_connection;
+        other.m_pool = nullptr;
+        other.m_connection = nullptr;
+    }
+    return *this;
+}
+
+ReadConnectionPool::Lease::~Lease() {
+    reset();
+}
+
+void ReadConnectionPool::Lease::reset() {
+    if (m_pool && m_connection) {
+        m_pool->giveBack(m_connection);
+    }
+    m_pool = nullptr;
+    m_connection = nullptr;
+}
+
+sqlite3* ReadConnectionPool::Lease::db() const {
+    return m_connection ? m_connection->db : nullptr;
+}
+
+int ReadConnectionPool::Lease::prepare(const char* sql, sqlite3_stmt** stmt) {
+    // La conexión es exclusiva del Lease: la caché no necesita más cerrojos
+    auto it = m_connection->statements.find(sql);
+    if (it != m_connection->statements.end()) {
+        *stmt = it->second;
+        return SQLITE_OK;
+    }
+
+    int rc = sqlite3_prepare_v3(m_connection->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        m_connection->statements.emplace(sql, *stmt);
+    }
+    return rc;
+}
+
+void ReadConnectionPool::Lease::release(sqlite3_stmt* stmt) {
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+}
+
+} // namespace TelegramCloud
@@ -1,6 +1,7 @@
 #include "telegramhandler.h"
 #include "config.h"
 #include "logger.h"
+#include "cryptoengine.h"
 #include <curl/curl.h>
 #include <sstream>
 #include <fstream>
@@ -31,6 +32,19 @@ static size_t WriteFileCallback(void* ptr, size_t size, size_t nmemb, FILE* stre
     return fwrite(ptr, size, nmemb, stream);
 }
 
+// Destino de escritura con digest calculado sobre la marcha
+struct DigestWriteTarget {
+    FILE* stream;
+    Sha256Stream* digest;
+};
+
+static size_t WriteFileDigestCallback(void* ptr, size_t size, size_t nmemb, void* userp) {
+    DigestWriteTarget* target = static_cast<DigestWriteTarget*>(userp);
+    size_t written = fwrite(ptr, size, nmemb, target->stream);
+    target->digest->update(ptr, written * size);
+    return written;
+}
+
 TelegramHandler::TelegramHandler() : m_currentBotIndex(0) {
     Config& config = Config::instance();
     m_botTokens = config.allTokens();
@@ -325,7 +339,8 @@ std::string TelegramHandler::getFilePath(const std::string& fileId, const std::s
     return "";
 }
 
-bool TelegramHandler::downloadFile(const std::string& fileId, const std::string& savePath, const std::string& botToken) {
+bool TelegramHandler::downloadFile(const std::string& fileId, const std::string& savePath, const std::string& botToken,
+                                   std::string* sha256Out) {
     Config& config = Config::instance();
     
     LOG_INFO("Starting download: " + fileId + " to " + savePath);
@@ -357,9 +372,18 @@ bool TelegramHandler::downloadFile(const std::string& fileId, const std::string&
         return false;
     }
     
+    // Digest opcional calculado en el mismo paso de escritura
+    Sha256Stream digest;
+    DigestWriteTarget digestTarget{fp, &digest};
+    
     curl_easy_setopt(curl, CURLOPT_URL, downloadUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+    if (sha256Out) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileDigestCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &digestTarget);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+    }
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L); // 5 minutos
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
@@ -370,6 +394,10 @@ bool TelegramHandler::downloadFile(const std::string& fileId, const std::string&
     fclose(fp);
     curl_easy_cleanup(curl);
     
+    if (sha256Out) {
+        *sha256Out = CryptoEngine::toHex(digest.finish());
+    }
+    
     if (res != CURLE_OK) {
         LOG_ERROR("Download failed: " + std::string(curl_easy_strerror(res)));
         std::remove(savePath.c_str()); // Eliminar archivo parcial
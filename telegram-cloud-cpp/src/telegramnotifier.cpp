@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <chrono>
 #include <thread>
+#include <algorithm>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 
@@ -20,16 +21,92 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::stri
     return size * nmemb;
 }
 
+namespace {
+
+constexpr uint32_t SLOT_BITS = 8;
+constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+static_assert(TelegramNotifier::MAX_OPERATIONS <= (size_t(1) << SLOT_BITS), "MAX_OPERATIONS no cabe en el handle");
+
+// La generación ocupa los bits altos del handle y nunca vale 0
+uint32_t nextGeneration(uint32_t generation) {
+    generation = (generation + 1) & (UINT32_MAX >> SLOT_BITS);
+    return generation == 0 ? 1 : generation;
+}
+
+const char* statusName(OperationStatus status) {
+    switch (status) {
+        case OperationStatus::UPLOADING: return "uploading";
+        case OperationStatus::DOWNLOADING: return "downloading";
+        case OperationStatus::RECONSTRUCTING: return "reconstructing";
+    }
+    return "";
+}
+
+} // namespace
+
+/**
+ * Datos fijos de la operación: no cambian tras el registro, así que los
+ * lectores los usan sin copiar bajo ningún lock. Se retiran en vez de
+ * borrarse mientras pueda haber una instantánea en curso.
+ */
+struct TelegramNotifier::OperationMeta {
+    std::string operationId;
+    OperationType type;
+    std::string fileName;
+    int64_t totalSize;
+    int64_t totalChunks;
+};
+
+/**
+ * Conexión del thread de polling: un único easy handle que se reutiliza
+ * (keep-alive) dentro de un multi handle, para que stop() pueda cortar el
+ * long poll en curso con curl_multi_wakeup.
+ */
+struct TelegramNotifier::PollConnection {
+    CURLM* multi = nullptr;
+    CURL* easy = nullptr;
+    std::string botToken;    // se vuelve a leer de EnvManager tras un error
+    std::string response;
+    
+    PollConnection() : multi(curl_multi_init()) {}
+    
+    ~PollConnection() {
+        if (easy) {
+            curl_easy_cleanup(easy);
+        }
+        if (multi) {
+            curl_multi_cleanup(multi);
+        }
+    }
+};
+
+struct TelegramNotifier::OperationSlot {
+    std::atomic<uint32_t> generation{0};              // cambia en cada alta del slot
+    std::atomic<const OperationMeta*> meta{nullptr};  // nullptr = slot libre
+    std::atomic<int64_t> completedChunks{0};
+    std::atomic<double> progressPercent{0.0};
+    std::atomic<OperationStatus> status{OperationStatus::UPLOADING};
+};
+
 TelegramNotifier::TelegramNotifier(Database* database, TelegramHandler* telegramHandler)
     : m_database(database)
     , m_telegramHandler(telegramHandler)
     , m_isActive(false)
     , m_shouldStop(false)
-    , m_lastUpdateId(0) {
+    , m_slots(new OperationSlot[MAX_OPERATIONS])
+    , m_snapshotReaders(0)
+    , m_nextSlot(0)
+    , m_liveMessageId(0)
+    , m_lastUpdateId(0)
+    , m_poll(std::make_unique<PollConnection>()) {
 }
 
 TelegramNotifier::~TelegramNotifier() {
     stop();
+    
+    for (size_t i = 0; i < MAX_OPERATIONS; i++) {
+        delete m_slots[i].meta.load();
+    }
 }
 
 void TelegramNotifier::start() {
@@ -55,6 +132,17 @@ void TelegramNotifier::stop() {
     m_shouldStop = true;
     m_isActive = false;
     
+    // Despertar al thread esté esperando un reintento o dentro del long poll
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wakeCv.notify_all();
+#if LIBCURL_VERSION_NUM >= 0x074400
+    if (m_poll->multi) {
+        curl_multi_wakeup(m_poll->multi);
+    }
+#endif
+    
     if (m_pollingThread.joinable()) {
         m_pollingThread.join();
     }
@@ -62,55 +150,170 @@ void TelegramNotifier::stop() {
     LOG_INFO("TelegramNotifier stopped");
 }
 
-void TelegramNotifier::registerOperation(const std::string& operationId,
-                                        OperationType type,
-                                        const std::string& fileName,
-                                        int64_t totalSize,
-                                        int64_t totalChunks) {
+OperationHandle TelegramNotifier::registerOperation(const std::string& operationId,
+                                                    OperationType type,
+                                                    const std::string& fileName,
+                                                    int64_t totalSize,
+                                                    int64_t totalChunks) {
     std::lock_guard<std::mutex> lock(m_operationsMutex);
     
-    ActiveOperation op;
-    op.operationId = operationId;
-    op.type = type;
-    op.fileName = fileName;
-    op.totalSize = totalSize;
-    op.totalChunks = totalChunks;
-    op.completedChunks = 0;
-    op.progressPercent = 0.0;
-    op.status = (type == OperationType::UPLOAD) ? "uploading" : "downloading";
+    // Reanudar con el mismo ID reemplaza el registro anterior
+    auto existing = m_handles.find(operationId);
+    if (existing != m_handles.end()) {
+        retireOperationLocked(existing->second, nullptr);
+    }
     
-    m_activeOperations[operationId] = op;
+    // Recorrido circular: un slot recién liberado tarda en reutilizarse
+    OperationSlot* slot = nullptr;
+    size_t index = 0;
+    for (size_t i = 0; i < MAX_OPERATIONS; i++) {
+        index = (m_nextSlot + i) % MAX_OPERATIONS;
+        if (!m_slots[index].meta.load()) {
+            slot = &m_slots[index];
+            break;
+        }
+    }
+    
+    if (!slot) {
+        LOG_WARNING("Too many active operations, not tracking: " + operationId);
+        return INVALID_OPERATION_HANDLE;
+    }
+    m_nextSlot = (index + 1) % MAX_OPERATIONS;
+    
+    auto meta = std::make_unique<OperationMeta>();
+    meta->operationId = operationId;
+    meta->type = type;
+    meta->fileName = fileName;
+    meta->totalSize = totalSize;
+    meta->totalChunks = totalChunks;
+    
+    uint32_t generation = nextGeneration(slot->generation.load());
+    slot->generation.store(generation);
+    slot->completedChunks.store(0);
+    slot->progressPercent.store(0.0);
+    slot->status.store(type == OperationType::UPLOAD ? OperationStatus::UPLOADING : OperationStatus::DOWNLOADING);
+    slot->meta.store(meta.release());
+    
+    OperationHandle handle = (generation << SLOT_BITS) | static_cast<uint32_t>(index);
+    m_handles[operationId] = handle;
     
     LOG_INFO("Registered operation: " + operationId + " (" + fileName + ")");
+    return handle;
 }
 
-void TelegramNotifier::updateOperationProgress(const std::string& operationId,
+TelegramNotifier::OperationSlot* TelegramNotifier::slotFor(OperationHandle handle) const {
+    if (handle == INVALID_OPERATION_HANDLE) {
+        return nullptr;
+    }
+    
+    OperationSlot* slot = &m_slots[handle & SLOT_MASK];
+    if (slot->generation.load(std::memory_order_acquire) != (handle >> SLOT_BITS)) {
+        return nullptr;
+    }
+    return slot;
+}
+
+void TelegramNotifier::updateOperationProgress(OperationHandle handle,
                                               int64_t completedChunks,
-                                              double progressPercent,
-                                              const std::string& status) {
-    std::lock_guard<std::mutex> lock(m_operationsMutex);
+                                              double progressPercent) {
+    // Una baja simultánea puede colar este valor en el siguiente registro del
+    // slot; la próxima actualización de esa operación lo corrige
+    OperationSlot* slot = slotFor(handle);
+    if (slot) {
+        slot->completedChunks.store(completedChunks, std::memory_order_relaxed);
+        slot->progressPercent.store(progressPercent, std::memory_order_relaxed);
+    }
+}
+
+void TelegramNotifier::setOperationStatus(OperationHandle handle, OperationStatus status) {
+    OperationSlot* slot = slotFor(handle);
+    if (slot) {
+        slot->status.store(status, std::memory_order_relaxed);
+    }
+}
+
+std::vector<ActiveOperation> TelegramNotifier::snapshotOperations() const {
+    std::vector<ActiveOperation> operations;
+    
+    // Mientras el contador no vuelva a 0 ninguna descripción retirada se libera
+    m_snapshotReaders.fetch_add(1);
     
-    auto it = m_activeOperations.find(operationId);
-    if (it != m_activeOperations.end()) {
-        it->second.completedChunks = completedChunks;
-        it->second.progressPercent = progressPercent;
-        if (!status.empty()) {
-            it->second.status = status;
+    for (size_t i = 0; i < MAX_OPERATIONS; i++) {
+        const OperationSlot& slot = m_slots[i];
+        const OperationMeta* meta = slot.meta.load();
+        if (!meta) {
+            continue;
+        }
+        
+        ActiveOperation op;
+        op.operationId = meta->operationId;
+        op.type = meta->type;
+        op.fileName = meta->fileName;
+        op.totalSize = meta->totalSize;
+        op.totalChunks = meta->totalChunks;
+        op.completedChunks = slot.completedChunks.load(std::memory_order_relaxed);
+        op.progressPercent = slot.progressPercent.load(std::memory_order_relaxed);
+        op.status = statusName(slot.status.load(std::memory_order_relaxed));
+        
+        // Si el slot cambió de operación mientras se leía, el progreso no es suyo
+        if (slot.meta.load() == meta) {
+            operations.push_back(std::move(op));
         }
     }
+    
+    m_snapshotReaders.fetch_sub(1);
+    return operations;
 }
 
-void TelegramNotifier::notifyOperationCompleted(const std::string& operationId,
-                                               const std::string& destination) {
-    std::lock_guard<std::mutex> lock(m_operationsMutex);
+bool TelegramNotifier::retireOperationLocked(OperationHandle handle, ActiveOperation* finalState) {
+    OperationSlot* slot = slotFor(handle);
+    if (!slot) {
+        return false;
+    }
     
-    auto it = m_activeOperations.find(operationId);
-    if (it == m_activeOperations.end()) {
-        LOG_WARNING("Operation not found for completion notification: " + operationId);
-        return;
+    const OperationMeta* meta = slot->meta.load();
+    if (!meta) {
+        return false;
     }
     
-    const auto& op = it->second;
+    if (finalState) {
+        finalState->operationId = meta->operationId;
+        finalState->type = meta->type;
+        finalState->fileName = meta->fileName;
+        finalState->totalSize = meta->totalSize;
+        finalState->totalChunks = meta->totalChunks;
+        finalState->completedChunks = slot->completedChunks.load();
+        finalState->progressPercent = slot->progressPercent.load();
+        finalState->status = statusName(slot->status.load());
+    }
+    
+    // Invalida el handle antes de soltar la descripción
+    slot->generation.store(nextGeneration(slot->generation.load()));
+    slot->meta.store(nullptr);
+    m_handles.erase(meta->operationId);
+    m_retired.emplace_back(meta);
+    reclaimRetiredLocked();
+    return true;
+}
+
+void TelegramNotifier::reclaimRetiredLocked() {
+    // La baja publicó nullptr antes de este load: un lector que aún no ha
+    // entrado ya no puede ver las descripciones retiradas
+    if (m_snapshotReaders.load() == 0) {
+        m_retired.clear();
+    }
+}
+
+void TelegramNotifier::notifyOperationCompleted(OperationHandle handle,
+                                               const std::string& destination) {
+    ActiveOperation op;
+    {
+        std::lock_guard<std::mutex> lock(m_operationsMutex);
+        if (!retireOperationLocked(handle, &op)) {
+            LOG_WARNING("Operation not found for completion notification");
+            return;
+        }
+    }
     
     // Formatear mensaje
     std::ostringstream msg;
@@ -129,29 +332,25 @@ void TelegramNotifier::notifyOperationCompleted(const std::string& operationId,
         msg << "📥 Location: " << destination << "\n\n";
     }
     
-    msg << "🆔 ID: " << operationId;
+    msg << "🆔 ID: " << op.operationId;
     
     // Enviar mensaje
     sendMessage(msg.str());
     
-    // Remover operación
-    m_activeOperations.erase(it);
-    
-    LOG_INFO("Sent completion notification for: " + operationId);
+    LOG_INFO("Sent completion notification for: " + op.operationId);
 }
 
-void TelegramNotifier::notifyOperationFailed(const std::string& operationId,
+void TelegramNotifier::notifyOperationFailed(OperationHandle handle,
                                             const std::string& errorMessage) {
-    std::lock_guard<std::mutex> lock(m_operationsMutex);
-    
-    auto it = m_activeOperations.find(operationId);
-    if (it == m_activeOperations.end()) {
-        LOG_WARNING("Operation not found for failure notification: " + operationId);
-        return;
+    ActiveOperation op;
+    {
+        std::lock_guard<std::mutex> lock(m_operationsMutex);
+        if (!retireOperationLocked(handle, &op)) {
+            LOG_WARNING("Operation not found for failure notification");
+            return;
+        }
     }
     
-    const auto& op = it->second;
-    
     // Formatear mensaje
     std::ostringstream msg;
     
@@ -169,76 +368,145 @@ void TelegramNotifier::notifyOperationFailed(const std::string& operationId,
         msg << "⚠️ Error: " << errorMessage << "\n\n";
     }
     
-    msg << "🆔 ID: " << operationId;
+    msg << "🆔 ID: " << op.operationId;
     
     // Enviar mensaje
     sendMessage(msg.str());
     
-    // Remover operación
-    m_activeOperations.erase(it);
-    
-    LOG_INFO("Sent failure notification for: " + operationId);
+    LOG_INFO("Sent failure notification for: " + op.operationId);
 }
 
-void TelegramNotifier::removeOperation(const std::string& operationId) {
+void TelegramNotifier::removeOperation(OperationHandle handle) {
     std::lock_guard<std::mutex> lock(m_operationsMutex);
-    m_activeOperations.erase(operationId);
+    retireOperationLocked(handle, nullptr);
 }
 
 void TelegramNotifier::pollingThread() {
     LOG_INFO("Polling thread started");
     
+    std::chrono::seconds retryDelay(0);
+    
     while (!m_shouldStop.load()) {
+        bool ok = false;
         try {
-            getUpdates();
+            ok = getUpdates(nextPollTimeout());
+            refreshLiveReport();
         } catch (const std::exception& e) {
             LOG_ERROR("Error in polling thread: " + std::string(e.what()));
         }
         
-        // Sleep mínimo (Long Polling mantiene la conexión abierta hasta 50s)
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Con éxito se vuelve a consultar en seguida: el long poll ya espera
+        // en el servidor. Tras un error, espera creciente interrumpible por stop()
+        if (ok) {
+            retryDelay = std::chrono::seconds(0);
+            continue;
+        }
+        
+        retryDelay = retryDelay.count() == 0 ? POLL_RETRY_MIN : std::min(retryDelay * 2, POLL_RETRY_MAX);
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wakeCv.wait_for(lock, retryDelay, [this]() { return m_shouldStop.load(); });
+    }
+    
+    // El easy handle solo lo usa este thread
+    if (m_poll->easy) {
+        curl_easy_cleanup(m_poll->easy);
+        m_poll->easy = nullptr;
     }
     
     LOG_INFO("Polling thread stopped");
 }
 
-void TelegramNotifier::getUpdates() {
-    std::lock_guard<std::mutex> lock(m_pollingMutex);
+std::chrono::seconds TelegramNotifier::nextPollTimeout() const {
+    if (m_liveMessageId == 0) {
+        return POLL_TIMEOUT;
+    }
     
-    std::string botToken = EnvManager::instance().get("BOT_TOKEN");
-    if (botToken.empty()) {
-        LOG_DEBUG("Bot token not configured for polling");
-        return;
+    // Volver a tiempo para la siguiente edición del informe de progreso
+    auto untilEdit = std::chrono::duration_cast<std::chrono::seconds>(
+        m_lastLiveEdit + LIVE_REPORT_INTERVAL - std::chrono::steady_clock::now());
+    return std::clamp(untilEdit, std::chrono::seconds(1), POLL_TIMEOUT);
+}
+
+bool TelegramNotifier::getUpdates(std::chrono::seconds timeout) {
+    PollConnection& poll = *m_poll;
+    if (!poll.multi) {
+        LOG_ERROR("Failed to initialize CURL multi handle for polling");
+        return false;
     }
     
-    // Construir URL correctamente con Long Polling (timeout reducido para cierre rápido)
-    std::string url = "https://api.telegram.org/bot" + botToken + "/getUpdates";
+    if (poll.botToken.empty()) {
+        poll.botToken = EnvManager::instance().get("BOT_TOKEN");
+        if (poll.botToken.empty()) {
+            LOG_DEBUG("Bot token not configured for polling");
+            return false;
+        }
+    }
+    
+    if (!poll.easy) {
+        poll.easy = curl_easy_init();
+        if (!poll.easy) {
+            LOG_ERROR("Failed to initialize CURL for polling");
+            return false;
+        }
+        curl_easy_setopt(poll.easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(poll.easy, CURLOPT_WRITEDATA, &poll.response);
+        curl_easy_setopt(poll.easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(poll.easy, CURLOPT_NOSIGNAL, 1L);
+    }
+    
+    // Long Polling: el servidor mantiene la petición hasta timeout o hasta que llega un update
+    std::string url = "https://api.telegram.org/bot" + poll.botToken + "/getUpdates?timeout=" +
+                      std::to_string(timeout.count());
     if (m_lastUpdateId > 0) {
-        url += "?offset=" + std::to_string(m_lastUpdateId + 1) + "&timeout=10"; // 10s para permitir cierre rápido
-    } else {
-        url += "?timeout=10"; // 10s
+        url += "&offset=" + std::to_string(m_lastUpdateId + 1);
     }
     
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        LOG_ERROR("Failed to initialize CURL for polling");
-        return;
+    poll.response.clear();
+    curl_easy_setopt(poll.easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(poll.easy, CURLOPT_TIMEOUT, static_cast<long>(timeout.count()) + 10L); // margen sobre el del servidor
+    curl_multi_add_handle(poll.multi, poll.easy);
+    
+    bool done = false;
+    CURLcode res = CURLE_OK;
+    int running = 1;
+    while (!done && !m_shouldStop.load()) {
+        if (curl_multi_perform(poll.multi, &running) != CURLM_OK) {
+            break;
+        }
+        
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(poll.multi, &queued)) {
+            if (msg->msg == CURLMSG_DONE && msg->easy_handle == poll.easy) {
+                res = msg->data.result;
+                done = true;
+            }
+        }
+        if (done || running == 0) {
+            break;
+        }
+        
+        // Esperar actividad del socket; stop() corta la espera
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_poll(poll.multi, nullptr, 0, static_cast<int>(timeout.count() + 10) * 1000, nullptr);
+#else
+        curl_multi_wait(poll.multi, nullptr, 0, 250, nullptr);
+#endif
     }
     
-    std::string response;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 12L); // Ligeramente mayor que timeout del servidor (10s)
+    // Quitar el handle del multi no cierra la conexión: queda en su caché para la siguiente
+    curl_multi_remove_handle(poll.multi, poll.easy);
     
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+    if (m_shouldStop.load()) {
+        return true;
+    }
     
-    if (res != CURLE_OK) {
-        LOG_DEBUG("Failed to get updates: " + std::string(curl_easy_strerror(res)));
-        return;
+    if (!done || res != CURLE_OK) {
+        LOG_DEBUG("Failed to get updates: " + std::string(done ? curl_easy_strerror(res) : "transfer aborted"));
+        return false;
     }
     
+    const std::string& response = poll.response;
+    
     try {
         json j = json::parse(response);
         
@@ -288,13 +556,23 @@ void TelegramNotifier::getUpdates() {
                     }
                 }
             }
-        } else if (j.contains("description")) {
+            return true;
+        }
+        
+        if (j.contains("description")) {
             LOG_ERROR("Telegram API error: " + j["description"].get<std::string>());
         }
+        
+        // Token revocado o cambiado: se vuelve a leer en el siguiente intento
+        int errorCode = j.contains("error_code") ? j["error_code"].get<int>() : 0;
+        if (errorCode == 401 || errorCode == 404) {
+            poll.botToken.clear();
+        }
     } catch (const std::exception& e) {
         LOG_ERROR("Error parsing updates: " + std::string(e.what()));
         LOG_DEBUG("Response: " + response);
     }
+    return false;
 }
 
 void TelegramNotifier::processCommand(const std::string& command) {
@@ -313,24 +591,16 @@ void TelegramNotifier::processCommand(const std::string& command) {
     }
 }
 
-void TelegramNotifier::sendProgressReport() {
-    std::lock_guard<std::mutex> lock(m_operationsMutex);
-    
-    LOG_INFO("Generating progress report (" + std::to_string(m_activeOperations.size()) + " active operations)");
-    
-    if (m_activeOperations.empty()) {
-        LOG_INFO("No active operations, sending empty report");
-        sendMessage("📊 No active operations");
-        return;
+std::string TelegramNotifier::formatProgressReport(const std::vector<ActiveOperation>& operations) {
+    if (operations.empty()) {
+        return "📊 No active operations";
     }
     
     std::ostringstream msg;
     msg << "📊 Active Operations Report\n\n";
     
     int index = 1;
-    for (const auto& pair : m_activeOperations) {
-        const auto& op = pair.second;
-        
+    for (const auto& op : operations) {
         if (op.type == OperationType::UPLOAD) {
             msg << "⬆️ Upload #" << index << "\n";
         } else {
@@ -347,42 +617,65 @@ void TelegramNotifier::sendProgressReport() {
         index++;
     }
     
-    LOG_INFO("Sending progress report message");
-    sendMessage(msg.str());
+    return msg.str();
 }
 
-bool TelegramNotifier::sendMessage(const std::string& message) {
-    std::string botToken = EnvManager::instance().get("BOT_TOKEN");
-    std::string chatId = EnvManager::instance().get("CHAT_ID");
+void TelegramNotifier::sendProgressReport() {
+    std::vector<ActiveOperation> operations = snapshotOperations();
     
-    // Si CHAT_ID está vacío, usar CHANNEL_ID
-    if (chatId.empty()) {
-        chatId = EnvManager::instance().get("CHANNEL_ID");
-        LOG_DEBUG("CHAT_ID not found, using CHANNEL_ID: " + chatId);
+    LOG_INFO("Generating progress report (" + std::to_string(operations.size()) + " active operations)");
+    
+    std::string report = formatProgressReport(operations);
+    int64_t messageId = 0;
+    if (!sendMessage(report, &messageId)) {
+        return;
     }
     
-    if (botToken.empty() || chatId.empty()) {
-        LOG_ERROR("Bot token or chat/channel ID not configured for sending message");
-        LOG_DEBUG("Bot token empty: " + std::string(botToken.empty() ? "yes" : "no") + 
-                 ", Chat/Channel ID empty: " + std::string(chatId.empty() ? "yes" : "no"));
-        return false;
+    // El nuevo informe sustituye al anterior como mensaje vivo; sin
+    // operaciones no hay nada que seguir editando
+    m_liveMessageId = operations.empty() ? 0 : messageId;
+    m_liveMessageText = report;
+    m_lastLiveEdit = std::chrono::steady_clock::now();
+}
+
+void TelegramNotifier::refreshLiveReport() {
+    if (m_liveMessageId == 0) {
+        return;
     }
     
-    LOG_DEBUG("Sending message to chat: " + chatId);
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastLiveEdit < LIVE_REPORT_INTERVAL) {
+        return;
+    }
+    m_lastLiveEdit = now;
     
-    std::string url = "https://api.telegram.org/bot" + botToken + "/sendMessage";
+    std::vector<ActiveOperation> operations = snapshotOperations();
+    std::string report = formatProgressReport(operations);
     
-    // Crear payload JSON
-    json payload;
-    payload["chat_id"] = chatId;
-    payload["text"] = message;
-    payload["parse_mode"] = "HTML";
+    // Editar con el mismo texto es un error en la API; no gasta cuota
+    if (report != m_liveMessageText) {
+        if (!editMessageText(m_liveMessageId, report)) {
+            m_liveMessageId = 0;
+            return;
+        }
+        m_liveMessageText = report;
+    }
     
+    // Última edición con "No active operations": el mensaje queda cerrado
+    if (operations.empty()) {
+        m_liveMessageId = 0;
+    }
+}
+
+// POST JSON a un método de la Bot API; result recibe el campo "result"
+static bool postBotApi(const std::string& botToken, const std::string& method,
+                       const json& payload, json* result) {
+    std::string url = "https://api.telegram.org/bot" + botToken + "/" + method;
     std::string jsonData = payload.dump();
     
     CURL* curl = curl_easy_init();
     if (!curl) {
-        LOG_ERROR("Failed to initialize CURL for sending message");
+        LOG_ERROR("Failed to initialize CURL for " + method);
         return false;
     }
     
@@ -403,7 +696,7 @@ bool TelegramNotifier::sendMessage(const std::string& message) {
     curl_easy_cleanup(curl);
     
     if (res != CURLE_OK) {
-        LOG_ERROR("Failed to send message: " + std::string(curl_easy_strerror(res)));
+        LOG_ERROR("Failed to call " + method + ": " + std::string(curl_easy_strerror(res)));
         return false;
     }
     
@@ -411,20 +704,95 @@ bool TelegramNotifier::sendMessage(const std::string& message) {
     try {
         json j = json::parse(response);
         if (j["ok"].get<bool>()) {
-            LOG_INFO("Message sent successfully");
+            if (result && j.contains("result")) {
+                *result = j["result"];
+            }
             return true;
-        } else {
-            std::string error = j.contains("description") ? j["description"].get<std::string>() : "Unknown error";
-            LOG_ERROR("Telegram API error when sending message: " + error);
-            return false;
         }
+        
+        std::string error = j.contains("description") ? j["description"].get<std::string>() : "Unknown error";
+        
+        // El mensaje ya tenía ese texto: no es un fallo
+        if (error.find("message is not modified") != std::string::npos) {
+            return true;
+        }
+        
+        LOG_ERROR("Telegram API error on " + method + ": " + error);
+        return false;
     } catch (const std::exception& e) {
-        LOG_ERROR("Failed to parse sendMessage response: " + std::string(e.what()));
+        LOG_ERROR("Failed to parse " + method + " response: " + std::string(e.what()));
         LOG_DEBUG("Response: " + response);
         return false;
     }
 }
 
+// Chat de destino: CHAT_ID, o CHANNEL_ID si está vacío
+static bool notificationTarget(std::string& botToken, std::string& chatId) {
+    botToken = EnvManager::instance().get("BOT_TOKEN");
+    chatId = EnvManager::instance().get("CHAT_ID");
+    
+    if (chatId.empty()) {
+        chatId = EnvManager::instance().get("CHANNEL_ID");
+        LOG_DEBUG("CHAT_ID not found, using CHANNEL_ID: " + chatId);
+    }
+    
+    if (botToken.empty() || chatId.empty()) {
+        LOG_ERROR("Bot token or chat/channel ID not configured for sending message");
+        LOG_DEBUG("Bot token empty: " + std::string(botToken.empty() ? "yes" : "no") + 
+                 ", Chat/Channel ID empty: " + std::string(chatId.empty() ? "yes" : "no"));
+        return false;
+    }
+    return true;
+}
+
+bool TelegramNotifier::sendMessage(const std::string& message, int64_t* messageId) {
+    std::string botToken;
+    std::string chatId;
+    if (!notificationTarget(botToken, chatId)) {
+        return false;
+    }
+    
+    LOG_DEBUG("Sending message to chat: " + chatId);
+    
+    // Crear payload JSON
+    json payload;
+    payload["chat_id"] = chatId;
+    payload["text"] = message;
+    payload["parse_mode"] = "HTML";
+    
+    json result;
+    if (!postBotApi(botToken, "sendMessage", payload, &result)) {
+        return false;
+    }
+    
+    if (messageId) {
+        *messageId = result.contains("message_id") ? result["message_id"].get<int64_t>() : 0;
+    }
+    LOG_INFO("Message sent successfully");
+    return true;
+}
+
+bool TelegramNotifier::editMessageText(int64_t messageId, const std::string& message) {
+    std::string botToken;
+    std::string chatId;
+    if (!notificationTarget(botToken, chatId)) {
+        return false;
+    }
+    
+    json payload;
+    payload["chat_id"] = chatId;
+    payload["message_id"] = messageId;
+    payload["text"] = message;
+    payload["parse_mode"] = "HTML";
+    
+    if (!postBotApi(botToken, "editMessageText", payload, nullptr)) {
+        return false;
+    }
+    
+    LOG_DEBUG("Progress message " + std::to_string(messageId) + " updated");
+    return true;
+}
+
 std::string TelegramNotifier::formatSize(int64_t bytes) {
     double sizeMB = bytes / 1024.0 / 1024.0;
     
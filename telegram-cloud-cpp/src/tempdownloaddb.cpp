@@ -1,5 +1,6 @@
 #include "tempdownloaddb.h"
 #include "logger.h"
+#include "cryptoengine.h"
 #include <sqlite3.h>
 #include <filesystem>
 #include <chrono>
@@ -16,6 +17,7 @@ TempDownloadDB::TempDownloadDB()
 }
 
 TempDownloadDB::~TempDownloadDB() {
+    stopWriter();
     if (m_db) {
         sqlite3_close(m_db);
         m_db = nullptr;
@@ -29,13 +31,7 @@ std::string TempDownloadDB::generateEncryptionKey() {
         return "";
     }
     
-    // Convertir a hex
-    std::stringstream ss;
-    for (int i = 0; i < 32; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)key[i];
-    }
-    
-    return ss.str();
+    return CryptoEngine::toHex(key, sizeof(key));
 }
 
 bool TempDownloadDB::initialize() {
@@ -71,10 +67,31 @@ bool TempDownloadDB::initialize() {
         return false;
     }
     
+    m_writer = std::make_unique<MetadataWriter>([this](const std::vector<MetadataWriter::Operation>& operations) {
+        return runBatch(operations);
+    });
+    
     LOG_INFO("Temporary download database initialized successfully (encrypted)");
     return true;
 }
 
+bool TempDownloadDB::runBatch(const std::vector<MetadataWriter::Operation>& operations) {
+    return MetadataWriter::runInTransaction(m_db, operations);
+}
+
+void TempDownloadDB::flushPendingWrites() {
+    if (m_writer) {
+        m_writer->flush();
+    }
+}
+
+void TempDownloadDB::stopWriter() {
+    if (m_writer) {
+        m_writer->stop();
+        m_writer.reset();
+    }
+}
+
 bool TempDownloadDB::encryptDatabase(const std::string& key) {
     std::string pragmaKey = "PRAGMA key = '" + key + "';";
     char* errMsg = nullptr;
@@ -193,6 +210,22 @@ bool TempDownloadDB::saveDownload(const LinkDownloadInfo& info) {
 bool TempDownloadDB::updateDownloadProgress(const std::string& downloadId, int64_t completedChunks, double progressPercent) {
     if (!m_db) return false;
     
+    // La hora se toma ahora, no cuando se confirme el lote
+    std::string timestamp = getCurrentTimestamp();
+    if (!m_writer) {
+        return writeDownloadProgress(downloadId, completedChunks, progressPercent, timestamp);
+    }
+    
+    m_writer->enqueue(downloadId, [this, downloadId, completedChunks, progressPercent, timestamp]() {
+        return writeDownloadProgress(downloadId, completedChunks, progressPercent, timestamp);
+    });
+    return true;
+}
+
+bool TempDownloadDB::writeDownloadProgress(const std::string& downloadId, int64_t completedChunks,
+                                           double progressPercent, const std::string& timestamp) {
+    if (!m_db) return false;
+    
     const char* sql = R"(
         UPDATE link_downloads 
         SET completed_chunks = ?, progress_percent = ?, last_update_time = ?
@@ -204,8 +237,6 @@ bool TempDownloadDB::updateDownloadProgress(const std::string& downloadId, int64
         return false;
     }
     
-    std::string timestamp = getCurrentTimestamp();
-    
     sqlite3_bind_int64(stmt, 1, completedChunks);
     sqlite3_bind_double(stmt, 2, progressPercent);
     sqlite3_bind_text(stmt, 3, timestamp.c_str(), -1, SQLITE_TRANSIENT);
@@ -219,6 +250,7 @@ bool TempDownloadDB::updateDownloadProgress(const std::string& downloadId, int64
 
 bool TempDownloadDB::updateDownloadStatus(const std::string& downloadId, const std::string& status) {
     if (!m_db) return false;
+    flushPendingWrites();
     
     const char* sql = R"(
         UPDATE link_downloads 
@@ -250,6 +282,7 @@ std::vector<LinkDownloadInfo> TempDownloadDB::getActiveDownloads() {
         LOG_ERROR("Database not initialized");
         return downloads;
     }
+    flushPendingWrites();
     
     const char* sql = R"(
         SELECT download_id, file_id, file_name, file_type, file_size, is_encrypted,
@@ -296,6 +329,7 @@ LinkDownloadInfo TempDownloadDB::getDownload(const std::string& downloadId) {
     LinkDownloadInfo info;
     
     if (!m_db) return info;
+    flushPendingWrites();
     
     const char* sql = R"(
         SELECT download_id, file_id, file_name, file_type, file_size, is_encrypted,
@@ -342,6 +376,7 @@ bool TempDownloadDB::markDownloadComplete(const std::string& downloadId) {
 
 bool TempDownloadDB::deleteDownload(const std::string& downloadId) {
     if (!m_db) return false;
+    flushPendingWrites();
     
     const char* sql = "DELETE FROM link_downloads WHERE download_id = ?";
     
@@ -370,6 +405,7 @@ bool TempDownloadDB::deleteDownload(const std::string& downloadId) {
 
 bool TempDownloadDB::hasActiveDownloads() {
     if (!m_db) return false;
+    flushPendingWrites();
     
     // Solo contar descargas NO completadas (active, paused, failed)
     const char* sql = "SELECT COUNT(*) FROM link_downloads WHERE status != 'completed'";
@@ -393,6 +429,7 @@ bool TempDownloadDB::hasActiveDownloads() {
 bool TempDownloadDB::cleanupDatabase() {
     LOG_INFO("Cleaning up temporary download database");
     
+    stopWriter();
     if (m_db) {
         sqlite3_close(m_db);
         m_db = nullptr;
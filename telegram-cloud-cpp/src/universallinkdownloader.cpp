@@ -1,15 +1,22 @@
 #include "universallinkdownloader.h"
 #include "telegramnotifier.h"
 #include "logger.h"
+#include "chunkintegrity.h"
+#include "chunkbitmap.h"
+#include "cryptoengine.h"
+#include "linkformat.h"
+#include "downloadqueue.h"
+#include "config.h"
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <algorithm>
-#include <thread>
-#include <future>
 #include <random>
-#include <openssl/evp.h>
-#include <openssl/sha.h>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <unordered_set>
 
 namespace TelegramCloud {
 
@@ -33,51 +40,90 @@ namespace TelegramCloud {
     return result;
 }
 
-// Parser JSON simple
-static std::string extractJsonString(const std::string& json, const std::string& key) {
-    std::string searchKey = "\"" + key + "\":\"";
-    size_t pos = json.find(searchKey);
-    if (pos == std::string::npos) return "";
-    
-    pos += searchKey.length();
-    size_t end = json.find("\"", pos);
-    if (end == std::string::npos) return "";
-    
-    return json.substr(pos, end - pos);
+UniversalLinkDownloader::UniversalLinkDownloader(TelegramHandler* telegramHandler, Database* database, TelegramNotifier* notifier)
+    : m_telegramHandler(telegramHandler)
+    , m_database(database)
+    , m_notifier(notifier) {
 }
 
-static int64_t extractJsonInt(const std::string& json, const std::string& key) {
-    std::string searchKey = "\"" + key + "\":";
-    size_t pos = json.find(searchKey);
-    if (pos == std::string::npos) return 0;
-    
-    pos += searchKey.length();
-    size_t end = json.find_first_of(",}", pos);
-    if (end == std::string::npos) return 0;
-    
-    std::string numStr = json.substr(pos, end - pos);
-    try {
-        return std::stoll(numStr);
-    } catch (...) {
-        return 0;
+namespace {
+
+// Progreso agregado del enlace. Los totales crecen según se decodifican
+// registros, así que el porcentaje se calcula sobre los bytes ya conocidos.
+class LinkAggregateProgress {
+public:
+    explicit LinkAggregateProgress(UniversalLinkProgressCallback callback)
+        : m_callback(std::move(callback)) {
     }
-}
 
-static bool extractJsonBool(const std::string& json, const std::string& key) {
-    std::string searchKey = "\"" + key + "\":";
-    size_t pos = json.find(searchKey);
-    if (pos == std::string::npos) return false;
-    
-    pos += searchKey.length();
-    return json.substr(pos, 4) == "true";
-}
+    void addFile(int64_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_filesKnown++;
+        m_bytesKnown += std::max<int64_t>(bytes, 0);
+    }
 
-UniversalLinkDownloader::UniversalLinkDownloader(TelegramHandler* telegramHandler, Database* database, TelegramNotifier* notifier)
-    : m_telegramHandler(telegramHandler)
-    , m_database(database)
-    , m_notifier(notifier) {
+    void advance(int64_t bytes, bool fileDone) {
+        if (!m_callback) {
+            return;
+        }
+        // Bajo el cerrojo para que las notificaciones no lleguen desordenadas
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bytesDone += std::max<int64_t>(bytes, 0);
+        if (fileDone) {
+            m_filesDone++;
+        }
+        double percent = m_bytesKnown > 0
+            ? static_cast<double>(m_bytesDone) / static_cast<double>(m_bytesKnown) * 100.0
+            : static_cast<double>(m_filesDone) / static_cast<double>(std::max(m_filesKnown, 1)) * 100.0;
+        m_callback(m_filesDone, m_filesKnown, "", std::min(percent, 100.0));
+    }
+
+private:
+    UniversalLinkProgressCallback m_callback;
+    std::mutex m_mutex;
+    int m_filesKnown = 0;
+    int m_filesDone = 0;
+    int64_t m_bytesKnown = 0;
+    int64_t m_bytesDone = 0;
+};
+
+// Ruta de destino libre dentro del enlace: dos archivos con el mismo nombre
+// se guardan como "nombre.ext" y "nombre (1).ext" en vez de pisarse
+std::string claimDestination(const std::string& destinationDir, const std::string& fileName,
+                             std::unordered_set<std::string>& claimed) {
+    std::string candidate = destinationDir + "/" + fileName;
+    if (claimed.insert(candidate).second) {
+        return candidate;
+    }
+    std::filesystem::path name(fileName);
+    std::string stem = name.stem().string();
+    std::string extension = name.extension().string();
+    for (int n = 1;; n++) {
+        candidate = destinationDir + "/" + stem + " (" + std::to_string(n) + ")" + extension;
+        if (claimed.insert(candidate).second) {
+            return candidate;
+        }
+    }
 }
 
+} // namespace
+
+// Archivo del enlace en curso: las tareas de sus chunks comparten este
+// estado y la última en terminar reconstruye el archivo
+struct UniversalLinkDownloader::LinkFileJob {
+    FileInfo fileInfo;
+    std::vector<ChunkInfo> chunks;
+    std::string destPath;
+    std::string tempDir;
+    std::string downloadId;
+    OperationHandle notifierHandle = INVALID_OPERATION_HANDLE;
+    TransferCheckpoint checkpoint;
+    std::atomic<int64_t> remaining{0};
+    std::atomic<int64_t> completed{0};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> finished{false};
+};
+
 bool UniversalLinkDownloader::downloadFromLinkFile(
     const std::string& linkFilePath,
     const std::string& password,
@@ -87,35 +133,141 @@ bool UniversalLinkDownloader::downloadFromLinkFile(
     
     try {
         LOG_INFO("Starting download from link file: " + linkFilePath);
+        [[maybe_unused]] auto start = std::chrono::steady_clock::now();
+        
+        LinkAggregateProgress aggregate(progressCallback);
+        std::vector<std::shared_ptr<LinkFileJob>> chunkedJobs;
+        std::atomic<int> succeeded(0);
+        int queued = 0;
+        bool startFailed = false;
+        std::unordered_set<std::string> seenFileIds;
+        std::unordered_set<std::string> claimedPaths;
+        
+        // Un solo presupuesto de descargas en vuelo para todo el enlace: los
+        // archivos pequeños avanzan en paralelo y los grandes reparten sus
+        // chunks en la misma ventana. Se detiene al primer fallo, como antes.
+        // Declarada la última: se destruye (y espera a sus workers) antes que
+        // el estado que usan las tareas.
+        Config& config = Config::instance();
+        DownloadQueue queue(config.downloadMaxInFlight(), config.downloadPerTokenLimit(), true);
+        
+        // Cada archivo se encola en cuanto se decodifica su registro, sin
+        // esperar a descifrar y parsear el resto del enlace
+        bool ok = streamLinkFile(linkFilePath, password,
+            [&](FileInfo fileInfo, std::vector<ChunkInfo> chunks) {
+                if (queued == 0) {
+                    LOG_INFOF("First link record decoded after {} ms",
+                              std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  std::chrono::steady_clock::now() - start).count());
+                }
+                // Un archivo repetido en el enlace se descarga una sola vez
+                if (!seenFileIds.insert(fileInfo.fileId).second) {
+                    LOG_WARNING("Skipping duplicate link record: " + fileInfo.fileName);
+                    return true;
+                }
+                // Contrapresión: la lectura va poco por delante de las descargas
+                // y deja de avanzar si un archivo ya falló
+                if (!queue.waitForRoom(MAX_QUEUED_TASKS)) {
+                    return false;
+                }
+                queued++;
+                
+                auto job = std::make_shared<LinkFileJob>();
+                job->destPath = claimDestination(destinationDir, fileInfo.fileName, claimedPaths);
+                job->fileInfo = std::move(fileInfo);
+                LOG_INFO("Queued file " + std::to_string(queued) + ": " + job->fileInfo.fileName);
+                
+                if (job->fileInfo.category != "chunked" || chunks.empty()) {
+                    aggregate.addFile(job->fileInfo.fileSize);
+                    queue.submit(job->fileInfo.uploaderBotToken,
+                                 [this, job, &filePassword, &progressCallback, &aggregate, &succeeded]() {
+                        bool success = downloadDirectFromLink(job->fileInfo, job->destPath, filePassword);
+                        if (success) {
+                            succeeded++;
+                            if (progressCallback) {
+                                progressCallback(1, 1, job->fileInfo.fileName, 100.0);
+                            }
+                            aggregate.advance(job->fileInfo.fileSize, true);
+                        }
+                        return success;
+                    });
+                    return true;
+                }
+                
+                job->chunks = std::move(chunks);
+                int64_t bytes = 0;
+                for (const ChunkInfo& chunk : job->chunks) {
+                    bytes += std::max<int64_t>(chunk.chunkSize, 0);
+                }
+                aggregate.addFile(bytes);
+                if (!startChunkedJob(*job)) {
+                    startFailed = true;
+                    return false;
+                }
+                job->remaining = static_cast<int64_t>(job->chunks.size());
+                
+                // Los trabajos terminados se sueltan para que la lista no crezca con el enlace
+                chunkedJobs.erase(std::remove_if(chunkedJobs.begin(), chunkedJobs.end(),
+                    [](const std::shared_ptr<LinkFileJob>& other) { return other->finished.load(); }),
+                    chunkedJobs.end());
+                chunkedJobs.push_back(job);
+                
+                for (size_t i = 0; i < job->chunks.size(); i++) {
+                    queue.submit(job->chunks[i].uploaderBotToken,
+                                 [this, job, i, &filePassword, &progressCallback, &aggregate, &succeeded]() {
+                        const ChunkInfo& chunk = job->chunks[i];
+                        bool success = !job->failed && downloadJobChunk(*job, chunk);
+                        if (success) {
+                            int64_t completed = ++job->completed;
+                            int64_t total = static_cast<int64_t>(job->chunks.size());
+                            if (progressCallback) {
+                                double percent = static_cast<double>(completed) / static_cast<double>(total) * 100.0;
+                                // Progreso del archivo en chunks, no en archivos
+                                progressCallback(static_cast<int>(completed), static_cast<int>(total),
+                                                 job->fileInfo.fileName, percent);
+                            }
+                            aggregate.advance(chunk.chunkSize, false);
+                        } else {
+                            job->failed = true;
+                        }
+                        
+                        // El último chunk en terminar reconstruye el archivo
+                        if (--job->remaining == 0) {
+                            if (job->failed) {
+                                abortChunkedJob(*job, "Chunk download failed");
+                            } else if (finishChunkedJob(*job, filePassword, progressCallback)) {
+                                succeeded++;
+                                aggregate.advance(0, true);
+                            } else {
+                                success = false;
+                            }
+                        }
+                        return success;
+                    });
+                }
+                return true;
+            });
         
-        // Leer y desencriptar archivo .link
-        std::string jsonData = readAndDecryptLinkFile(linkFilePath, password);
-        if (jsonData.empty()) {
-            LOG_ERROR("Failed to decrypt link file");
-            return false;
-        }
+        bool allSucceeded = queue.waitAll();
         
-        // Parsear datos
-        std::vector<FileInfo> filesInfo;
-        std::vector<std::vector<ChunkInfo>> filesChunks;
+        // Chunks descartados tras un fallo: sus archivos no llegan a reconstruirse
+        for (auto& job : chunkedJobs) {
+            if (!job->finished) {
+                abortChunkedJob(*job, "Download cancelled after another file failed");
+            }
+        }
         
-        if (!parseLinkData(jsonData, filesInfo, filesChunks)) {
-            LOG_ERROR("Failed to parse link data");
+        if (!ok || !allSucceeded || startFailed || succeeded.load() != queued) {
+            LOG_ERROR("Link download failed: " + std::to_string(succeeded.load()) + "/" +
+                      std::to_string(queued) + " file(s) completed");
             return false;
         }
-        
-        LOG_INFO("Found " + std::to_string(filesInfo.size()) + " file(s) in link");
-        
-        // Descargar cada archivo
-        for (size_t i = 0; i < filesInfo.size(); i++) {
-            if (!downloadSingleFile(filesInfo[i], filesChunks[i], destinationDir, 
-                                   filePassword, progressCallback, i + 1, filesInfo.size())) {
-                LOG_ERROR("Failed to download file: " + filesInfo[i].fileName);
-                return false;
-            }
+        if (queued == 0) {
+            LOG_ERROR("No files found in link");
+            return false;
         }
         
-        LOG_INFO("All files downloaded successfully from link");
+        LOG_INFO("All " + std::to_string(queued) + " file(s) downloaded successfully from link");
         return true;
         
     } catch (const std::exception& e) {
@@ -131,14 +283,15 @@ std::vector<FileInfo> UniversalLinkDownloader::getLinkFileInfo(
     std::vector<FileInfo> result;
     
     try {
-        std::string jsonData = readAndDecryptLinkFile(linkFilePath, password);
-        if (jsonData.empty()) {
-            return result;
+        // Solo hace falta FileInfo: las tablas de chunks se descartan al decodificarlas
+        bool ok = streamLinkFile(linkFilePath, password, [&](FileInfo fileInfo, std::vector<ChunkInfo>) {
+            result.push_back(std::move(fileInfo));
+            return true;
+        });
+        if (!ok) {
+            result.clear();   // un enlace corrupto no devuelve una lista a medias
         }
         
-        std::vector<std::vector<ChunkInfo>> filesChunks;
-        parseLinkData(jsonData, result, filesChunks);
-        
     } catch (const std::exception& e) {
         LOG_ERROR("Exception in getLinkFileInfo: " + std::string(e.what()));
     }
@@ -146,378 +299,132 @@ std::vector<FileInfo> UniversalLinkDownloader::getLinkFileInfo(
     return result;
 }
 
-std::string UniversalLinkDownloader::readAndDecryptLinkFile(
+bool UniversalLinkDownloader::streamLinkFile(
     const std::string& linkFilePath,
-    const std::string& password) {
+    const std::string& password,
+    LinkFileVisitor visitor) {
     
-    try {
-        // Leer archivo
-        std::ifstream inFile(linkFilePath, std::ios::binary);
-        if (!inFile) {
-            LOG_ERROR("Failed to open link file: " + linkFilePath);
-            return "";
-        }
-        
-        std::string encrypted((std::istreambuf_iterator<char>(inFile)),
-                             std::istreambuf_iterator<char>());
-        inFile.close();
-        
-        // Desencriptar
-        return decryptData(encrypted, password);
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("Failed to read link file: " + std::string(e.what()));
-        return "";
+    LinkStreamReader reader(password, std::move(visitor));
+    if (!reader.readFile(linkFilePath)) {
+        LOG_ERROR("Failed to read link file: " + reader.error());
+        return false;
     }
+    LOG_DEBUG("Link file streamed: " + std::to_string(reader.filesDecoded()) + " record(s)");
+    return true;
 }
 
-bool UniversalLinkDownloader::parseLinkData(
-    const std::string& jsonData,
-    std::vector<FileInfo>& filesInfo,
-    std::vector<std::vector<ChunkInfo>>& filesChunks) {
-    
+bool UniversalLinkDownloader::startChunkedJob(LinkFileJob& job) {
     try {
-        // Detectar tipo
-        std::string type = extractJsonString(jsonData, "type");
+        job.downloadId = generateDownloadId();
+        LOG_INFO("Downloading chunked file: " + job.fileInfo.fileName + 
+                " (" + std::to_string(job.chunks.size()) + " chunks)");
         
-        if (type == "single") {
-            // Archivo individual
-            size_t filePos = jsonData.find("\"file\":{");
-            if (filePos == std::string::npos) return false;
-            
-            std::string fileJson = jsonData.substr(filePos);
-            
-            FileInfo fileInfo;
-            fileInfo.fileId = extractJsonString(fileJson, "fileId");
-            fileInfo.fileName = extractJsonString(fileJson, "fileName");
-            fileInfo.fileSize = extractJsonInt(fileJson, "fileSize");
-            fileInfo.mimeType = extractJsonString(fileJson, "mimeType");
-            fileInfo.category = extractJsonString(fileJson, "category");
-            fileInfo.uploadDate = extractJsonString(fileJson, "uploadDate");
-            fileInfo.telegramFileId = extractJsonString(fileJson, "telegramFileId");
-            fileInfo.uploaderBotToken = extractJsonString(fileJson, "uploaderBotToken");
-            fileInfo.isEncrypted = extractJsonBool(fileJson, "isEncrypted");
-            
-            filesInfo.push_back(fileInfo);
-            
-            // Parsear chunks si existen
-            std::vector<ChunkInfo> chunks;
-            size_t chunksPos = fileJson.find("\"chunks\":[");
-            if (chunksPos != std::string::npos) {
-                size_t chunkStart = chunksPos;
-                while (true) {
-                    chunkStart = fileJson.find("{", chunkStart + 1);
-                    if (chunkStart == std::string::npos) break;
-                    
-                    size_t chunkEnd = fileJson.find("}", chunkStart);
-                    if (chunkEnd == std::string::npos) break;
-                    
-                    std::string chunkJson = fileJson.substr(chunkStart, chunkEnd - chunkStart + 1);
-                    
-                    ChunkInfo chunk;
-                    chunk.fileId = fileInfo.fileId;
-                    chunk.chunkNumber = extractJsonInt(chunkJson, "chunkNumber");
-                    chunk.totalChunks = extractJsonInt(chunkJson, "totalChunks");
-                    chunk.chunkSize = extractJsonInt(chunkJson, "chunkSize");
-                    chunk.chunkHash = extractJsonString(chunkJson, "chunkHash");
-                    chunk.telegramFileId = extractJsonString(chunkJson, "telegramFileId");
-                    chunk.uploaderBotToken = extractJsonString(chunkJson, "uploaderBotToken");
-                    
-                    chunks.push_back(chunk);
-                    
-                    chunkStart = chunkEnd;
-                    if (fileJson[chunkStart + 1] != ',') break;
-                }
-            }
-            filesChunks.push_back(chunks);
-            
-        } else if (type == "batch") {
-            // Múltiples archivos
-            size_t filesArrayPos = jsonData.find("\"files\":[");
-            if (filesArrayPos == std::string::npos) return false;
+        // Directorio temporal propio de esta descarga: otra del mismo archivo
+        // (en este enlace o en otro en curso) no comparte sus chunks
+        job.tempDir = "temp_link_download_" + job.downloadId;
+        std::filesystem::create_directories(job.tempDir);
+        
+        // Registrar descarga en base de datos
+        if (m_database) {
+            DownloadInfo downloadInfo;
+            downloadInfo.downloadId = job.downloadId;
+            downloadInfo.fileId = job.fileInfo.fileId;
+            downloadInfo.fileName = job.fileInfo.fileName;
+            downloadInfo.destPath = job.destPath;
+            downloadInfo.totalSize = job.fileInfo.fileSize;
+            downloadInfo.totalChunks = static_cast<int64_t>(job.chunks.size());
+            downloadInfo.completedChunks = 0;
+            downloadInfo.status = "downloading";
+            downloadInfo.tempDir = job.tempDir;
             
-            size_t fileStart = filesArrayPos;
-            while (true) {
-                fileStart = jsonData.find("{\"fileId\"", fileStart + 1);
-                if (fileStart == std::string::npos) break;
-                
-                // Encontrar el cierre del objeto
-                int braceCount = 0;
-                size_t fileEnd = fileStart;
-                bool inString = false;
-                for (size_t i = fileStart; i < jsonData.length(); i++) {
-                    if (jsonData[i] == '\"' && (i == 0 || jsonData[i-1] != '\\')) {
-                        inString = !inString;
-                    }
-                    if (!inString) {
-                        if (jsonData[i] == '{') braceCount++;
-                        if (jsonData[i] == '}') {
-                            braceCount--;
-                            if (braceCount == 0) {
-                                fileEnd = i;
-                                break;
-                            }
-                        }
-                    }
-                }
-                
-                std::string fileJson = jsonData.substr(fileStart, fileEnd - fileStart + 1);
-                
-                FileInfo fileInfo;
-                fileInfo.fileId = extractJsonString(fileJson, "fileId");
-                fileInfo.fileName = extractJsonString(fileJson, "fileName");
-                fileInfo.fileSize = extractJsonInt(fileJson, "fileSize");
-                fileInfo.mimeType = extractJsonString(fileJson, "mimeType");
-                fileInfo.category = extractJsonString(fileJson, "category");
-                fileInfo.uploadDate = extractJsonString(fileJson, "uploadDate");
-                fileInfo.telegramFileId = extractJsonString(fileJson, "telegramFileId");
-                fileInfo.uploaderBotToken = extractJsonString(fileJson, "uploaderBotToken");
-                fileInfo.isEncrypted = extractJsonBool(fileJson, "isEncrypted");
-                
-                filesInfo.push_back(fileInfo);
-                
-                // Parsear chunks
-                std::vector<ChunkInfo> chunks;
-                size_t chunksPos = fileJson.find("\"chunks\":[");
-                if (chunksPos != std::string::npos) {
-                    size_t chunkStart = chunksPos;
-                    while (true) {
-                        chunkStart = fileJson.find("{", chunkStart + 1);
-                        if (chunkStart == std::string::npos || chunkStart > fileEnd) break;
-                        
-                        size_t chunkEnd = fileJson.find("}", chunkStart);
-                        if (chunkEnd == std::string::npos || chunkEnd > fileEnd) break;
-                        
-                        std::string chunkJson = fileJson.substr(chunkStart, chunkEnd - chunkStart + 1);
-                        
-                        ChunkInfo chunk;
-                        chunk.fileId = fileInfo.fileId;
-                        chunk.chunkNumber = extractJsonInt(chunkJson, "chunkNumber");
-                        chunk.totalChunks = extractJsonInt(chunkJson, "totalChunks");
-                        chunk.chunkSize = extractJsonInt(chunkJson, "chunkSize");
-                        chunk.chunkHash = extractJsonString(chunkJson, "chunkHash");
-                        chunk.telegramFileId = extractJsonString(chunkJson, "telegramFileId");
-                        chunk.uploaderBotToken = extractJsonString(chunkJson, "uploaderBotToken");
-                        
-                        chunks.push_back(chunk);
-                        
-                        chunkStart = chunkEnd;
-                        if (chunkStart + 1 >= fileJson.length() || fileJson[chunkStart + 1] != ',') break;
-                    }
-                }
-                filesChunks.push_back(chunks);
-                
-                fileStart = fileEnd;
+            if (!m_database->registerDownload(downloadInfo)) {
+                LOG_WARNING("Failed to register download in database");
+            } else {
+                LOG_INFO("Download registered in database with ID: " + job.downloadId);
             }
         }
         
-        return !filesInfo.empty();
+        // Registrar operación en TelegramNotifier
+        if (m_notifier) {
+            job.notifierHandle = m_notifier->registerOperation(job.downloadId, OperationType::DOWNLOAD,
+                                                              job.fileInfo.fileName, job.fileInfo.fileSize,
+                                                              static_cast<int64_t>(job.chunks.size()));
+        }
+        
+        // Progreso en memoria; se vuelca a BD por lotes
+        std::string downloadId = job.downloadId;
+        job.checkpoint.reset(ChunkBitmap(static_cast<int64_t>(job.chunks.size())),
+                             [this, downloadId](const std::string& blob, int64_t completed) {
+            if (m_database) {
+                m_database->queueDownloadCheckpoint(downloadId, blob, completed);
+            }
+        });
+        return true;
         
     } catch (const std::exception& e) {
-        LOG_ERROR("Failed to parse link data: " + std::string(e.what()));
+        LOG_ERROR("Failed to start chunked download: " + std::string(e.what()));
+        abortChunkedJob(job, e.what());
         return false;
     }
 }
 
-bool UniversalLinkDownloader::downloadSingleFile(
-    const FileInfo& fileInfo,
-    const std::vector<ChunkInfo>& chunks,
-    const std::string& destinationDir,
-    const std::string& filePassword,
-    UniversalLinkProgressCallback progressCallback,
-    int currentIndex,
-    int totalFiles) {
+bool UniversalLinkDownloader::downloadJobChunk(LinkFileJob& job, const ChunkInfo& chunk) {
+    std::string chunkPath = job.tempDir + "/chunk_" + std::to_string(chunk.chunkNumber) + ".dat";
     
-    try {
-        std::string destPath = destinationDir + "/" + fileInfo.fileName;
-        LOG_INFO("Downloading file " + std::to_string(currentIndex) + "/" + 
-                std::to_string(totalFiles) + ": " + fileInfo.fileName);
-        
-        bool success = false;
-        
-        if (fileInfo.category == "chunked" && !chunks.empty()) {
-            // Crear callback específico para chunks que actualice el progreso
-            auto chunkProgressCallback = [&, progressCallback](int64_t completed, int64_t total) {
-                if (progressCallback) {
-                    double percent = (static_cast<double>(completed) / static_cast<double>(total)) * 100.0;
-                    // Pasar completed y total como los parámetros de progreso (chunks, no archivos)
-                    progressCallback(static_cast<int>(completed), static_cast<int>(total), fileInfo.fileName, percent);
-                }
-            };
-            
-            success = downloadChunkedFromLinkWithProgress(fileInfo, chunks, destPath, filePassword, chunkProgressCallback);
-        } else {
-            success = downloadDirectFromLink(fileInfo, destPath, filePassword);
-            
-            if (progressCallback) {
-                progressCallback(1, 1, fileInfo.fileName, 100.0);
-            }
-        }
-        
-        return success;
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("Failed to download single file: " + std::string(e.what()));
+    // Caché local o red; el hash se verifica al escribir y solo se reintenta este chunk
+    if (!ChunkIntegrity::fetchVerifiedChunk(m_telegramHandler, chunk, chunkPath, chunk.uploaderBotToken)) {
+        LOG_ERROR("Chunk download failed: " + job.fileInfo.fileName + " #" + std::to_string(chunk.chunkNumber));
         return false;
     }
-}
-
-bool UniversalLinkDownloader::downloadChunkedFromLink(
-    const FileInfo& fileInfo,
-    const std::vector<ChunkInfo>& chunks,
-    const std::string& destPath,
-    const std::string& filePassword) {
     
-    return downloadChunkedFromLinkWithProgress(fileInfo, chunks, destPath, filePassword, nullptr);
+    int64_t completed = job.checkpoint.markCompleted(chunk.chunkNumber);
+    LOG_DEBUGF("Downloaded chunk {}/{} of {}", chunk.chunkNumber + 1, job.chunks.size(), job.fileInfo.fileName);
+    
+    // Actualizar progreso en TelegramNotifier
+    if (m_notifier) {
+        double progressPercent = (static_cast<double>(completed) / static_cast<double>(job.chunks.size())) * 100.0;
+        m_notifier->updateOperationProgress(job.notifierHandle, completed, progressPercent);
+    }
+    return true;
 }
 
-bool UniversalLinkDownloader::downloadChunkedFromLinkWithProgress(
-    const FileInfo& fileInfo,
-    const std::vector<ChunkInfo>& chunks,
-    const std::string& destPath,
+bool UniversalLinkDownloader::finishChunkedJob(
+    LinkFileJob& job,
     const std::string& filePassword,
-    std::function<void(int64_t completed, int64_t total)> progressCallback) {
-    
-    // Generar download ID fuera del try para poder usarlo en el catch
-    std::string downloadId = generateDownloadId();
+    const UniversalLinkProgressCallback& progressCallback) {
     
     try {
-        LOG_INFO("Downloading chunked file: " + fileInfo.fileName + 
-                " (" + std::to_string(chunks.size()) + " chunks)");
-        
-        // Crear directorio temporal
-        std::string tempDir = "temp_link_download_" + fileInfo.fileId;
-        std::filesystem::create_directories(tempDir);
-        
-        // Registrar descarga en base de datos
+        job.checkpoint.flush();
         if (m_database) {
-            DownloadInfo downloadInfo;
-            downloadInfo.downloadId = downloadId;
-            downloadInfo.fileId = fileInfo.fileId;
-            downloadInfo.fileName = fileInfo.fileName;
-            downloadInfo.destPath = destPath;
-            downloadInfo.totalSize = fileInfo.fileSize;
-            downloadInfo.totalChunks = static_cast<int64_t>(chunks.size());
-            downloadInfo.completedChunks = 0;
-            downloadInfo.status = "downloading";
-            downloadInfo.tempDir = tempDir;
-            
-            if (!m_database->registerDownload(downloadInfo)) {
-                LOG_WARNING("Failed to register download in database");
-            } else {
-                LOG_INFO("Download registered in database with ID: " + downloadId);
-            }
+            m_database->flushQueuedWrites();
         }
         
-        // Registrar operación en TelegramNotifier
+        LOG_INFO("All chunks downloaded, reconstructing " + job.fileInfo.fileName + "...");
         if (m_notifier) {
-            m_notifier->registerOperation(downloadId, OperationType::DOWNLOAD,
-                                         fileInfo.fileName, fileInfo.fileSize,
-                                         static_cast<int64_t>(chunks.size()));
-        }
-        
-        // Descargar chunks en paralelo controlado (5 simultáneos)
-        std::vector<std::future<bool>> futures;
-        std::atomic<int64_t> completedCount(0);
-        const int MAX_PARALLEL = 5;
-        int64_t totalChunks = static_cast<int64_t>(chunks.size());
-        
-        for (size_t i = 0; i < chunks.size(); ++i) {
-            const auto& chunk = chunks[i];
-            
-            // Lanzar descarga asíncrona
-            auto future = std::async(std::launch::async, [&, chunk, progressCallback, downloadId]() {
-                std::string chunkPath = tempDir + "/chunk_" + 
-                                      std::to_string(chunk.chunkNumber) + ".dat";
-                
-                // Usar uploaderBotToken del chunk si está disponible, sino usar el token por defecto
-                std::string tokenToUse = chunk.uploaderBotToken.empty() ? "" : chunk.uploaderBotToken;
-                
-                // Reintentar hasta 3 veces
-                bool success = false;
-                for (int retry = 0; retry < 3 && !success; retry++) {
-                    if (retry > 0) {
-                        LOG_WARNING("Retrying chunk " + std::to_string(chunk.chunkNumber) + 
-                                  " (attempt " + std::to_string(retry + 1) + "/3)");
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    }
-                    success = m_telegramHandler->downloadFile(chunk.telegramFileId, chunkPath, tokenToUse);
-                }
-                
-                if (success) {
-                    int64_t completed = ++completedCount;
-                    LOG_DEBUG("Downloaded chunk " + std::to_string(chunk.chunkNumber + 1) + 
-                            "/" + std::to_string(chunks.size()));
-                    
-                    // Actualizar progreso en base de datos
-                    if (m_database) {
-                        m_database->updateDownloadChunkState(downloadId, chunk.chunkNumber, "completed");
-                        m_database->updateDownloadProgress(downloadId, completed);
-                    }
-                    
-                    // Notificar progreso
-                    if (progressCallback) {
-                        progressCallback(completed, totalChunks);
-                    }
-                    
-                    // Actualizar progreso en TelegramNotifier
-                    if (m_notifier) {
-                        double progressPercent = (static_cast<double>(completed) / static_cast<double>(totalChunks)) * 100.0;
-                        m_notifier->updateOperationProgress(downloadId, completed, progressPercent, "downloading");
-                    }
-                }
-                
-                return success;
-            });
-            
-            futures.push_back(std::move(future));
-            
-            // Limitar descargas paralelas
-            if (futures.size() >= MAX_PARALLEL) {
-                // Esperar a que terminen todos los actuales
-                for (auto& f : futures) {
-                    if (!f.get()) {
-                        LOG_ERROR("Chunk download failed");
-                        std::filesystem::remove_all(tempDir);
-                        return false;
-                    }
-                }
-                futures.clear();
-            }
-        }
-        
-        // Esperar a que terminen los futuros restantes
-        for (auto& future : futures) {
-            if (!future.get()) {
-                LOG_ERROR("Chunk download failed");
-                std::filesystem::remove_all(tempDir);
-                return false;
-            }
+            m_notifier->setOperationStatus(job.notifierHandle, OperationStatus::RECONSTRUCTING);
         }
         
-        LOG_INFO("All chunks downloaded, reconstructing file...");
-        
         // Reconstruir archivo con reporte de progreso
-        std::ofstream outFile(destPath, std::ios::binary);
+        std::ofstream outFile(job.destPath, std::ios::binary);
         if (!outFile) {
-            LOG_ERROR("Failed to create output file: " + destPath);
-            std::filesystem::remove_all(tempDir);
+            LOG_ERROR("Failed to create output file: " + job.destPath);
+            abortChunkedJob(job, "Failed to create output file");
             return false;
         }
         
         int64_t processedChunks = 0;
-        int64_t totalChunksToReconstruct = static_cast<int64_t>(chunks.size());
+        int64_t totalChunksToReconstruct = static_cast<int64_t>(job.chunks.size());
         
-        for (const auto& chunk : chunks) {
-            std::string chunkPath = tempDir + "/chunk_" + 
+        for (const auto& chunk : job.chunks) {
+            std::string chunkPath = job.tempDir + "/chunk_" + 
                                   std::to_string(chunk.chunkNumber) + ".dat";
             
             std::ifstream chunkFile(chunkPath, std::ios::binary);
             if (!chunkFile) {
                 LOG_ERROR("Failed to read chunk: " + chunkPath);
                 outFile.close();
-                std::filesystem::remove_all(tempDir);
-                std::filesystem::remove(destPath);
+                std::filesystem::remove(job.destPath);
+                abortChunkedJob(job, "Failed to read chunk");
                 return false;
             }
             
@@ -526,39 +433,29 @@ bool UniversalLinkDownloader::downloadChunkedFromLinkWithProgress(
             
             processedChunks++;
             
-            // Reportar progreso de reconstrucción
+            // Valores negativos: reconstrucción
             if (progressCallback) {
-                progressCallback(-processedChunks, -totalChunksToReconstruct);
+                double percent = static_cast<double>(processedChunks) / static_cast<double>(totalChunksToReconstruct) * 100.0;
+                progressCallback(static_cast<int>(-processedChunks), static_cast<int>(-totalChunksToReconstruct),
+                                 job.fileInfo.fileName, percent);
             }
-            
-            LOG_DEBUG("Reconstructed chunk " + std::to_string(processedChunks) + "/" + std::to_string(totalChunksToReconstruct));
         }
         
         outFile.close();
         
         // Limpiar chunks temporales
-        std::filesystem::remove_all(tempDir);
+        std::filesystem::remove_all(job.tempDir);
         
         // Desencriptar si es necesario
-        if (fileInfo.isEncrypted && !filePassword.empty()) {
+        if (job.fileInfo.isEncrypted && !filePassword.empty()) {
             LOG_INFO("Decrypting file...");
-            std::string tempEncrypted = destPath + ".encrypted";
-            std::filesystem::rename(destPath, tempEncrypted);
+            std::string tempEncrypted = job.destPath + ".encrypted";
+            std::filesystem::rename(job.destPath, tempEncrypted);
             
-            if (!decryptFile(tempEncrypted, destPath, filePassword)) {
+            if (!decryptFile(tempEncrypted, job.destPath, filePassword)) {
                 LOG_ERROR("Failed to decrypt file");
-                std::filesystem::rename(tempEncrypted, destPath);
-                
-                // Marcar como fallida en la base de datos
-                if (m_database) {
-                    m_database->updateDownloadState(downloadId, "failed");
-                }
-                
-                // Notificar fallo a TelegramNotifier
-                if (m_notifier) {
-                    m_notifier->notifyOperationFailed(downloadId, "Failed to decrypt file");
-                }
-                
+                std::filesystem::rename(tempEncrypted, job.destPath);
+                abortChunkedJob(job, "Failed to decrypt file");
                 return false;
             }
             
@@ -568,30 +465,53 @@ bool UniversalLinkDownloader::downloadChunkedFromLinkWithProgress(
         
         // Marcar descarga como completada en la base de datos
         if (m_database) {
-            m_database->updateDownloadState(downloadId, "completed");
-            LOG_INFO("Download marked as completed in database");
+            m_database->updateDownloadState(job.downloadId, "completed");
         }
         
         // Notificar completado a TelegramNotifier
         if (m_notifier) {
-            m_notifier->notifyOperationCompleted(downloadId, destPath);
+            m_notifier->notifyOperationCompleted(job.notifierHandle, job.destPath);
         }
         
-        LOG_INFO("Chunked file downloaded successfully: " + destPath);
+        // Las tareas del archivo ya terminaron: la tabla de chunks ya no hace falta
+        job.chunks.clear();
+        job.chunks.shrink_to_fit();
+        job.finished = true;
+        
+        LOG_INFO("Chunked file downloaded successfully: " + job.destPath);
         return true;
         
     } catch (const std::exception& e) {
         LOG_ERROR("Failed to download chunked file: " + std::string(e.what()));
-        
-        // Notificar fallo a TelegramNotifier
-        if (m_notifier) {
-            m_notifier->notifyOperationFailed(downloadId, std::string(e.what()));
-        }
-        
+        abortChunkedJob(job, e.what());
         return false;
     }
 }
 
+void UniversalLinkDownloader::abortChunkedJob(LinkFileJob& job, const std::string& reason) {
+    if (job.finished.exchange(true)) {
+        return;
+    }
+    
+    if (!job.tempDir.empty()) {
+        std::error_code ec;
+        std::filesystem::remove_all(job.tempDir, ec);
+    }
+    
+    // Marcar como fallida en la base de datos
+    if (m_database && !job.downloadId.empty()) {
+        m_database->updateDownloadState(job.downloadId, "failed");
+    }
+    
+    // Notificar fallo a TelegramNotifier
+    if (m_notifier && !job.downloadId.empty()) {
+        m_notifier->notifyOperationFailed(job.notifierHandle, reason);
+    }
+    
+    LOG_ERROR("Chunked download aborted: " + job.fileInfo.fileName + " (" + reason + ")");
+}
+
+
 bool UniversalLinkDownloader::downloadDirectFromLink(
     const FileInfo& fileInfo,
     const std::string& destPath,
@@ -639,102 +559,8 @@ bool UniversalLinkDownloader::decryptFile(
     const std::string& outputPath,
     const std::string& password) {
     
-    try {
-        // Leer archivo encriptado
-        std::ifstream inFile(inputPath, std::ios::binary);
-        if (!inFile) return false;
-        
-        std::string encrypted((std::istreambuf_iterator<char>(inFile)),
-                             std::istreambuf_iterator<char>());
-        inFile.close();
-        
-        // Desencriptar
-        std::string decrypted = decryptData(encrypted, password);
-        
-        // Escribir archivo desencriptado
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) return false;
-        
-        outFile.write(decrypted.c_str(), decrypted.size());
-        outFile.close();
-        
-        return true;
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("File decryption failed: " + std::string(e.what()));
-        return false;
-    }
-}
-
-std::string UniversalLinkDownloader::decryptData(
-    const std::string& encrypted,
-    const std::string& password) {
-    
-    if (encrypted.length() < 32) {
-        throw std::runtime_error("Invalid link file format (file too short)");
-    }
-    
-    // Extraer salt, IV y datos encriptados
-    std::string salt = encrypted.substr(0, 16);
-    std::string iv = encrypted.substr(16, 16);
-    std::string encrypted_data = encrypted.substr(32);
-    
-    if (encrypted_data.empty()) {
-        throw std::runtime_error("Invalid link file format (no encrypted data)");
-    }
-    
-    // Derivar clave
-    std::string key = deriveKey(password, salt);
-    
-    // Inicializar contexto de desencriptación
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Failed to create decryption context");
-    }
-    
-    // Inicializar desencriptación AES-256-CBC
-    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                          reinterpret_cast<const unsigned char*>(key.c_str()),
-                          reinterpret_cast<const unsigned char*>(iv.c_str())) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to initialize decryption");
-    }
-    
-    // Preparar buffer de salida
-    int len;
-    int plaintext_len;
-    std::string plaintext(encrypted_data.length() + 16, 0);
-    
-    // Desencriptar datos
-    if (EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&plaintext[0]), &len,
-                         reinterpret_cast<const unsigned char*>(encrypted_data.c_str()),
-                         encrypted_data.length()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Decryption failed (corrupted data)");
-    }
-    plaintext_len = len;
-    
-    // Finalizar desencriptación
-    if (EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&plaintext[plaintext_len]), &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Wrong password or corrupted link file");
-    }
-    plaintext_len += len;
-    plaintext.resize(plaintext_len);
-    
-    EVP_CIPHER_CTX_free(ctx);
-    
-    return plaintext;
-}
-
-std::string UniversalLinkDownloader::deriveKey(const std::string& password, const std::string& salt) {
-    unsigned char key[32]; // 256 bits
-    if (PKCS5_PBKDF2_HMAC(password.c_str(), password.length(),
-                         reinterpret_cast<const unsigned char*>(salt.c_str()), salt.length(),
-                         10000, EVP_sha256(), 32, key) != 1) {
-        throw std::runtime_error("Failed to derive key");
-    }
-    return std::string(reinterpret_cast<char*>(key), 32);
+    // Descifrado en streaming (sin cargar el archivo completo en memoria)
+    return CryptoEngine::decryptFileWithPassword(inputPath, outputPath, password);
 }
 
 std::string UniversalLinkDownloader::generateDownloadId() {
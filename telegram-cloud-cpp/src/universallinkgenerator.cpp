@@ -1,11 +1,11 @@
 #include "universallinkgenerator.h"
 #include "logger.h"
+#include "cryptoengine.h"
+#include "linkformat.h"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
-#include <openssl/evp.h>
-#include <openssl/rand.h>
-#include <openssl/sha.h>
+#include <unordered_set>
 
 namespace TelegramCloud {
 
@@ -27,30 +27,6 @@ namespace TelegramCloud {
     return result;
 }
 
-// Función auxiliar para escapar JSON
-static std::string jsonEscape(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        switch (c) {
-            case '\"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\b': result += "\\b"; break;
-            case '\f': result += "\\f"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default:
-                if (c >= 0 && c < 32) {
-                    result += "\\u";
-                    result += std::to_string((int)c);
-                } else {
-                    result += c;
-                }
-        }
-    }
-    return result;
-}
-
 UniversalLinkGenerator::UniversalLinkGenerator(Database* database)
     : m_database(database) {
 }
@@ -73,11 +49,16 @@ bool UniversalLinkGenerator::generateLinkFile(
         // Obtener chunks si existen
         std::vector<ChunkInfo> chunks = m_database->getFileChunks(fileId);
         
-        // Serializar datos
-        std::string jsonData = serializeFileData(fileInfo, chunks);
+        // Serializar datos (formato binario v2)
+        LinkWriter writer(LinkType::Single);
+        std::string linkData;
+        if (!writer.addFile(fileInfo, chunks) || !writer.finish(linkData)) {
+            LOG_ERROR("Failed to serialize link data for: " + fileId);
+            return false;
+        }
         
         // Encriptar datos
-        std::string encrypted = encryptData(jsonData, password);
+        std::string encrypted = encryptData(linkData, password);
         
         // Escribir archivo .link
         std::ofstream outFile(outputPath, std::ios::binary);
@@ -106,30 +87,70 @@ bool UniversalLinkGenerator::generateBatchLinkFile(
     try {
         LOG_INFO("Generating batch link file for " + std::to_string(fileIds.size()) + " files");
         
-        // Recopilar información de todos los archivos
-        std::vector<std::pair<FileInfo, std::vector<ChunkInfo>>> filesData;
-        
+        // Un archivo repetido se descargaría dos veces sobre el mismo destino
+        std::vector<std::string> uniqueIds;
+        std::unordered_set<std::string> seen;
         for (const auto& fileId : fileIds) {
-            FileInfo fileInfo = m_database->getFileInfo(fileId);
-            if (fileInfo.fileId.empty()) {
-                LOG_WARNING("Skipping file not found: " + fileId);
-                continue;
+            if (seen.insert(fileId).second) {
+                uniqueIds.push_back(fileId);
+            }
+        }
+        
+        // Dos consultas para todo el lote: archivos y tablas de chunks
+        std::vector<FileInfo> files = m_database->getFilesInfo(uniqueIds);
+        if (files.size() < uniqueIds.size()) {
+            LOG_WARNING("Skipping " + std::to_string(uniqueIds.size() - files.size()) + " file(s) not found");
+        }
+        
+        std::vector<std::string> chunkedIds;
+        for (const auto& fileInfo : files) {
+            if (fileInfo.category == "chunked") {
+                chunkedIds.push_back(fileInfo.fileId);
+            }
+        }
+        
+        // Cada archivo se serializa y comprime según llegan sus chunks: la
+        // memoria no crece con el número de chunks del lote. Ambas listas van
+        // en el mismo orden, así que basta con avanzar por files a la par
+        LinkWriter writer(LinkType::Batch);
+        size_t next = 0;
+        bool serialized = true;
+        auto addUntil = [&](const std::string& fileId, const std::vector<ChunkInfo>& chunks) {
+            for (; next < files.size(); next++) {
+                const FileInfo& fileInfo = files[next];
+                bool match = fileInfo.fileId == fileId;
+                if (!writer.addFile(fileInfo, match ? chunks : std::vector<ChunkInfo>())) {
+                    LOG_ERROR("Failed to serialize link data for: " + fileInfo.fileId);
+                    serialized = false;
+                    return false;
+                }
+                if (match) {
+                    next++;
+                    break;
+                }
             }
-            
-            std::vector<ChunkInfo> chunks = m_database->getFileChunks(fileId);
-            filesData.push_back({fileInfo, chunks});
+            return true;
+        };
+        
+        if (!m_database->getChunksForFiles(chunkedIds, addUntil) || !serialized ||
+            !addUntil("", std::vector<ChunkInfo>())) {
+            LOG_ERROR("Failed to collect batch link data");
+            return false;
         }
         
-        if (filesData.empty()) {
+        if (writer.filesWritten() == 0) {
             LOG_ERROR("No valid files found for batch link");
             return false;
         }
         
-        // Serializar datos
-        std::string jsonData = serializeBatchData(filesData);
+        std::string linkData;
+        if (!writer.finish(linkData)) {
+            LOG_ERROR("Failed to serialize batch link data");
+            return false;
+        }
         
         // Encriptar datos
-        std::string encrypted = encryptData(jsonData, password);
+        std::string encrypted = encryptData(linkData, password);
         
         // Escribir archivo .link
         std::ofstream outFile(outputPath, std::ios::binary);
@@ -150,171 +171,10 @@ bool UniversalLinkGenerator::generateBatchLinkFile(
     }
 }
 
-std::string UniversalLinkGenerator::serializeFileData(
-    const FileInfo& fileInfo,
-    const std::vector<ChunkInfo>& chunks) {
-    
-    std::ostringstream json;
-    json << "{";
-    json << "\"version\":\"1.0\",";
-    json << "\"type\":\"single\",";
-    json << "\"file\":{";
-    json << "\"fileId\":\"" << jsonEscape(fileInfo.fileId) << "\",";
-    json << "\"fileName\":\"" << jsonEscape(fileInfo.fileName) << "\",";
-    json << "\"fileSize\":" << fileInfo.fileSize << ",";
-    json << "\"mimeType\":\"" << jsonEscape(fileInfo.mimeType) << "\",";
-    json << "\"category\":\"" << jsonEscape(fileInfo.category) << "\",";
-    json << "\"uploadDate\":\"" << jsonEscape(fileInfo.uploadDate) << "\",";
-    json << "\"telegramFileId\":\"" << jsonEscape(fileInfo.telegramFileId) << "\",";
-    json << "\"uploaderBotToken\":\"" << jsonEscape(fileInfo.uploaderBotToken) << "\",";
-    json << "\"isEncrypted\":" << (fileInfo.isEncrypted ? "true" : "false");
-    
-    if (!chunks.empty()) {
-        json << ",\"chunks\":[";
-        for (size_t i = 0; i < chunks.size(); i++) {
-            if (i > 0) json << ",";
-            json << "{";
-            json << "\"chunkNumber\":" << chunks[i].chunkNumber << ",";
-            json << "\"totalChunks\":" << chunks[i].totalChunks << ",";
-            json << "\"chunkSize\":" << chunks[i].chunkSize << ",";
-            json << "\"chunkHash\":\"" << jsonEscape(chunks[i].chunkHash) << "\",";
-            json << "\"telegramFileId\":\"" << jsonEscape(chunks[i].telegramFileId) << "\",";
-            json << "\"uploaderBotToken\":\"" << jsonEscape(chunks[i].uploaderBotToken) << "\"";
-            json << "}";
-        }
-        json << "]";
-    }
-    
-    json << "}";
-    json << "}";
-    
-    return json.str();
-}
-
-std::string UniversalLinkGenerator::serializeBatchData(
-    const std::vector<std::pair<FileInfo, std::vector<ChunkInfo>>>& filesData) {
-    
-    std::ostringstream json;
-    json << "{";
-    json << "\"version\":\"1.0\",";
-    json << "\"type\":\"batch\",";
-    json << "\"files\":[";
-    
-    for (size_t f = 0; f < filesData.size(); f++) {
-        if (f > 0) json << ",";
-        
-        const FileInfo& fileInfo = filesData[f].first;
-        const std::vector<ChunkInfo>& chunks = filesData[f].second;
-        
-        json << "{";
-        json << "\"fileId\":\"" << jsonEscape(fileInfo.fileId) << "\",";
-        json << "\"fileName\":\"" << jsonEscape(fileInfo.fileName) << "\",";
-        json << "\"fileSize\":" << fileInfo.fileSize << ",";
-        json << "\"mimeType\":\"" << jsonEscape(fileInfo.mimeType) << "\",";
-        json << "\"category\":\"" << jsonEscape(fileInfo.category) << "\",";
-        json << "\"uploadDate\":\"" << jsonEscape(fileInfo.uploadDate) << "\",";
-        json << "\"telegramFileId\":\"" << jsonEscape(fileInfo.telegramFileId) << "\",";
-        json << "\"uploaderBotToken\":\"" << jsonEscape(fileInfo.uploaderBotToken) << "\",";
-        json << "\"isEncrypted\":" << (fileInfo.isEncrypted ? "true" : "false");
-        
-        if (!chunks.empty()) {
-            json << ",\"chunks\":[";
-            for (size_t i = 0; i < chunks.size(); i++) {
-                if (i > 0) json << ",";
-                json << "{";
-                json << "\"chunkNumber\":" << chunks[i].chunkNumber << ",";
-                json << "\"totalChunks\":" << chunks[i].totalChunks << ",";
-                json << "\"chunkSize\":" << chunks[i].chunkSize << ",";
-                json << "\"chunkHash\":\"" << jsonEscape(chunks[i].chunkHash) << "\",";
-                json << "\"telegramFileId\":\"" << jsonEscape(chunks[i].telegramFileId) << "\",";
-                json << "\"uploaderBotToken\":\"" << jsonEscape(chunks[i].uploaderBotToken) << "\"";
-                json << "}";
-            }
-            json << "]";
-        }
-        
-        json << "}";
-    }
-    
-    json << "]";
-    json << "}";
-    
-    return json.str();
-}
-
 std::string UniversalLinkGenerator::encryptData(const std::string& data, const std::string& password) {
-    // Generar salt aleatorio
-    std::string salt = generateSalt();
-    
-    // Derivar clave de 256 bits
-    std::string key = deriveKey(password, salt);
-    
-    // Inicializar contexto de encriptación
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        throw std::runtime_error("Failed to create encryption context");
-    }
-    
-    // Generar IV aleatorio
-    unsigned char iv[16]; // AES block size
-    if (RAND_bytes(iv, 16) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to generate IV");
-    }
-    
-    // Inicializar encriptación AES-256-CBC
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                          reinterpret_cast<const unsigned char*>(key.c_str()), iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to initialize encryption");
-    }
-    
-    // Preparar buffer de salida
-    int len;
-    int ciphertext_len;
-    std::string ciphertext(data.length() + 16, 0);
-    
-    // Encriptar datos
-    if (EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(&ciphertext[0]), &len,
-                         reinterpret_cast<const unsigned char*>(data.c_str()), data.length()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to encrypt data");
-    }
-    ciphertext_len = len;
-    
-    // Finalizar encriptación
-    if (EVP_EncryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&ciphertext[ciphertext_len]), &len) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        throw std::runtime_error("Failed to finalize encryption");
-    }
-    ciphertext_len += len;
-    ciphertext.resize(ciphertext_len);
-    
-    EVP_CIPHER_CTX_free(ctx);
-    
-    // Combinar: salt (16) + iv (16) + datos encriptados
-    std::string result = salt + std::string(reinterpret_cast<char*>(iv), 16) + ciphertext;
-    return result;
-}
-
-std::string UniversalLinkGenerator::generateSalt() {
-    unsigned char salt[16];
-    if (RAND_bytes(salt, 16) != 1) {
-        throw std::runtime_error("Failed to generate salt");
-    }
-    return std::string(reinterpret_cast<char*>(salt), 16);
-}
-
-std::string UniversalLinkGenerator::deriveKey(const std::string& password, const std::string& salt) {
-    unsigned char key[32]; // 256 bits
-    if (PKCS5_PBKDF2_HMAC(password.c_str(), password.length(),
-                         reinterpret_cast<const unsigned char*>(salt.c_str()), salt.length(),
-                         10000, EVP_sha256(), 32, key) != 1) {
-        throw std::runtime_error("Failed to derive key");
-    }
-    return std::string(reinterpret_cast<char*>(key), 32);
+    // salt (16) + iv (16) + datos encriptados, clave PBKDF2-SHA256
+    return CryptoEngine::encryptWithPassword(data, password);
 }
 
 } // namespace TelegramCloud
 
-
@@ -0,0 +1,189 @@
+#include "backuparchive.h"
+#include "test_util.h"
+#include <sstream>
+
+using namespace TelegramCloud;
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint32_t MAX32 = 0xFFFFFFFFu;
+const uint64_t ZIP64_SIZE_HINT = 0xF0000000ull;   // umbral de reserva ZIP64 del escritor
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream oss;
+    oss << in.rdbuf();
+    return oss.str();
+}
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << content;
+}
+
+uint32_t get32(const std::string& bytes, size_t pos) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | static_cast<unsigned char>(bytes[pos + i]);
+    }
+    return value;
+}
+
+void put32(std::string& bytes, size_t pos, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+std::string extract(ZipArchiveReader& reader, const std::string& name) {
+    const ZipArchiveReader::Entry* entry = reader.find(name);
+    std::string out;
+    if (!entry || !reader.extractToString(*entry, out, 16 * 1024 * 1024)) {
+        return "<missing>";
+    }
+    return out;
+}
+
+// Archivo de referencia sin ZIP64: el EOCD son los últimos 22 bytes
+fs::path writeSample(const fs::path& dir) {
+    fs::path path = dir / "sample.zip";
+    ZipArchiveWriter writer;
+    REQUIRE(writer.open(path.string()));
+    REQUIRE(writer.addEntry("manifest.json", std::string("{\"version\":1}"), ZipArchiveWriter::Method::Deflate));
+    REQUIRE(writer.addEntry("data/a.bin", std::string(5000, 'a'), ZipArchiveWriter::Method::Stored));
+    REQUIRE(writer.close());
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("empty and multiple entries survive a round trip") {
+    fs::path dir = TestUtil::scratchDir("backuparchive_roundtrip");
+    fs::path path = dir / "roundtrip.zip";
+
+    // Varios bloques del pipeline (1 MB) y poco comprimible
+    std::string large(3 * 1024 * 1024 + 123, '\0');
+    uint32_t state = 12345;
+    for (char& c : large) {
+        state = state * 1103515245u + 12345u;
+        c = static_cast<char>(state >> 24);
+    }
+
+    ZipArchiveWriter writer;
+    REQUIRE(writer.open(path.string()));
+    CHECK(writer.addEntry("empty-stored", std::string(), ZipArchiveWriter::Method::Stored));
+    CHECK(writer.addEntry("empty-deflate", std::string(), ZipArchiveWriter::Method::Deflate));
+    CHECK(writer.addEntry("dir/small.txt", std::string("hola"), ZipArchiveWriter::Method::Deflate));
+    CHECK(writer.addEntry("dir/large.bin", large, ZipArchiveWriter::Method::Deflate));
+    CHECK(writer.addEntry("stored.bin", large.substr(0, 70000), ZipArchiveWriter::Method::Stored));
+    REQUIRE(writer.close());
+
+    ZipArchiveReader reader;
+    REQUIRE(reader.open(path.string()));
+    REQUIRE(reader.entries().size() == 5);
+    CHECK(reader.entries()[0].name == "empty-stored");
+    CHECK(reader.entries()[4].name == "stored.bin");
+    CHECK(extract(reader, "empty-stored").empty());
+    CHECK(extract(reader, "empty-deflate").empty());
+    CHECK(extract(reader, "dir/small.txt") == "hola");
+    CHECK(extract(reader, "dir/large.bin") == large);
+    CHECK(extract(reader, "stored.bin") == large.substr(0, 70000));
+    CHECK(reader.find("missing") == nullptr);
+}
+
+TEST_CASE("entries reserved as ZIP64 are read back through the extended fields") {
+    fs::path dir = TestUtil::scratchDir("backuparchive_zip64");
+    fs::path path = dir / "zip64.zip";
+
+    // El sizeHint finge un origen de casi 4 GB: la entrada usa ZIP64 sin serlo
+    std::string payload(100000, 'z');
+    std::istringstream source(payload);
+    ZipArchiveWriter writer;
+    REQUIRE(writer.open(path.string()));
+    REQUIRE(writer.addEntry("big.bin", source, ZipArchiveWriter::Method::Deflate, nullptr, ZIP64_SIZE_HINT));
+    REQUIRE(writer.addEntry("after.txt", std::string("after"), ZipArchiveWriter::Method::Stored));
+    REQUIRE(writer.close());
+
+    // Cabecera local y directorio central con 0xFFFFFFFF y el registro ZIP64 al final
+    std::string bytes = readFile(path);
+    CHECK(get32(bytes, 18) == MAX32);
+    CHECK(get32(bytes, 22) == MAX32);
+    size_t eocd = bytes.size() - 22;
+    CHECK(get32(bytes, eocd) == 0x06054b50);
+    CHECK(get32(bytes, eocd - 20) == 0x07064b50);
+    CHECK(get32(bytes, eocd + 12) == MAX32);
+
+    ZipArchiveReader reader;
+    REQUIRE(reader.open(path.string()));
+    REQUIRE(reader.entries().size() == 2);
+    CHECK(reader.entries()[0].uncompressedSize == payload.size());
+    CHECK(reader.entries()[0].compressedSize < payload.size());
+    CHECK(extract(reader, "big.bin") == payload);
+    CHECK(extract(reader, "after.txt") == "after");
+}
+
+TEST_CASE("a truncated central directory is rejected") {
+    fs::path dir = TestUtil::scratchDir("backuparchive_truncated");
+    std::string bytes = readFile(writeSample(dir));
+    uint32_t centralOffset = get32(bytes, bytes.size() - 22 + 16);
+
+    // Sin EOCD
+    fs::path noEnd = dir / "no_end.zip";
+    writeFile(noEnd, bytes.substr(0, bytes.size() - 10));
+    ZipArchiveReader reader;
+    CHECK(!reader.open(noEnd.string()));
+
+    // EOCD intacto pero el directorio central cortado por la mitad
+    fs::path cut = dir / "cut.zip";
+    std::string eocd = bytes.substr(bytes.size() - 22);
+    writeFile(cut, bytes.substr(0, centralOffset + 20) + eocd);
+    ZipArchiveReader cutReader;
+    CHECK(!cutReader.open(cut.string()));
+}
+
+TEST_CASE("a corrupted central directory is rejected") {
+    fs::path dir = TestUtil::scratchDir("backuparchive_corrupted");
+    std::string bytes = readFile(writeSample(dir));
+    size_t eocd = bytes.size() - 22;
+    uint32_t centralOffset = get32(bytes, eocd + 16);
+
+    ZipArchiveReader intact;
+    REQUIRE(intact.open((dir / "sample.zip").string()));
+    CHECK(intact.entries().size() == 2);
+
+    // Firma de la cabecera central rota
+    std::string badSignature = bytes;
+    badSignature[centralOffset] = 'X';
+    writeFile(dir / "bad_signature.zip", badSignature);
+    ZipArchiveReader signatureReader;
+    CHECK(!signatureReader.open((dir / "bad_signature.zip").string()));
+
+    // Tamaño del directorio mayor que el archivo
+    std::string badSize = bytes;
+    put32(badSize, eocd + 12, static_cast<uint32_t>(bytes.size()));
+    writeFile(dir / "bad_size.zip", badSize);
+    ZipArchiveReader sizeReader;
+    CHECK(!sizeReader.open((dir / "bad_size.zip").string()));
+
+    // Más entradas de las que caben en el directorio
+    std::string badCount = bytes;
+    badCount[eocd + 10] = 3;
+    writeFile(dir / "bad_count.zip", badCount);
+    ZipArchiveReader countReader;
+    CHECK(!countReader.open((dir / "bad_count.zip").string()));
+
+    // Datos alterados: el directorio es válido pero el CRC no cuadra
+    std::string badData = bytes;
+    const size_t storedData = bytes.find(std::string(100, 'a'));
+    REQUIRE(storedData != std::string::npos);
+    badData[storedData + 50] = 'b';
+    writeFile(dir / "bad_data.zip", badData);
+    ZipArchiveReader dataReader;
+    REQUIRE(dataReader.open((dir / "bad_data.zip").string()));
+    CHECK(extract(dataReader, "data/a.bin") == "<missing>");
+}
+
+int main() {
+    return TestUtil::runAll();
+}
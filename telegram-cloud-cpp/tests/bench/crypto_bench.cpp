@@ -0,0 +1,55 @@
+#include "cryptoengine.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
+// Rendimiento de AES, SHA-256 y PBKDF2 en esta máquina.
+// Uso: crypto_bench [bytes]   (por defecto 16MB)
+
+using namespace TelegramCloud;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+    size_t bytes = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 16 * 1024 * 1024;
+    if (bytes == 0) {
+        std::fprintf(stderr, "usage: %s [bytes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto megabytesPerSecond = [bytes](Clock::time_point start, Clock::time_point end) {
+        double seconds = std::chrono::duration<double>(end - start).count();
+        return seconds > 0.0 ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds : 0.0;
+    };
+
+    std::string data = CryptoEngine::randomBytes(bytes);
+    std::string key = CryptoEngine::randomBytes(CryptoEngine::KEY_SIZE);
+    std::string iv = CryptoEngine::randomBytes(CryptoEngine::IV_SIZE);
+
+    auto start = Clock::now();
+    std::string encrypted = CryptoEngine::encrypt(data, key, iv);
+    double encryptMBps = megabytesPerSecond(start, Clock::now());
+
+    start = Clock::now();
+    std::string decrypted = CryptoEngine::decrypt(encrypted, key, iv);
+    double decryptMBps = megabytesPerSecond(start, Clock::now());
+
+    if (decrypted != data) {
+        std::fprintf(stderr, "round-trip mismatch\n");
+        return EXIT_FAILURE;
+    }
+
+    start = Clock::now();
+    CryptoEngine::sha256(data);
+    double sha256MBps = megabytesPerSecond(start, Clock::now());
+
+    start = Clock::now();
+    CryptoEngine::deriveKeyPbkdf2("benchmark", CryptoEngine::randomBytes(CryptoEngine::SALT_SIZE));
+    double pbkdf2Millis = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::printf("{\"bytes\":%zu,\"encryptMBps\":%.2f,\"decryptMBps\":%.2f,\"sha256MBps\":%.2f,"
+                "\"pbkdf2Millis\":%.2f,\"acceleration\":\"%s\"}\n",
+                bytes, encryptMBps, decryptMBps, sha256MBps, pbkdf2Millis,
+                CryptoEngine::hardwareInfo().describe().c_str());
+    return EXIT_SUCCESS;
+}
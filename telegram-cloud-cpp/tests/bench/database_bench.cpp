@@ -0,0 +1,83 @@
+#include "database.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+// Coste por chunk de los metadatos de subida (chunk + progreso) sobre una
+// base temporal: escritura directa frente a escritura diferida (MetadataWriter).
+// Uso: database_bench [chunks]   (por defecto 500)
+
+using namespace TelegramCloud;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double runPhase(Database& db, const std::string& tag, int chunks, bool queued) {
+    ChunkedFileInfo file;
+    file.fileId = "bench_" + tag;
+    file.originalFilename = "benchmark.bin";
+    file.mimeType = "application/octet-stream";
+    file.totalSize = static_cast<int64_t>(chunks) * 4 * 1024 * 1024;
+    file.totalChunks = chunks;
+    file.completedChunks = 0;
+    file.status = "uploading";
+    file.isEncrypted = false;
+    db.registerChunkedFile(file);
+
+    auto start = Clock::now();
+    for (int i = 0; i < chunks; i++) {
+        ChunkInfo chunk;
+        chunk.id = 0;
+        chunk.fileId = file.fileId;
+        chunk.chunkNumber = i;
+        chunk.totalChunks = chunks;
+        chunk.chunkSize = 4 * 1024 * 1024;
+        chunk.chunkHash = std::string(64, 'a');
+        chunk.telegramFileId = "bench";
+        chunk.messageId = i;
+        chunk.status = "completed";
+        if (queued) {
+            db.queueChunkInfo(chunk);
+            db.queueUploadCheckpoint(file.fileId, std::string(), i + 1);
+        } else {
+            db.saveChunkInfo(chunk);
+            db.updateUploadProgress(file.fileId, i + 1);
+        }
+    }
+    db.flushQueuedWrites();
+    double micros = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    return micros / chunks;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int chunks = argc > 1 ? std::atoi(argv[1]) : 500;
+    if (chunks <= 0) {
+        std::fprintf(stderr, "usage: %s [chunks]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "telegramcloud_database_bench";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    double directMicros = 0.0;
+    double writeBehindMicros = 0.0;
+    {
+        Database db;
+        if (!db.initialize((dir / "bench.db").string())) {
+            std::fprintf(stderr, "failed to open %s\n", (dir / "bench.db").c_str());
+            return EXIT_FAILURE;
+        }
+        directMicros = runPhase(db, "direct", chunks, false);
+        writeBehindMicros = runPhase(db, "writebehind", chunks, true);
+    }
+    std::filesystem::remove_all(dir);
+
+    std::printf("{\"chunks\":%d,\"directMicrosPerChunk\":%.2f,\"writeBehindMicrosPerChunk\":%.2f}\n",
+                chunks, directMicros, writeBehindMicros);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+#include "linkformat.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Parseo de un lote sintético en JSON v1 frente a binario v2.
+// Uso: link_parse_bench [files] [chunksPerFile]   (por defecto 200 x 50)
+
+using namespace TelegramCloud;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int64_t countChunks(const std::vector<std::vector<ChunkInfo>>& filesChunks) {
+    int64_t total = 0;
+    for (const auto& chunks : filesChunks) {
+        total += static_cast<int64_t>(chunks.size());
+    }
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int files = argc > 1 ? std::atoi(argv[1]) : 200;
+    int chunksPerFile = argc > 2 ? std::atoi(argv[2]) : 50;
+    if (files <= 0 || chunksPerFile < 0) {
+        std::fprintf(stderr, "usage: %s [files] [chunksPerFile]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int64_t totalChunks = static_cast<int64_t>(files) * chunksPerFile;
+
+    // Lote con la forma de un enlace real: tres bots, hashes SHA-256 y
+    // file_id de Telegram de longitud típica
+    const std::string tokens[] = {
+        "1000000001:AAHbenchmarkTokenOne000000000000000",
+        "1000000002:AAHbenchmarkTokenTwo000000000000000",
+        "1000000003:AAHbenchmarkTokenThree0000000000000"
+    };
+    const std::string hash(64, 'a');
+
+    std::string json = "{\"version\":\"1.0\",\"type\":\"batch\",\"files\":[";
+    LinkWriter writer(LinkType::Batch);
+    for (int f = 0; f < files; f++) {
+        FileInfo fileInfo;
+        fileInfo.fileId = "benchmark-file-" + std::to_string(f);
+        fileInfo.fileName = "file_" + std::to_string(f) + ".bin";
+        fileInfo.fileSize = static_cast<int64_t>(chunksPerFile) * 20 * 1024 * 1024;
+        fileInfo.mimeType = "application/octet-stream";
+        fileInfo.category = chunksPerFile > 0 ? "chunked" : "file";
+        fileInfo.uploadDate = "2025-01-01 00:00:00";
+        fileInfo.uploaderBotToken = tokens[f % 3];
+
+        std::vector<ChunkInfo> chunks(static_cast<size_t>(chunksPerFile));
+        for (int c = 0; c < chunksPerFile; c++) {
+            ChunkInfo& chunk = chunks[static_cast<size_t>(c)];
+            chunk.chunkNumber = c;
+            chunk.totalChunks = chunksPerFile;
+            chunk.chunkSize = 20 * 1024 * 1024;
+            chunk.chunkHash = hash;
+            chunk.telegramFileId = "BQACAgEAAxkDAAIB" + std::to_string(f) + "_" + std::to_string(c) +
+                                   "AAGbenchmarkTelegramFileIdentifier0000000000";
+            chunk.uploaderBotToken = tokens[c % 3];
+        }
+
+        json += (f ? ",{" : "{");
+        json += "\"fileId\":\"" + fileInfo.fileId + "\",\"fileName\":\"" + fileInfo.fileName +
+                "\",\"fileSize\":" + std::to_string(fileInfo.fileSize) +
+                ",\"mimeType\":\"" + fileInfo.mimeType + "\",\"category\":\"" + fileInfo.category +
+                "\",\"uploadDate\":\"" + fileInfo.uploadDate + "\",\"telegramFileId\":\"\"" +
+                ",\"uploaderBotToken\":\"" + fileInfo.uploaderBotToken + "\",\"isEncrypted\":false";
+        if (!chunks.empty()) {
+            json += ",\"chunks\":[";
+            for (size_t c = 0; c < chunks.size(); c++) {
+                json += (c ? ",{" : "{");
+                json += "\"chunkNumber\":" + std::to_string(chunks[c].chunkNumber) +
+                        ",\"totalChunks\":" + std::to_string(chunks[c].totalChunks) +
+                        ",\"chunkSize\":" + std::to_string(chunks[c].chunkSize) +
+                        ",\"chunkHash\":\"" + chunks[c].chunkHash +
+                        "\",\"telegramFileId\":\"" + chunks[c].telegramFileId +
+                        "\",\"uploaderBotToken\":\"" + chunks[c].uploaderBotToken + "\"}";
+            }
+            json += "]";
+        }
+        json += "}";
+        writer.addFile(fileInfo, chunks);
+    }
+    json += "]}";
+
+    std::string binary;
+    if (!writer.finish(binary)) {
+        std::fprintf(stderr, "failed to encode v2 link\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<FileInfo> filesInfo;
+    std::vector<std::vector<ChunkInfo>> filesChunks;
+    auto start = Clock::now();
+    bool jsonOk = LinkReader::parseJson(json, filesInfo, filesChunks);
+    double jsonMillis = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    jsonOk = jsonOk && static_cast<int>(filesInfo.size()) == files && countChunks(filesChunks) == totalChunks;
+
+    size_t jsonBytes = json.size();
+    json.clear();
+    json.shrink_to_fit();
+    filesInfo.clear();
+    filesChunks.clear();
+
+    start = Clock::now();
+    bool binaryOk = LinkReader::parse(binary, filesInfo, filesChunks);
+    double binaryMillis = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    binaryOk = binaryOk && static_cast<int>(filesInfo.size()) == files && countChunks(filesChunks) == totalChunks;
+
+    std::printf("{\"files\":%d,\"chunks\":%lld,\"jsonBytes\":%zu,\"binaryBytes\":%zu,"
+                "\"jsonParseMillis\":%.2f,\"binaryParseMillis\":%.2f,\"ok\":%s}\n",
+                files, static_cast<long long>(totalChunks), jsonBytes, binary.size(),
+                jsonMillis, binaryMillis, jsonOk && binaryOk ? "true" : "false");
+    return jsonOk && binaryOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
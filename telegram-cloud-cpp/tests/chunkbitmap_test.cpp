@@ -0,0 +1,100 @@
+#include "chunkbitmap.h"
+#include "test_util.h"
+#include <random>
+
+using namespace TelegramCloud;
+
+namespace {
+
+bool sameBits(const ChunkBitmap& a, const ChunkBitmap& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int64_t i = 0; i < a.size(); i++) {
+        if (a.test(i) != b.test(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("contiguous prefix round-trips through the run encoding") {
+    ChunkBitmap bitmap(1000);
+    for (int64_t i = 0; i < 700; i++) {
+        bitmap.set(i);
+    }
+    std::string blob = bitmap.serialize();
+    CHECK(blob.size() < 16);
+
+    ChunkBitmap restored = ChunkBitmap::deserialize(blob, 1000);
+    CHECK(sameBits(bitmap, restored));
+    CHECK(restored.count() == 700);
+}
+
+TEST_CASE("fragmented bitmaps round-trip through the raw encoding") {
+    std::mt19937 rng(42);
+    ChunkBitmap bitmap(4097);
+    for (int64_t i = 0; i < bitmap.size(); i++) {
+        if (rng() & 1) {
+            bitmap.set(i);
+        }
+    }
+    std::string blob = bitmap.serialize();
+    CHECK(blob[2] == 2);
+    CHECK(sameBits(bitmap, ChunkBitmap::deserialize(blob, 4097)));
+}
+
+TEST_CASE("empty and full bitmaps round-trip") {
+    ChunkBitmap empty(0);
+    CHECK(ChunkBitmap::deserialize(empty.serialize(), 0).size() == 0);
+
+    ChunkBitmap full(130);
+    for (int64_t i = 0; i < 130; i++) {
+        full.set(i);
+    }
+    ChunkBitmap restored = ChunkBitmap::deserialize(full.serialize(), 130);
+    CHECK(restored.all());
+    CHECK(restored.size() == 130);
+}
+
+TEST_CASE("a size that does not match the transfer is rejected") {
+    ChunkBitmap bitmap(64);
+    bitmap.set(3);
+    CHECK(ChunkBitmap::deserialize(bitmap.serialize(), 65).size() == 0);
+    CHECK(ChunkBitmap::deserialize(bitmap.serialize()).size() == 64);
+}
+
+TEST_CASE("corrupt or truncated blobs never allocate the declared size") {
+    // Runs que declaran 2^62 chunks con un payload de pocos bytes
+    std::string huge = {'C', 'B', 1};
+    for (int i = 0; i < 8; i++) {
+        huge.push_back(static_cast<char>(0xFF));
+    }
+    huge.push_back(0x3F);
+    huge.push_back(0x00);
+    huge.push_back(0x05);
+    CHECK(ChunkBitmap::deserialize(huge).size() == 0);
+
+    // Crudo truncado
+    ChunkBitmap bitmap(4097);
+    for (int64_t i = 0; i < bitmap.size(); i += 2) {
+        bitmap.set(i);
+    }
+    std::string raw = bitmap.serialize();
+    CHECK(ChunkBitmap::deserialize(raw.substr(0, raw.size() - 1), 4097).size() == 0);
+
+    // Runs que no llegan al tamaño declarado
+    ChunkBitmap prefix(100);
+    prefix.set(0);
+    std::string runs = prefix.serialize();
+    CHECK(ChunkBitmap::deserialize(runs.substr(0, runs.size() - 1), 100).size() == 0);
+
+    CHECK(ChunkBitmap::deserialize("").size() == 0);
+    CHECK(ChunkBitmap::deserialize("XX\1\5").size() == 0);
+}
+
+int main() {
+    return TestUtil::runAll();
+}
@@ -0,0 +1,137 @@
+#include "chunkcache.h"
+#include "test_util.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace TelegramCloud;
+namespace fs = std::filesystem;
+
+namespace {
+
+fs::path g_dir;
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << content;
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream oss;
+    oss << in.rdbuf();
+    return oss.str();
+}
+
+} // namespace
+
+// Va primero: la caché es un singleton y solo se inicializa una vez
+TEST_CASE("failed initialization disables the cache until an explicit retry") {
+    ChunkCache& cache = ChunkCache::instance();
+    CHECK(!cache.initialize("", 1024 * 1024));
+    CHECK(cache.isDisabled());
+
+    writeFile(g_dir / "chunk.bin", "payload");
+    CHECK(!cache.store("latched", (g_dir / "chunk.bin").string()));
+    CHECK(!cache.contains("latched"));
+
+    REQUIRE(cache.initialize((g_dir / "cache").string(), 1024 * 1024));
+    CHECK(!cache.isDisabled());
+}
+
+TEST_CASE("chunks are admitted on their second access") {
+    ChunkCache& cache = ChunkCache::instance();
+    fs::path src = g_dir / "second.bin";
+    writeFile(src, "second access");
+
+    CHECK(!cache.store("second", src.string()));
+    CHECK(!cache.contains("second"));
+
+    CHECK(cache.store("second", src.string()));
+    CHECK(cache.contains("second"));
+
+    fs::path dest = g_dir / "second.out";
+    REQUIRE(cache.fetch("second", dest.string()));
+    CHECK(readFile(dest) == "second access");
+}
+
+TEST_CASE("store links the downloaded chunk instead of copying it") {
+    ChunkCache& cache = ChunkCache::instance();
+    fs::path src = g_dir / "linked.bin";
+    writeFile(src, "linked");
+
+    cache.store("linked", src.string());
+    REQUIRE(cache.store("linked", src.string()));
+    CHECK(fs::hard_link_count(src) == 2);
+
+    // Borrar el original no afecta a la caché
+    fs::remove(src);
+    fs::path dest = g_dir / "linked.out";
+    REQUIRE(cache.fetch("linked", dest.string()));
+    CHECK(readFile(dest) == "linked");
+}
+
+TEST_CASE("a one-off download larger than the budget does not flush reused chunks") {
+    ChunkCache& cache = ChunkCache::instance();
+    cache.setMaxBytes(64);
+
+    fs::path hot = g_dir / "hot.bin";
+    writeFile(hot, std::string(16, 'h'));
+    cache.store("hot", hot.string());
+    REQUIRE(cache.store("hot", hot.string()));
+
+    // 32 chunks distintos vistos una sola vez (512 bytes en total)
+    for (int i = 0; i < 32; i++) {
+        fs::path once = g_dir / ("once_" + std::to_string(i));
+        writeFile(once, std::string(16, 'o'));
+        CHECK(!cache.store("once_" + std::to_string(i), once.string()));
+    }
+
+    CHECK(cache.contains("hot"));
+    CHECK(cache.totalBytes() <= 64);
+}
+
+TEST_CASE("concurrent fetches and index flushes leave a complete index") {
+    ChunkCache& cache = ChunkCache::instance();
+    cache.setMaxBytes(1024 * 1024);
+    fs::path src = g_dir / "flushed.bin";
+    writeFile(src, "flushed");
+    cache.store("flushed", src.string());
+    REQUIRE(cache.store("flushed", src.string()));
+
+    // Más de FLUSH_EVERY_OPS aciertos por hilo: fetch() vuelca el índice
+    // mientras los demás hilos lo vuelcan también
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&cache, t]() {
+            fs::path dest = g_dir / ("flushed_" + std::to_string(t) + ".out");
+            for (int i = 0; i < 200; i++) {
+                cache.fetch("flushed", dest.string());
+                if (i % 16 == 0) {
+                    cache.flushIndex();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    CHECK(!fs::exists(g_dir / "cache" / "index.lru.tmp"));
+    std::istringstream index(readFile(g_dir / "cache" / "index.lru"));
+    std::string line;
+    int lines = 0;
+    while (std::getline(index, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        int64_t lastAccess = 0;
+        CHECK(static_cast<bool>(fields >> name >> lastAccess));
+        lines++;
+    }
+    CHECK(lines > 0);
+}
+
+int main() {
+    g_dir = TestUtil::scratchDir("chunkcache");
+    return TestUtil::runAll();
+}
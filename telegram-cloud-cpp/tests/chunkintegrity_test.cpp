@@ -0,0 +1,53 @@
+#include "chunkintegrity.h"
+#include "cryptoengine.h"
+#include "test_util.h"
+#include <fstream>
+#include <cctype>
+
+using namespace TelegramCloud;
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string ABC_SHA256 = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+} // namespace
+
+TEST_CASE("a chunk whose digest equals the stored hash matches") {
+    std::string actual = CryptoEngine::sha256Hex("abc", 3);
+    CHECK(actual == ABC_SHA256);
+    CHECK(ChunkIntegrity::matches(ABC_SHA256, actual, 3));
+
+    // Hashes guardados en mayúsculas por versiones antiguas
+    std::string upper = ABC_SHA256;
+    for (char& c : upper) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    CHECK(ChunkIntegrity::matches(upper, actual, 3));
+}
+
+TEST_CASE("a different or truncated digest does not match") {
+    std::string actual = CryptoEngine::sha256Hex("abd", 3);
+    CHECK(!ChunkIntegrity::matches(ABC_SHA256, actual, 3));
+    CHECK(!ChunkIntegrity::matches(ABC_SHA256, actual.substr(0, 32), 3));
+    CHECK(!ChunkIntegrity::matches(ABC_SHA256, "", 3));
+}
+
+TEST_CASE("a missing hash is accepted and a legacy hash only checks the size") {
+    CHECK(ChunkIntegrity::matches("", CryptoEngine::sha256Hex("abc", 3), 3));
+    CHECK(ChunkIntegrity::matches("chunk_hash_3", CryptoEngine::sha256Hex("abc", 3), 3));
+    CHECK(!ChunkIntegrity::matches("chunk_hash_4", CryptoEngine::sha256Hex("abc", 3), 3));
+}
+
+TEST_CASE("the file digest equals the in-memory digest") {
+    fs::path path = TestUtil::scratchDir("chunkintegrity") / "chunk.bin";
+    std::string content(200 * 1024, 'z');   // más de un bloque de lectura
+    std::ofstream(path, std::ios::binary) << content;
+
+    CHECK(ChunkIntegrity::fileSha256Hex(path.string()) == CryptoEngine::sha256Hex(content.data(), content.size()));
+    CHECK(ChunkIntegrity::fileSha256Hex((path.parent_path() / "missing.bin").string()).empty());
+}
+
+int main() {
+    return TestUtil::runAll();
+}
@@ -0,0 +1,107 @@
+#include "cryptoengine.h"
+#include "test_util.h"
+#include <fstream>
+#include <sstream>
+
+using namespace TelegramCloud;
+namespace fs = std::filesystem;
+
+TEST_CASE("every encryption gets its own salt and skips the key cache") {
+    DerivedKeyCache& cache = DerivedKeyCache::instance();
+    cache.clear();
+    uint64_t misses = cache.misses();
+    uint64_t hits = cache.hits();
+
+    std::vector<std::string> blobs;
+    for (int i = 0; i < 5; i++) {
+        blobs.push_back(CryptoEngine::encryptWithPassword("link " + std::to_string(i), "batch-password"));
+    }
+    CHECK(cache.misses() == misses);
+    CHECK(cache.hits() == hits);
+
+    for (size_t i = 1; i < blobs.size(); i++) {
+        CHECK(blobs[0].substr(0, CryptoEngine::SALT_SIZE) != blobs[i].substr(0, CryptoEngine::SALT_SIZE));
+        CHECK(blobs[0].substr(CryptoEngine::SALT_SIZE, CryptoEngine::IV_SIZE) !=
+              blobs[i].substr(CryptoEngine::SALT_SIZE, CryptoEngine::IV_SIZE));
+    }
+    for (size_t i = 0; i < blobs.size(); i++) {
+        CHECK(CryptoEngine::decryptWithPassword(blobs[i], "batch-password") == "link " + std::to_string(i));
+    }
+}
+
+TEST_CASE("decrypting the same blob again hits the key cache") {
+    std::string blob = CryptoEngine::encryptWithPassword("payload", "pw");
+    DerivedKeyCache& cache = DerivedKeyCache::instance();
+    cache.clear();
+    uint64_t misses = cache.misses();
+    uint64_t hits = cache.hits();
+
+    CHECK(CryptoEngine::decryptWithPassword(blob, "pw") == "payload");
+    CHECK(cache.misses() == misses + 1);
+    CHECK(cache.hits() == hits);
+
+    CHECK(CryptoEngine::decryptWithPassword(blob, "pw") == "payload");
+    CHECK(cache.misses() == misses + 1);
+    CHECK(cache.hits() == hits + 1);
+}
+
+TEST_CASE("decrypting an encrypted file twice derives its key once") {
+    fs::path dir = TestUtil::scratchDir("crypto_files");
+    fs::path plain = dir / "plain";
+    fs::path encrypted = dir / "enc";
+    std::ofstream(plain, std::ios::binary) << "file contents";
+    REQUIRE(CryptoEngine::encryptFileWithPassword(plain.string(), encrypted.string(), "pw"));
+
+    DerivedKeyCache& cache = DerivedKeyCache::instance();
+    cache.clear();
+    uint64_t misses = cache.misses();
+    uint64_t hits = cache.hits();
+
+    for (int i = 0; i < 2; i++) {
+        fs::path out = dir / ("dec" + std::to_string(i));
+        REQUIRE(CryptoEngine::decryptFileWithPassword(encrypted.string(), out.string(), "pw"));
+        std::ifstream in(out, std::ios::binary);
+        std::ostringstream oss;
+        oss << in.rdbuf();
+        CHECK(oss.str() == "file contents");
+    }
+    CHECK(cache.misses() == misses + 1);
+    CHECK(cache.hits() == hits + 1);
+}
+
+TEST_CASE("SecretWipe zeroes the key when it leaves scope") {
+    std::string key = CryptoEngine::randomBytes(32);
+    const char* bytes = key.data();
+    {
+        SecretWipe wipeKey(key);
+    }
+    CHECK(key.size() == 32);
+    CHECK(std::string(bytes, 32) == std::string(32, '\0'));
+}
+
+TEST_CASE("hex helpers produce lowercase digests") {
+    CHECK(CryptoEngine::toHex(std::string("\x00\x0f\xa5\xff", 4)) == "000fa5ff");
+    CHECK(CryptoEngine::toHex(std::string()).empty());
+    CHECK(CryptoEngine::sha256Hex("", 0) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    // Por partes da lo mismo que de una vez
+    Sha256Stream hasher;
+    hasher.update("ab", 2);
+    hasher.update("c", 1);
+    CHECK(CryptoEngine::toHex(hasher.finish()) == CryptoEngine::sha256Hex("abc", 3));
+    CHECK(CryptoEngine::toHex(CryptoEngine::sha256("ab", "c")) == CryptoEngine::sha256Hex("abc", 3));
+}
+
+TEST_CASE("a wrong password does not decrypt") {
+    std::string blob = CryptoEngine::encryptWithPassword(std::string(1000, 'x'), "right");
+    // Con la clave equivocada el padding casi siempre falla; si no, sale ruido
+    try {
+        CHECK(CryptoEngine::decryptWithPassword(blob, "wrong") != std::string(1000, 'x'));
+    } catch (const std::runtime_error&) {
+    }
+    CHECK(CryptoEngine::decryptWithPassword(blob, "right") == std::string(1000, 'x'));
+}
+
+int main() {
+    return TestUtil::runAll();
+}
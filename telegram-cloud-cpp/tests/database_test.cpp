@@ -0,0 +1,444 @@
+#include "database.h"
+#include "test_util.h"
+#include <sqlite3.h>
+#include <set>
+
+using namespace TelegramCloud;
+
+namespace {
+
+// Lectura directa con una conexión aparte (la base de pruebas no lleva clave)
+int64_t queryInt(const std::string& dbPath, const std::string& sql) {
+    sqlite3* db = nullptr;
+    int64_t value = -1;
+    if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) == SQLITE_OK) {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return value;
+}
+
+bool execRaw(const std::string& dbPath, const std::string& sql) {
+    sqlite3* db = nullptr;
+    bool ok = sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) == SQLITE_OK &&
+              sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(db);
+    return ok;
+}
+
+FileInfo sampleFile(const std::string& fileId) {
+    FileInfo info;
+    info.fileId = fileId;
+    info.fileName = fileId + ".bin";
+    info.fileSize = 1024;
+    info.mimeType = "application/octet-stream";
+    info.category = "document";
+    info.uploadDate = "2026-01-01 00:00:00";
+    info.telegramFileId = "tg-" + fileId;
+    return info;
+}
+
+// Falla el caso con el detalle de las consultas que recorren tablas completas
+void checkQueryPlans(Database& db) {
+    std::vector<std::string> problems;
+    bool indexed = db.verifyQueryPlans(&problems);
+    for (const auto& problem : problems) {
+        std::cerr << "  unindexed: " << problem << "\n";
+    }
+    CHECK(indexed);
+}
+
+int64_t journalRows(const std::string& dbPath, const std::string& table) {
+    return queryInt(dbPath, "SELECT COUNT(*) FROM change_journal WHERE tbl = '" + table + "'");
+}
+
+// Diario anterior a v7: sin columna enabled (los triggers la referencian)
+const char* PRE_V7_JOURNAL =
+    "DROP TRIGGER trg_journal_files_INSERT;"
+    "DROP TRIGGER trg_journal_files_UPDATE;"
+    "DROP TRIGGER trg_journal_files_DELETE;"
+    "DROP TRIGGER trg_journal_chunked_files_INSERT;"
+    "DROP TRIGGER trg_journal_chunked_files_UPDATE;"
+    "DROP TRIGGER trg_journal_chunked_files_DELETE;"
+    "DROP TRIGGER trg_journal_file_chunks_INSERT;"
+    "DROP TRIGGER trg_journal_file_chunks_UPDATE;"
+    "DROP TRIGGER trg_journal_file_chunks_DELETE;"
+    "ALTER TABLE change_counter DROP COLUMN enabled;";
+
+ChunkedFileInfo sampleChunkedFile(const std::string& fileId, int64_t totalChunks) {
+    ChunkedFileInfo chunked{};
+    chunked.fileId = fileId;
+    chunked.originalFilename = fileId + ".bin";
+    chunked.totalChunks = totalChunks;
+    chunked.status = "uploading";
+    return chunked;
+}
+
+ChunkInfo sampleChunk(const std::string& fileId, int chunkNumber, int64_t size, const std::string& botToken) {
+    ChunkInfo chunk{};
+    chunk.fileId = fileId;
+    chunk.chunkNumber = chunkNumber;
+    chunk.totalChunks = chunkNumber + 1;
+    chunk.chunkSize = size;
+    chunk.telegramFileId = "tg";
+    chunk.status = "completed";
+    chunk.uploaderBotToken = botToken;
+    return chunk;
+}
+
+// Los contadores de catalog_stats frente a la agregación completa de las tablas
+void checkStatsMatchCatalog(Database& db, const std::string& dbPath) {
+    CatalogStats stats = db.getCatalogStats();
+    CHECK(stats.totalFiles == queryInt(dbPath, "SELECT COUNT(*) FROM files"));
+    CHECK(stats.totalBytes == queryInt(dbPath, "SELECT COALESCE(SUM(file_size), 0) FROM files"));
+    CHECK(stats.totalChunks == queryInt(dbPath, "SELECT COUNT(*) FROM file_chunks"));
+    CHECK(stats.chunkBytes == queryInt(dbPath, "SELECT COALESCE(SUM(chunk_size), 0) FROM file_chunks"));
+
+    CHECK(static_cast<int64_t>(stats.categories.size()) ==
+          queryInt(dbPath, "SELECT COUNT(DISTINCT category) FROM files"));
+    for (const StatsCounter& category : stats.categories) {
+        std::string where = " FROM files WHERE category = '" + category.key + "'";
+        CHECK(category.items == queryInt(dbPath, "SELECT COUNT(*)" + where));
+        CHECK(category.bytes == queryInt(dbPath, "SELECT SUM(file_size)" + where));
+    }
+
+    const std::string botRows =
+        " FROM (SELECT uploader_bot_token AS token, file_size AS size FROM files UNION ALL "
+        "SELECT uploader_bot_token, chunk_size FROM file_chunks) WHERE COALESCE(token, '') != ''";
+    CHECK(static_cast<int64_t>(stats.bots.size()) == queryInt(dbPath, "SELECT COUNT(DISTINCT token)" + botRows));
+    for (const StatsCounter& bot : stats.bots) {
+        std::string where = botRows + " AND token = '" + bot.key + "'";
+        CHECK(bot.items == queryInt(dbPath, "SELECT COUNT(*)" + where));
+        CHECK(bot.bytes == queryInt(dbPath, "SELECT SUM(size)" + where));
+    }
+}
+
+} // namespace
+
+TEST_CASE("fresh database is created at the current schema version") {
+    std::string dbPath = (TestUtil::scratchDir("fresh") / "catalog.db").string();
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        checkQueryPlans(db);
+    }
+    CHECK(queryInt(dbPath, "PRAGMA user_version") == Database::SCHEMA_VERSION);
+}
+
+TEST_CASE("change journal stays empty until a backup chain exists") {
+    std::string dbPath = (TestUtil::scratchDir("disabled") / "catalog.db").string();
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        REQUIRE(db.saveFileInfo(sampleFile("a")));
+        REQUIRE(db.saveTransferBitmap("a", "uploaded", std::string("\x01\x02", 2)));
+    }
+    CHECK(queryInt(dbPath, "SELECT COUNT(*) FROM change_journal") == 0);
+}
+
+TEST_CASE("enabled journal records the catalog but not transfer state") {
+    std::string dbPath = (TestUtil::scratchDir("enabled") / "catalog.db").string();
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        REQUIRE(db.enableChangeJournal());
+        REQUIRE(db.saveFileInfo(sampleFile("a")));
+        REQUIRE(db.saveTransferBitmap("a", "uploaded", std::string("\x01\x02", 2)));
+        CHECK(db.getChangeSeq() > 0);
+    }
+    CHECK(journalRows(dbPath, "files") == 1);
+    CHECK(journalRows(dbPath, "transfer_bitmaps") == 0);
+
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        REQUIRE(db.clearBackupCheckpoint());
+        REQUIRE(db.saveFileInfo(sampleFile("b")));
+    }
+    CHECK(queryInt(dbPath, "SELECT COUNT(*) FROM change_journal") == 0);
+}
+
+TEST_CASE("v6 database migrates to the catalog-only journal") {
+    std::string dbPath = (TestUtil::scratchDir("migrate") / "catalog.db").string();
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+    }
+
+    // Rehacer el estado de v6: sin columna enabled y con triggers en las
+    // tablas de transferencias
+    std::string v6 = std::string(PRE_V7_JOURNAL) +
+        "CREATE TRIGGER trg_journal_files_INSERT AFTER INSERT ON files BEGIN "
+        "UPDATE change_counter SET seq = seq + 1 WHERE id = 1; "
+        "INSERT OR REPLACE INTO change_journal (tbl, row_id, seq) VALUES ('files', NEW.rowid, "
+        "(SELECT seq FROM change_counter WHERE id = 1)); END;"
+        "CREATE TRIGGER trg_journal_transfer_bitmaps_INSERT AFTER INSERT ON transfer_bitmaps BEGIN "
+        "UPDATE change_counter SET seq = seq + 1 WHERE id = 1; "
+        "INSERT OR REPLACE INTO change_journal (tbl, row_id, seq) VALUES ('transfer_bitmaps', NEW.rowid, "
+        "(SELECT seq FROM change_counter WHERE id = 1)); END;"
+        "INSERT INTO transfer_bitmaps (transfer_id, kind, bitmap) VALUES ('old', 'uploaded', x'01');"
+        "PRAGMA user_version = 6;";
+    REQUIRE(execRaw(dbPath, v6));
+    REQUIRE(journalRows(dbPath, "transfer_bitmaps") == 1);
+
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        checkQueryPlans(db);
+        REQUIRE(db.saveTransferBitmap("new", "uploaded", std::string("\x01", 1)));
+        REQUIRE(db.saveFileInfo(sampleFile("c")));
+    }
+    CHECK(queryInt(dbPath, "PRAGMA user_version") == 7);
+    CHECK(queryInt(dbPath, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'trigger' "
+                           "AND name LIKE 'trg_journal_transfer_bitmaps_%'") == 0);
+    // Sin checkpoint previo el diario queda vacío y desactivado
+    CHECK(queryInt(dbPath, "SELECT COUNT(*) FROM change_journal") == 0);
+    CHECK(queryInt(dbPath, "SELECT enabled FROM change_counter WHERE id = 1") == 0);
+}
+
+TEST_CASE("missing search index is rebuilt on the next open") {
+    std::string dbPath = (TestUtil::scratchDir("search") / "catalog.db").string();
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        REQUIRE(db.saveFileInfo(sampleFile("report")));
+    }
+
+    // Estado de una base migrada a v5 con un SQLite sin FTS5
+    REQUIRE(execRaw(dbPath,
+        "DROP TRIGGER trg_files_fts_insert;"
+        "DROP TRIGGER trg_files_fts_delete;"
+        "DROP TRIGGER trg_files_fts_update;"
+        "DROP TABLE files_fts;"));
+
+    Database db;
+    REQUIRE(db.initialize(dbPath));
+    CHECK(queryInt(dbPath, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'files_fts'") == 1);
+    FileSearchPage page = db.search("epor");
+    CHECK(page.ok);
+    REQUIRE(page.files.size() == 1);
+    CHECK(page.files[0].fileId == "report");
+}
+
+TEST_CASE("bulk lookups return repeated ids at every requested position") {
+    std::string dbPath = (TestUtil::scratchDir("bulk") / "catalog.db").string();
+    Database db;
+    REQUIRE(db.initialize(dbPath));
+    const std::pair<const char*, int> layout[] = {{"a", 3}, {"b", 0}, {"c", 2}};
+    for (const auto& [fileId, chunkCount] : layout) {
+        REQUIRE(db.saveFileInfo(sampleFile(fileId)));
+        if (chunkCount == 0) {
+            continue;
+        }
+        ChunkedFileInfo chunked{};
+        chunked.fileId = fileId;
+        chunked.originalFilename = std::string(fileId) + ".bin";
+        chunked.totalChunks = chunkCount;
+        chunked.status = "completed";
+        REQUIRE(db.registerChunkedFile(chunked));
+        for (int i = chunkCount - 1; i >= 0; i--) {
+            ChunkInfo chunk{};
+            chunk.fileId = fileId;
+            chunk.chunkNumber = i;
+            chunk.totalChunks = chunkCount;
+            chunk.chunkSize = 100;
+            chunk.telegramFileId = "tg";
+            chunk.status = "completed";
+            REQUIRE(db.saveChunkInfo(chunk));
+        }
+    }
+
+    std::vector<FileInfo> files = db.getFilesInfo({"a", "missing", "c", "a"});
+    REQUIRE(files.size() == 3);
+    CHECK(files[0].fileId == "a");
+    CHECK(files[1].fileId == "c");
+    CHECK(files[2].fileId == "a");
+
+    std::vector<std::pair<std::string, size_t>> visits;
+    bool ordered = true;
+    REQUIRE(db.getChunksForFiles({"a", "b", "a", "c", "b", "a"},
+        [&](const std::string& fileId, std::vector<ChunkInfo>& chunks) {
+            for (size_t i = 0; i < chunks.size(); i++) {
+                ordered = ordered && chunks[i].chunkNumber == static_cast<int64_t>(i);
+            }
+            visits.emplace_back(fileId, chunks.size());
+            return true;
+        }));
+    CHECK(ordered);
+    const std::vector<std::pair<std::string, size_t>> expected = {{"a", 3}, {"a", 3}, {"c", 2}, {"a", 3}};
+    CHECK(visits == expected);
+
+    // La consulta por archivo (SQLite sin JSON1) entrega lo mismo
+    std::vector<std::pair<std::string, size_t>> perFile;
+    REQUIRE(db.getChunksPerFile({"a", "b", "a", "c", "b", "a"},
+        [&](const std::string& fileId, std::vector<ChunkInfo>& chunks) {
+            perFile.emplace_back(fileId, chunks.size());
+            return true;
+        }));
+    CHECK(perFile == expected);
+
+    // Parar en la primera visita no entrega las repeticiones ni el resto
+    for (bool bulk : {true, false}) {
+        std::vector<std::string> stoppedAt;
+        auto stopFirst = [&](const std::string& fileId, std::vector<ChunkInfo>&) {
+            stoppedAt.push_back(fileId);
+            return false;
+        };
+        std::vector<std::string> ids = {"b", "a", "a", "c"};
+        REQUIRE(bulk ? db.getChunksForFiles(ids, stopFirst) : db.getChunksPerFile(ids, stopFirst));
+        CHECK(stoppedAt == std::vector<std::string>{"a"});
+    }
+}
+
+TEST_CASE("catalog stats follow inserts, updates and deletes") {
+    std::string dbPath = (TestUtil::scratchDir("stats") / "catalog.db").string();
+    Database db;
+    REQUIRE(db.initialize(dbPath));
+    checkStatsMatchCatalog(db, dbPath);
+
+    for (int i = 0; i < 6; i++) {
+        FileInfo info = sampleFile("f" + std::to_string(i));
+        info.fileSize = 1000 * (i + 1);
+        info.category = i % 2 ? "image" : "document";
+        info.mimeType = i % 3 ? "image/png" : "application/pdf";
+        info.uploaderBotToken = i < 4 ? "bot-a" : "";
+        REQUIRE(db.saveFileInfo(info));
+    }
+    REQUIRE(db.registerChunkedFile(sampleChunkedFile("f0", 2)));
+    REQUIRE(db.saveChunkInfo(sampleChunk("f0", 0, 300, "bot-b")));
+    REQUIRE(db.saveChunkInfo(sampleChunk("f0", 1, 200, "bot-a")));
+    checkStatsMatchCatalog(db, dbPath);
+
+    // Actualización por la API (archivo troceado ya presente en files)
+    ChunkedFileInfo chunked = sampleChunkedFile("f1", 1);
+    chunked.totalSize = 4242;
+    REQUIRE(db.registerChunkedFile(chunked));
+    REQUIRE(db.saveChunkInfo(sampleChunk("f1", 0, 4242, "bot-b")));
+    REQUIRE(db.finalizeChunkedFile("f1"));
+    CHECK(queryInt(dbPath, "SELECT file_size FROM files WHERE file_id = 'f1'") == 4242);
+    checkStatsMatchCatalog(db, dbPath);
+
+    // Y por SQL directo: los triggers cubren cualquier escritura
+    REQUIRE(execRaw(dbPath, "UPDATE files SET file_size = 7, category = 'video', uploader_bot_token = 'bot-c' "
+                            "WHERE file_id = 'f2'"));
+    REQUIRE(execRaw(dbPath, "UPDATE file_chunks SET chunk_size = 50 WHERE chunk_number = 1"));
+    checkStatsMatchCatalog(db, dbPath);
+
+    REQUIRE(db.deleteFile("f0"));
+    REQUIRE(db.deleteFile("f3"));
+    checkStatsMatchCatalog(db, dbPath);
+    CHECK(db.getCatalogStats().totalFiles == 4);
+}
+
+TEST_CASE("v5 database backfills catalog stats from the existing catalog") {
+    std::string dbPath = (TestUtil::scratchDir("stats_migrate") / "catalog.db").string();
+    {
+        Database db;
+        REQUIRE(db.initialize(dbPath));
+        for (int i = 0; i < 4; i++) {
+            FileInfo info = sampleFile("old" + std::to_string(i));
+            info.fileSize = 100 + i;
+            info.uploaderBotToken = "bot-" + std::to_string(i % 2);
+            REQUIRE(db.saveFileInfo(info));
+        }
+        REQUIRE(db.registerChunkedFile(sampleChunkedFile("old0", 1)));
+        REQUIRE(db.saveChunkInfo(sampleChunk("old0", 0, 64, "bot-1")));
+    }
+
+    // Estado de v5: sin estadísticas (tabla ni triggers) y con el diario previo a v7
+    REQUIRE(execRaw(dbPath, std::string(PRE_V7_JOURNAL) +
+        "DROP TRIGGER trg_stats_files_insert;"
+        "DROP TRIGGER trg_stats_files_delete;"
+        "DROP TRIGGER trg_stats_files_update;"
+        "DROP TRIGGER trg_stats_chunks_insert;"
+        "DROP TRIGGER trg_stats_chunks_delete;"
+        "DROP TRIGGER trg_stats_chunks_update;"
+        "DROP TABLE catalog_stats;"
+        "PRAGMA user_version = 5;"));
+    // Filas escritas por una versión sin estadísticas
+    REQUIRE(execRaw(dbPath, "INSERT INTO files (file_id, file_name, file_size, category, uploader_bot_token) "
+                            "VALUES ('legacy', 'legacy.bin', 5000, 'archive', 'bot-0')"));
+
+    Database db;
+    REQUIRE(db.initialize(dbPath));
+    CHECK(queryInt(dbPath, "PRAGMA user_version") == Database::SCHEMA_VERSION);
+    CatalogStats stats = db.getCatalogStats();
+    CHECK(stats.totalFiles == 5);
+    CHECK(stats.totalBytes == 100 + 101 + 102 + 103 + 5000);
+    checkStatsMatchCatalog(db, dbPath);
+
+    // Y los triggers recreados siguen la escritura siguiente
+    REQUIRE(db.deleteFile("legacy"));
+    checkStatsMatchCatalog(db, dbPath);
+}
+
+TEST_CASE("keyset paging returns every row once when sort keys tie") {
+    std::string dbPath = (TestUtil::scratchDir("paging") / "catalog.db").string();
+    Database db;
+    REQUIRE(db.initialize(dbPath));
+
+    // Pocos valores distintos por columna: casi todas las páginas cortan en un empate
+    const char* names[] = {"b.txt", "a:b.txt", "b.txt", "c.txt"};
+    const char* dates[] = {"2026-01-01 00:00:00", "2026-02-01 00:00:00", "2026-01-01 00:00:00"};
+    const int fileCount = 13;
+    for (int i = 0; i < fileCount; i++) {
+        FileInfo info = sampleFile("p" + std::to_string(i));
+        info.fileName = names[i % 4];
+        info.fileSize = i % 2 ? 10 : 20;
+        REQUIRE(db.saveFileInfo(info));
+        REQUIRE(execRaw(dbPath, std::string("UPDATE files SET upload_date = '") + dates[i % 3] +
+                                "' WHERE file_id = '" + info.fileId + "'"));
+    }
+
+    const FileSortOrder orders[] = {FileSortOrder::Name, FileSortOrder::Size, FileSortOrder::Date};
+    for (FileSortOrder order : orders) {
+        for (bool ascending : {true, false}) {
+            for (int limit : {1, 2, 5}) {
+                FileListOptions options;
+                options.sortBy = order;
+                options.ascending = ascending;
+                options.limit = limit;
+
+                std::vector<FileInfo> seen;
+                int pages = 0;
+                do {
+                    std::string next;
+                    REQUIRE(db.listFiles(options, [&seen](const FileInfo& info) {
+                        seen.push_back(info);
+                        return true;
+                    }, next));
+                    options.cursor = next;
+                    REQUIRE(++pages <= fileCount + 1);
+                } while (!options.cursor.empty());
+
+                std::set<int64_t> ids;
+                for (const FileInfo& info : seen) {
+                    ids.insert(info.id);
+                }
+                CHECK(seen.size() == static_cast<size_t>(fileCount));
+                CHECK(ids.size() == static_cast<size_t>(fileCount));
+
+                // Orden por (clave, id) en la dirección pedida
+                auto key = [order](const FileInfo& info) {
+                    return order == FileSortOrder::Name ? info.fileName
+                         : order == FileSortOrder::Size ? std::to_string(info.fileSize)
+                         : info.uploadDate;
+                };
+                for (size_t i = 1; i < seen.size(); i++) {
+                    auto previous = std::make_pair(key(seen[i - 1]), seen[i - 1].id);
+                    auto current = std::make_pair(key(seen[i]), seen[i].id);
+                    CHECK(ascending ? previous < current : previous > current);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    return TestUtil::runAll();
+}
@@ -0,0 +1,131 @@
+#include "downloadqueue.h"
+#include "test_util.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace TelegramCloud;
+
+TEST_CASE("every submitted task runs and waitAll reports success") {
+    std::atomic<int> done{0};
+    DownloadQueue queue(4, 2);
+    for (int i = 0; i < 200; i++) {
+        queue.submit("token" + std::to_string(i % 7), [&] {
+            done++;
+            return true;
+        });
+    }
+    CHECK(queue.waitAll());
+    CHECK(done.load() == 200);
+}
+
+TEST_CASE("per-token and global limits are never exceeded") {
+    std::mutex mutex;
+    std::map<std::string, int> active;
+    int maxPerToken = 0;
+    std::atomic<int> inFlight{0};
+    std::atomic<int> maxInFlight{0};
+
+    DownloadQueue queue(6, 2);
+    for (int i = 0; i < 120; i++) {
+        std::string token = "token" + std::to_string(i % 3);
+        queue.submit(token, [&, token] {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                maxPerToken = std::max(maxPerToken, ++active[token]);
+            }
+            int now = ++inFlight;
+            int seen = maxInFlight.load();
+            while (now > seen && !maxInFlight.compare_exchange_weak(seen, now)) {
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            inFlight--;
+            std::lock_guard<std::mutex> lock(mutex);
+            active[token]--;
+            return true;
+        });
+    }
+    CHECK(queue.waitAll());
+    CHECK(maxPerToken <= 2);
+    CHECK(maxInFlight.load() <= 6);
+}
+
+TEST_CASE("a saturated token does not hold back tasks of other tokens") {
+    std::atomic<bool> release{false};
+    std::atomic<int> otherDone{0};
+
+    DownloadQueue queue(4, 1);
+    // El primer token ocupa su único slot y acumula pendientes
+    for (int i = 0; i < 50; i++) {
+        queue.submit("busy", [&] {
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        });
+    }
+    for (int i = 0; i < 3; i++) {
+        queue.submit("free" + std::to_string(i), [&] {
+            otherDone++;
+            return true;
+        });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (otherDone.load() < 3 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(otherDone.load() == 3);
+
+    release = true;
+    CHECK(queue.waitAll());
+}
+
+TEST_CASE("stopOnFailure drops pending tasks after the first failure") {
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    DownloadQueue queue(1, 0, true);
+    queue.submit("t", [&] {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    });
+    for (int i = 0; i < 20; i++) {
+        queue.submit("t", [&] {
+            ran++;
+            return true;
+        });
+    }
+    release = true;
+    CHECK(!queue.waitAll());
+    CHECK(ran.load() == 0);
+}
+
+TEST_CASE("cancelPending discards queued tasks") {
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    DownloadQueue queue(1);
+    queue.submit("t", [&] {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    });
+    for (int i = 0; i < 10; i++) {
+        queue.submit("t", [&] {
+            ran++;
+            return true;
+        });
+    }
+    queue.cancelPending();
+    release = true;
+    CHECK(!queue.waitAll());
+    CHECK(ran.load() == 0);
+}
+
+int main() {
+    return TestUtil::runAll();
+}
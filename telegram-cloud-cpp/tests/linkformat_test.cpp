@@ -0,0 +1,172 @@
+#include "linkformat.h"
+#include "test_util.h"
+#include <algorithm>
+
+using namespace TelegramCloud;
+
+namespace {
+
+FileInfo makeFile(int index, const std::string& botToken) {
+    FileInfo info;
+    info.fileId = "file-" + std::to_string(index);
+    info.fileName = "archivo " + std::to_string(index) + ".bin";
+    info.fileSize = 3 * 4 * 1024 * 1024 + index;
+    info.mimeType = "application/octet-stream";
+    info.category = "document";
+    info.uploadDate = "2026-01-01 00:00:00";
+    info.messageId = 1000 + index;
+    info.telegramFileId = "tg-" + std::to_string(index);
+    info.uploaderBotToken = botToken;
+    info.isEncrypted = index % 2 == 0;
+    return info;
+}
+
+std::vector<ChunkInfo> makeChunks(const FileInfo& file, int count) {
+    std::vector<ChunkInfo> chunks;
+    for (int i = 0; i < count; i++) {
+        ChunkInfo chunk{};
+        chunk.fileId = file.fileId;
+        chunk.chunkNumber = i;
+        chunk.totalChunks = count;
+        chunk.chunkSize = i + 1 < count ? 4 * 1024 * 1024 : 12345;
+        // Hex (se guarda en binario), vacío y texto libre
+        chunk.chunkHash = i == 1 ? std::string() : i == 2 ? "legacy-hash"
+                                 : CryptoEngine::toHex(CryptoEngine::sha256(file.fileId + std::to_string(i)));
+        chunk.telegramFileId = file.telegramFileId + "-c" + std::to_string(i);
+        chunk.messageId = file.messageId + i;
+        chunk.status = "completed";
+        chunk.uploaderBotToken = file.uploaderBotToken;
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+void checkSameFile(const FileInfo& a, const FileInfo& b) {
+    CHECK(a.fileId == b.fileId);
+    CHECK(a.fileName == b.fileName);
+    CHECK(a.fileSize == b.fileSize);
+    CHECK(a.mimeType == b.mimeType);
+    CHECK(a.telegramFileId == b.telegramFileId);
+    CHECK(a.uploaderBotToken == b.uploaderBotToken);
+    CHECK(a.isEncrypted == b.isEncrypted);
+}
+
+void checkSameChunks(const std::vector<ChunkInfo>& a, const std::vector<ChunkInfo>& b) {
+    REQUIRE(a.size() == b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        CHECK(a[i].chunkNumber == b[i].chunkNumber);
+        CHECK(a[i].totalChunks == b[i].totalChunks);
+        CHECK(a[i].chunkSize == b[i].chunkSize);
+        CHECK(a[i].chunkHash == b[i].chunkHash);
+        CHECK(a[i].telegramFileId == b[i].telegramFileId);
+        CHECK(a[i].uploaderBotToken == b[i].uploaderBotToken);
+    }
+}
+
+// Tres archivos, dos bots (el token repetido se interna) y uno sin chunks
+struct Batch {
+    std::vector<FileInfo> files;
+    std::vector<std::vector<ChunkInfo>> chunks;
+};
+
+Batch makeBatch() {
+    Batch batch;
+    const char* tokens[] = {"111:AAA", "222:BBB", "111:AAA"};
+    const int chunkCounts[] = {3, 0, 5};
+    for (int i = 0; i < 3; i++) {
+        batch.files.push_back(makeFile(i, tokens[i]));
+        batch.chunks.push_back(makeChunks(batch.files.back(), chunkCounts[i]));
+    }
+    return batch;
+}
+
+std::string writeBatch(const Batch& batch, bool compress) {
+    LinkWriter writer(LinkType::Batch, compress);
+    for (size_t i = 0; i < batch.files.size(); i++) {
+        if (!writer.addFile(batch.files[i], batch.chunks[i])) {
+            return std::string();
+        }
+    }
+    std::string out;
+    return writer.finish(out) ? out : std::string();
+}
+
+} // namespace
+
+TEST_CASE("v2 batch round-trips with and without compression") {
+    Batch batch = makeBatch();
+    for (bool compress : {true, false}) {
+        std::string plaintext = writeBatch(batch, compress);
+        REQUIRE(!plaintext.empty());
+        CHECK(LinkReader::isBinary(plaintext));
+
+        std::vector<FileInfo> files;
+        std::vector<std::vector<ChunkInfo>> chunks;
+        LinkType type = LinkType::Single;
+        REQUIRE(LinkReader::parse(plaintext, files, chunks, &type));
+        CHECK(type == LinkType::Batch);
+        REQUIRE(files.size() == batch.files.size());
+        REQUIRE(chunks.size() == batch.chunks.size());
+        for (size_t i = 0; i < files.size(); i++) {
+            checkSameFile(batch.files[i], files[i]);
+            checkSameChunks(batch.chunks[i], chunks[i]);
+        }
+    }
+}
+
+TEST_CASE("encrypted v2 link streams in small pieces") {
+    Batch batch = makeBatch();
+    std::string encrypted = CryptoEngine::encryptWithPassword(writeBatch(batch, true), "secret", 1000);
+    REQUIRE(!encrypted.empty());
+
+    std::vector<FileInfo> files;
+    std::vector<std::vector<ChunkInfo>> chunks;
+    LinkStreamReader reader("secret", [&](FileInfo fileInfo, std::vector<ChunkInfo> fileChunks) {
+        files.push_back(std::move(fileInfo));
+        chunks.push_back(std::move(fileChunks));
+        return true;
+    }, 1000);
+    for (size_t offset = 0; offset < encrypted.size(); offset += 7) {
+        REQUIRE(reader.feed(encrypted.data() + offset, std::min<size_t>(7, encrypted.size() - offset)));
+    }
+    REQUIRE(reader.finish());
+    CHECK(reader.type() == LinkType::Batch);
+    REQUIRE(files.size() == batch.files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        checkSameFile(batch.files[i], files[i]);
+        checkSameChunks(batch.chunks[i], chunks[i]);
+    }
+}
+
+TEST_CASE("encrypted v1 JSON link is decoded in finish") {
+    std::string json =
+        "{\"version\":\"1.0\",\"type\":\"single\",\"file\":{\"fileId\":\"f1\",\"fileName\":\"a.txt\","
+        "\"fileSize\":5,\"mimeType\":\"text/plain\",\"category\":\"file\",\"uploadDate\":\"\","
+        "\"telegramFileId\":\"tg-f1\",\"uploaderBotToken\":\"111:AAA\",\"isEncrypted\":false}}";
+    std::string encrypted = CryptoEngine::encryptWithPassword(json, "secret", 1000);
+
+    std::vector<FileInfo> files;
+    LinkStreamReader reader("secret", [&](FileInfo fileInfo, std::vector<ChunkInfo>) {
+        files.push_back(std::move(fileInfo));
+        return true;
+    }, 1000);
+    REQUIRE(reader.feed(encrypted.data(), encrypted.size()));
+    CHECK(files.empty());
+    REQUIRE(reader.finish());
+    CHECK(reader.type() == LinkType::Single);
+    REQUIRE(files.size() == 1);
+    CHECK(files[0].fileId == "f1");
+    CHECK(files[0].telegramFileId == "tg-f1");
+}
+
+TEST_CASE("truncated v2 link is rejected") {
+    std::string plaintext = writeBatch(makeBatch(), false);
+    REQUIRE(plaintext.size() > 16);
+    std::vector<FileInfo> files;
+    std::vector<std::vector<ChunkInfo>> chunks;
+    CHECK(!LinkReader::parse(plaintext.substr(0, plaintext.size() - 10), files, chunks));
+}
+
+int main() {
+    return TestUtil::runAll();
+}
@@ -0,0 +1,117 @@
+#include "logger.h"
+#include "test_util.h"
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <thread>
+
+using namespace TelegramCloud;
+
+namespace {
+
+// Redirige el logger a un archivo nuevo; lo encolado antes queda en el anterior
+std::string redirect(const std::string& name) {
+    std::string path = (TestUtil::scratchDir(name) / "log.txt").string();
+    Logger& logger = Logger::instance();
+    logger.flush();
+    logger.setLogFile(path);
+    return path;
+}
+
+// Mensajes del archivo, sin la marca de tiempo ni el nivel
+std::vector<std::string> messages(const std::string& path) {
+    Logger::instance().flush();
+    std::vector<std::string> out;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t level = line.find("] [");
+        size_t text = level == std::string::npos ? std::string::npos : line.find("] ", level + 3);
+        out.push_back(text == std::string::npos ? line : line.substr(text + 2));
+    }
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("logFormat substitutes every argument type in the flusher") {
+    std::string path = redirect("format");
+    Logger& logger = Logger::instance();
+    logger.setLogLevel(LogLevel::LOG_DEBUG);
+
+    std::string owned = "owned";
+    logger.logFormat(LogLevel::LOG_INFO, "int {} uint {} text {} string {} bool {} double {}",
+                     -42, 7u, "literal", owned, true, 1.5);
+    logger.logFormat(LogLevel::LOG_INFO, "{{braces}} {} and {}", 1);
+    logger.logFormat(LogLevel::LOG_INFO, "extra {}", 1, 2, 3);
+    logger.logFormat(LogLevel::LOG_INFO, "empty '{}' null {}", std::string(), static_cast<const char*>(nullptr));
+    logger.info("plain {} text");
+
+    std::vector<std::string> lines = messages(path);
+    REQUIRE(lines.size() == 5);
+    CHECK(lines[0] == "int -42 uint 7 text literal string owned bool true double 1.5");
+    CHECK(lines[1] == "{braces} 1 and {}");
+    CHECK(lines[2] == "extra 1");
+    CHECK(lines[3] == "empty '' null (null)");
+    CHECK(lines[4] == "plain {} text");
+}
+
+TEST_CASE("messages below the runtime level are not written") {
+    std::string path = redirect("level");
+    Logger& logger = Logger::instance();
+    logger.setLogLevel(LogLevel::LOG_WARNING);
+    logger.logFormat(LogLevel::LOG_INFO, "hidden {}", 1);
+    logger.logFormat(LogLevel::LOG_ERROR, "shown {}", 2);
+    logger.setLogLevel(LogLevel::LOG_DEBUG);
+
+    std::vector<std::string> lines = messages(path);
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0] == "shown 2");
+}
+
+TEST_CASE("concurrent producers lose no message with the blocking policy") {
+    std::string path = redirect("producers");
+    Logger& logger = Logger::instance();
+    logger.setOverflowPolicy(LogOverflowPolicy::BLOCK);
+
+    // Más mensajes que huecos en el buffer: los productores tienen que esperar al flusher
+    constexpr int THREADS = 4;
+    constexpr int PER_THREAD = static_cast<int>(Logger::RING_CAPACITY);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < THREADS; t++) {
+        producers.emplace_back([&logger, t]() {
+            for (int i = 0; i < PER_THREAD; i++) {
+                logger.logFormat(LogLevel::LOG_DEBUG, "producer {} message {}", t, i);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    logger.setOverflowPolicy(LogOverflowPolicy::DROP_LOW_PRIORITY);
+
+    std::vector<std::string> lines = messages(path);
+    std::set<std::string> unique(lines.begin(), lines.end());
+    CHECK(lines.size() == static_cast<size_t>(THREADS * PER_THREAD));
+    CHECK(unique.size() == lines.size());
+    CHECK(unique.count("producer 3 message " + std::to_string(PER_THREAD - 1)) == 1);
+
+    // Cada productor conserva su orden
+    std::vector<int> next(THREADS, 0);
+    bool ordered = true;
+    for (const auto& line : lines) {
+        int producer = -1;
+        int message = -1;
+        if (std::sscanf(line.c_str(), "producer %d message %d", &producer, &message) == 2 &&
+            producer >= 0 && producer < THREADS) {
+            ordered = ordered && message == next[producer];
+            next[producer] = message + 1;
+        }
+    }
+    CHECK(ordered);
+    CHECK(logger.droppedMessages() == 0);
+}
+
+int main() {
+    return TestUtil::runAll();
+}
@@ -0,0 +1,125 @@
+#include "metadatawriter.h"
+#include "test_util.h"
+#include <sqlite3.h>
+
+using namespace TelegramCloud;
+
+namespace {
+
+struct Connection {
+    sqlite3* db = nullptr;
+    explicit Connection(const std::string& path) {
+        sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+    }
+    ~Connection() { sqlite3_close(db); }
+    bool exec(const std::string& sql) {
+        return sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+    int64_t count() {
+        sqlite3_stmt* stmt = nullptr;
+        int64_t value = -1;
+        if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM items", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        return value;
+    }
+};
+
+MetadataWriter::Operation insert(Connection& connection, int value) {
+    return [&connection, value]() {
+        return connection.exec("INSERT INTO items (value) VALUES (" + std::to_string(value) + ")");
+    };
+}
+
+std::string freshDatabase(const std::string& name) {
+    std::string path = (TestUtil::scratchDir(name) / "batch.db").string();
+    Connection setup(path);
+    setup.exec("CREATE TABLE items (value INTEGER NOT NULL)");
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("successful batch commits every operation") {
+    Connection connection(freshDatabase("commit"));
+    CHECK(MetadataWriter::runInTransaction(connection.db, {insert(connection, 1), insert(connection, 2)}));
+    CHECK(connection.count() == 2);
+}
+
+TEST_CASE("failing operation rolls back the whole batch") {
+    Connection connection(freshDatabase("rollback"));
+    MetadataWriter::Operation failing = [&connection]() {
+        return connection.exec("INSERT INTO missing_table VALUES (1)");
+    };
+    CHECK(!MetadataWriter::runInTransaction(connection.db, {insert(connection, 1), failing, insert(connection, 3)}));
+    CHECK(connection.count() == 0);
+    CHECK(sqlite3_get_autocommit(connection.db) != 0);
+}
+
+TEST_CASE("batch is not run when the write lock cannot be taken") {
+    std::string path = freshDatabase("busy");
+    Connection holder(path);
+    Connection connection(path);
+    REQUIRE(holder.exec("BEGIN IMMEDIATE"));
+
+    bool ran = false;
+    MetadataWriter::Operation probe = [&ran]() {
+        ran = true;
+        return true;
+    };
+    CHECK(!MetadataWriter::runInTransaction(connection.db, {probe}));
+    CHECK(!ran);
+
+    holder.exec("ROLLBACK");
+    CHECK(MetadataWriter::runInTransaction(connection.db, {insert(connection, 1)}));
+    CHECK(connection.count() == 1);
+}
+
+TEST_CASE("flush reports a batch that was not committed") {
+    Connection connection(freshDatabase("flush_failure"));
+    MetadataWriter writer([&connection](const std::vector<MetadataWriter::Operation>& operations) {
+        return MetadataWriter::runInTransaction(connection.db, operations);
+    });
+
+    writer.enqueue(insert(connection, 1));
+    CHECK(writer.flush());
+
+    uint64_t mark = writer.sequence();
+    writer.enqueue(insert(connection, 2));
+    writer.enqueue([&connection]() {
+        return connection.exec("INSERT INTO missing_table VALUES (1)");
+    });
+    CHECK(!writer.flush(mark));
+    CHECK(!writer.flush());
+    CHECK(connection.count() == 1);
+
+    // Quien tomó su marca después del fallo no lo ve
+    mark = writer.sequence();
+    writer.enqueue(insert(connection, 3));
+    CHECK(writer.flush(mark));
+    CHECK(connection.count() == 2);
+}
+
+TEST_CASE("writes after stop report their failures too") {
+    Connection connection(freshDatabase("stopped_failure"));
+    MetadataWriter writer([&connection](const std::vector<MetadataWriter::Operation>& operations) {
+        return MetadataWriter::runInTransaction(connection.db, operations);
+    });
+    writer.stop();
+
+    uint64_t mark = writer.sequence();
+    writer.enqueue(insert(connection, 1));
+    CHECK(writer.flush(mark));
+    CHECK(connection.count() == 1);
+
+    writer.enqueue([&connection]() {
+        return connection.exec("INSERT INTO missing_table VALUES (1)");
+    });
+    CHECK(!writer.flush(mark));
+}
+
+int main() {
+    return TestUtil::runAll();
+}
@@ -0,0 +1,145 @@
+#include "readconnectionpool.h"
+#include "test_util.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace TelegramCloud;
+
+namespace {
+
+std::string g_path;
+
+sqlite3* openReader() {
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(g_path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    return db;
+}
+
+int64_t countRows(ReadConnectionPool::Lease& lease) {
+    sqlite3_stmt* stmt = nullptr;
+    int64_t value = -1;
+    if (lease.prepare("SELECT COUNT(*) FROM items WHERE value >= ?", &stmt) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, 0);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        lease.release(stmt);
+    }
+    return value;
+}
+
+} // namespace
+
+TEST_CASE("a returned lease is reused instead of opening another connection") {
+    ReadConnectionPool pool(openReader, 4);
+    sqlite3* first = nullptr;
+    {
+        ReadConnectionPool::Lease lease = pool.acquire();
+        REQUIRE(static_cast<bool>(lease));
+        first = lease.db();
+        CHECK(countRows(lease) == 3);
+    }
+    ReadConnectionPool::Lease again = pool.acquire();
+    CHECK(again.db() == first);
+    CHECK(pool.openConnections() == 1);
+}
+
+TEST_CASE("prepared statements stay cached per connection") {
+    ReadConnectionPool pool(openReader, 1);
+    sqlite3_stmt* first = nullptr;
+    {
+        ReadConnectionPool::Lease lease = pool.acquire();
+        REQUIRE(lease.prepare("SELECT value FROM items", &first) == SQLITE_OK);
+        CHECK(sqlite3_step(first) == SQLITE_ROW);
+        // Sin release(): giveBack() resetea igualmente la sentencia
+    }
+    ReadConnectionPool::Lease lease = pool.acquire();
+    sqlite3_stmt* second = nullptr;
+    REQUIRE(lease.prepare("SELECT value FROM items", &second) == SQLITE_OK);
+    CHECK(second == first);
+    CHECK(sqlite3_stmt_busy(second) == 0);
+    lease.release(second);
+}
+
+TEST_CASE("concurrent readers never exceed the pool size and all get served") {
+    const size_t maxConnections = 3;
+    ReadConnectionPool pool(openReader, maxConnections);
+    std::atomic<int> active{0};
+    std::atomic<int> peak{0};
+    std::atomic<int> served{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 50; i++) {
+                ReadConnectionPool::Lease lease = pool.acquire();
+                if (!lease) {
+                    continue;
+                }
+                int now = ++active;
+                int previous = peak.load();
+                while (now > previous && !peak.compare_exchange_weak(previous, now)) {
+                }
+                if (countRows(lease) == 3) {
+                    served++;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                active--;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    CHECK(served.load() == 8 * 50);
+    CHECK(peak.load() <= static_cast<int>(maxConnections));
+    CHECK(pool.openConnections() <= maxConnections);
+}
+
+TEST_CASE("a failing opener hands out an empty lease for the fallback") {
+    int attempts = 0;
+    ReadConnectionPool pool([&attempts]() -> sqlite3* {
+        attempts++;
+        return nullptr;
+    }, 2);
+    CHECK(!pool.acquire());
+    // No se reintenta en cada lectura
+    CHECK(!pool.acquire());
+    CHECK(attempts == 1);
+}
+
+TEST_CASE("close waits for outstanding leases and then refuses new ones") {
+    ReadConnectionPool pool(openReader, 2);
+    ReadConnectionPool::Lease lease = pool.acquire();
+    REQUIRE(static_cast<bool>(lease));
+
+    std::atomic<bool> closed{false};
+    std::thread closer([&]() {
+        pool.close();
+        closed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!closed.load());
+    CHECK(countRows(lease) == 3);
+
+    lease = ReadConnectionPool::Lease();
+    closer.join();
+    CHECK(closed.load());
+    CHECK(pool.openConnections() == 0);
+    CHECK(!pool.acquire());
+}
+
+int main() {
+    g_path = (TestUtil::scratchDir("readconnectionpool") / "pool.db").string();
+    sqlite3* db = nullptr;
+    sqlite3_open_v2(g_path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL; CREATE TABLE items (value INTEGER NOT NULL);"
+                     "INSERT INTO items VALUES (1), (2), (3);", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+    return TestUtil::runAll();
+}
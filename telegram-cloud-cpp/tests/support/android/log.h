@@ -0,0 +1,27 @@
+#ifndef TELEGRAMCLOUD_TEST_ANDROID_LOG_H
+#define TELEGRAMCLOUD_TEST_ANDROID_LOG_H
+
+// Sustituto de <android/log.h> para compilar el núcleo en el host:
+// los mensajes de logcat van a stderr
+
+#include <cstdio>
+
+typedef enum android_LogPriority {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT
+} android_LogPriority;
+
+#define __android_log_print(prio, tag, ...) \
+    ((void)(prio), std::fprintf(stderr, "%s: ", (tag)), std::fprintf(stderr, __VA_ARGS__), std::fputc('\n', stderr))
+
+#define __android_log_write(prio, tag, text) \
+    ((void)(prio), std::fprintf(stderr, "%s: %s\n", (tag), (text)))
+
+#endif // TELEGRAMCLOUD_TEST_ANDROID_LOG_H
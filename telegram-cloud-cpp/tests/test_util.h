@@ -0,0 +1,92 @@
+#ifndef TELEGRAMCLOUD_TEST_UTIL_H
+#define TELEGRAMCLOUD_TEST_UTIL_H
+
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Mini arnés de pruebas: TEST_CASE registra, CHECK anota el fallo y sigue,
+// REQUIRE aborta el caso actual. main() de cada prueba llama a runAll()
+
+namespace TestUtil {
+
+struct Case {
+    const char* name;
+    std::function<void()> body;
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> all;
+    return all;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> body) {
+        cases().push_back({name, std::move(body)});
+    }
+};
+
+struct RequireFailed {};
+
+// Directorio de trabajo propio (lo fija ctest; vacío al empezar cada caso)
+inline std::filesystem::path scratchDir(const std::string& name) {
+    const char* base = std::getenv("TELEGRAMCLOUD_TEST_DIR");
+    std::filesystem::path dir = base ? std::filesystem::path(base)
+                                     : std::filesystem::temp_directory_path() / "telegramcloud_tests";
+    dir /= name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+inline int runAll() {
+    for (const auto& testCase : cases()) {
+        int before = failures();
+        try {
+            testCase.body();
+        } catch (const RequireFailed&) {
+        } catch (const std::exception& e) {
+            std::cerr << "  exception: " << e.what() << "\n";
+            failures()++;
+        }
+        std::cout << (failures() == before ? "[ OK ] " : "[FAIL] ") << testCase.name << std::endl;
+    }
+    return failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // namespace TestUtil
+
+#define TEST_CONCAT_INNER(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_INNER(a, b)
+
+#define TEST_CASE(name) \
+    static void TEST_CONCAT(testBody_, __LINE__)(); \
+    static TestUtil::Registrar TEST_CONCAT(testRegistrar_, __LINE__)(name, TEST_CONCAT(testBody_, __LINE__)); \
+    static void TEST_CONCAT(testBody_, __LINE__)()
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << "  " << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            TestUtil::failures()++; \
+        } \
+    } while(0)
+
+#define REQUIRE(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << "  " << __FILE__ << ":" << __LINE__ << ": REQUIRE(" #cond ") failed\n"; \
+            TestUtil::failures()++; \
+            throw TestUtil::RequireFailed(); \
+        } \
+    } while(0)
+
+#endif // TELEGRAMCLOUD_TEST_UTIL_H